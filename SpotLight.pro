@@ -16,9 +16,85 @@ MOC_DIR=moc
 CONFIG-=app_bundle
 # Auto include all .cpp files in the project src directory (can specifiy individually if required)
 SOURCES+= $$PWD/src/NGLScene.cpp    \
+					$$PWD/src/LightBlock.cpp  \
+					$$PWD/src/TextureBuffer.cpp  \
+					$$PWD/src/ClusterGrid.cpp  \
+					$$PWD/src/SpotState.cpp  \
+					$$PWD/src/SpotAnimator.cpp  \
+					$$PWD/src/SpotSimulation.cpp  \
+					$$PWD/src/OffscreenBenchmark.cpp  \
+					$$PWD/src/FrameProfiler.cpp  \
+					$$PWD/src/ShaderCache.cpp  \
+					$$PWD/src/MappedFile.cpp  \
+					$$PWD/src/MeshFile.cpp  \
+					$$PWD/src/StaticMesh.cpp  \
+					$$PWD/src/LightCuller.cpp  \
+					$$PWD/src/DeferredRenderer.cpp  \
+					$$PWD/src/ShadowAtlas.cpp  \
+					$$PWD/src/FrameCache.cpp  \
+					$$PWD/src/SceneFile.cpp  \
+					$$PWD/src/SpotRecording.cpp  \
+					$$PWD/src/MeshSimplifier.cpp  \
+					$$PWD/src/LodSelector.cpp  \
+					$$PWD/src/InstanceCuller.cpp  \
+					$$PWD/src/DynamicBuffer.cpp  \
+					$$PWD/src/TransformBatch.cpp  \
+					$$PWD/src/ResolutionController.cpp  \
+					$$PWD/src/DynamicResolution.cpp  \
+					$$PWD/src/SpotCurve.cpp  \
+					$$PWD/src/GpuSpotAnimator.cpp  \
+					$$PWD/src/FrameWriter.cpp  \
+					$$PWD/src/FrameCapture.cpp  \
+					$$PWD/src/MeshOptimizer.cpp  \
+					$$PWD/src/FragmentCounter.cpp  \
+					$$PWD/src/JobSystem.cpp  \
+					$$PWD/src/JobGraph.cpp  \
 					$$PWD/src/main.cpp
 # same for the .h files
-HEADERS+= $$PWD/include/NGLScene.h
+HEADERS+= $$PWD/include/NGLScene.h \
+					$$PWD/include/LightBlock.h \
+					$$PWD/include/FrameStats.h \
+					$$PWD/include/LightStd140.h \
+					$$PWD/include/TransformStd140.h \
+					$$PWD/include/TextureBuffer.h \
+					$$PWD/include/SpotCone.h \
+					$$PWD/include/ClusterGrid.h \
+					$$PWD/include/SpotState.h \
+					$$PWD/include/SpotAnimator.h \
+					$$PWD/include/SpotSimulation.h \
+					$$PWD/include/TripleBuffer.h \
+					$$PWD/include/OffscreenBenchmark.h \
+					$$PWD/include/FrameProfiler.h \
+					$$PWD/include/ShaderCache.h \
+					$$PWD/include/MappedFile.h \
+					$$PWD/include/MeshFile.h \
+					$$PWD/include/StaticMesh.h \
+					$$PWD/include/LightCuller.h \
+					$$PWD/include/DeferredRenderer.h \
+					$$PWD/include/ShadowAtlas.h \
+					$$PWD/include/FrameCache.h \
+					$$PWD/include/SceneFile.h \
+					$$PWD/include/SpotRecording.h \
+					$$PWD/include/MeshSimplifier.h \
+					$$PWD/include/LodSelector.h \
+					$$PWD/include/InstanceCuller.h \
+					$$PWD/include/DynamicBuffer.h \
+					$$PWD/include/TransformBatch.h \
+					$$PWD/include/ResolutionController.h \
+					$$PWD/include/DynamicResolution.h \
+					$$PWD/include/SpotParamsStd430.h \
+					$$PWD/include/SpotCurve.h \
+					$$PWD/include/GpuSpotAnimator.h \
+					$$PWD/include/FrameWriter.h \
+					$$PWD/include/FrameCapture.h \
+					$$PWD/include/MeshOptimizer.h \
+					$$PWD/include/PackedVertex.h \
+					$$PWD/include/FragmentCounter.h \
+					$$PWD/include/JobSystem.h \
+					$$PWD/include/JobGraph.h \
+					$$PWD/include/SimdSupport.h \
+					$$PWD/include/Fnv1a.h \
+					$$PWD/include/FenceWait.h
 # and add the include dir into the search path for Qt and make
 INCLUDEPATH +=./include
 # where our exe is going to live (root of project)
@@ -0,0 +1,96 @@
+#ifndef BENCHUTIL_H_
+#define BENCHUTIL_H_
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "LightStd140.h"
+#include "SpotAnimator.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file BenchUtil.h
+/// @brief the scene fixtures and timing loop the stand alone benchmarks share
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the spots hang at the height NGLScene::createLights puts them
+//----------------------------------------------------------------------------------------------------------------------
+constexpr float BENCHSPOTHEIGHT=3.0f;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief spots scattered over the ground the way NGLScene::createLights does, each aimed at a point on its
+/// animation ellipse and given the range SpotAnimator would, in world space
+/// @param [in] _count the number of spots
+/// @param [in] _spread the spots are placed in [-_spread,_spread] in x and z
+/// @param [in] _aimScale the ellipse centres are the spot positions scaled by this, 1 aims each spot near the
+/// ground below it
+/// @param [out] o_lights the spots
+//----------------------------------------------------------------------------------------------------------------------
+inline void randomLights(size_t _count, float _spread, float _aimScale, std::vector<LightStd140> &o_lights)
+{
+  std::mt19937 gen(1234);
+  std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+  std::uniform_real_distribution<float> positive(0.0f,1.0f);
+  o_lights.assign(_count,LightStd140());
+  for(auto &l : o_lights)
+  {
+    float x=unit(gen)*_spread;
+    float z=unit(gen)*_spread;
+    float angle=positive(gen)*static_cast<float>(SpotAnimator::TWOPI);
+    float aim[3]={x*_aimScale+unit(gen)+std::cos(angle)*(unit(gen)*2.0f+0.5f),0.0f,
+                  z*_aimScale+unit(gen)+std::sin(angle)*(unit(gen)*2.0f+0.5f)};
+    float d[3]={aim[0]-x,aim[1]-BENCHSPOTHEIGHT,aim[2]-z};
+    float len=std::sqrt(d[0]*d[0]+d[1]*d[1]+d[2]*d[2]);
+    float cutoff=(positive(gen)*24.0f+0.5f)*3.14159265f/180.0f;
+    l.m_position[0]=x;
+    l.m_position[1]=BENCHSPOTHEIGHT;
+    l.m_position[2]=z;
+    l.m_position[3]=1.0f;
+    for(int i=0; i<3; ++i)
+    {
+      l.m_direction[i]=d[i]/len;
+    }
+    l.m_spotCosCutoff=std::cos(cutoff);
+    l.m_range=SpotAnimator::range(BENCHSPOTHEIGHT,
+                                  SpotAnimator::cosEdge(l.m_direction[1],l.m_spotCosCutoff,std::sin(cutoff)));
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief NGLScene's 45 degree perspective and clip planes at 16:9, column major
+//----------------------------------------------------------------------------------------------------------------------
+inline void projectionMatrix(float *o_m)
+{
+  float f=1.0f/std::tan(0.5f*45.0f*3.14159265f/180.0f);
+  float zNear=0.05f;
+  float zFar=350.0f;
+  float m[16]={f/(16.0f/9.0f),0.0f,0.0f,0.0f,
+               0.0f,f,0.0f,0.0f,
+               0.0f,0.0f,(zFar+zNear)/(zNear-zFar),-1.0f,
+               0.0f,0.0f,2.0f*zFar*zNear/(zNear-zFar),0.0f};
+  std::copy(m,m+16,o_m);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief time a kernel over enough runs for a stable figure whatever the size, after one untimed warm up run
+/// @param [in] _items the items each run processes
+/// @param [in] _budget roughly how many items to process in the measurement
+/// @param [in] _run called with the run number, 0 for the warm up, to set up and process the items
+/// @returns the time per item in ns
+//----------------------------------------------------------------------------------------------------------------------
+template <typename Func>
+double timeNsPerItem(size_t _items, size_t _budget, Func _run)
+{
+  size_t runs=std::max<size_t>(8,_budget/_items);
+  _run(0);
+  auto start=std::chrono::steady_clock::now();
+  for(size_t r=1; r<=runs; ++r)
+  {
+    _run(r);
+  }
+  auto end=std::chrono::steady_clock::now();
+  return std::chrono::duration<double,std::nano>(end-start).count()/(double(runs)*_items);
+}
+
+#endif
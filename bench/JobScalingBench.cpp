@@ -0,0 +1,204 @@
+/****************************************************************************
+Scaling benchmark of the job system. Runs the CPU stages of a frame the way
+NGLScene's frame graph does over a large grid of teapots and many spots,
+moving the lights and the bounds into eye space, culling the lights per
+object and computing the per draw transforms, with the view turning every
+frame so all of it is redone. The graph is run with 1 thread then doubling up
+to the number given, reporting the time per frame, the speedup over one
+thread and the jobs stolen. The light lists and transforms of every run are
+checked against the single thread ones.
+usage : JobScalingBench [max threads (default one per core)] [grid size (default 128)] [lights (default 2048)]
+****************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "BenchUtil.h"
+#include "JobGraph.h"
+#include "JobSystem.h"
+#include "LightCuller.h"
+#include "TransformBatch.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the same teapot bound as NGLScene, the frames timed and the grains NGLScene uses
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static float TEAPOTRADIUS=1.25f;
+constexpr static int FRAMES=30;
+constexpr static size_t BOUNDSGRAIN=1024;
+constexpr static size_t TRANSFORMGRAIN=256;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a column major view orbiting the origin
+//----------------------------------------------------------------------------------------------------------------------
+static void viewMatrix(float _angle, float _distance, float *o_m)
+{
+  float c=std::cos(_angle);
+  float s=std::sin(_angle);
+  float m[16]={c,0.0f,s,0.0f,
+               0.0f,1.0f,0.0f,0.0f,
+               -s,0.0f,c,0.0f,
+               0.0f,-4.0f,-_distance,1.0f};
+  std::copy(m,m+16,o_m);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief _m times the point or direction _v
+//----------------------------------------------------------------------------------------------------------------------
+static void transformPoint(const float *_m, const float *_v, float _w, float *o_r)
+{
+  for(int r=0; r<3; ++r)
+  {
+    o_r[r]=_m[r]*_v[0]+_m[4+r]*_v[1]+_m[8+r]*_v[2]+_m[12+r]*_w;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief everything one run of the frame's stages reads and writes
+//----------------------------------------------------------------------------------------------------------------------
+struct Frame
+{
+  std::vector<LightStd140> m_worldLights;
+  std::vector<BoundingSphere> m_worldBounds;
+  std::vector<LightStd140> m_lights;
+  std::vector<BoundingSphere> m_bounds;
+  LightCuller m_culler;
+  TransformBatch m_transforms;
+  float m_view[16];
+  float m_projection[16];
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the stages of NGLScene's frame graph that have no GL side
+//----------------------------------------------------------------------------------------------------------------------
+static void createGraph(Frame &_frame, JobSystem &_jobs, JobGraph &o_graph)
+{
+  o_graph.clear();
+  size_t lightPack=o_graph.add("lightPack",[&]()
+  {
+    _jobs.parallelFor(0,_frame.m_lights.size(),BOUNDSGRAIN,[&](size_t _begin, size_t _end)
+    {
+      for(size_t i=_begin; i<_end; ++i)
+      {
+        transformPoint(_frame.m_view,_frame.m_worldLights[i].m_position,1.0f,_frame.m_lights[i].m_position);
+        transformPoint(_frame.m_view,_frame.m_worldLights[i].m_direction,0.0f,_frame.m_lights[i].m_direction);
+      }
+    });
+    return true;
+  });
+  size_t lod=o_graph.add("lod",[&]()
+  {
+    _jobs.parallelFor(0,_frame.m_bounds.size(),BOUNDSGRAIN,[&](size_t _begin, size_t _end)
+    {
+      for(size_t i=_begin; i<_end; ++i)
+      {
+        transformPoint(_frame.m_view,_frame.m_worldBounds[i].m_centre,1.0f,_frame.m_bounds[i].m_centre);
+      }
+    });
+    return true;
+  });
+  o_graph.add("transforms",[&]()
+  {
+    _jobs.parallelFor(0,_frame.m_transforms.size(),TRANSFORMGRAIN,[&](size_t _begin, size_t _end)
+    {
+      _frame.m_transforms.transform(_frame.m_view,_frame.m_projection,_begin,_end);
+    });
+    return true;
+  });
+  size_t lightCull=o_graph.add("lightCull",[&]()
+  {
+    _frame.m_culler.cull(_frame.m_lights.data(),_frame.m_lights.size(),_frame.m_bounds.data(),_frame.m_bounds.size());
+    return true;
+  });
+  o_graph.depend(lightCull,lightPack);
+  o_graph.depend(lightCull,lod);
+}
+
+int main(int argc, char **argv)
+{
+  size_t maxThreads= argc > 1 ? std::strtoul(argv[1],nullptr,10) : 0;
+  if(maxThreads == 0)
+  {
+    maxThreads=std::max(1u,std::thread::hardware_concurrency());
+  }
+  int grid= argc > 2 ? std::max(1,std::atoi(argv[2])) : 128;
+  size_t numLights= argc > 3 ? std::strtoul(argv[3],nullptr,10) : 2048;
+
+  Frame frame;
+  for(int iz=0; iz<grid; ++iz)
+  {
+    for(int ix=0; ix<grid; ++ix)
+    {
+      float x=static_cast<float>(2*ix-grid);
+      float z=static_cast<float>(2*iz-grid);
+      frame.m_worldBounds.push_back({{x,0.49f,z},TEAPOTRADIUS});
+      float model[16]={1.0f,0.0f,0.0f,0.0f, 0.0f,1.0f,0.0f,0.0f, 0.0f,0.0f,1.0f,0.0f, x,0.49f,z,1.0f};
+      frame.m_transforms.addModel(model);
+    }
+  }
+  frame.m_bounds=frame.m_worldBounds;
+  // the spots over the grid aimed at the ground near them
+  randomLights(numLights,static_cast<float>(grid),1.0f,frame.m_worldLights);
+  frame.m_lights=frame.m_worldLights;
+  projectionMatrix(frame.m_projection);
+  std::printf("%zu objects, %zu lights, %s transforms, %d frames per run\n",frame.m_bounds.size(),numLights,
+              TransformBatch::kernelName(frame.m_transforms.kernel()),FRAMES);
+
+  // the single thread run's results, every other run must match them
+  std::vector<uint32_t> cells;
+  std::vector<uint32_t> indices;
+  std::vector<char> transforms;
+  double serialMs=0.0;
+  std::printf("%8s %10s %8s %10s %12s %8s\n","threads","ms/frame","speedup","efficiency","steals/frame","match");
+  for(size_t threads=1; threads<=maxThreads; threads= threads < maxThreads ? std::min(threads*2,maxThreads) : threads+1)
+  {
+    JobSystem jobs;
+    jobs.start(threads);
+    frame.m_culler.setJobSystem(&jobs);
+    JobGraph graph;
+    createGraph(frame,jobs,graph);
+    // a couple of frames to wake the workers and size the culler's arrays
+    for(int f=0; f<2; ++f)
+    {
+      viewMatrix(0.0f,static_cast<float>(grid),frame.m_view);
+      graph.run(jobs);
+    }
+    uint64_t steals=jobs.steals();
+    auto start=std::chrono::steady_clock::now();
+    for(int f=0; f<FRAMES; ++f)
+    {
+      viewMatrix(0.05f*f,static_cast<float>(grid),frame.m_view);
+      graph.run(jobs);
+    }
+    auto end=std::chrono::steady_clock::now();
+    double ms=std::chrono::duration<double,std::milli>(end-start).count()/FRAMES;
+    double stealsPerFrame=static_cast<double>(jobs.steals()-steals)/FRAMES;
+    const char *data=frame.m_transforms.data();
+    size_t bytes=frame.m_transforms.size()*frame.m_transforms.stride();
+    bool match=true;
+    if(threads == 1)
+    {
+      serialMs=ms;
+      cells=frame.m_culler.cells();
+      indices=frame.m_culler.indices();
+      transforms.assign(data,data+bytes);
+    }
+    else
+    {
+      match=cells == frame.m_culler.cells() && indices == frame.m_culler.indices() &&
+            std::memcmp(transforms.data(),data,bytes) == 0;
+    }
+    double speedup= ms > 0.0 ? serialMs/ms : 0.0;
+    std::printf("%8zu %10.3f %8.2f %9.0f%% %12.1f %8s\n",threads,ms,speedup,100.0*speedup/threads,stealsPerFrame,
+                match ? "yes" : "NO");
+    frame.m_culler.setJobSystem(nullptr);
+    if(!match)
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/****************************************************************************
+Micro benchmark of the per object light culling. Scatters spots the way
+NGLScene::createLights does over a grid of teapots and reports the time to
+build the per object lists and how many lights each object is left to shade
+compared with looping over every light, which is what the fragment shader
+cost scales with. The lists are first checked against points sampled inside
+each object so the cone test is known never to drop a light that reaches one.
+usage : LightCullBench [max lights (default 4096)] [grid size (default 8)]
+****************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "BenchUtil.h"
+#include "LightCuller.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the same teapot bound and ground plane as NGLScene
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static float TEAPOTRADIUS=1.25f;
+constexpr static float PLANESIZE=30.0f;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief spots aimed out past the grid as well as over it, the spread grows so the density stays about the same
+//----------------------------------------------------------------------------------------------------------------------
+static void randomLights(size_t _count, std::vector<LightStd140> &o_lights)
+{
+  randomLights(_count,3.0f*std::sqrt(std::max(1.0f,_count/8.0f)),4.0f,o_lights);
+}
+
+static void teapotGrid(int _grid, std::vector<BoundingSphere> &o_objects)
+{
+  o_objects.clear();
+  for(int iz=0; iz<_grid; ++iz)
+  {
+    for(int ix=0; ix<_grid; ++ix)
+    {
+      o_objects.push_back({{static_cast<float>(2*ix-_grid),0.49f,static_cast<float>(2*iz-_grid)},TEAPOTRADIUS});
+    }
+  }
+  o_objects.push_back({{0.0f,0.0f,0.0f},0.5f*std::sqrt(2.0f)*PLANESIZE});
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief is a point lit by a light, the exact test the shader makes before the spot falloff
+//----------------------------------------------------------------------------------------------------------------------
+static bool pointLit(const LightStd140 &_light, const float *_p)
+{
+  float v[3]={_p[0]-_light.m_position[0],_p[1]-_light.m_position[1],_p[2]-_light.m_position[2]};
+  float d=std::sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+  if(d > _light.m_range || d == 0.0f)
+  {
+    return d == 0.0f;
+  }
+  float spotDot=(v[0]*_light.m_direction[0]+v[1]*_light.m_direction[1]+v[2]*_light.m_direction[2])/d;
+  return spotDot >= _light.m_spotCosCutoff;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief count lights that reach a sampled point of an object but are missing from its list
+//----------------------------------------------------------------------------------------------------------------------
+static size_t countMissed(const LightCuller &_culler, const std::vector<LightStd140> &_lights,
+                          const std::vector<BoundingSphere> &_objects)
+{
+  std::mt19937 gen(99);
+  std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+  size_t missed=0;
+  std::vector<bool> listed(_lights.size());
+  for(size_t o=0; o<_objects.size(); ++o)
+  {
+    uint32_t count;
+    const uint32_t *lights=_culler.lightsForObject(o,count);
+    if(count == LightCuller::USECLUSTERS)
+    {
+      continue;
+    }
+    std::fill(listed.begin(),listed.end(),false);
+    for(uint32_t i=0; i<count; ++i)
+    {
+      listed[lights[i]]=true;
+    }
+    const BoundingSphere &s=_objects[o];
+    for(int n=0; n<256; ++n)
+    {
+      float p[3];
+      do
+      {
+        p[0]=unit(gen);
+        p[1]=unit(gen);
+        p[2]=unit(gen);
+      } while(p[0]*p[0]+p[1]*p[1]+p[2]*p[2] > 1.0f);
+      for(int i=0; i<3; ++i)
+      {
+        p[i]=s.m_centre[i]+p[i]*s.m_radius;
+      }
+      for(size_t l=0; l<_lights.size(); ++l)
+      {
+        if(!listed[l] && pointLit(_lights[l],p))
+        {
+          ++missed;
+          listed[l]=true;
+        }
+      }
+    }
+  }
+  return missed;
+}
+
+int main(int argc, char **argv)
+{
+  size_t maxLights= argc > 1 ? std::strtoul(argv[1],nullptr,10) : 4096;
+  int grid= argc > 2 ? std::max(1,std::atoi(argv[2])) : 8;
+  std::vector<BoundingSphere> objects;
+  teapotGrid(grid,objects);
+  LightCuller culler;
+
+  {
+    std::vector<LightStd140> lights;
+    randomLights(256,lights);
+    culler.cull(lights.data(),lights.size(),objects.data(),objects.size());
+    std::printf("lights missed by the cone test %zu\n",countMissed(culler,lights,objects));
+  }
+
+  std::printf("%8s %8s %10s %8s %8s %10s %10s\n","lights","objects","cull us","unlit","cluster","per object","% shaded");
+  for(size_t count=8; count<=maxLights; count*=2)
+  {
+    std::vector<LightStd140> lights;
+    randomLights(count,lights);
+    // enough repeats for a stable time whatever the size
+    size_t repeats=std::max<size_t>(4,(size_t(1)<<22)/(count*objects.size()));
+    auto start=std::chrono::steady_clock::now();
+    for(size_t r=0; r<repeats; ++r)
+    {
+      culler.cull(lights.data(),lights.size(),objects.data(),objects.size());
+    }
+    auto end=std::chrono::steady_clock::now();
+    double us=std::chrono::duration<double,std::micro>(end-start).count()/repeats;
+    // lights shaded per fragment of the objects with their own list, against every light as before
+    size_t listed=0;
+    size_t withLists=0;
+    for(size_t o=0; o<objects.size(); ++o)
+    {
+      uint32_t n;
+      culler.lightsForObject(o,n);
+      if(n != LightCuller::USECLUSTERS)
+      {
+        listed+=n;
+        ++withLists;
+      }
+    }
+    double perObject=withLists ? static_cast<double>(listed)/withLists : 0.0;
+    std::printf("%8zu %8zu %10.2f %8zu %8zu %10.2f %10.3f\n",count,objects.size(),us,culler.numUnlit(),
+                culler.numOverflowed(),perObject,100.0*perObject/count);
+  }
+  return EXIT_SUCCESS;
+}
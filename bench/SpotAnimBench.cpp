@@ -0,0 +1,223 @@
+/****************************************************************************
+Micro benchmark of the spot light animation. Compares the original array of
+structures loop from NGLScene::timerEvent (cosf / sinf, trigInterp and aim per
+light) against the structure of arrays SpotAnimator kernels, after checking the
+kernels against each other and the closed form SpotCurve the GPU animation uses
+against the animator stepped tick by tick.
+usage : SpotAnimBench [max lights (default 1048576)]
+****************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "BenchUtil.h"
+#include "SpotAnimator.h"
+#include "SpotCurve.h"
+#include "SpotState.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief mirror of the old SpotData plus the fields of ngl::SpotLight touched by the animation
+//----------------------------------------------------------------------------------------------------------------------
+struct LegacySpot
+{
+  float m_time;
+  float m_radiusX;
+  float m_radiusZ;
+  float m_mix;
+  float m_aimCenter[3];
+  float m_startColour[4];
+  float m_endColour[4];
+  float m_position[4];
+  float m_colour[4];
+  float m_dir[3];
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the loop from the original timerEvent without the shader upload
+//----------------------------------------------------------------------------------------------------------------------
+static void legacyUpdate(std::vector<LegacySpot> &_spots, float _time)
+{
+  for(auto &s : _spots)
+  {
+    float pointOnCircleX=cosf(_time+s.m_time)*s.m_radiusX;
+    float pointOnCircleZ=sinf(_time+s.m_time)*s.m_radiusZ;
+    float p[3]={s.m_aimCenter[0]+pointOnCircleX,0.0f,s.m_aimCenter[2]+pointOnCircleZ};
+    // trigInterp
+    float t=sinf(s.m_mix*1.57079632679f);
+    for(int c=0; c<4; ++c)
+    {
+      s.m_colour[c]=s.m_startColour[c]+(s.m_endColour[c]-s.m_startColour[c])*t;
+    }
+    s.m_mix+=0.05f;
+    if(s.m_mix >= 1.0f)
+    {
+      s.m_mix=0.0f;
+    }
+    // SpotLight::aim
+    float d[3]={p[0]-s.m_position[0],p[1]-s.m_position[1],p[2]-s.m_position[2]};
+    float len=sqrtf(d[0]*d[0]+d[1]*d[1]+d[2]*d[2]);
+    for(int c=0; c<3; ++c)
+    {
+      s.m_dir[c]=d[c]/len;
+    }
+  }
+}
+
+static void randomise(size_t _count, std::vector<LegacySpot> &o_legacy, SpotState &o_state)
+{
+  std::mt19937 gen(1234);
+  std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+  std::uniform_real_distribution<float> positive(0.0f,1.0f);
+  o_legacy.resize(_count);
+  o_state.resize(_count);
+  for(size_t i=0; i<_count; ++i)
+  {
+    LegacySpot &l=o_legacy[i];
+    l.m_position[0]=o_state.m_posX[i]=unit(gen)*3.0f;
+    l.m_position[1]=o_state.m_posY[i]=3.0f;
+    l.m_position[2]=o_state.m_posZ[i]=unit(gen)*3.0f;
+    l.m_position[3]=1.0f;
+    l.m_aimCenter[0]=o_state.m_centreX[i]=unit(gen)*12.0f;
+    l.m_aimCenter[1]=0.0f;
+    l.m_aimCenter[2]=o_state.m_centreZ[i]=unit(gen)*12.0f;
+    l.m_radiusX=o_state.m_radiusX[i]=unit(gen)*2.0f+0.5f;
+    l.m_radiusZ=o_state.m_radiusZ[i]=unit(gen)*2.0f+0.5f;
+    l.m_time=o_state.m_timeOffset[i]=positive(gen)*4.0f+0.6f;
+    l.m_mix=o_state.m_mix[i]=0.0f;
+    float *start[3]={&o_state.m_startR[i],&o_state.m_startG[i],&o_state.m_startB[i]};
+    float *end[3]={&o_state.m_endR[i],&o_state.m_endG[i],&o_state.m_endB[i]};
+    for(int c=0; c<3; ++c)
+    {
+      l.m_startColour[c]=*start[c]=0.4f+0.6f*positive(gen);
+      l.m_endColour[c]=*end[c]=0.4f+0.6f*positive(gen);
+    }
+    l.m_startColour[3]=l.m_endColour[3]=1.0f;
+    float cutoff=(positive(gen)*24.0f+0.5f)*3.14159265f/180.0f;
+    o_state.m_cosCutoff[i]=std::cos(cutoff);
+    o_state.m_sinCutoff[i]=std::sin(cutoff);
+  }
+}
+
+template <typename Func>
+static double timeNsPerLight(size_t _count, Func _func)
+{
+  // aim for roughly 16M light updates per measurement whatever the count
+  return timeNsPerItem(_count,size_t(1)<<24,[&](size_t _tick)
+  {
+    _func(std::fmod(0.2f*_tick,static_cast<float>(SpotAnimator::TWOPI)));
+  });
+}
+
+int main(int argc, char **argv)
+{
+  size_t maxLights= argc > 1 ? std::strtoul(argv[1],nullptr,10) : size_t(1)<<20;
+  const SpotAnimator::Kernel kernels[]={SpotAnimator::Kernel::SCALAR,SpotAnimator::Kernel::SSE2,SpotAnimator::Kernel::AVX2};
+
+  // check the vector kernels agree with the scalar reference before timing them
+  {
+    std::vector<LegacySpot> legacy;
+    SpotState reference;
+    SpotState test;
+    randomise(1003,legacy,reference);
+    SpotAnimator(SpotAnimator::Kernel::SCALAR).update(reference,2.7f);
+    for(auto k : kernels)
+    {
+      if(!SpotAnimator::isSupported(k))
+      {
+        continue;
+      }
+      randomise(1003,legacy,test);
+      SpotAnimator(k).update(test,2.7f);
+      float maxError=0.0f;
+      for(size_t i=0; i<test.size(); ++i)
+      {
+        maxError=std::max({maxError,std::fabs(test.m_dirX[i]-reference.m_dirX[i]),
+                           std::fabs(test.m_dirZ[i]-reference.m_dirZ[i]),
+                           std::fabs(test.m_colourG[i]-reference.m_colourG[i]),
+                           std::fabs(test.m_range[i]-reference.m_range[i])/reference.m_range[i]});
+      }
+      std::printf("%-7s max error vs scalar %g\n",SpotAnimator::kernelName(k),maxError);
+    }
+  }
+
+  // SpotCurve at tick n should be where n steps of the animator leave the spots, and every cone should stay
+  // inside the envelope culled in its place
+  {
+    std::vector<LegacySpot> legacy;
+    SpotState state;
+    randomise(1003,legacy,state);
+    std::vector<SpotParamsStd430> params;
+    SpotCurve::pack(state,params);
+    std::vector<SpotCone> envelopes(params.size());
+    for(size_t i=0; i<params.size(); ++i)
+    {
+      envelopes[i]=SpotCurve::envelope(params[i]);
+    }
+    const float timeStep=0.2f;
+    SpotAnimator animator(SpotAnimator::Kernel::SCALAR);
+    float time=0.0f;
+    float maxError=0.0f;
+    size_t outside=0;
+    for(int tick=0; tick<200; ++tick)
+    {
+      animator.update(state,time);
+      time=std::fmod(time+timeStep,static_cast<float>(SpotAnimator::TWOPI));
+      float angle;
+      float mix;
+      SpotCurve::phase(tick,0.0,timeStep,angle,mix);
+      for(size_t i=0; i<state.size(); ++i)
+      {
+        SpotCurve::Sample s=SpotCurve::evaluate(params[i],angle,mix);
+        maxError=std::max({maxError,std::fabs(s.m_dir[0]-state.m_dirX[i]),std::fabs(s.m_dir[1]-state.m_dirY[i]),
+                           std::fabs(s.m_dir[2]-state.m_dirZ[i]),std::fabs(s.m_colour[0]-state.m_colourR[i]),
+                           std::fabs(s.m_colour[1]-state.m_colourG[i]),std::fabs(s.m_colour[2]-state.m_colourB[i]),
+                           std::fabs(s.m_range-state.m_range[i])/state.m_range[i]});
+        const SpotCone &e=envelopes[i];
+        float cosAxis=s.m_dir[0]*e.m_axis[0]+s.m_dir[1]*e.m_axis[1]+s.m_dir[2]*e.m_axis[2];
+        float reach=std::acos(std::min(cosAxis,1.0f))+std::acos(params[i].m_cutoff[0]);
+        if(s.m_range > e.m_range*1.0001f || (e.m_cosAngle > 0.0f && reach > std::acos(e.m_cosAngle)+1e-4f))
+        {
+          ++outside;
+        }
+      }
+    }
+    std::printf("curve   max error vs stepped %g, %zu cones outside their envelope\n",maxError,outside);
+  }
+
+  std::printf("%10s %12s","lights","legacy ns");
+  for(auto k : kernels)
+  {
+    if(SpotAnimator::isSupported(k))
+    {
+      std::printf(" %12s",SpotAnimator::kernelName(k));
+    }
+  }
+  std::printf("   (ns per light, speedup vs legacy)\n");
+
+  for(size_t count=8; count<=maxLights; count*=8)
+  {
+    std::vector<LegacySpot> legacy;
+    SpotState state;
+    randomise(count,legacy,state);
+    double legacyNs=timeNsPerLight(count,[&](float _t){legacyUpdate(legacy,_t);});
+    std::printf("%10zu %12.2f",count,legacyNs);
+    for(auto k : kernels)
+    {
+      if(!SpotAnimator::isSupported(k))
+      {
+        continue;
+      }
+      SpotAnimator animator(k);
+      double ns=timeNsPerLight(count,[&](float _t){animator.update(state,_t);});
+      std::printf(" %6.2f %4.1fx",ns,legacyNs/ns);
+    }
+    std::printf("\n");
+    if(count < maxLights && count*8 > maxLights)
+    {
+      count=maxLights/8;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+/****************************************************************************
+Micro benchmark of the per draw transforms. Compares the original per object
+path from NGLScene::loadMatricesToShader (build the model from the
+transformation, MV=V*M, MVP=P*MV and a general inverse transpose of MV for the
+normal matrix) against the cached, batched TransformBatch kernels.
+usage : TransformBench [max objects (default 65536)]
+****************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "BenchUtil.h"
+#include "TransformBatch.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief what ngl::Transformation holds for a teapot, a rotation about y, a scale and a position
+//----------------------------------------------------------------------------------------------------------------------
+struct LegacyObject
+{
+  float m_rotation;
+  float m_scale[3];
+  float m_position[3];
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief column major 4x4 multiply, o_r=_a*_b
+//----------------------------------------------------------------------------------------------------------------------
+static void multiply(const float *_a, const float *_b, float *o_r)
+{
+  for(int c=0; c<4; ++c)
+  {
+    for(int r=0; r<4; ++r)
+    {
+      o_r[c*4+r]=_a[r]*_b[c*4]+_a[4+r]*_b[c*4+1]+_a[8+r]*_b[c*4+2]+_a[12+r]*_b[c*4+3];
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the matrix ngl::Transformation::getMatrix builds, scale then rotate then translate
+//----------------------------------------------------------------------------------------------------------------------
+static void modelMatrix(const LegacyObject &_o, float *o_m)
+{
+  float radians=_o.m_rotation*3.14159265f/180.0f;
+  float c=std::cos(radians);
+  float s=std::sin(radians);
+  float m[16]={c*_o.m_scale[0],0.0f,-s*_o.m_scale[0],0.0f,
+               0.0f,_o.m_scale[1],0.0f,0.0f,
+               s*_o.m_scale[2],0.0f,c*_o.m_scale[2],0.0f,
+               _o.m_position[0],_o.m_position[1],_o.m_position[2],1.0f};
+  std::copy(m,m+16,o_m);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the original path, one object at a time with a full inverse for every normal matrix
+//----------------------------------------------------------------------------------------------------------------------
+static void legacyTransforms(const std::vector<LegacyObject> &_objects, const float *_view, const float *_projection,
+                             std::vector<TransformStd140> &o_out)
+{
+  for(size_t i=0; i<_objects.size(); ++i)
+  {
+    TransformStd140 &t=o_out[i];
+    float model[16];
+    modelMatrix(_objects[i],model);
+    multiply(_view,model,t.m_MV);
+    multiply(_projection,t.m_MV,t.m_MVP);
+    // Mat3 normalMatrix=MV; normalMatrix.inverse().transpose();
+    const float *m=t.m_MV;
+    float a=m[0], b=m[4], c=m[8];
+    float d=m[1], e=m[5], f=m[9];
+    float g=m[2], h=m[6], k=m[10];
+    float det=a*(e*k-f*h)-b*(d*k-f*g)+c*(d*h-e*g);
+    float inv=1.0f/det;
+    // the cofactors row by row, over the determinant
+    float n[9]={(e*k-f*h)*inv,-(d*k-f*g)*inv,(d*h-e*g)*inv,
+                -(b*k-c*h)*inv,(a*k-c*g)*inv,-(a*h-b*g)*inv,
+                (b*f-c*e)*inv,-(a*f-c*d)*inv,(a*e-b*d)*inv};
+    for(int col=0; col<3; ++col)
+    {
+      for(int r=0; r<3; ++r)
+      {
+        t.m_normalMatrix[col*4+r]=n[r*3+col];
+      }
+      t.m_normalMatrix[col*4+3]=0.0f;
+    }
+    t.m_objectID=static_cast<int32_t>(i);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief teapots on a grid, every _scaleEvery'th one scaled unevenly so it needs a real inverse
+//----------------------------------------------------------------------------------------------------------------------
+static void randomise(size_t _count, size_t _scaleEvery, std::vector<LegacyObject> &o_objects, TransformBatch &o_batch)
+{
+  std::mt19937 gen(1234);
+  std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+  o_objects.resize(_count);
+  o_batch.clear();
+  o_batch.reserve(_count);
+  for(size_t i=0; i<_count; ++i)
+  {
+    LegacyObject &o=o_objects[i];
+    o.m_rotation=unit(gen)*180.0f;
+    o.m_position[0]=unit(gen)*40.0f;
+    o.m_position[1]=0.49f;
+    o.m_position[2]=unit(gen)*40.0f;
+    bool scaled= _scaleEvery != 0 && i%_scaleEvery == 0;
+    o.m_scale[0]= scaled ? 1.5f : 1.0f;
+    o.m_scale[1]=1.0f;
+    o.m_scale[2]= scaled ? 0.75f : 1.0f;
+    float model[16];
+    modelMatrix(o,model);
+    o_batch.addModel(model);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a camera looking at the origin and a 45 degree perspective
+//----------------------------------------------------------------------------------------------------------------------
+static void camera(float _angle, float *o_view, float *o_projection)
+{
+  float eye[3]={std::cos(_angle)*30.0f,12.0f,std::sin(_angle)*30.0f};
+  float len=std::sqrt(eye[0]*eye[0]+eye[1]*eye[1]+eye[2]*eye[2]);
+  float z[3]={eye[0]/len,eye[1]/len,eye[2]/len};
+  float x[3]={z[2],0.0f,-z[0]};
+  float xl=std::sqrt(x[0]*x[0]+x[2]*x[2]);
+  x[0]/=xl;
+  x[2]/=xl;
+  float y[3]={z[1]*x[2]-z[2]*x[1],z[2]*x[0]-z[0]*x[2],z[0]*x[1]-z[1]*x[0]};
+  float view[16]={x[0],y[0],z[0],0.0f,
+                  x[1],y[1],z[1],0.0f,
+                  x[2],y[2],z[2],0.0f,
+                  -(x[0]*eye[0]+x[1]*eye[1]+x[2]*eye[2]),
+                  -(y[0]*eye[0]+y[1]*eye[1]+y[2]*eye[2]),
+                  -(z[0]*eye[0]+z[1]*eye[1]+z[2]*eye[2]),1.0f};
+  std::copy(view,view+16,o_view);
+  projectionMatrix(o_projection);
+}
+
+template <typename Func>
+static double timeNsPerObject(size_t _count, Func _func)
+{
+  // aim for roughly 4M objects per measurement whatever the count
+  float view[16];
+  float projection[16];
+  return timeNsPerItem(_count,size_t(1)<<22,[&](size_t _frame)
+  {
+    camera(0.01f*_frame,view,projection);
+    _func(view,projection);
+  });
+}
+
+int main(int argc, char **argv)
+{
+  size_t maxObjects= argc > 1 ? std::strtoul(argv[1],nullptr,10) : size_t(1)<<16;
+  const TransformBatch::Kernel kernels[]={TransformBatch::Kernel::SCALAR,TransformBatch::Kernel::SSE2,
+                                          TransformBatch::Kernel::AVX2};
+
+  // check every kernel against the original path, scaled models included, before timing them
+  {
+    std::vector<LegacyObject> objects;
+    std::vector<TransformStd140> reference(1003);
+    float view[16];
+    float projection[16];
+    camera(0.7f,view,projection);
+    for(auto k : kernels)
+    {
+      if(!TransformBatch::isSupported(k))
+      {
+        continue;
+      }
+      TransformBatch batch(k);
+      randomise(1003,7,objects,batch);
+      legacyTransforms(objects,view,projection,reference);
+      batch.transform(view,projection,0,batch.size());
+      float maxError=0.0f;
+      bool idsMatch=true;
+      for(size_t i=0; i<batch.size(); ++i)
+      {
+        const TransformStd140 &a=batch[i];
+        const TransformStd140 &b=reference[i];
+        for(int e=0; e<16; ++e)
+        {
+          maxError=std::max({maxError,std::fabs(a.m_MV[e]-b.m_MV[e]),
+                             std::fabs(a.m_MVP[e]-b.m_MVP[e])/std::max(1.0f,std::fabs(b.m_MVP[e]))});
+        }
+        for(int e=0; e<12; ++e)
+        {
+          maxError=std::max(maxError,std::fabs(a.m_normalMatrix[e]-b.m_normalMatrix[e]));
+        }
+        idsMatch=idsMatch && a.m_objectID == b.m_objectID;
+      }
+      std::printf("%-7s max error vs legacy %g, ids %s, %zu of %zu models inverted\n",
+                  TransformBatch::kernelName(k),maxError,idsMatch ? "match" : "DIFFER",
+                  batch.numInverted(),batch.size());
+    }
+  }
+
+  std::printf("%10s %12s","objects","legacy ns");
+  for(auto k : kernels)
+  {
+    if(TransformBatch::isSupported(k))
+    {
+      std::printf(" %12s",TransformBatch::kernelName(k));
+    }
+  }
+  std::printf("   (ns per object, speedup vs legacy)\n");
+
+  for(size_t count=8; count<=maxObjects; count*=8)
+  {
+    std::vector<LegacyObject> objects;
+    std::vector<TransformStd140> legacy(count);
+    TransformBatch models;
+    randomise(count,0,objects,models);
+    double legacyNs=timeNsPerObject(count,[&](const float *_v, const float *_p)
+    {
+      legacyTransforms(objects,_v,_p,legacy);
+    });
+    std::printf("%10zu %12.2f",count,legacyNs);
+    for(auto k : kernels)
+    {
+      if(!TransformBatch::isSupported(k))
+      {
+        continue;
+      }
+      TransformBatch batch(k);
+      randomise(count,0,objects,batch);
+      double ns=timeNsPerObject(count,[&](const float *_v, const float *_p)
+      {
+        batch.transform(_v,_p,0,batch.size());
+      });
+      std::printf(" %6.2f %4.1fx",ns,legacyNs/ns);
+    }
+    std::printf("\n");
+    if(count < maxObjects && count*8 > maxObjects)
+    {
+      count=maxObjects/8;
+    }
+  }
+  return EXIT_SUCCESS;
+}
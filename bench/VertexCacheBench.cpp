@@ -0,0 +1,157 @@
+/****************************************************************************
+Micro benchmark of the MeshOptimizer reordering and vertex packing. Builds
+the ground plane grid, shuffles its triangles and vertices as a mesh
+exported with no care for the caches would be, and prints the cache misses
+per triangle of the grid order, the shuffled order and the reordered one
+with the time the reordering takes, and the cache lines fetched before and
+after the vertices are put in the order they are used. Then checks the
+precision of the packed layout, the worst angle of the octahedral normals
+over random directions and the worst position error over the plane.
+usage : VertexCacheBench [grid steps (default 180)]
+****************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "MeshOptimizer.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the same grid as MeshFile::writePlane, position, up normal and uv per vertex
+//----------------------------------------------------------------------------------------------------------------------
+static void plane(float _size, uint32_t _steps, std::vector<float> &o_vertices, std::vector<uint32_t> &o_indices)
+{
+  uint32_t columns=_steps+1;
+  o_vertices.clear();
+  o_indices.clear();
+  for(uint32_t z=0; z<columns; ++z)
+  {
+    for(uint32_t x=0; x<columns; ++x)
+    {
+      float u=static_cast<float>(x)/_steps;
+      float v=static_cast<float>(z)/_steps;
+      const float vertex[8]={(u-0.5f)*_size,0.0f,(v-0.5f)*_size,0.0f,1.0f,0.0f,u,v};
+      o_vertices.insert(o_vertices.end(),vertex,vertex+8);
+    }
+  }
+  for(uint32_t z=0; z<_steps; ++z)
+  {
+    for(uint32_t x=0; x<_steps; ++x)
+    {
+      uint32_t a=z*columns+x;
+      const uint32_t quad[6]={a,a+columns,a+1,a+1,a+columns,a+columns+1};
+      o_indices.insert(o_indices.end(),quad,quad+6);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t steps= argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1],nullptr,10)) : 180;
+  steps=std::max(1u,steps);
+  std::vector<float> vertices;
+  std::vector<uint32_t> grid;
+  plane(30.0f,steps,vertices,grid);
+  size_t vertexCount=vertices.size()/8;
+  size_t triangles=grid.size()/3;
+  std::mt19937 rng(1);
+  std::vector<size_t> order(triangles);
+  for(size_t t=0; t<triangles; ++t)
+  {
+    order[t]=t;
+  }
+  std::shuffle(order.begin(),order.end(),rng);
+  // the vertices are shuffled too, for the shuffled triangles only
+  std::vector<uint32_t> renumber(vertexCount);
+  for(size_t v=0; v<vertexCount; ++v)
+  {
+    renumber[v]=static_cast<uint32_t>(v);
+  }
+  std::shuffle(renumber.begin(),renumber.end(),rng);
+  std::vector<float> shuffledVertices(vertices.size());
+  for(size_t v=0; v<vertexCount; ++v)
+  {
+    std::copy_n(&vertices[v*8],8,&shuffledVertices[renumber[v]*8]);
+  }
+  std::vector<uint32_t> shuffled;
+  shuffled.reserve(grid.size());
+  for(size_t t : order)
+  {
+    for(size_t c=0; c<3; ++c)
+    {
+      shuffled.push_back(renumber[grid[t*3+c]]);
+    }
+  }
+
+  std::printf("%u x %u grid, %zu triangles, %zu vertex cache\n",steps,steps,triangles,MeshOptimizer::CACHESIZE);
+  std::printf("%-12s %10s %10s\n","order","acmr","ms");
+  std::printf("%-12s %10.3f %10s\n","grid",MeshOptimizer::acmr(grid,vertexCount),"-");
+  std::printf("%-12s %10.3f %10s\n","shuffled",MeshOptimizer::acmr(shuffled,vertexCount),"-");
+  for(auto source : {&grid,&shuffled})
+  {
+    std::vector<uint32_t> indices=*source;
+    auto start=std::chrono::steady_clock::now();
+    MeshOptimizer::optimizeVertexCache(indices,vertexCount);
+    double ms=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+    std::printf("%-12s %10.3f %10.2f\n",source == &grid ? "grid tipsify" : "shuf tipsify",
+                MeshOptimizer::acmr(indices,vertexCount),ms);
+  }
+  // the 64 byte lines the fetches pull in through a small FIFO, before and after the fetch reorder
+  std::vector<uint32_t> indices=shuffled;
+  MeshOptimizer::optimizeVertexCache(indices,vertexCount);
+  auto lineMisses=[vertexCount](const std::vector<uint32_t> &_indices)
+  {
+    const size_t lines=16;
+    std::vector<size_t> entered(vertexCount*32/64+1,0);
+    size_t misses=0;
+    for(uint32_t v : _indices)
+    {
+      size_t line=v*32/64;
+      if(entered[line] == 0 || misses+1-entered[line] >= lines)
+      {
+        entered[line]=++misses;
+      }
+    }
+    return static_cast<double>(misses)/(_indices.size()/3);
+  };
+  double before=lineMisses(indices);
+  std::vector<float> fetched=shuffledVertices;
+  MeshOptimizer::optimizeVertexFetch(fetched,indices);
+  std::printf("float vertex lines fetched per triangle %.3f before the fetch reorder, %.3f after\n",before,
+              lineMisses(indices));
+
+  std::vector<PackedVertex> packed;
+  MeshOptimizer::pack(fetched,packed);
+  std::printf("vertices %zu KB as floats, %zu KB packed\n",fetched.size()*sizeof(float)/1024,
+              packed.size()*sizeof(PackedVertex)/1024);
+  float positionError=0.0f;
+  for(size_t v=0; v<packed.size(); ++v)
+  {
+    for(int c=0; c<3; ++c)
+    {
+      float error=std::fabs(MeshOptimizer::fromHalf(packed[v].m_position[c])-fetched[v*8+c]);
+      positionError=std::max(positionError,error);
+    }
+  }
+  std::normal_distribution<float> gaussian;
+  float angleError=0.0f;
+  for(int i=0; i<1000000; ++i)
+  {
+    float n[3]={gaussian(rng),gaussian(rng),gaussian(rng)};
+    float length=std::sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+    for(float &c : n)
+    {
+      c/=length;
+    }
+    int16_t e[2];
+    float d[3];
+    MeshOptimizer::octEncode(n,e);
+    MeshOptimizer::octDecode(e,d);
+    float cosine=std::min(1.0f,n[0]*d[0]+n[1]*d[1]+n[2]*d[2]);
+    angleError=std::max(angleError,std::acos(cosine)*180.0f/3.14159265f);
+  }
+  std::printf("worst position error %g, worst normal error %g degrees\n",positionError,angleError);
+  return 0;
+}
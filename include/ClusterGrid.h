@@ -0,0 +1,135 @@
+#ifndef CLUSTERGRID_H_
+#define CLUSTERGRID_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "LightStd140.h"
+#include "SpotCone.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ClusterGrid.h
+/// @brief CPU light assignment for clustered forward shading
+/// @class ClusterGrid
+/// @brief splits the view frustum into screen tiles and exponentially spaced depth slices (froxels) and
+/// builds a compact list of the spot lights whose cone reaches each one. The fragment shader finds its
+/// cluster from gl_FragCoord and the eye space depth and only shades the lights in that list.
+/// NGLScene uploads cells() and indices() to the texture buffers the shader reads, tests/ClusterGridTest.cpp
+/// checks them against a brute force assignment.
+//----------------------------------------------------------------------------------------------------------------------
+class ClusterGrid
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor
+  /// @param [in] _x number of tiles across the screen
+  /// @param [in] _y number of tiles down the screen
+  /// @param [in] _z number of depth slices
+  //----------------------------------------------------------------------------------------------------------------------
+  ClusterGrid(unsigned int _x=16, unsigned int _y=9, unsigned int _z=24);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the symmetric perspective projection the clusters are built for
+  /// @param [in] _xScale element [0][0] of the projection matrix
+  /// @param [in] _yScale element [1][1] of the projection matrix
+  /// @param [in] _near the near clip distance
+  /// @param [in] _far the far clip distance
+  //----------------------------------------------------------------------------------------------------------------------
+  void setProjection(float _xScale, float _yScale, float _near, float _far);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bin the lights into the clusters, positions and directions must be in eye space
+  /// @param [in] _lights the lights to assign
+  /// @param [in] _count the number of lights
+  //----------------------------------------------------------------------------------------------------------------------
+  void assign(const LightStd140 *_lights, size_t _count);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the linear index of a cluster
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t clusterIndex(unsigned int _x, unsigned int _y, unsigned int _z) const
+  {
+    return (static_cast<size_t>(_z)*m_dimY+_y)*m_dimX+_x;
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the depth slice containing an eye space distance, matches the calculation in the shader
+  /// @param [in] _depth the positive distance in front of the camera
+  //----------------------------------------------------------------------------------------------------------------------
+  unsigned int sliceForDepth(float _depth) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the light index list of one cluster
+  /// @param [in] _cluster the linear cluster index
+  /// @param [out] o_count the number of lights in the list
+  /// @returns pointer to the first light index
+  //----------------------------------------------------------------------------------------------------------------------
+  const uint32_t *lightsInCluster(size_t _cluster, uint32_t &o_count) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief per cluster (offset,count) pairs into indices()
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<uint32_t> &cells() const {return m_cells;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the light indices of all clusters packed end to end
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<uint32_t> &indices() const {return m_indices;}
+  inline unsigned int dimX() const {return m_dimX;}
+  inline unsigned int dimY() const {return m_dimY;}
+  inline unsigned int dimZ() const {return m_dimZ;}
+  inline size_t numClusters() const {return m_cellBounds.size();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief slice = log(depth)*zScale()+zBias()
+  //----------------------------------------------------------------------------------------------------------------------
+  inline float zScale() const {return m_zScale;}
+  inline float zBias() const {return m_zBias;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief eye space bounding box of a cluster
+  //----------------------------------------------------------------------------------------------------------------------
+  struct CellBounds
+  {
+    float m_min[3];
+    float m_max[3];
+    BoundingSphere m_sphere;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief rebuild the eye space bounds of every cluster after the projection changes
+  //----------------------------------------------------------------------------------------------------------------------
+  void buildBounds();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the inclusive range of tiles covered by a sphere on one axis
+  /// @param [in] _min the minimum eye space coordinate of the sphere on that axis
+  /// @param [in] _max the maximum eye space coordinate of the sphere on that axis
+  /// @param [in] _nearDepth the closest depth of the sphere
+  /// @param [in] _farDepth the furthest depth of the sphere
+  /// @param [in] _scale the projection scale for the axis
+  /// @param [in] _tiles the number of tiles on the axis
+  /// @param [out] o_first the first tile
+  /// @param [out] o_last the last tile
+  //----------------------------------------------------------------------------------------------------------------------
+  static void tileRange(float _min, float _max, float _nearDepth, float _farDepth, float _scale,
+                        unsigned int _tiles, unsigned int &o_first, unsigned int &o_last);
+
+  unsigned int m_dimX;
+  unsigned int m_dimY;
+  unsigned int m_dimZ;
+  float m_xScale=1.0f;
+  float m_yScale=1.0f;
+  float m_near=0.1f;
+  float m_far=100.0f;
+  float m_zScale=1.0f;
+  float m_zBias=0.0f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the bounds of each cluster, rebuilt by setProjection
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<CellBounds> m_cellBounds;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief (offset,count) into m_indices for each cluster
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_cells;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief packed light lists
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_indices;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief scratch list of (cluster,light) hits kept between calls to avoid reallocation
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_hits;
+};
+
+#endif
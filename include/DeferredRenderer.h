@@ -0,0 +1,128 @@
+#ifndef DEFERREDRENDERER_H_
+#define DEFERREDRENDERER_H_
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file DeferredRenderer.h
+/// @brief G-buffer and light volume passes for deferred shading
+/// @class DeferredRenderer
+/// @brief the scene is drawn once into a G-buffer holding the eye space position, normal and material ID of
+/// the closest surface at each pixel, then each spot is applied by rasterising a cone bounding its lit
+/// volume so only the pixels it covers run the lighting, and every visible pixel is lit exactly once per
+/// light however much overdraw the scene has. The light pass accumulates into its own buffer which is
+/// copied to the target framebuffer at the end, the target may be multisampled so it can't be blitted.
+/// With half resolution lighting the light pass shades one G-buffer pixel of each 2x2 block into a quarter
+/// size buffer and the composite adds it to the full resolution ambient with a bilateral upsample, the
+/// bilinear weights of the four nearest half resolution pixels scaled down by how far their depth and normal
+/// are from the pixel's so the light doesn't bleed across edges. The passes draw into the viewport set when
+/// they are called, which may be smaller than the G-buffer. The passes use the SpotVolume, Composite and
+/// CompositeHalf ShaderLib programs.
+//----------------------------------------------------------------------------------------------------------------------
+class DeferredRenderer
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief texture units the G-buffer is read from
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr GLuint POSITIONUNIT=6;
+  static constexpr GLuint NORMALUNIT=7;
+  static constexpr GLuint LIGHTINGUNIT=8;
+  static constexpr GLuint HALFLIGHTINGUNIT=12;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until create is called
+  //----------------------------------------------------------------------------------------------------------------------
+  DeferredRenderer()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the framebuffers and meshes, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~DeferredRenderer();
+  DeferredRenderer(const DeferredRenderer &)=delete;
+  DeferredRenderer &operator=(const DeferredRenderer &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief build the light volume mesh and point the pass programs at the G-buffer units, the SpotVolume and
+  /// Composite programs must already exist
+  //----------------------------------------------------------------------------------------------------------------------
+  void create();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief (re)allocate the G-buffer to match the viewport
+  /// @param [in] _width the width in pixels
+  /// @param [in] _height the height in pixels
+  /// @returns false if the framebuffers are incomplete
+  //----------------------------------------------------------------------------------------------------------------------
+  bool resize(int _width, int _height);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bind and clear the G-buffer ready for the scene to be drawn with the GBuffer programs, the
+  /// framebuffer bound now is the one composite draws to
+  //----------------------------------------------------------------------------------------------------------------------
+  void beginGeometry();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief draw one cone per light, adding each light to the pixels it covers
+  /// @param [in] _numLights the number of lights in the light texture buffer
+  /// @param [in] _project the projection matrix
+  //----------------------------------------------------------------------------------------------------------------------
+  void lightPass(size_t _numLights, const ngl::Mat4 &_project);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief copy the lit image to the framebuffer that was bound in beginGeometry
+  //----------------------------------------------------------------------------------------------------------------------
+  void composite();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief evaluate the lights at half resolution and upsample them in the composite, the buffers are
+  /// remade by the next resize
+  //----------------------------------------------------------------------------------------------------------------------
+  void setHalfResLighting(bool _half);
+  inline bool isHalfResLighting() const {return m_halfRes;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief has the G-buffer been allocated
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isValid() const {return m_valid;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief sides around the cone, the base ring is pushed out so the polygon contains the round cone
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr int CONESEGMENTS=16;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief release the G-buffer attachments
+  //----------------------------------------------------------------------------------------------------------------------
+  void destroyTargets();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief create a texture of the G-buffer size
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint createTarget(GLenum _format, int _width, int _height) const;
+  int m_width=0;
+  int m_height=0;
+  bool m_valid=false;
+  bool m_halfRes=false;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the G-buffer, position, normal and lighting attachments with a depth buffer
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_gbuffer=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief framebuffer with only the lighting attachment so the light pass never writes what it reads
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_lightBuffer=0;
+  GLuint m_position=0;
+  GLuint m_normal=0;
+  GLuint m_lighting=0;
+  GLuint m_depth=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the half resolution light buffer and its framebuffer, only made with half resolution lighting
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_halfLightBuffer=0;
+  GLuint m_halfLighting=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the framebuffer bound when the frame started
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_target=0;
+  GLuint m_coneVAO=0;
+  GLuint m_coneVBO=0;
+  GLuint m_coneIBO=0;
+  GLsizei m_coneIndices=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief core profile needs a VAO bound even when the vertices come from gl_VertexID
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_screenVAO=0;
+};
+
+#endif
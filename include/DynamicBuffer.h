@@ -0,0 +1,170 @@
+#ifndef DYNAMICBUFFER_H_
+#define DYNAMICBUFFER_H_
+#include <ngl/Types.h>
+#include <cstdint>
+#include <vector>
+#include "FrameStats.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file DynamicBuffer.h
+/// @brief a ring of per frame regions the data written every frame is sub-allocated from
+/// @class DynamicBuffer
+/// @brief one buffer split into FRAMES regions, each frame takes the next region and hands out aligned pieces
+/// of it with a bump pointer. A fence is set at the end of each frame and waited on before its region is
+/// written again, so the CPU never writes what the GPU is still reading and the driver never has to copy or
+/// synchronise behind our back. On GL 4.4 the buffer is created with glBufferStorage and stays mapped
+/// persistent and coherent so an allocation is written in place, otherwise the allocations are staged on the
+/// CPU and sent with a glBufferSubData per flush into the fenced region. Anything allocated only lives for
+/// the frame it was allocated in. An allocation that doesn't fit grows the ring there and then, the frame's
+/// earlier allocations stay in the old buffer, which is kept until the next frame begins.
+//----------------------------------------------------------------------------------------------------------------------
+class DynamicBuffer
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the regions in the ring, the CPU can be writing one while the GPU reads the two before it
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t FRAMES=3;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a piece of the current region
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Allocation
+  {
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief where to write the data, valid until the next flush or the end of the frame
+    //----------------------------------------------------------------------------------------------------------------------
+    void *m_data;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief byte offset of the data in the buffer, for glBindBufferRange, a buffer copy or an attribute
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_offset;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief does the current context have glBufferStorage (GL 4.4)
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool persistentSupported();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief round _bytes up to a multiple of _alignment
+  //----------------------------------------------------------------------------------------------------------------------
+  static inline size_t alignUp(size_t _bytes, size_t _alignment)
+  {
+    return (_bytes+_alignment-1)/_alignment*_alignment;
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until create is called
+  //----------------------------------------------------------------------------------------------------------------------
+  DynamicBuffer()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the buffer and fences, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~DynamicBuffer();
+  DynamicBuffer(const DynamicBuffer &)=delete;
+  DynamicBuffer &operator=(const DynamicBuffer &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief read the uniform offset alignment of the context, the storage is made by the first beginFrame
+  /// @param [in] _persistent map the buffer persistently, only if persistentSupported
+  //----------------------------------------------------------------------------------------------------------------------
+  void create(bool _persistent);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is the buffer mapped persistently, if not the allocations must be flushed before they are drawn with
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isPersistent() const {return m_persistent;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the offsets glBindBufferRange accepts for a uniform block are multiples of this
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t uniformAlignment() const {return m_uniformAlignment;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief move to the next region, waiting for the GPU to finish the frame that last used it
+  /// @param [in] _bytes the most the frame will allocate, the ring grows if its regions are smaller
+  //----------------------------------------------------------------------------------------------------------------------
+  void beginFrame(size_t _bytes);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief take the next piece of the current region, growing the ring if it doesn't fit
+  /// @param [in] _bytes the size wanted
+  /// @param [in] _alignment the alignment of the offset
+  /// @param [in,out] _stats the frame counters to add the bytes to
+  //----------------------------------------------------------------------------------------------------------------------
+  Allocation allocate(size_t _bytes, size_t _alignment, FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief send everything allocated since the last flush, nothing to do when the buffer is mapped
+  /// @param [in,out] _stats the frame counters to add the upload to
+  //----------------------------------------------------------------------------------------------------------------------
+  void flush(FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief fence the current region once every draw reading it has been issued
+  //----------------------------------------------------------------------------------------------------------------------
+  void endFrame();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the buffer object, it changes when the ring grows so read it after each allocate
+  //----------------------------------------------------------------------------------------------------------------------
+  inline GLuint bufferID() const {return m_buffer;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bytes in each region
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t regionSize() const {return m_regionSize;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames begun, how many of them found their region still in use and the time spent waiting for it
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t frames() const {return m_frames;}
+  inline uint64_t waits() const {return m_waits;}
+  inline double waitTime() const {return m_waitTime;}
+  inline double maxWait() const {return m_maxWait;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief allocations that didn't fit in their region and grew the ring
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t overflows() const {return m_overflows;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief replace the buffer with one of FRAMES regions of _regionSize bytes
+  //----------------------------------------------------------------------------------------------------------------------
+  void allocateStorage(size_t _regionSize);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief drop the fences and hand the buffer to m_retired, its mapping stays valid until it is deleted
+  //----------------------------------------------------------------------------------------------------------------------
+  void retire();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief delete the buffers replaced by a grow, deleting a mapped buffer unmaps it
+  //----------------------------------------------------------------------------------------------------------------------
+  void deleteRetired();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief unmap and delete the buffer and the fences
+  //----------------------------------------------------------------------------------------------------------------------
+  void release();
+  GLuint m_buffer=0;
+  bool m_persistent=false;
+  size_t m_uniformAlignment=256;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the persistent mapping of the whole buffer, or nullptr when the allocations are staged
+  //----------------------------------------------------------------------------------------------------------------------
+  char *m_mapped=nullptr;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the CPU copy of the current region when the buffer isn't mapped
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<char> m_staging;
+  size_t m_regionSize=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the current region, the bump pointer into it and how much of it has been flushed
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_region=0;
+  size_t m_head=0;
+  size_t m_flushed=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the fence after the last frame to use each region, nullptr once it is known to be free
+  //----------------------------------------------------------------------------------------------------------------------
+  GLsync m_fences[FRAMES]={};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief buffers replaced by a grow during a frame, bindings made earlier in the frame still name them
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<GLuint> m_retired;
+  uint64_t m_frames=0;
+  uint64_t m_waits=0;
+  uint64_t m_overflows=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief total and longest wait for a fence in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  double m_waitTime=0.0;
+  double m_maxWait=0.0;
+};
+
+#endif
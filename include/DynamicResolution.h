@@ -0,0 +1,138 @@
+#ifndef DYNAMICRESOLUTION_H_
+#define DYNAMICRESOLUTION_H_
+#include <ngl/Types.h>
+#include <fstream>
+#include <string>
+#include "ResolutionController.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file DynamicResolution.h
+/// @brief renders the scene below the output size and scales it up to hold a frame time budget
+/// @class DynamicResolution
+/// @brief the scene is drawn into the bottom left corner of a colour and depth target the size of the output,
+/// the render size is the output size times the scale the ResolutionController picked so changing it never
+/// reallocates anything. end draws the target over the framebuffer that was bound in begin, bilinear or with
+/// FXAA, which also makes FXAA on an unscaled target a cheaper alternative to multisampling. The GPU time
+/// from begin to the end of the upscale is measured with GL_TIMESTAMP queries read back LATENCY frames later,
+/// so they never stall and don't clash with any GL_TIME_ELAPSED query around the frame, and fed to the
+/// controller. Each measurement can be written to a CSV log for tuning. The pass uses the Upscale and
+/// UpscaleFxaa ShaderLib programs.
+//----------------------------------------------------------------------------------------------------------------------
+class DynamicResolution
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief texture unit the target is read from
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr GLuint SCENEUNIT=13;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames in flight before a timer result is read
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t LATENCY=4;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until create is called
+  //----------------------------------------------------------------------------------------------------------------------
+  DynamicResolution()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the target and queries, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~DynamicResolution();
+  DynamicResolution(const DynamicResolution &)=delete;
+  DynamicResolution &operator=(const DynamicResolution &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief make the queries and point the pass programs at the target unit, the Upscale and UpscaleFxaa
+  /// programs must already exist
+  //----------------------------------------------------------------------------------------------------------------------
+  void create();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief hold the GPU time under a budget by scaling the render size
+  /// @param [in] _ms the budget in ms, 0 to always render at the output size
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setBudget(double _ms){m_controller.setBudget(_ms);}
+  inline bool isScaling() const {return m_controller.budget() > 0.0;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief smooth the edges with FXAA as the target is scaled
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setFxaa(bool _fxaa){m_fxaa=_fxaa;}
+  inline bool isFxaa() const {return m_fxaa;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is the scene drawn through the target, otherwise begin does nothing and it goes to the framebuffer
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isActive() const {return isScaling() || m_fxaa;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief write the frame, measured and smoothed time, scale and render size of every measurement to a CSV file
+  /// @param [in] _fname the file, empty for none
+  /// @returns false if the file can't be written
+  //----------------------------------------------------------------------------------------------------------------------
+  bool setLog(const std::string &_fname);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bind the target and set the viewport to the render size, if inactive or the target can't be made
+  /// nothing is done
+  /// @param [in] _width the output width in pixels
+  /// @param [in] _height the output height in pixels
+  /// @returns true if the scene is to be drawn into the target and end called
+  //----------------------------------------------------------------------------------------------------------------------
+  bool begin(int _width, int _height);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief draw the target over the framebuffer bound in begin at the output size
+  //----------------------------------------------------------------------------------------------------------------------
+  void end();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the size the scene is drawn at this frame
+  //----------------------------------------------------------------------------------------------------------------------
+  inline int renderWidth() const {return m_renderWidth;}
+  inline int renderHeight() const {return m_renderHeight;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the controller, for the scale limits and counters
+  //----------------------------------------------------------------------------------------------------------------------
+  inline ResolutionController &controller() {return m_controller;}
+  inline const ResolutionController &controller() const {return m_controller;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the last GPU time measured in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  inline double lastTime() const {return m_lastTime;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief (re)allocate the target at the output size
+  //----------------------------------------------------------------------------------------------------------------------
+  bool resize(int _width, int _height);
+  void destroyTarget();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief read every finished pair of timestamps in frame order
+  //----------------------------------------------------------------------------------------------------------------------
+  void collect();
+  ResolutionController m_controller;
+  bool m_fxaa=false;
+  GLuint m_framebuffer=0;
+  GLuint m_colour=0;
+  GLuint m_depth=0;
+  int m_width=0;
+  int m_height=0;
+  bool m_valid=false;
+  int m_renderWidth=0;
+  int m_renderHeight=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the framebuffer and viewport bound when the frame started
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_target=0;
+  GLint m_viewport[4]={0,0,0,0};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a begin and end timestamp per frame in flight, the frames issued and read so far
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_queries[2*LATENCY]={};
+  uint64_t m_issued=0;
+  uint64_t m_read=0;
+  double m_lastTime=0.0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the render size of each frame in flight, for the log
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_sizes[LATENCY][2]={};
+  std::ofstream m_log;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief core profile needs a VAO bound even when the vertices come from gl_VertexID
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_screenVAO=0;
+};
+
+#endif
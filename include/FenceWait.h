@@ -0,0 +1,42 @@
+#ifndef FENCEWAIT_H_
+#define FENCEWAIT_H_
+#include <ngl/Types.h>
+#include <chrono>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FenceWait.h
+/// @brief the blocking fence wait of the dynamic buffer and the frame capture, both of which only wait on a
+/// fence set frames ago and count it as a stall if it hasn't signalled yet
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief how long each glClientWaitSync blocks for before it is retried, 1ms in ns
+//----------------------------------------------------------------------------------------------------------------------
+constexpr GLuint64 FENCEWAITSLICE=1000000;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief wait until a fence has signalled, polling it first so a signalled fence costs no flush or timing
+/// @param [in] _fence the fence to wait on, it is left for the caller to delete
+/// @param [out] o_status GL_ALREADY_SIGNALED, GL_CONDITION_SATISFIED or GL_WAIT_FAILED
+/// @param [out] o_ms the time spent blocked in ms, 0 if the fence had already signalled
+/// @returns true if the fence hadn't signalled and the CPU stalled on it
+//----------------------------------------------------------------------------------------------------------------------
+inline bool waitFence(GLsync _fence, GLenum &o_status, double &o_ms)
+{
+  o_ms=0.0;
+  o_status=glClientWaitSync(_fence,0,0);
+  if(o_status != GL_TIMEOUT_EXPIRED)
+  {
+    return false;
+  }
+  auto start=std::chrono::steady_clock::now();
+  do
+  {
+    o_status=glClientWaitSync(_fence,GL_SYNC_FLUSH_COMMANDS_BIT,FENCEWAITSLICE);
+  }
+  while(o_status == GL_TIMEOUT_EXPIRED);
+  o_ms=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+  return true;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef FNV1A_H_
+#define FNV1A_H_
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Fnv1a.h
+/// @brief the 64 bit FNV-1a hash the shader and mesh caches build their keys with
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the FNV offset basis, the seed of a new hash
+//----------------------------------------------------------------------------------------------------------------------
+constexpr uint64_t FNV1ABASIS=0xcbf29ce484222325ULL;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief hash some bytes
+/// @param [in] _data the bytes to hash
+/// @param [in] _bytes the number of bytes
+/// @param [in] _seed the hash to continue from, FNV1ABASIS to start a new one
+//----------------------------------------------------------------------------------------------------------------------
+inline uint64_t fnv1a(const void *_data, size_t _bytes, uint64_t _seed=FNV1ABASIS)
+{
+  const unsigned char *bytes=static_cast<const unsigned char *>(_data);
+  uint64_t h=_seed;
+  for(size_t i=0; i<_bytes; ++i)
+  {
+    h^=bytes[i];
+    h*=0x100000001b3ULL;
+  }
+  return h;
+}
+
+inline uint64_t fnv1a(const std::string &_data, uint64_t _seed=FNV1ABASIS)
+{
+  return fnv1a(_data.data(),_data.size(),_seed);
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef FRAGMENTCOUNTER_H_
+#define FRAGMENTCOUNTER_H_
+#include <ngl/Types.h>
+#include <cstddef>
+#include <cstdint>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FragmentCounter.h
+/// @brief counts the samples a pass shades with GL_SAMPLES_PASSED queries
+/// @class FragmentCounter
+/// @brief a GL_SAMPLES_PASSED query around the lit pass counts the samples that passed the depth test, which
+/// with early depth testing are the ones the fragment shader ran for. Divided by the samples of the target
+/// that gives the overdraw, 1 would be every sample shaded once. The queries are read back LATENCY frames
+/// later like the DynamicResolution timers so they never stall, a frame still not done by then is dropped.
+//----------------------------------------------------------------------------------------------------------------------
+class FragmentCounter
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames in flight before a count is read
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t LATENCY=4;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until create is called
+  //----------------------------------------------------------------------------------------------------------------------
+  FragmentCounter()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the queries, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~FragmentCounter();
+  FragmentCounter(const FragmentCounter &)=delete;
+  FragmentCounter &operator=(const FragmentCounter &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief make the queries
+  //----------------------------------------------------------------------------------------------------------------------
+  void create();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start counting a frame's pass
+  /// @param [in] _samples the samples of the target drawn into, pixels times samples per pixel
+  //----------------------------------------------------------------------------------------------------------------------
+  void begin(uint64_t _samples);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief stop counting
+  //----------------------------------------------------------------------------------------------------------------------
+  void end();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief read back every count that is ready, begin does this too
+  //----------------------------------------------------------------------------------------------------------------------
+  void collect();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the samples shaded and the overdraw of the last frame read back
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t shaded() const {return m_lastShaded;}
+  inline double overdraw() const {return m_lastSamples ? static_cast<double>(m_lastShaded)/m_lastSamples : 0.0;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the frames read back since clearCounters, their samples shaded and their overdraw
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t frames() const {return m_frames;}
+  inline uint64_t totalShaded() const {return m_totalShaded;}
+  inline double meanOverdraw() const
+  {
+    return m_totalSamples ? static_cast<double>(m_totalShaded)/m_totalSamples : 0.0;
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start the totals again, frames already in flight aren't counted in them
+  //----------------------------------------------------------------------------------------------------------------------
+  void clearCounters();
+
+private :
+  GLuint m_queries[LATENCY]={};
+  uint64_t m_samples[LATENCY]={};
+  uint64_t m_issued=0;
+  uint64_t m_read=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the first frame counted in the totals
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_countFrom=0;
+  uint64_t m_lastShaded=0;
+  uint64_t m_lastSamples=0;
+  uint64_t m_frames=0;
+  uint64_t m_totalShaded=0;
+  uint64_t m_totalSamples=0;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef FRAMECACHE_H_
+#define FRAMECACHE_H_
+#include <ngl/Types.h>
+#include "DeferredRenderer.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FrameCache.h
+/// @brief keeps a copy of the last frame so it can be shown again without drawing the scene
+/// @class FrameCache
+/// @brief the window contents are undefined after a swap so when Qt asks for a frame and nothing in the scene
+/// has changed the stored copy is drawn instead. The copy is resolved from the (possibly multisampled) target
+/// with a blit and drawn back with the Composite program, a blit into a multisampled target isn't allowed.
+/// NGLScene stores the frame before the profile overlay and draws the overlay again over each restore.
+//----------------------------------------------------------------------------------------------------------------------
+class FrameCache
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief texture unit the copy is read from, shared with the deferred lighting buffer as both are drawn by
+  /// the Composite program
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr GLuint UNIT=DeferredRenderer::LIGHTINGUNIT;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until store is called
+  //----------------------------------------------------------------------------------------------------------------------
+  FrameCache()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the copy, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~FrameCache();
+  FrameCache(const FrameCache &)=delete;
+  FrameCache &operator=(const FrameCache &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief copy the bound draw framebuffer
+  /// @param [in] _width the width in pixels
+  /// @param [in] _height the height in pixels
+  /// @returns false if the copy couldn't be made
+  //----------------------------------------------------------------------------------------------------------------------
+  bool store(int _width, int _height);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief draw the copy into the bound draw framebuffer
+  /// @returns false if there is no copy of the current size
+  //----------------------------------------------------------------------------------------------------------------------
+  bool restore(int _width, int _height);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief forget the copy, the next frame must be drawn in full
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void invalidate(){m_valid=false;}
+  inline bool isValid() const {return m_valid;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief (re)allocate the copy at a new size
+  //----------------------------------------------------------------------------------------------------------------------
+  bool resize(int _width, int _height);
+  int m_width=0;
+  int m_height=0;
+  bool m_valid=false;
+  GLuint m_framebuffer=0;
+  GLuint m_colour=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief core profile needs a VAO bound even when the vertices come from gl_VertexID
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_screenVAO=0;
+};
+
+#endif
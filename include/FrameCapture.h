@@ -0,0 +1,103 @@
+#ifndef FRAMECAPTURE_H_
+#define FRAMECAPTURE_H_
+#include <ngl/Types.h>
+#include <cstdint>
+#include <string>
+#include "FrameWriter.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FrameCapture.h
+/// @brief reads finished frames back without stalling and hands them to a FrameWriter
+/// @class FrameCapture
+/// @brief each captured frame is resolved with a blit into a single sampled copy and glReadPixels copies that
+/// into the next of a ring of SLOTS pixel buffer objects, which returns straight away, then a fence is set.
+/// The slot is only mapped when the ring comes round to it SLOTS frames later, by which time the copy has
+/// long finished, and its pixels are queued on the writer thread so neither the readback nor the disk
+/// hold up the frame. A slot whose fence hasn't passed yet is waited on and counted, like DynamicBuffer.
+//----------------------------------------------------------------------------------------------------------------------
+class FrameCapture
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief readbacks in flight, a frame is mapped SLOTS frames after it was read
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t SLOTS=3;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until open is called
+  //----------------------------------------------------------------------------------------------------------------------
+  FrameCapture()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor writes the frames still in flight, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~FrameCapture();
+  FrameCapture(const FrameCapture &)=delete;
+  FrameCapture &operator=(const FrameCapture &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start capturing, a GL context must be current
+  /// @param [in] _fname the file or numbered file pattern, see FrameWriter
+  /// @param [in] _fps the frame rate of a Y4M stream
+  /// @returns false if the writer couldn't be started
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_fname, int _fps);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief read back the frames in flight, wait for the writer to finish them and release the buffers
+  //----------------------------------------------------------------------------------------------------------------------
+  void close();
+  inline bool isOpen() const {return m_writer.isOpen();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start the readback of the bound draw framebuffer
+  /// @param [in] _width the width in pixels
+  /// @param [in] _height the height in pixels
+  //----------------------------------------------------------------------------------------------------------------------
+  void capture(int _width, int _height);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the writer, for its frame rate and queue depth
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const FrameWriter &writer() const {return m_writer;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames read back so far
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t framesCaptured() const {return m_frames;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief captures that waited for their slot's readback and the time they waited in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t waits() const {return m_waits;}
+  inline double waitTime() const {return m_waitTime;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a readback in flight
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Slot
+  {
+    GLuint m_buffer=0;
+    size_t m_size=0;
+    GLsync m_fence=nullptr;
+    int m_width=0;
+    int m_height=0;
+    uint64_t m_index=0;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief wait for a slot's readback and queue its pixels
+  //----------------------------------------------------------------------------------------------------------------------
+  void collect(Slot &_slot);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief size the single sampled copy
+  //----------------------------------------------------------------------------------------------------------------------
+  bool resize(int _width, int _height);
+  FrameWriter m_writer;
+  Slot m_slots[SLOTS];
+  size_t m_next=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the copy the samples are resolved into for glReadPixels
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_framebuffer=0;
+  GLuint m_colour=0;
+  int m_width=0;
+  int m_height=0;
+  uint64_t m_frames=0;
+  uint64_t m_waits=0;
+  double m_waitTime=0.0;
+};
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef FRAMEPROFILER_H_
+#define FRAMEPROFILER_H_
+#include <ngl/Types.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FrameProfiler.h
+/// @brief scoped CPU and GPU timing of the phases of a frame
+/// @class FrameProfiler
+/// @brief each scope records CPU timestamps and, if asked, a pair of GL_TIMESTAMP queries. Timestamps are
+/// used rather than GL_TIME_ELAPSED as the phases nest and elapsed queries can't. The queries for a frame
+/// are read back FRAMELAG frames later, if they still aren't ready the GPU part of that frame is dropped
+/// rather than waiting, so profiling never stalls the pipeline. Other threads can add CPU only events.
+/// Per frame averages are rebuilt once a second for the overlay, and a number of frames can be captured
+/// to a Chrome trace_event file (load it in chrome://tracing or ui.perfetto.dev).
+//----------------------------------------------------------------------------------------------------------------------
+class FrameProfiler
+{
+public :
+  typedef std::chrono::steady_clock Clock;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the thread ids used in the trace, job system worker n is WORKER+n-1
+  //----------------------------------------------------------------------------------------------------------------------
+  enum Thread : int {RENDER=1, SIMULATION=2, GPU=3, WORKER=4};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the trace thread of a JobSystem thread index, 0 being the render thread
+  //----------------------------------------------------------------------------------------------------------------------
+  static inline Thread jobThread(size_t _index)
+  {
+    return _index == 0 ? RENDER : static_cast<Thread>(WORKER+static_cast<int>(_index)-1);
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief averages of one named phase per frame
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Phase
+  {
+    const char *m_name;
+    double m_cpuMs;
+    double m_gpuMs;
+    double m_calls;
+  };
+  static constexpr size_t NOSCOPE=~size_t(0);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, nothing is recorded until the profiler is enabled
+  //----------------------------------------------------------------------------------------------------------------------
+  FrameProfiler();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the queries, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~FrameProfiler();
+  FrameProfiler(const FrameProfiler &)=delete;
+  FrameProfiler &operator=(const FrameProfiler &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief line up the GPU and CPU clocks, call once the context is current
+  //----------------------------------------------------------------------------------------------------------------------
+  void initializeGL();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief turn recording on or off
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setEnabled(bool _enabled){m_enabled=_enabled;}
+  inline bool isEnabled() const {return m_enabled || m_captureFrames > 0 || m_capturePending > 0;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start a frame, also resolves the queries of the frame FRAMELAG ago
+  //----------------------------------------------------------------------------------------------------------------------
+  void beginFrame();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief finish the frame
+  //----------------------------------------------------------------------------------------------------------------------
+  void endFrame();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief resolve every frame still in flight, waits for the GPU so only use it once rendering is done
+  //----------------------------------------------------------------------------------------------------------------------
+  void finish();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief open a scope on the render thread, use ProfileScope rather than calling this directly
+  /// @param [in] _name the phase name, must be a string literal as only the pointer is kept
+  /// @param [in] _gpu also time the GL commands issued in the scope
+  /// @returns the scope id to pass to endScope, NOSCOPE if not recording
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t beginScope(const char *_name, bool _gpu);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief close a scope opened with beginScope
+  //----------------------------------------------------------------------------------------------------------------------
+  void endScope(size_t _id);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief add a CPU only event from any thread
+  /// @param [in] _name the phase name, must be a string literal
+  /// @param [in] _thread the trace thread the event belongs to
+  /// @param [in] _begin the start of the event
+  /// @param [in] _end the end of the event
+  //----------------------------------------------------------------------------------------------------------------------
+  void record(const char *_name, Thread _thread, Clock::time_point _begin, Clock::time_point _end);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief per frame averages over the last second, the first entry is the whole frame
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<Phase> &phases() const {return m_phases;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief GPU frames dropped because their queries weren't ready in time, over the last second
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t droppedFrames() const {return m_droppedReported;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief record the next _frames frames and write them as a Chrome trace
+  /// @param [in] _fname the json file to write
+  /// @param [in] _frames how many frames to capture
+  //----------------------------------------------------------------------------------------------------------------------
+  void captureTrace(const std::string &_fname, size_t _frames);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is a trace being captured
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isCapturing() const {return m_captureFrames > 0;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames between issuing a query and reading it back
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t FRAMELAG=4;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a scope on the render thread
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Scope
+  {
+    const char *m_name;
+    Clock::time_point m_begin;
+    Clock::time_point m_end;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief index of the begin query in the frame's query list, the end query follows it, -1 for CPU only
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_query;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a CPU only event from another thread
+  //----------------------------------------------------------------------------------------------------------------------
+  struct ThreadEvent
+  {
+    const char *m_name;
+    Thread m_thread;
+    Clock::time_point m_begin;
+    Clock::time_point m_end;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the scopes and queries of one frame in the ring
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Frame
+  {
+    std::vector<Scope> m_scopes;
+    std::vector<GLuint> m_queries;
+    size_t m_usedQueries=0;
+    bool m_pending=false;
+    bool m_capture=false;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief running totals for one phase
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Total
+  {
+    const char *m_name;
+    double m_cpuMs;
+    double m_gpuMs;
+    size_t m_calls;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a finished event waiting to be written to the trace
+  //----------------------------------------------------------------------------------------------------------------------
+  struct TraceEvent
+  {
+    const char *m_name;
+    int m_thread;
+    double m_beginUs;
+    double m_durationUs;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief read back a frame's queries if they are ready and add it to the totals and trace
+  //----------------------------------------------------------------------------------------------------------------------
+  void resolve(Frame &_frame);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief add an event to the running totals
+  //----------------------------------------------------------------------------------------------------------------------
+  Total &total(const char *_name);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief microseconds since the profiler was created
+  //----------------------------------------------------------------------------------------------------------------------
+  double toUs(Clock::time_point _time) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief write the captured events and clear them
+  //----------------------------------------------------------------------------------------------------------------------
+  void writeTrace();
+
+  bool m_enabled;
+  bool m_inFrame;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief mirrors isEnabled for the other threads calling record
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<bool> m_active;
+  size_t m_frameNumber;
+  Frame m_frames[FRAMELAG];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief events from other threads, guarded by m_threadMutex
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<ThreadEvent> m_threadEvents;
+  std::mutex m_threadMutex;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief totals since m_windowStart and the averages built from the previous window
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Total> m_totals;
+  size_t m_windowFrames;
+  size_t m_dropped;
+  size_t m_droppedReported;
+  Clock::time_point m_windowStart;
+  std::vector<GLuint64> m_stamps;
+  std::vector<Phase> m_phases;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief CPU time all trace timestamps are relative to and the GL timestamp at the same moment
+  //----------------------------------------------------------------------------------------------------------------------
+  Clock::time_point m_epoch;
+  int64_t m_gpuEpochNs;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief trace capture state
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_traceFile;
+  size_t m_captureFrames;
+  size_t m_capturePending;
+  std::vector<TraceEvent> m_trace;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class ProfileScope
+/// @brief times the enclosing block on the render thread
+//----------------------------------------------------------------------------------------------------------------------
+class ProfileScope
+{
+public :
+  ProfileScope(FrameProfiler &_profiler, const char *_name, bool _gpu=true) :
+    m_profiler(_profiler), m_id(_profiler.beginScope(_name,_gpu)) {}
+  ~ProfileScope(){m_profiler.endScope(m_id);}
+  ProfileScope(const ProfileScope &)=delete;
+  ProfileScope &operator=(const ProfileScope &)=delete;
+private :
+  FrameProfiler &m_profiler;
+  size_t m_id;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef FRAMESTATS_H_
+#define FRAMESTATS_H_
+#include <cstddef>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FrameStats.h
+/// @brief simple counters of the CPU to GPU traffic and the geometry generated in a frame
+/// @class FrameStats
+/// @brief accumulates the number of uniform / buffer update calls and the bytes they move, the bytes written
+/// to the ring buffer and the triangles submitted, reset once per frame
+//----------------------------------------------------------------------------------------------------------------------
+struct FrameStats
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief number of bytes sent to the GPU via uniforms or buffer updates
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_bytesUploaded=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief number of glUniform* / glBufferSubData style calls made
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_uniformCalls=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief number of bytes written to the per frame ring buffer, only counted as uploads when they are flushed
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_bytesStreamed=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief number of triangles of the teapots and plane submitted, shadow passes included
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_triangles=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief record a single upload call
+  /// @param [in] _bytes the size of the data sent
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void addUpload(size_t _bytes){m_bytesUploaded+=_bytes; ++m_uniformCalls;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief record a write to the ring buffer
+  /// @param [in] _bytes the size of the data written
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void addStreamed(size_t _bytes){m_bytesStreamed+=_bytes;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief record a draw
+  /// @param [in] _triangles the triangles it submits
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void addTriangles(size_t _triangles){m_triangles+=_triangles;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief clear the counters ready for the next frame
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void reset(){m_bytesUploaded=0; m_uniformCalls=0; m_bytesStreamed=0; m_triangles=0;}
+};
+
+#endif
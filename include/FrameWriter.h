@@ -0,0 +1,144 @@
+#ifndef FRAMEWRITER_H_
+#define FRAMEWRITER_H_
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FrameWriter.h
+/// @brief encodes captured frames to disk on its own thread
+/// @class FrameWriter
+/// @brief frames are RGBA8 rows bottom up, as glReadPixels returns them. The render thread takes a buffer with
+/// acquire, fills it and hands it back with submit, the writer thread encodes it and returns the buffer to a
+/// pool so a capture allocates nothing once it is running. The format comes from the extension: .png and .exr
+/// write a numbered file per frame (a printf style %d in the name sets the numbering, otherwise _0000 is added
+/// before the extension), .y4m appends every frame to one 4:2:0 YUV4MPEG2 stream that ffmpeg and most players
+/// read directly. The EXR files are uncompressed half float B, G and R with the 8 bit values stored as they are.
+/// submit only waits when the queue is full, which means the disk can't keep up, and the waits are counted.
+//----------------------------------------------------------------------------------------------------------------------
+class FrameWriter
+{
+public :
+  enum class Format {PNG,EXR,Y4M};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a frame on its way to disk
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Frame
+  {
+    std::vector<unsigned char> m_pixels;
+    int m_width=0;
+    int m_height=0;
+    uint64_t m_index=0;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, nothing is written until open is called
+  //----------------------------------------------------------------------------------------------------------------------
+  FrameWriter()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor writes whatever is queued and stops the thread
+  //----------------------------------------------------------------------------------------------------------------------
+  ~FrameWriter();
+  FrameWriter(const FrameWriter &)=delete;
+  FrameWriter &operator=(const FrameWriter &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the format written for a file name
+  /// @param [in] _fname the name, only the extension is looked at
+  /// @param [out] o_format the format
+  /// @returns false if the extension isn't one we write
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool formatOf(const std::string &_fname, Format &o_format);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the file frame _index of a numbered capture goes to
+  //----------------------------------------------------------------------------------------------------------------------
+  static std::string frameName(const std::string &_pattern, uint64_t _index);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start the writer thread
+  /// @param [in] _fname the file or numbered file pattern
+  /// @param [in] _fps the frame rate written in the Y4M header
+  /// @param [in] _maxQueue frames queued before submit waits
+  /// @returns false if the format is unknown or the stream can't be created
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_fname, int _fps, size_t _maxQueue=8);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief write everything queued and stop the thread
+  //----------------------------------------------------------------------------------------------------------------------
+  void close();
+  inline bool isOpen() const {return m_thread.joinable();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a frame to fill, its pixels are sized for _width x _height
+  //----------------------------------------------------------------------------------------------------------------------
+  Frame acquire(int _width, int _height);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief queue a frame filled by the caller, waits if the queue is full
+  //----------------------------------------------------------------------------------------------------------------------
+  void submit(Frame &&_frame);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames waiting to be written now and the most there have been
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t queueDepth() const;
+  inline size_t maxQueueDepth() const {return m_maxDepth;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames written, and the ones that failed or didn't match the size of a Y4M stream
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t framesWritten() const;
+  uint64_t framesFailed() const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames written per second of wall clock from the first submit to the last write
+  //----------------------------------------------------------------------------------------------------------------------
+  double framesPerSecond() const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief submits that waited for room in the queue and the time they waited in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t stalls() const {return m_stalls;}
+  inline double stallTime() const {return m_stallTime;}
+
+private :
+  typedef std::chrono::steady_clock Clock;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the thread function, writes frames until closed and drained
+  //----------------------------------------------------------------------------------------------------------------------
+  void run();
+  bool write(const Frame &_frame);
+  bool writePng(const Frame &_frame, const std::string &_fname) const;
+  bool writeExr(const Frame &_frame, const std::string &_fname) const;
+  bool writeY4m(const Frame &_frame);
+  Format m_format=Format::PNG;
+  std::string m_fname;
+  int m_fps=30;
+  size_t m_maxQueue=8;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the Y4M stream and the frame size its header was written for
+  //----------------------------------------------------------------------------------------------------------------------
+  std::ofstream m_stream;
+  int m_streamWidth=0;
+  int m_streamHeight=0;
+  std::vector<unsigned char> m_yuv;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames queued and pixel buffers free for reuse, guarded by m_mutex
+  //----------------------------------------------------------------------------------------------------------------------
+  std::deque<Frame> m_queue;
+  std::vector<std::vector<unsigned char>> m_pool;
+  bool m_closing=false;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_queued;
+  std::condition_variable m_written;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief counters, those written by the thread are guarded by m_mutex
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_framesWritten=0;
+  uint64_t m_framesFailed=0;
+  size_t m_maxDepth=0;
+  uint64_t m_stalls=0;
+  double m_stallTime=0.0;
+  Clock::time_point m_firstSubmit;
+  Clock::time_point m_lastWrite;
+  std::thread m_thread;
+};
+
+#endif
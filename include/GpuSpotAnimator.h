@@ -0,0 +1,110 @@
+#ifndef GPUSPOTANIMATOR_H_
+#define GPUSPOTANIMATOR_H_
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+#include <vector>
+#include "FrameStats.h"
+#include "LightBlock.h"
+#include "SpotParamsStd430.h"
+#include "SpotState.h"
+#include "TextureBuffer.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file GpuSpotAnimator.h
+/// @brief evaluates the spot animation in a compute shader
+/// @class GpuSpotAnimator
+/// @brief the spot parameters are sent once, when they are set, and every frame the SpotAnimate compute
+/// program works out the direction, colour and range of every spot from the phase of the animation and
+/// writes them into a light buffer laid out like LightBlock's. The only per frame CPU work is setting two
+/// uniforms and a dispatch, whatever the light count. The buffer is viewed by a texture on the same unit
+/// as LightBlock so the lighting shaders read whichever was bound last. Needs a GL 4.3 context.
+//----------------------------------------------------------------------------------------------------------------------
+class GpuSpotAnimator
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief spots evaluated by each compute work group, the GROUPSIZE define of the animation shader
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr GLuint GROUPSIZE=64;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until create is called
+  //----------------------------------------------------------------------------------------------------------------------
+  GpuSpotAnimator()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the parameter buffer, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~GpuSpotAnimator();
+  GpuSpotAnimator(const GpuSpotAnimator &)=delete;
+  GpuSpotAnimator &operator=(const GpuSpotAnimator &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief create the buffers
+  /// @param [in] _program the linked SpotAnimate compute program, 0 if the context can't run it
+  /// @param [in] _unit the texture unit the light buffer is bound to, LightBlock's
+  /// @param [in] _timeStep the animation time advanced per tick
+  //----------------------------------------------------------------------------------------------------------------------
+  void create(GLuint _program, GLuint _unit, float _timeStep);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief can the animation run on the GPU
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isAvailable() const {return m_program != 0;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief send new spot parameters, the only call whose cost grows with the light count
+  /// @param [in] _state the spots
+  /// @param [in] _lights the lights in GPU layout, anything the animation doesn't write is taken from here
+  /// @param [in] _ticks the tick the colour mix of _state belongs to
+  /// @param [in,out] _stats the frame counters to add the upload to
+  //----------------------------------------------------------------------------------------------------------------------
+  void setSpots(const SpotState &_state, const LightBlock &_lights, double _ticks, FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief evaluate every spot, nothing is dispatched if neither the time nor the spots have changed
+  /// @param [in] _ticks the animation time in ticks, fractions are evaluated exactly rather than blended
+  /// @param [in] _lightTransform takes world space to the eye space of the lights
+  /// @param [in,out] _stats the frame counters to add the uniforms to
+  //----------------------------------------------------------------------------------------------------------------------
+  void update(double _ticks, const ngl::Mat4 &_lightTransform, FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bind the animated lights for drawing
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void bind() const {m_lights.bind();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the parameters last sent
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<SpotParamsStd430> &params() const {return m_params;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief read the lights back, waiting for the last update, and check them against SpotCurve
+  /// @param [in] _lightTransform the transform of the last update
+  /// @returns the largest difference of a direction or colour component or relative range, 0 if nothing
+  /// has been animated
+  //----------------------------------------------------------------------------------------------------------------------
+  float verify(const ngl::Mat4 &_lightTransform) const;
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the animation program and its uniforms
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_program=0;
+  GLint m_phaseLocation=-1;
+  GLint m_rotationLocation=-1;
+  GLint m_countLocation=-1;
+  float m_timeStep=0.2f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the CPU and GPU copies of the parameters
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<SpotParamsStd430> m_params;
+  GLuint m_spotsBuffer=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the animated lights, written by the compute shader
+  //----------------------------------------------------------------------------------------------------------------------
+  TextureBuffer m_lights;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the tick the parameters were set at and the time of the last update, negative before the first
+  //----------------------------------------------------------------------------------------------------------------------
+  double m_baseTicks=0.0;
+  double m_ticks=-1.0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set when the spots have changed since the last update
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_stale=true;
+};
+
+#endif
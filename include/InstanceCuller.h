@@ -0,0 +1,189 @@
+#ifndef INSTANCECULLER_H_
+#define INSTANCECULLER_H_
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+#include <cstdint>
+#include <vector>
+#include "DynamicBuffer.h"
+#include "FrameStats.h"
+#include "LodSelector.h"
+#include "SpotCone.h"
+#include "StaticMesh.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file InstanceCuller.h
+/// @brief frustum culling of the teapot instances and the draws that submit the survivors
+/// @class InstanceCuller
+/// @brief tests the bounding sphere of every instance against the camera frustum and lists the visible ones
+/// grouped by level of detail, along with every instance for the shadow passes which need the casters the
+/// camera can't see. On a GL 4.3 context a compute shader does the tests and appends each survivor to the
+/// list of its level, counting them straight into the instanceCount of that level's indirect command, so
+/// each pass is one glMultiDrawElementsIndirect and the CPU does the same work whatever the number of
+/// instances. Otherwise the same lists are built on the CPU and drawn with an instanced call per level, the
+/// camera's list is written to the frame's ring buffer each time it is drawn. The command counts are reset
+/// and the levels sent by copying from the ring buffer on the GPU so a cull never writes a buffer the last
+/// frame's draws read.
+/// Given a front to back order, for the depth pre-pass, the instances are tested in that order so each level's
+/// list is drawn nearest first, exactly on the CPU and roughly on the GPU where the appends race.
+/// The GPU counts are copied back behind a fence for the frame stats so they never stall a frame, they
+/// trail the cull by a frame or two.
+//----------------------------------------------------------------------------------------------------------------------
+class InstanceCuller
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the lists built, the camera's visible instances and every instance for the shadows
+  //----------------------------------------------------------------------------------------------------------------------
+  enum Pass : size_t {CAMERA=0, SHADOW=1, PASSES=2};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the draw commands of a pass, one per level of detail
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t LEVELS=LodSelector::LEVELS;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief instances tested by each compute work group, the GROUPSIZE define of the cull shader
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr GLuint GROUPSIZE=64;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief does the current context have compute shaders and multi draw indirect (GL 4.3)
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool gpuSupported();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the six frustum planes of a clip matrix (Gribb and Hartmann), normalised with the inside positive
+  /// @param [in] _clip the projection times everything up to the space the bounds are in
+  /// @param [out] o_planes a, b, c, d of each plane
+  //----------------------------------------------------------------------------------------------------------------------
+  static void frustumPlanes(const ngl::Mat4 &_clip, float o_planes[6][4]);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is any of a sphere inside the planes, spheres just outside a corner pass as they do on the GPU
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool isVisible(const float _planes[6][4], const BoundingSphere &_bound);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until create is called
+  //----------------------------------------------------------------------------------------------------------------------
+  InstanceCuller()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the buffers, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~InstanceCuller();
+  InstanceCuller(const InstanceCuller &)=delete;
+  InstanceCuller &operator=(const InstanceCuller &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief create the buffers
+  /// @param [in] _mesh the mesh drawn, one part per level of detail
+  /// @param [in] _program the linked cull compute program, 0 to cull on the CPU
+  /// @param [in] _ring the per frame ring buffer the per frame lists and commands are written to
+  //----------------------------------------------------------------------------------------------------------------------
+  void create(const StaticMesh &_mesh, GLuint _program, DynamicBuffer &_ring);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is the culling done by the compute shader
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isGpu() const {return m_program != 0;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the instances culled, the levels are sent with the next cull
+  /// @param [in] _bounds the world space bounding sphere of each instance
+  /// @param [in] _count the number of instances
+  /// @param [in,out] _stats the frame counters to add the upload to
+  //----------------------------------------------------------------------------------------------------------------------
+  void setInstances(const BoundingSphere *_bounds, size_t _count, FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start rebuilding the lists for a new view or new levels, the CPU path's lists are built here. This
+  /// makes no GL calls so it can run on any thread, submit must follow on the context's thread
+  /// @param [in] _lod the level of every instance, its order is the shadow list of the CPU path
+  /// @param [in] _clip the projection times the view and mouse transforms
+  /// @param [in] _frontToBack every instance nearest first, empty to list them in index order
+  //----------------------------------------------------------------------------------------------------------------------
+  void prepare(const LodSelector &_lod, const ngl::Mat4 &_clip, const std::vector<uint32_t> &_frontToBack);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief send what the last prepare needs to the GPU, the shadow list on the CPU path, the cull dispatch on
+  /// the GPU path. _lod and _frontToBack must not have changed since
+  /// @param [in,out] _stats the frame counters to add the uploads to
+  //----------------------------------------------------------------------------------------------------------------------
+  void submit(FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief draw the instances of a pass with the current program
+  /// @param [in] _pass the list to draw
+  /// @param [in,out] _stats the frame counters to add the triangles to
+  //----------------------------------------------------------------------------------------------------------------------
+  void draw(Pass _pass, FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the instances of a pass in the last counts known
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t count(Pass _pass) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief read the GPU lists back, waiting for the cull to finish, and check them against the CPU test
+  /// @param [in] _lod the levels the last cull used
+  /// @returns the number of instances missing from or wrongly in a list, always 0 for the CPU path
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t verify(const LodSelector &_lod);
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief write data to the ring buffer and have the GPU copy it to the start of one of our buffers
+  //----------------------------------------------------------------------------------------------------------------------
+  void copyFromRing(GLuint _buffer, const void *_data, size_t _bytes, FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief pick up the GPU counts once the fence after the last cull has passed
+  //----------------------------------------------------------------------------------------------------------------------
+  void readCounts();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief does a sphere touch one of the planes of the last cull to within float rounding
+  //----------------------------------------------------------------------------------------------------------------------
+  bool onPlane(const BoundingSphere &_bound) const;
+  const StaticMesh *m_mesh=nullptr;
+  DynamicBuffer *m_ring=nullptr;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the cull program and the locations of its uniforms
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_program=0;
+  GLint m_planesLocation=-1;
+  GLint m_countLocation=-1;
+  GLint m_sortedLocation=-1;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the instance lists, on the GPU a region of m_bounds.size() entries per command and on the CPU the
+  /// shadow list, the visible instances are sent with each draw
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_listBuffer=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the GPU path's bounds, levels, indirect commands and the copy of the commands read back
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_boundsBuffer=0;
+  GLuint m_levelsBuffer=0;
+  GLuint m_commandBuffer=0;
+  GLuint m_readbackBuffer=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the front to back order the GPU path tests the instances in
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_orderBuffer=0;
+  GLsync m_fence=nullptr;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the commands with no instances, reset before every cull
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<StaticMesh::DrawCommand> m_commands;
+  std::vector<BoundingSphere> m_bounds;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set when the levels or the shadow list must be sent again
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_levelsStale=true;
+  float m_planes[6][4];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief what prepare left for submit
+  //----------------------------------------------------------------------------------------------------------------------
+  const LodSelector *m_lod=nullptr;
+  const std::vector<uint32_t> *m_frontToBack=nullptr;
+  bool m_levelsChanged=false;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the CPU path's visible instances grouped by level
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_visible;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the CPU path's visible instances front to back before they are grouped by level
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_sorted;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief where each level's entries start in its list and how many there are
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_first[PASSES][LEVELS]={};
+  size_t m_count[PASSES][LEVELS]={};
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef JOBGRAPH_H_
+#define JOBGRAPH_H_
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "JobSystem.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file JobGraph.h
+/// @brief a fixed graph of jobs run on a JobSystem once per frame
+/// @class JobGraph
+/// @brief the nodes and their dependencies are added once, then every run queues the nodes with nothing to
+/// wait for and each node, as it finishes, queues the nodes it was the last dependency of. run returns once
+/// every node is done, the caller running nodes too. A node's function returns false when it had nothing to
+/// do that run, the thread and times of the nodes that did work are kept for the profiler. Nodes can use the
+/// JobSystem's parallelFor themselves.
+//----------------------------------------------------------------------------------------------------------------------
+class JobGraph
+{
+public :
+  typedef std::chrono::steady_clock Clock;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a node's work, returns false if there was nothing to do
+  //----------------------------------------------------------------------------------------------------------------------
+  typedef std::function<bool()> Func;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, an empty graph
+  //----------------------------------------------------------------------------------------------------------------------
+  JobGraph()=default;
+  JobGraph(const JobGraph &)=delete;
+  JobGraph &operator=(const JobGraph &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief add a node
+  /// @param [in] _name the node name, must be a string literal as only the pointer is kept
+  /// @param [in] _func the node's work
+  /// @returns the node's index
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t add(const char *_name, Func _func);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief make a node wait for another, which must have been added first
+  /// @param [in] _node the node that waits
+  /// @param [in] _on the node it waits for
+  //----------------------------------------------------------------------------------------------------------------------
+  void depend(size_t _node, size_t _on);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief remove every node
+  //----------------------------------------------------------------------------------------------------------------------
+  void clear();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief run every node once, returns when they are all done
+  //----------------------------------------------------------------------------------------------------------------------
+  void run(JobSystem &_jobs);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the nodes and what each did in the last run
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t size() const {return m_nodes.size();}
+  inline const char *name(size_t _node) const {return m_nodes[_node].m_name;}
+  inline bool didWork(size_t _node) const {return m_nodes[_node].m_didWork;}
+  inline size_t thread(size_t _node) const {return m_nodes[_node].m_thread;}
+  inline Clock::time_point begin(size_t _node) const {return m_nodes[_node].m_begin;}
+  inline Clock::time_point end(size_t _node) const {return m_nodes[_node].m_end;}
+
+private :
+  struct Node
+  {
+    const char *m_name;
+    Func m_func;
+    std::vector<size_t> m_next;
+    size_t m_dependencies=0;
+    bool m_didWork=false;
+    size_t m_thread=0;
+    Clock::time_point m_begin;
+    Clock::time_point m_end;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the JobSystem function running node _begin
+  //----------------------------------------------------------------------------------------------------------------------
+  static void runNode(void *_graph, size_t _begin, size_t _end);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief queue a node whose dependencies are done
+  //----------------------------------------------------------------------------------------------------------------------
+  void queue(size_t _node);
+  std::vector<Node> m_nodes;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the dependencies of each node still running in this run, and the nodes not yet done
+  //----------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<std::atomic<size_t>[]> m_waiting;
+  size_t m_waitingSize=0;
+  std::atomic<size_t> m_remaining{0};
+  JobSystem *m_jobs=nullptr;
+};
+
+#endif
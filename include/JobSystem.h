@@ -0,0 +1,161 @@
+#ifndef JOBSYSTEM_H_
+#define JOBSYSTEM_H_
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file JobSystem.h
+/// @brief a small work stealing scheduler for the CPU work of a frame
+/// @class JobSystem
+/// @brief every thread has its own deque of jobs, it pushes and pops at the back and the others steal from the
+/// front so a thief takes the oldest, largest piece of work and the owner keeps the newest which is still in
+/// its cache. A job is a range of a loop: while it is larger than its grain it halves, pushing the upper half
+/// for anyone to steal, so a parallelFor starts as one job and spreads only as far as there are idle threads.
+/// The thread that calls start is thread 0 and takes part whenever it waits, so a wait, even inside a job,
+/// runs other jobs rather than blocking. Idle workers spin briefly then sleep until a job is pushed. With one
+/// thread, or before start, everything runs inline on the caller. Only the render thread has the GL context
+/// so jobs must not make GL calls.
+//----------------------------------------------------------------------------------------------------------------------
+class JobSystem
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the jobs a thread's deque holds, a push to a full deque runs the job there and then
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t QUEUESIZE=1024;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief runs [_begin,_end) of a job
+  //----------------------------------------------------------------------------------------------------------------------
+  typedef void (*RangeFunc)(void *_context, size_t _begin, size_t _end);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a range of work, split down to m_grain, m_pending is decremented when it is done
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Job
+  {
+    RangeFunc m_func;
+    void *m_context;
+    size_t m_begin;
+    size_t m_end;
+    size_t m_grain;
+    std::atomic<size_t> *m_pending;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no threads are started until start is called
+  //----------------------------------------------------------------------------------------------------------------------
+  JobSystem()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor stops the workers
+  //----------------------------------------------------------------------------------------------------------------------
+  ~JobSystem();
+  JobSystem(const JobSystem &)=delete;
+  JobSystem &operator=(const JobSystem &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start the workers
+  /// @param [in] _threads the threads sharing the work including the caller, 0 for one per core
+  //----------------------------------------------------------------------------------------------------------------------
+  void start(size_t _threads);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief stop and join the workers, no jobs may be outstanding
+  //----------------------------------------------------------------------------------------------------------------------
+  void stop();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the threads sharing the work, the caller of start included
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t numThreads() const {return std::max<size_t>(1,m_queues.size());}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the index of the calling thread, 0 for the thread that called start and any that isn't a worker
+  //----------------------------------------------------------------------------------------------------------------------
+  static size_t currentThread();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief call _func(begin,end) over sub-ranges of [_begin,_end) no smaller than _grain on every thread and
+  /// return once all are done
+  /// @param [in] _grain the smallest range worth handing to another thread
+  /// @param [in] _func callable as _func(size_t,size_t), it must be safe to run on disjoint ranges at once
+  //----------------------------------------------------------------------------------------------------------------------
+  template<typename Func>
+  void parallelFor(size_t _begin, size_t _end, size_t _grain, const Func &_func)
+  {
+    if(_begin >= _end)
+    {
+      return;
+    }
+    if(m_queues.size() <= 1 || _end-_begin <= _grain)
+    {
+      _func(_begin,_end);
+      return;
+    }
+    std::atomic<size_t> pending(1);
+    Job job={&JobSystem::invoke<Func>,const_cast<void *>(static_cast<const void *>(&_func)),_begin,_end,
+             std::max<size_t>(1,_grain),&pending};
+    execute(job);
+    wait(pending);
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief queue a job on the calling thread's deque for any thread to run
+  //----------------------------------------------------------------------------------------------------------------------
+  void push(const Job &_job);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief run jobs until a counter reaches 0
+  //----------------------------------------------------------------------------------------------------------------------
+  void wait(const std::atomic<size_t> &_pending);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief jobs run and jobs taken from another thread's deque since start
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t jobsRun() const {return m_jobsRun.load(std::memory_order_relaxed);}
+  inline uint64_t steals() const {return m_steals.load(std::memory_order_relaxed);}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief spins round the deques before an idle worker goes to sleep
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr unsigned SPINS=64;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a thread's deque, a ring of QUEUESIZE jobs, m_front is stolen from and m_back pushed and popped
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Queue
+  {
+    std::mutex m_mutex;
+    Job m_jobs[QUEUESIZE];
+    size_t m_front=0;
+    size_t m_back=0;
+  };
+  template<typename Func>
+  static void invoke(void *_context, size_t _begin, size_t _end)
+  {
+    (*static_cast<const Func *>(_context))(_begin,_end);
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief split a job down to its grain, pushing the upper halves, then run what is left
+  //----------------------------------------------------------------------------------------------------------------------
+  void execute(Job _job);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief take the newest job of a thread's own deque or the oldest of another's
+  //----------------------------------------------------------------------------------------------------------------------
+  bool pop(size_t _thread, Job &o_job);
+  bool steal(size_t _thread, Job &o_job);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the worker thread function
+  //----------------------------------------------------------------------------------------------------------------------
+  void run(size_t _thread);
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_workers;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief jobs in the deques, and the sleeping workers waiting on m_wake for it to be non zero
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<size_t> m_queued{0};
+  std::atomic<size_t> m_sleeping{0};
+  std::atomic<bool> m_running{false};
+  std::mutex m_sleepMutex;
+  std::condition_variable m_wake;
+  std::atomic<uint64_t> m_jobsRun{0};
+  std::atomic<uint64_t> m_steals{0};
+};
+
+#endif
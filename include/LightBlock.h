@@ -0,0 +1,151 @@
+#ifndef LIGHTBLOCK_H_
+#define LIGHTBLOCK_H_
+#include <ngl/Colour.h>
+#include <ngl/Vec4.h>
+#include <limits>
+#include <string>
+#include <vector>
+#include "DynamicBuffer.h"
+#include "FrameStats.h"
+#include "LightStd140.h"
+#include "TextureBuffer.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file LightBlock.h
+/// @brief a CPU side copy of the spot light buffer with dirty tracking
+/// @class LightBlock
+/// @brief holds all the spot lights in the GPU layout, the setters mirror ngl::SpotLight but only mark the
+/// light as changed, upload then sends the changed range to the light texture buffer with a single write.
+/// When the ring buffer is mapped persistently that range is written into the ring and copied across on the
+/// GPU, so nothing waits on the frames still reading the lights. Nothing is sent when no light changed.
+//----------------------------------------------------------------------------------------------------------------------
+class LightBlock
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until create is called
+  //----------------------------------------------------------------------------------------------------------------------
+  LightBlock()=default;
+  LightBlock(const LightBlock &)=delete;
+  LightBlock &operator=(const LightBlock &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief allocate storage for the lights, the GL buffer is created on first use
+  /// @param [in] _count the number of lights
+  /// @param [in] _unit the texture unit the light buffer is bound to
+  //----------------------------------------------------------------------------------------------------------------------
+  void create(size_t _count, GLuint _unit);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief point the named samplerBuffer in a program at the light data
+  /// @param [in] _programID the linked shader program
+  /// @param [in] _samplerName the name of the sampler in the shader
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void bindToProgram(GLuint _programID, const std::string &_samplerName) const
+  {
+    m_buffer.bindToProgram(_programID,_samplerName);
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bind the light data for drawing
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void bind() const {m_buffer.bind();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief send the lights changed since the last upload to the GPU, called once every frame drawn
+  /// @param [in] _ring the frame's ring buffer, the changes are staged in it when it is mapped persistently
+  /// @param [in,out] _stats the frame counters to add the upload to
+  /// @returns true if any light was changed
+  //----------------------------------------------------------------------------------------------------------------------
+  bool upload(DynamicBuffer &_ring, FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief forget the lights changed since the last upload without sending them, for when the shaders read
+  /// the lights from somewhere else
+  /// @returns true if any light was changed
+  //----------------------------------------------------------------------------------------------------------------------
+  bool takeChanges();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief has any light changed since the last upload or takeChanges
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool hasChanges() const {return m_dirtyEnd > m_dirtyBegin;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief mark every light as changed
+  //----------------------------------------------------------------------------------------------------------------------
+  void markAllDirty();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of lights in the block
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t size() const {return m_lights.size();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief read only access to a light in GPU layout
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const LightStd140 &operator[](size_t _i) const {return m_lights[_i];}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief all the lights as a contiguous array
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const LightStd140 *data() const {return m_lights.data();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the (already transformed) light position
+  //----------------------------------------------------------------------------------------------------------------------
+  void setPosition(size_t _i, const ngl::Vec4 &_pos);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the (already transformed) spot direction
+  //----------------------------------------------------------------------------------------------------------------------
+  void setDirection(size_t _i, const ngl::Vec4 &_dir);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the ambient and diffuse colour of the light
+  //----------------------------------------------------------------------------------------------------------------------
+  void setColour(size_t _i, const ngl::Colour &_colour);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the specular colour of the light
+  //----------------------------------------------------------------------------------------------------------------------
+  void setSpecColour(size_t _i, const ngl::Colour &_colour);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the outer cone angle in degrees
+  //----------------------------------------------------------------------------------------------------------------------
+  void setCutoff(size_t _i, float _degrees);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the inner cone angle in degrees
+  //----------------------------------------------------------------------------------------------------------------------
+  void setInnerCutoff(size_t _i, float _degrees);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the spot falloff exponent
+  //----------------------------------------------------------------------------------------------------------------------
+  void setExponent(size_t _i, float _exponent);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the distance attenuation terms
+  //----------------------------------------------------------------------------------------------------------------------
+  void setAttenuation(size_t _i, float _constant, float _linear, float _quadratic);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the distance past which the light is culled
+  //----------------------------------------------------------------------------------------------------------------------
+  void setRange(size_t _i, float _range);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief replace every value of a light, it is only flagged for upload if something differs
+  //----------------------------------------------------------------------------------------------------------------------
+  void set(size_t _i, const LightStd140 &_light);
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief flag light _i as needing upload
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void markDirty(size_t _i)
+  {
+    m_dirtyBegin = _i < m_dirtyBegin ? _i : m_dirtyBegin;
+    m_dirtyEnd = _i+1 > m_dirtyEnd ? _i+1 : m_dirtyEnd;
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the CPU copy of the lights in GPU layout
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<LightStd140> m_lights;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief first changed light
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_dirtyBegin=std::numeric_limits<size_t>::max();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief one past the last changed light, nothing has changed when this is <= m_dirtyBegin
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_dirtyEnd=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the GPU copy of the lights, seven RGBA32F texels per light
+  //----------------------------------------------------------------------------------------------------------------------
+  TextureBuffer m_buffer;
+};
+
+#endif
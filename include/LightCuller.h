@@ -0,0 +1,118 @@
+#ifndef LIGHTCULLER_H_
+#define LIGHTCULLER_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "LightStd140.h"
+#include "SpotCone.h"
+
+class JobSystem;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file LightCuller.h
+/// @brief CPU per object light culling
+/// @class LightCuller
+/// @brief intersects every spot cone with the bounding sphere of every object and builds a compact list of
+/// the lights reaching each one, laid out like the ClusterGrid lists so the shader reads them the same way.
+/// Objects no light reaches get an empty list and skip the lighting loop, objects reached by more than the
+/// cap are marked to use the cluster lists instead so no light is ever dropped.
+/// Given a JobSystem the objects are tested in parallel, each writing its lights to a fixed size slot, and
+/// the slots are then packed in order so the lists are the same as a serial cull.
+/// NGLScene uploads the lists next to the cluster lists, tests/SpotConeTest.cpp covers the cone test of reaches.
+//----------------------------------------------------------------------------------------------------------------------
+class LightCuller
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the count stored for an object that should use the cluster lists, larger than any real count so
+  /// the shader can simply pick the shorter list
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr uint32_t USECLUSTERS=0xffffffffu;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor
+  /// @param [in] _maxLights the most lights kept in one object's list
+  //----------------------------------------------------------------------------------------------------------------------
+  explicit LightCuller(size_t _maxLights=16);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the most lights kept in one object's list
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setMaxLights(size_t _maxLights){m_maxLights=_maxLights;}
+  inline size_t maxLights() const {return m_maxLights;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief share the object tests of cull across a job system's threads, nullptr to cull serially
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setJobSystem(JobSystem *_jobs){m_jobs=_jobs;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief build the per object light lists, everything must be in the same (eye) space
+  /// @param [in] _lights the lights
+  /// @param [in] _numLights the number of lights
+  /// @param [in] _objects the bounding sphere of each object
+  /// @param [in] _numObjects the number of objects
+  //----------------------------------------------------------------------------------------------------------------------
+  void cull(const LightStd140 *_lights, size_t _numLights, const BoundingSphere *_objects, size_t _numObjects);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief mark every object as using the cluster lists, used when culling is turned off
+  /// @param [in] _numObjects the number of objects
+  //----------------------------------------------------------------------------------------------------------------------
+  void reset(size_t _numObjects);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the lights reaching an object
+  /// @param [in] _object the object index
+  /// @param [out] o_count the number of lights or USECLUSTERS
+  /// @returns the first light index
+  //----------------------------------------------------------------------------------------------------------------------
+  const uint32_t *lightsForObject(size_t _object, uint32_t &o_count) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is an object reached by a light, the cone test used by cull
+  /// @param [in] _light the light
+  /// @param [in] _object the bounding sphere of the object
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool reaches(const LightStd140 &_light, const BoundingSphere &_object);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief (offset,count) into indices() for each object
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<uint32_t> &cells() const {return m_cells;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief all the object light lists packed end to end
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<uint32_t> &indices() const {return m_indices;}
+  inline size_t numObjects() const {return m_cells.size()/2;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of objects no light reaches
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t numUnlit() const {return m_unlit;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of objects reached by more than maxLights
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t numOverflowed() const {return m_overflowed;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief objects tested per job when culling in parallel
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t OBJECTGRAIN=64;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the lights reaching an object from m_cones
+  /// @param [out] o_lights room for m_maxLights indices
+  /// @returns the number of lights, m_maxLights+1 if there are more than m_maxLights
+  //----------------------------------------------------------------------------------------------------------------------
+  uint32_t lightsReaching(const BoundingSphere &_object, uint32_t *o_lights) const;
+  size_t m_maxLights;
+  JobSystem *m_jobs=nullptr;
+  std::vector<uint32_t> m_cells;
+  std::vector<uint32_t> m_indices;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief cones and their bounding spheres, rebuilt each cull and kept to avoid reallocation
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<SpotCone> m_cones;
+  std::vector<BoundingSphere> m_coneBounds;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the m_maxLights slot and light count of each object when culling in parallel
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_slots;
+  std::vector<uint32_t> m_counts;
+  size_t m_unlit=0;
+  size_t m_overflowed=0;
+};
+
+#endif
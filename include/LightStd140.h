@@ -0,0 +1,31 @@
+#ifndef LIGHTSTD140_H_
+#define LIGHTSTD140_H_
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file LightStd140.h
+/// @brief GPU layout of a single spot light, this must match the Lights struct in SpotlightFrag.glsl
+/// @class LightStd140
+/// @brief every member is a vec4 or packed into a vec4 so the struct is seven texels (112 bytes) with no
+/// hidden padding, the same bytes work as a std140 / std430 array element or an RGBA32F texture buffer
+/// all positions and directions are in eye space
+//----------------------------------------------------------------------------------------------------------------------
+struct LightStd140
+{
+  float m_position[4];
+  float m_direction[4];
+  float m_ambient[4];
+  float m_diffuse[4];
+  float m_specular[4];
+  float m_spotCosCutoff;
+  float m_spotCosInnerCutoff;
+  float m_spotExponent;
+  float m_constantAttenuation;
+  float m_linearAttenuation;
+  float m_quadraticAttenuation;
+  /// @brief distance beyond which the light is treated as having no effect, used for culling
+  float m_range;
+  float m_pad;
+};
+static_assert(sizeof(LightStd140)==112,"LightStd140 must match the layout of the Lights struct");
+
+#endif
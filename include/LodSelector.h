@@ -0,0 +1,88 @@
+#ifndef LODSELECTOR_H_
+#define LODSELECTOR_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "SpotCone.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file LodSelector.h
+/// @brief per instance level of detail selection
+/// @class LodSelector
+/// @brief picks the level of detail of each object from the size its bounding sphere covers on screen. An
+/// object only moves to a finer level once it is HYSTERESIS bigger than the switch size and to a coarser one
+/// once it is HYSTERESIS smaller, so objects sitting on a switch size don't flip between levels every frame.
+/// The objects are also listed grouped by level so each level can be drawn with one instanced call, the list
+/// is only rebuilt when a level changes.
+/// The InstanceCuller reads the levels from here whether it culls on the CPU or the GPU.
+//----------------------------------------------------------------------------------------------------------------------
+class LodSelector
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of levels, 0 is the full mesh
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t LEVELS=4;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief fraction of the switch size an object has to pass it by before its level changes
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr float HYSTERESIS=0.15f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the diameter in pixels an object covers
+  /// @param [in] _eyeBound the bounding sphere in eye space
+  /// @param [in] _pixelScale the projection's y scale times half the viewport height
+  //----------------------------------------------------------------------------------------------------------------------
+  static float projectedSize(const BoundingSphere &_eyeBound, float _pixelScale);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the projected diameters in pixels below which each level gives way to the next coarser one, a
+  /// size of 0 means the coarser level is always good enough
+  /// @param [in] _sizes LEVELS-1 decreasing sizes
+  //----------------------------------------------------------------------------------------------------------------------
+  void setSwitchSizes(const float _sizes[LEVELS-1]);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief turn the selection off to draw everything with the full mesh
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setEnabled(bool _enabled){m_enabled=_enabled;}
+  inline bool isEnabled() const {return m_enabled;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief choose the level of every object, objects are matched to the last call by index so a change of
+  /// count starts them all again without hysteresis
+  /// @param [in] _eyeBounds the bounding sphere of each object in eye space
+  /// @param [in] _count the number of objects
+  /// @param [in] _pixelScale the projection's y scale times half the viewport height
+  //----------------------------------------------------------------------------------------------------------------------
+  void select(const BoundingSphere *_eyeBounds, size_t _count, float _pixelScale);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the level of an object
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t level(size_t _object) const {return m_levels[_object];}
+  inline const std::vector<uint8_t> &levels() const {return m_levels;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the objects grouped by level, finest first
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<uint32_t> &order() const {return m_order;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief where the objects of a level start in order() and how many there are
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t first(size_t _level) const {return m_first[_level];}
+  inline size_t count(size_t _level) const {return m_count[_level];}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief was order() rebuilt by the last select
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool orderChanged() const {return m_orderChanged;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the level for a size given the current one, LEVELS for an object with no level yet
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t chooseLevel(size_t _current, float _size) const;
+  float m_switchSizes[LEVELS-1]={0.0f,0.0f,0.0f};
+  bool m_enabled=true;
+  std::vector<uint8_t> m_levels;
+  std::vector<uint32_t> m_order;
+  size_t m_first[LEVELS]={0,0,0,0};
+  size_t m_count[LEVELS]={0,0,0,0};
+  bool m_orderChanged=false;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+#include <cstddef>
+#include <string>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MappedFile.h
+/// @brief read only memory mapping of a whole file
+/// @class MappedFile
+/// @brief maps a file with mmap so its contents can be handed straight to GL without reading them into
+/// our own buffers first, the pages are only read from disk as they are touched
+//----------------------------------------------------------------------------------------------------------------------
+class MappedFile
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, nothing is mapped until open is called
+  //----------------------------------------------------------------------------------------------------------------------
+  MappedFile()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor unmaps the file
+  //----------------------------------------------------------------------------------------------------------------------
+  ~MappedFile();
+  MappedFile(const MappedFile &)=delete;
+  MappedFile &operator=(const MappedFile &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief map a file, any previous mapping is released
+  /// @param [in] _fname the file to map
+  /// @returns false if the file doesn't exist, is empty or can't be mapped
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_fname);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief release the mapping
+  //----------------------------------------------------------------------------------------------------------------------
+  void close();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is a file mapped
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isOpen() const {return m_data != nullptr;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the start of the mapping
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const unsigned char *data() const {return m_data;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the size of the file in bytes
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t size() const {return m_size;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief drop the pages of a range we're done with, they are read from the file again if touched so
+  /// streaming a large file through doesn't leave all of it resident
+  /// @param [in] _offset the first byte of the range
+  /// @param [in] _bytes the length of the range, only whole pages inside it are dropped
+  //----------------------------------------------------------------------------------------------------------------------
+  void release(size_t _offset, size_t _bytes) const;
+
+private :
+  const unsigned char *m_data=nullptr;
+  size_t m_size=0;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef MESHFILE_H_
+#define MESHFILE_H_
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MeshFile.h
+/// @brief compact binary mesh cache files
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class MeshHeader
+/// @brief the start of every mesh file, followed by the vertices and then the indices
+//----------------------------------------------------------------------------------------------------------------------
+struct MeshHeader
+{
+  uint32_t m_magic;
+  uint32_t m_version;
+  uint32_t m_vertexCount;
+  uint32_t m_indexCount;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief 2 or 4 byte indices
+  //----------------------------------------------------------------------------------------------------------------------
+  uint32_t m_indexSize;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bytes per vertex, the layout is position, normal, uv as floats
+  //----------------------------------------------------------------------------------------------------------------------
+  uint32_t m_stride;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief hash of the parameters the mesh was generated from
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_key;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class MeshFile
+/// @brief an indexed triangle mesh stored as a header, the interleaved vertices and the indices. Generated
+/// meshes are written row by row so the whole mesh is never held in memory, reading maps the file and
+/// hands out pointers into the mapping.
+//----------------------------------------------------------------------------------------------------------------------
+class MeshFile
+{
+public :
+  static constexpr uint32_t MAGIC=0x434d5053; // SPMC
+  static constexpr uint32_t VERSION=1;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief floats per vertex, position, normal and uv
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t VERTEXFLOATS=8;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the cache key of a plane
+  //----------------------------------------------------------------------------------------------------------------------
+  static uint64_t planeKey(float _width, float _depth, int _wSteps, int _dSteps);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the file a mesh with this key is cached in
+  /// @param [in] _dir the cache directory
+  /// @param [in] _name the mesh name
+  /// @param [in] _key the cache key
+  //----------------------------------------------------------------------------------------------------------------------
+  static std::string cachePath(const std::string &_dir, const std::string &_name, uint64_t _key);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief generate a subdivided plane in xz facing +y, centred on the origin, and write it to a file. This
+  /// is the same surface ngl::VAOPrimitives::createTrianglePlane builds but with shared vertices
+  /// @param [in] _fname the file to write
+  /// @param [in] _width the size in x
+  /// @param [in] _depth the size in z
+  /// @param [in] _wSteps the number of quads in x
+  /// @param [in] _dSteps the number of quads in z
+  /// @returns false if the file couldn't be written
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool writePlane(const std::string &_fname, float _width, float _depth, int _wSteps, int _dSteps);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief write a mesh built in memory, the indices are stored in 16 bits when they fit
+  /// @param [in] _fname the file to write
+  /// @param [in] _key the cache key to store
+  /// @param [in] _vertices VERTEXFLOATS floats per vertex
+  /// @param [in] _indices three per triangle
+  /// @returns false if the file couldn't be written
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool write(const std::string &_fname, uint64_t _key, const std::vector<float> &_vertices,
+                    const std::vector<uint32_t> &_indices);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief map a mesh file
+  /// @param [in] _fname the file
+  /// @param [in] _key the key the file must have been written with
+  /// @returns false if the file is missing, from another version or doesn't match the key
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_fname, uint64_t _key);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief copy the mapped mesh out for processing, such as building its levels of detail
+  /// @param [out] o_vertices VERTEXFLOATS floats per vertex
+  /// @param [out] o_indices the indices widened to 32 bits
+  /// @returns false if no mesh is mapped or its vertices aren't in the VERTEXFLOATS layout
+  //----------------------------------------------------------------------------------------------------------------------
+  bool read(std::vector<float> &o_vertices, std::vector<uint32_t> &o_indices) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is a mesh mapped
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isOpen() const {return m_file.isOpen();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the header of the mapped mesh
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const MeshHeader &header() const {return *reinterpret_cast<const MeshHeader *>(m_file.data());}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the interleaved vertices
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const unsigned char *vertices() const {return m_file.data()+sizeof(MeshHeader);}
+  inline size_t vertexBytes() const {return size_t(header().m_vertexCount)*header().m_stride;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the indices
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const unsigned char *indices() const {return vertices()+vertexBytes();}
+  inline size_t indexBytes() const {return size_t(header().m_indexCount)*header().m_indexSize;}
+
+private :
+  MappedFile m_file;
+};
+
+#endif
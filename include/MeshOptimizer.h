@@ -0,0 +1,67 @@
+#ifndef MESHOPTIMIZER_H_
+#define MESHOPTIMIZER_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "PackedVertex.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MeshOptimizer.h
+/// @brief reorders indexed meshes for the vertex caches and packs their vertices
+/// @class MeshOptimizer
+/// @brief the triangles are reordered with Tipsify (Sander, Nehab and Barczak 2007) so a vertex is shaded once
+/// and then reused by the triangles around it while it is still in the post transform cache: the triangles
+/// are fanned around one vertex at a time, moving next to the vertex of the last fan that is still in the
+/// cache and has the most triangles left. It runs in linear time so every level can be reordered at load.
+/// The vertices are then put in the order the triangles first use them so the fetches walk the buffer
+/// forwards. Vertices are in the MeshFile layout, position, normal and uv.
+//----------------------------------------------------------------------------------------------------------------------
+class MeshOptimizer
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the cache size the triangles are ordered for and the ACMR is measured with, small enough to hold
+  /// on every GPU the demo runs on
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t CACHESIZE=16;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief reorder the triangles for the post transform cache
+  /// @param [in,out] io_indices three per triangle
+  /// @param [in] _vertexCount the number of vertices
+  /// @param [in] _cacheSize the cache size assumed
+  //----------------------------------------------------------------------------------------------------------------------
+  static void optimizeVertexCache(std::vector<uint32_t> &io_indices, size_t _vertexCount,
+                                  size_t _cacheSize=CACHESIZE);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief put the vertices in the order the triangles first use them, unused vertices are dropped
+  /// @param [in,out] io_vertices MeshFile::VERTEXFLOATS floats per vertex
+  /// @param [in,out] io_indices three per triangle, renumbered
+  //----------------------------------------------------------------------------------------------------------------------
+  static void optimizeVertexFetch(std::vector<float> &io_vertices, std::vector<uint32_t> &io_indices);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the average cache miss ratio, vertices shaded per triangle through a FIFO cache. 0.5 is the best a
+  /// large regular grid can do and 3 means nothing is reused
+  /// @param [in] _indices three per triangle
+  /// @param [in] _vertexCount the number of vertices
+  /// @param [in] _cacheSize the FIFO size
+  //----------------------------------------------------------------------------------------------------------------------
+  static float acmr(const std::vector<uint32_t> &_indices, size_t _vertexCount, size_t _cacheSize=CACHESIZE);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief convert vertices to the packed layout
+  /// @param [in] _vertices MeshFile::VERTEXFLOATS floats per vertex
+  /// @param [out] o_vertices one per vertex
+  //----------------------------------------------------------------------------------------------------------------------
+  static void pack(const std::vector<float> &_vertices, std::vector<PackedVertex> &o_vertices);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief round a float to the nearest half, values past the half range become infinite
+  //----------------------------------------------------------------------------------------------------------------------
+  static uint16_t toHalf(float _value);
+  static float fromHalf(uint16_t _half);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief octahedral encoding of a unit vector, the inverse of the decode in SpotlightVert.glsl
+  //----------------------------------------------------------------------------------------------------------------------
+  static void octEncode(const float _n[3], int16_t o_e[2]);
+  static void octDecode(const int16_t _e[2], float o_n[3]);
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef MESHSIMPLIFIER_H_
+#define MESHSIMPLIFIER_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MeshSimplifier.h
+/// @brief quadric error edge collapse simplification of indexed triangle meshes
+/// @class MeshSimplifier
+/// @brief builds the coarser levels of detail of a mesh. Each vertex carries the sum of the squared distance
+/// to the planes of the triangles around it (Garland and Heckbert) and the edge whose collapse onto one of its
+/// ends adds the least to that sum is collapsed until the target is reached. Keeping the end rather than
+/// solving for a new position means every vertex of a level is one of the original vertices so normals and
+/// uvs need no interpolation. Open edges carry an extra plane at right angles to their triangle so borders
+/// only move along themselves, and collapses that would fold a triangle over or pinch the surface are
+/// skipped. Vertices are in the MeshFile layout, position, normal and uv. It is slow enough that NGLScene keeps
+/// the levels it makes in the mesh cache keyed on VERSION.
+//----------------------------------------------------------------------------------------------------------------------
+class MeshSimplifier
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bumped whenever the output for the same input changes, part of the key of cached levels
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr uint32_t VERSION=1;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief turn a triangle soup into an indexed mesh, corners with the same position and normal become one
+  /// vertex so the collapses can see the triangles around it. The uv of the first corner is kept and
+  /// triangles left with a repeated vertex are dropped
+  /// @param [in] _vertices the corners, three per triangle
+  /// @param [in] _count the number of corners
+  /// @param [out] o_vertices the shared vertices
+  /// @param [out] o_indices three per triangle
+  //----------------------------------------------------------------------------------------------------------------------
+  static void weld(const float *_vertices, size_t _count, std::vector<float> &o_vertices,
+                   std::vector<uint32_t> &o_indices);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief collapse edges until the mesh has no more than _targetTriangles triangles or nothing more can be
+  /// collapsed without folding the surface
+  /// @param [in] _vertices the vertices
+  /// @param [in] _indices three per triangle
+  /// @param [in] _targetTriangles the number of triangles wanted
+  /// @param [out] o_vertices the vertices still used, in their original order
+  /// @param [out] o_indices three per triangle
+  //----------------------------------------------------------------------------------------------------------------------
+  void simplify(const std::vector<float> &_vertices, const std::vector<uint32_t> &_indices, size_t _targetTriangles,
+                std::vector<float> &o_vertices, std::vector<uint32_t> &o_indices);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the square root of the largest error of the collapses made by the last simplify, an estimate of how
+  /// far the surface moved in model units, 0 when it is unchanged as for a flat plane
+  //----------------------------------------------------------------------------------------------------------------------
+  inline float error() const {return m_error;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the symmetric 4x4 matrix summing the squared distance to a set of planes, upper triangle by rows
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Quadric
+  {
+    double m_q[10];
+    void addPlane(double _a, double _b, double _c, double _d, double _weight);
+    void add(const Quadric &_q);
+    double error(const float *_p) const;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a candidate collapse of m_from onto m_to, stale once either vertex has changed since. Equal costs,
+  /// as over a flat area, go to the shorter edge so the triangles stay evenly sized rather than fanning out
+  /// from one vertex
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Collapse
+  {
+    double m_cost;
+    float m_length;
+    uint32_t m_from;
+    uint32_t m_to;
+    uint32_t m_fromVersion;
+    uint32_t m_toVersion;
+    bool operator>(const Collapse &_c) const
+    {
+      return m_cost > _c.m_cost || (m_cost == _c.m_cost && m_length > _c.m_length);
+    }
+  };
+  const float *position(uint32_t _v) const {return &(*m_vertices)[size_t(_v)*VERTEXFLOATS];}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief queue the cheaper direction of collapsing an edge
+  //----------------------------------------------------------------------------------------------------------------------
+  void pushEdge(uint32_t _a, uint32_t _b);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief would collapsing _from onto _to keep the surface manifold and every triangle facing the same way
+  //----------------------------------------------------------------------------------------------------------------------
+  bool canCollapse(uint32_t _from, uint32_t _to);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief move the triangles of _from onto _to and queue the edges around _to again
+  /// @returns the number of triangles removed
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t collapse(uint32_t _from, uint32_t _to);
+  static constexpr size_t VERTEXFLOATS=8;
+  const std::vector<float> *m_vertices=nullptr;
+  std::vector<uint32_t> m_triangles;
+  std::vector<char> m_triangleRemoved;
+  std::vector<char> m_vertexRemoved;
+  std::vector<char> m_boundary;
+  std::vector<uint32_t> m_version;
+  std::vector<Quadric> m_quadrics;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the triangles using each vertex, entries for removed triangles are dropped lazily
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<std::vector<uint32_t>> m_vertexTriangles;
+  std::vector<Collapse> m_heap;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief stamp per vertex used to gather the neighbours of a vertex without a set
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_mark;
+  uint32_t m_stamp=0;
+  float m_error=0.0f;
+};
+
+#endif
@@ -2,45 +2,38 @@
 #define NGLSCENE_H_
 #include <ngl/Camera.h>
 #include <ngl/Colour.h>
-#include <ngl/SpotLight.h>
+#include <ngl/Mat3.h>
 #include <ngl/Transformation.h>
 #include <ngl/Text.h>
+#include <QElapsedTimer>
 #include <QOpenGLWindow>
+#include <ctime>
 #include <memory>
-
-class SpotData
-{
-public :
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief the time offset for the spot
-  //----------------------------------------------------------------------------------------------------------------------
-  float m_time;
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief x radius of ellipse
-  //----------------------------------------------------------------------------------------------------------------------
-  float m_radiusX;
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief z radius of the ellipse
-  //----------------------------------------------------------------------------------------------------------------------
-  float m_radiusZ;
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief current mix factor of the light for Lerp of colours
-  //----------------------------------------------------------------------------------------------------------------------
-  float m_mix;
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief aim center of the spot where the ellipse is centered
-  //----------------------------------------------------------------------------------------------------------------------
-  ngl::Vec3 m_aimCenter;
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief start colour of light interpolated to end colour
-  //----------------------------------------------------------------------------------------------------------------------
-  ngl::Colour m_startColour;
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief end colour of the light
-  //----------------------------------------------------------------------------------------------------------------------
-  ngl::Colour m_endColour;
-};
-
+#include "ClusterGrid.h"
+#include "DeferredRenderer.h"
+#include "DynamicResolution.h"
+#include "DynamicBuffer.h"
+#include "FrameCache.h"
+#include "FrameCapture.h"
+#include "FragmentCounter.h"
+#include "FrameProfiler.h"
+#include "FrameStats.h"
+#include "GpuSpotAnimator.h"
+#include "InstanceCuller.h"
+#include "JobGraph.h"
+#include "JobSystem.h"
+#include "LightBlock.h"
+#include "LightCuller.h"
+#include "LodSelector.h"
+#include "SceneFile.h"
+#include "ShaderCache.h"
+#include "ShadowAtlas.h"
+#include "SpotRecording.h"
+#include "SpotSimulation.h"
+#include "SpotState.h"
+#include "StaticMesh.h"
+#include "TextureBuffer.h"
+#include "TransformBatch.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 /// @file NGLScene.h
@@ -88,9 +81,326 @@ class NGLScene : public QOpenGLWindow
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief toggle the Animation of the lights called from main window
     //----------------------------------------------------------------------------------------------------------------------
-    inline void toggleAnimation(){m_animate^=true;}
+    void toggleAnimation();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief start or pause the light animation, while paused frames are only drawn when something changes
+    /// @param [in] _animate true to animate the lights
+    //----------------------------------------------------------------------------------------------------------------------
+    void setAnimate(bool _animate);
+    inline bool isAnimating() const {return m_animate;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set the number of teapots drawn in x and z, must be called before initializeGL
+    /// @param [in] _x the number of columns in the grid
+    /// @param [in] _z the number of rows in the grid
+    //----------------------------------------------------------------------------------------------------------------------
+    void setGridSize(int _x, int _z);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief choose between a single instanced draw and the per teapot draw loop
+    /// @param [in] _instanced true to use the instanced path
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setInstanced(bool _instanced){m_instanced=_instanced;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief toggle between the instanced and per teapot draw paths
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void toggleInstancing(){m_instanced^=true;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief enable printing of the per frame upload counters and CPU use once a second, must be called
+    /// before initializeGL
+    /// @param [in] _print true to print the stats
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setPrintStats(bool _print){m_printStats=_print;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set the number of spot lights, after initializeGL the lights are rebuilt so the context must be
+    /// current
+    /// @param [in] _count the number of lights
+    //----------------------------------------------------------------------------------------------------------------------
+    void setNumLights(int _count);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the number of spot lights
+    //----------------------------------------------------------------------------------------------------------------------
+    inline size_t numLights() const {return m_numLights;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the number of teapots drawn
+    //----------------------------------------------------------------------------------------------------------------------
+    inline int numInstances() const {return m_numInstances;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the teapots and spots of a scene file written by SceneConvert rather than the grid and random
+    /// spots, must be called before initializeGL. The grid size is ignored and the scene's spots are used
+    /// while the light count is the scene's, the random spots if it is changed or the scene has none
+    /// @param [in] _fname the scene file, empty for the grid
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setSceneFile(const std::string &_fname){m_scenePath=_fname;}
+    inline const std::string &sceneFile() const {return m_scenePath;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief ms spent mapping the scene file and loading it into the instance buffer and lights, 0 without one
+    //----------------------------------------------------------------------------------------------------------------------
+    inline double sceneLoadTime() const {return m_sceneLoadTime;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief record the packed lights of every animation tick, the animation is then stepped once per redraw
+    /// on the GUI thread so each frame shows exactly one tick, must be called before initializeGL
+    /// @param [in] _fname the recording to write, empty for none
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setRecordFile(const std::string &_fname){m_recordPath=_fname;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief play a recording back one tick per frame rather than animating, the light count is the
+    /// recording's, must be called before initializeGL
+    /// @param [in] _fname the recording to play, empty for none
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setReplayFile(const std::string &_fname){m_replayPath=_fname;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief read back every frame drawn and write it to disk on a background thread, must be called before
+    /// initializeGL
+    /// @param [in] _fname numbered .png or .exr files or a .y4m stream, see FrameWriter, empty for none
+    /// @param [in] _fps the frame rate of a Y4M stream
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setCaptureFile(const std::string &_fname, int _fps){m_capturePath=_fname; m_captureRate=_fps;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the frame capture, for its counters
+    //----------------------------------------------------------------------------------------------------------------------
+    inline const FrameCapture &frameCapture() const {return m_capture;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write the captured frames still in flight and stop capturing, the context must be current
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void finishCapture(){m_capture.close();}
+    inline const std::string &recordFile() const {return m_recordPath;}
+    inline const std::string &replayFile() const {return m_replayPath;}
+    inline const SpotRecorder &recorder() const {return m_recorder;}
+    inline const SpotPlayer &player() const {return m_player;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief are the teapots drawn with the instanced path
+    //----------------------------------------------------------------------------------------------------------------------
+    inline bool isInstanced() const {return m_instanced;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief use a fixed random seed for the lights rather than the time so every run is the same
+    /// @param [in] _seed the seed
+    //----------------------------------------------------------------------------------------------------------------------
+    void setSeed(unsigned int _seed);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief choose between animating on the simulation thread and stepping with stepAnimation, must be
+    /// called before initializeGL
+    /// @param [in] _threaded true to start the simulation thread
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setThreadedAnimation(bool _threaded){m_threadedAnimation=_threaded;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief advance the animation one tick on the calling thread, does nothing when the simulation
+    /// thread is running, the animation is paused or a recording is playing
+    //----------------------------------------------------------------------------------------------------------------------
+    void stepAnimation();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluate the spot animation in a compute shader from the animation time rather than on the CPU,
+    /// needs a GL 4.3 context and isn't used while recording or replaying. Can be changed at any time
+    /// @param [in] _gpu true to animate on the GPU when possible
+    //----------------------------------------------------------------------------------------------------------------------
+    void setGpuAnimation(bool _gpu);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief are the spots animated on the GPU
+    //----------------------------------------------------------------------------------------------------------------------
+    inline bool isGpuAnimation() const {return m_lightsOnGpu;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief wait for the last GPU animation and check it against the CPU reference, the context must be current
+    /// @returns the largest difference in a direction, colour or relative range, 0 when animating on the CPU
+    //----------------------------------------------------------------------------------------------------------------------
+    inline float verifyAnimation() const {return m_lightsOnGpu ? m_gpuSpots.verify(m_lightTransform) : 0.0f;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief show or hide the per phase timing overlay
+    //----------------------------------------------------------------------------------------------------------------------
+    void setShowProfile(bool _show);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write the CPU and GPU timings of the next frames to a Chrome trace file
+    /// @param [in] _fname the json file to write
+    /// @param [in] _frames the number of frames to capture
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void captureTrace(const std::string &_fname, size_t _frames){m_profiler.captureTrace(_fname,_frames);}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief where the linked shader binaries are cached, empty to always compile, must be called before
+    /// initializeGL
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setShaderCacheDir(const std::string &_dir){m_shaderCache.setDirectory(_dir);}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the shader cache, holds the startup build times
+    //----------------------------------------------------------------------------------------------------------------------
+    inline const ShaderCache &shaderCache() const {return m_shaderCache;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief choose between per object light lists and the cluster lists alone
+    /// @param [in] _cull true to cull the lights against each object
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setObjectCulling(bool _cull){m_objectCulling=_cull;}
+    inline bool isObjectCulling() const {return m_objectCulling;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief choose between forward shading and the deferred G-buffer and light volume passes
+    /// @param [in] _deferred true to use deferred shading
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setDeferred(bool _deferred){m_deferred=_deferred;}
+    inline bool isDeferred() const {return m_deferred;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief toggle between forward and deferred shading
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void toggleDeferred(){m_deferred^=true;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluate the deferred lights at half resolution with a bilateral upsample
+    /// @param [in] _half true for half resolution lighting
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setHalfResLighting(bool _half){m_deferredRenderer.setHalfResLighting(_half);}
+    inline bool isHalfResLighting() const {return m_deferredRenderer.isHalfResLighting();}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief scale the render size to keep the GPU frame time under a budget
+    /// @param [in] _ms the budget in ms, 0 to always draw at the window size
+    //----------------------------------------------------------------------------------------------------------------------
+    void setFrameBudget(double _ms);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief turn the render scaling on with the last budget set, or off
+    //----------------------------------------------------------------------------------------------------------------------
+    void toggleDynamicResolution();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the smallest scale of each axis of the render size
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setMinRenderScale(float _scale){m_resolution.controller().setLimits(_scale,1.0f);}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief smooth the edges with FXAA as the scene is drawn to the window, meant for a format without
+    /// multisampling
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setFxaa(bool _fxaa){m_resolution.setFxaa(_fxaa);}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write the GPU time and render scale of every frame to a CSV file
+    /// @param [in] _fname the log, empty for none
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setResolutionLog(const std::string &_fname){m_resolution.setLog(_fname);}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the render scaling, holds the scale and frame time counters
+    //----------------------------------------------------------------------------------------------------------------------
+    inline DynamicResolution &resolution() {return m_resolution;}
+    inline const DynamicResolution &resolution() const {return m_resolution;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief turn the spot shadow maps on or off
+    /// @param [in] _shadows true to draw shadows
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setShadowMapping(bool _shadows){m_shadowAtlas.setEnabled(_shadows);}
+    inline bool isShadowMapping() const {return m_shadowAtlas.isEnabled();}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the most shadow tiles redrawn in one frame, 0 for no limit
+    /// @param [in] _tiles the budget
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setShadowBudget(size_t _tiles){m_shadowAtlas.setBudget(_tiles);}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief choose between the level of detail for each object's size on screen and the full meshes
+    /// @param [in] _lod true to use the levels of detail
+    //----------------------------------------------------------------------------------------------------------------------
+    void setLod(bool _lod);
+    inline bool isLod() const {return m_teapotLod.isEnabled();}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief cull the teapots with a compute shader and draw them with multi draw indirect when the context is
+    /// GL 4.3, otherwise or when false cull them on the CPU, must be called before initializeGL
+    /// @param [in] _gpu true to use the GPU path when there is one
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setGpuCulling(bool _gpu){m_gpuCulling=_gpu;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the teapot frustum culling, says which path is in use and how many teapots were visible
+    //----------------------------------------------------------------------------------------------------------------------
+    inline const InstanceCuller &instanceCuller() const {return m_instanceCuller;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the per frame ring buffer, for its fence waits
+    //----------------------------------------------------------------------------------------------------------------------
+    inline const DynamicBuffer &dynamicBuffer() const {return m_dynamicBuffer;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief wait for the last cull and check the GPU lists against the CPU test, the context must be current
+    /// @returns the number of teapots wrongly culled or kept
+    //----------------------------------------------------------------------------------------------------------------------
+    inline size_t verifyCulling(){return m_instanceCuller.verify(m_teapotLod);}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief triangles submitted since construction, shadow passes included
+    //----------------------------------------------------------------------------------------------------------------------
+    inline uint64_t trianglesDrawn() const {return m_trianglesDrawn;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the shadow atlas, holds the tile counts
+    //----------------------------------------------------------------------------------------------------------------------
+    inline const ShadowAtlas &shadowAtlas() const {return m_shadowAtlas;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the per object light lists of the last frame
+    //----------------------------------------------------------------------------------------------------------------------
+    inline const LightCuller &lightCuller() const {return m_culler;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief where the generated ground plane is cached, empty to build it with VAOPrimitives every run, must
+    /// be called before initializeGL
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setMeshCacheDir(const std::string &_dir){m_meshCacheDir=_dir;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief upload the teapot and plane as PackedVertex rather than floats, must be called before initializeGL
+    /// @param [in] _packed true for the packed layout
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setPackedVertices(bool _packed){m_packedVertices=_packed;}
+    inline bool isPackedVertices() const {return m_packedVertices;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the teapot and plane with a part per level of detail, for their sizes
+    //----------------------------------------------------------------------------------------------------------------------
+    inline const StaticMesh &teapotMesh() const {return m_teapot;}
+    inline const StaticMesh &planeMesh() const {return m_plane;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the post transform cache misses per triangle of a full mesh before and after its triangles were
+    /// reordered, see MeshOptimizer::acmr
+    //----------------------------------------------------------------------------------------------------------------------
+    struct CacheStats
+    {
+      float m_before=0.0f;
+      float m_after=0.0f;
+    };
+    inline const CacheStats &teapotCacheStats() const {return m_teapotCacheStats;}
+    inline const CacheStats &planeCacheStats() const {return m_planeCacheStats;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief time the vertex stage alone, the finest part of a mesh is drawn with the Spotlight program and the
+    /// rasterizer discarding everything, the context must be current
+    /// @param [in] _mesh the mesh
+    /// @param [in] _repeats the number of draws timed
+    /// @returns the GPU time of one draw in ms
+    //----------------------------------------------------------------------------------------------------------------------
+    double vertexStageTime(const StaticMesh &_mesh, int _repeats);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief ms from construction until the first frame had finished on the GPU, negative until then
+    //----------------------------------------------------------------------------------------------------------------------
+    inline double firstFrameTime() const {return m_firstFrameTime;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief ms spent creating the ground plane in initializeGL
+    //----------------------------------------------------------------------------------------------------------------------
+    inline double planeTime() const {return m_planeTime;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief where the ground plane came from, "cache", "generated" or "primitives"
+    //----------------------------------------------------------------------------------------------------------------------
+    inline const std::string &planeSource() const {return m_planeSource;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief frames drawn in full and frames shown from the copy of the last one since construction
+    //----------------------------------------------------------------------------------------------------------------------
+    inline uint64_t framesDrawn() const {return m_framesDrawn;}
+    inline uint64_t framesCached() const {return m_framesCached;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the frame profiler
+    //----------------------------------------------------------------------------------------------------------------------
+    inline FrameProfiler &profiler() {return m_profiler;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the forward pass's depth first with colour writes off so the lit pass shades each visible
+    /// sample once, testing GL_EQUAL against it. The teapots are drawn front to back. The deferred path
+    /// already shades once per pixel and is unchanged
+    /// @param [in] _prepass true for the pre-pass
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setDepthPrepass(bool _prepass){m_depthPrepass=_prepass;}
+    inline bool isDepthPrepass() const {return m_depthPrepass;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the samples the forward lit pass shaded and the overdraw, its samples per sample of the target
+    //----------------------------------------------------------------------------------------------------------------------
+    inline FragmentCounter &fragmentCounter() {return m_fragmentCounter;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the threads sharing the per frame CPU work, set before the window is shown
+    /// @param [in] _threads 0 for one per core, 1 to do everything on the render thread
+    //----------------------------------------------------------------------------------------------------------------------
+    inline void setJobThreads(int _threads){m_jobThreads=_threads;}
+    inline const JobSystem &jobSystem() const {return m_jobs;}
 
 private:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief what has changed since the last frame was drawn, DIRTYVIEW the camera or m_mouseGlobalTX,
+    /// DIRTYLIGHTS any spot value or how the spots are culled, DIRTYINSTANCES the teapot transforms and
+    /// DIRTYSETTINGS a render mode, the overlay or the window size. Frames with nothing changed are shown from
+    /// m_frameCache rather than drawn
+    //----------------------------------------------------------------------------------------------------------------------
+    enum Dirty : unsigned int {DIRTYVIEW=1, DIRTYLIGHTS=2, DIRTYINSTANCES=4, DIRTYSETTINGS=8, DIRTYALL=15};
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief used to store the x rotation mouse value
     //----------------------------------------------------------------------------------------------------------------------
@@ -132,6 +442,19 @@ private:
     //----------------------------------------------------------------------------------------------------------------------
     int m_height;
     //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the size the scene is drawn at this frame, smaller than the window while the render is scaled
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_renderWidth;
+    int m_renderHeight;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the scaled render target, its upscale and the controller choosing its size
+    //----------------------------------------------------------------------------------------------------------------------
+    DynamicResolution m_resolution;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the budget toggleDynamicResolution turns the scaling back on with, in ms
+    //----------------------------------------------------------------------------------------------------------------------
+    double m_frameBudget;
+    //----------------------------------------------------------------------------------------------------------------------
     /// @brief used to store the global mouse transforms
     //----------------------------------------------------------------------------------------------------------------------
     ngl::Mat4 m_mouseGlobalTX;
@@ -144,33 +467,444 @@ private:
     //----------------------------------------------------------------------------------------------------------------------
     ngl::Vec3 m_modelPos;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief timer to change the light
+    /// @brief timer to redraw the scene while the lights are animating, 0 while paused
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_redrawTimer;
     //----------------------------------------------------------------------------------------------------------------------
-    int m_lightChangeTimer;
+    /// @brief timer printing the stats once a second
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief light parameter change timer
+    int m_statsTimerID;
     //----------------------------------------------------------------------------------------------------------------------
-    int m_lightParamChangeTimer;
+    /// @brief the Dirty flags raised since the last frame was drawn
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief our transform stack for drawing the teapots
+    unsigned int m_dirty;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set once update has been called until the frame is painted so input events share one request
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_updatePending;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set when the per object light lists need rebuilding
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_objectListsDirty;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief copy of the last frame drawn while paused
+    //----------------------------------------------------------------------------------------------------------------------
+    FrameCache m_frameCache;
+    uint64_t m_framesDrawn;
+    uint64_t m_framesCached;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the transform stack the grid teapots' models are built with
     //----------------------------------------------------------------------------------------------------------------------
     ngl::Transformation m_transform;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief dynamic array of spotlights for drawing
+    /// @brief the cached models of the objects drawn one at a time, every teapot then the plane or only the plane
+    /// when the teapots are instanced, and their per draw blocks for the current view
+    //----------------------------------------------------------------------------------------------------------------------
+    TransformBatch m_transformBatch;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the object id of the first model in the batch and where its block went in the ring this frame
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_firstTransform;
+    size_t m_transformsOffset;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of teapots in the x direction of the grid
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_gridX;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of teapots in the z direction of the grid
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_gridZ;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of teapots, the grid's or the scene file's
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_numInstances;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the scene file, the mapping is kept for the per teapot draw loop
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string m_scenePath;
+    SceneFile m_scene;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief time taken to load the scene file
+    //----------------------------------------------------------------------------------------------------------------------
+    double m_sceneLoadTime;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the light recording being written and the one being played back
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string m_recordPath;
+    SpotRecorder m_recorder;
+    std::string m_replayPath;
+    SpotPlayer m_player;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the frames written to disk, the file and the frame rate of a Y4M stream
+    //----------------------------------------------------------------------------------------------------------------------
+    FrameCapture m_capture;
+    std::string m_capturePath;
+    int m_captureRate;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate if we draw the teapots with one instanced call
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_instanced;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief one model matrix per teapot, fetched by the instanced shaders with the instance index
+    //----------------------------------------------------------------------------------------------------------------------
+    TextureBuffer m_instanceMatrices;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the teapot and the plane with a part per level of detail, finest first
+    //----------------------------------------------------------------------------------------------------------------------
+    StaticMesh m_teapot;
+    StaticMesh m_plane;
+    CacheStats m_teapotCacheStats;
+    CacheStats m_planeCacheStats;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate the meshes are uploaded as PackedVertex
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_packedVertices;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the level each teapot and the plane is drawn with
+    //----------------------------------------------------------------------------------------------------------------------
+    LodSelector m_teapotLod;
+    LodSelector m_planeLod;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate the forward pass lays down depth first
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_depthPrepass;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief every teapot nearest the camera first, empty without the pre-pass
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<uint32_t> m_frontToBack;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief counts the samples the forward lit pass shades
+    //----------------------------------------------------------------------------------------------------------------------
+    FragmentCounter m_fragmentCounter;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief lists the teapots inside the view grouped by level, the instance attribute of the instanced draws
+    //----------------------------------------------------------------------------------------------------------------------
+    InstanceCuller m_instanceCuller;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate the teapots are culled on the GPU when the context allows
     //----------------------------------------------------------------------------------------------------------------------
-    std::vector <ngl::SpotLight> m_spots;
+    bool m_gpuCulling;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief a class to contain the spot attributes
+    /// @brief triangles submitted in all the frames drawn
     //----------------------------------------------------------------------------------------------------------------------
-    std::vector <SpotData> m_spotData;
+    uint64_t m_trianglesDrawn;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the ring the transforms, lights and visible teapots of each frame are written to
+    //----------------------------------------------------------------------------------------------------------------------
+    DynamicBuffer m_dynamicBuffer;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the spot lights in GPU layout, uploaded to the LightBlock uniform buffer
+    //----------------------------------------------------------------------------------------------------------------------
+    LightBlock m_lights;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of spot lights in the scene
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_numLights;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief assigns the lights to view space clusters so each fragment only shades nearby lights
+    //----------------------------------------------------------------------------------------------------------------------
+    ClusterGrid m_clusters;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief GPU copy of the per cluster (offset,count) pairs
+    //----------------------------------------------------------------------------------------------------------------------
+    TextureBuffer m_clusterCells;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief GPU copy of the packed cluster light lists
+    //----------------------------------------------------------------------------------------------------------------------
+    TextureBuffer m_clusterIndices;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief builds the list of lights reaching each teapot and the plane
+    //----------------------------------------------------------------------------------------------------------------------
+    LightCuller m_culler;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate if the lights are culled per object
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_objectCulling;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief world space bounds of each teapot in instance order followed by the plane
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<BoundingSphere> m_objectBounds;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_objectBounds in eye space for the current frame
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<BoundingSphere> m_eyeBounds;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief GPU copy of the per object (offset,count) pairs
+    //----------------------------------------------------------------------------------------------------------------------
+    TextureBuffer m_objectCells;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief GPU copy of the packed object light lists
+    //----------------------------------------------------------------------------------------------------------------------
+    TextureBuffer m_objectIndices;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate if the deferred path is used
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_deferred;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the G-buffer and light volume passes
+    //----------------------------------------------------------------------------------------------------------------------
+    DeferredRenderer m_deferredRenderer;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the cached shadow maps of the spots
+    //----------------------------------------------------------------------------------------------------------------------
+    ShadowAtlas m_shadowAtlas;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set when the projection or viewport changes and the cluster uniforms must be reloaded
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_clustersDirty;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief transform applied to the spot positions and directions before they are sent to the shader
+    //----------------------------------------------------------------------------------------------------------------------
+    ngl::Mat4 m_lightTransform;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief upload counters for the current frame
+    //----------------------------------------------------------------------------------------------------------------------
+    FrameStats m_frameStats;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief upload counters accumulated since the last report
+    //----------------------------------------------------------------------------------------------------------------------
+    FrameStats m_statsTotal;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of frames accumulated in m_statsTotal
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_statsFrames;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of frames shown from m_frameCache since the last report
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_statsCached;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief process CPU time at the last report
+    //----------------------------------------------------------------------------------------------------------------------
+    std::clock_t m_statsClock;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief time since the last stats report
+    //----------------------------------------------------------------------------------------------------------------------
+    QElapsedTimer m_statsTimer;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate if the upload stats are printed
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_printStats;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief simulation ticks at the last stats report
+    //----------------------------------------------------------------------------------------------------------------------
+    uint64_t m_statsTicks;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief shadow tiles drawn at the last stats report
+    //----------------------------------------------------------------------------------------------------------------------
+    uint64_t m_statsShadowTiles;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief ring buffer fence waits and the time spent in them at the last stats report
+    //----------------------------------------------------------------------------------------------------------------------
+    uint64_t m_statsRingWaits;
+    double m_statsRingWaitTime;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief frames captured and readback waits at the last stats report
+    //----------------------------------------------------------------------------------------------------------------------
+    uint64_t m_statsCaptured;
+    uint64_t m_statsCaptureWaits;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief builds and caches the spotlight shader variants
+    //----------------------------------------------------------------------------------------------------------------------
+    ShaderCache m_shaderCache;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief constant, linear and quadratic attenuation of every spot, fixed for the run so the shader can
+    /// be specialised on it
+    //----------------------------------------------------------------------------------------------------------------------
+    ngl::Vec3 m_attenuation;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief times the phases of each frame
+    //----------------------------------------------------------------------------------------------------------------------
+    FrameProfiler m_profiler;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the scheduler the per frame CPU work runs on and the threads asked for
+    //----------------------------------------------------------------------------------------------------------------------
+    JobSystem m_jobs;
+    int m_jobThreads;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the CPU stages of a frame, light packing, levels, culling, binning and transforms, run on m_jobs
+    /// before anything is drawn. Only their results are sent to GL afterwards on the render thread
+    //----------------------------------------------------------------------------------------------------------------------
+    JobGraph m_frameGraph;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief which of the stages have work this frame, set before the graph runs
+    //----------------------------------------------------------------------------------------------------------------------
+    struct FrameWork
+    {
+      bool m_lightPack=false;
+      bool m_viewChanged=false;
+      bool m_forward=false;
+    };
+    FrameWork m_frameWork;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief text used to draw the profile overlay
+    //----------------------------------------------------------------------------------------------------------------------
+    std::unique_ptr<ngl::Text> m_text;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate if the profile overlay is drawn
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_showProfile;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the animation parameters of every spot, a copy is handed to the simulation when they change
+    //----------------------------------------------------------------------------------------------------------------------
+    SpotState m_spotState;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief animates the spots on its own thread at a fixed timestep
+    //----------------------------------------------------------------------------------------------------------------------
+    SpotSimulation m_simulation;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the spots blended between the last two simulation ticks for the current frame
+    //----------------------------------------------------------------------------------------------------------------------
+    SpotFrame m_spotFrame;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluates the spots in a compute shader when m_lightsOnGpu is set
+    //----------------------------------------------------------------------------------------------------------------------
+    GpuSpotAnimator m_gpuSpots;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate the GPU animation was asked for, and if the lights are animated by it now
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_gpuAnimation;
+    bool m_lightsOnGpu;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set when the spots have changed and the GPU animation needs them
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_gpuSpotsStale;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the animation time of the GPU path in ticks and when it was last advanced
+    //----------------------------------------------------------------------------------------------------------------------
+    double m_animationTicks;
+    SpotSimulation::Clock::time_point m_animationClock;
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief flag to indicate if animation is active or not
     //----------------------------------------------------------------------------------------------------------------------
     bool m_animate;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief method to load transform matrices to the shader
+    /// @brief flag to indicate if the animation runs on the simulation thread
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_threadedAnimation;
     //----------------------------------------------------------------------------------------------------------------------
-    void loadMatricesToShader();
+    /// @brief the random seed used when m_fixedSeed is set
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned int m_seed;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag to indicate the lights are seeded from m_seed rather than the time
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_fixedSeed;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief directory the ground plane mesh is cached in
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string m_meshCacheDir;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief where the ground plane came from
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string m_planeSource;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief time taken to create the ground plane
+    //----------------------------------------------------------------------------------------------------------------------
+    double m_planeTime;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief started on construction to measure the time to the first frame
+    //----------------------------------------------------------------------------------------------------------------------
+    QElapsedTimer m_startupTimer;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief time to the first frame, negative until it has been drawn
+    //----------------------------------------------------------------------------------------------------------------------
+    double m_firstFrameTime;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief recalculate the blocks of the objects drawn on their own as the view, projection or models changed,
+    /// split across the job threads
+    //----------------------------------------------------------------------------------------------------------------------
+    void updateTransforms();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief copy the blocks of the objects drawn on their own to the ring buffer
+    //----------------------------------------------------------------------------------------------------------------------
+    void uploadTransforms();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief bind the block of an object for the next draws
+    /// @param [in] _object the object's index into the light lists
+    //----------------------------------------------------------------------------------------------------------------------
+    void bindTransforms(size_t _object);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write a Transforms block to the ring buffer and bind it for the next draws
+    //----------------------------------------------------------------------------------------------------------------------
+    void loadTransforms(const ngl::Mat4 &_MV, const ngl::Mat4 &_MVP, const ngl::Mat3 &_normalMatrix, int _objectID);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the most the frame can write to the ring buffer with the current settings
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t frameBytes() const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief map the scene file if one was given, it sets the light count to its number of spots
+    //----------------------------------------------------------------------------------------------------------------------
+    void openScene();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the per instance model matrices for the teapot grid, or stream them from the scene file,
+    /// into the instance matrix buffer
+    //----------------------------------------------------------------------------------------------------------------------
+    void createInstances();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the model matrix of the grid teapot in column _ix and row _iz, set with m_transform
+    //----------------------------------------------------------------------------------------------------------------------
+    ngl::Mat4 gridModel(int _ix, int _iz);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief fill the transform batch with the objects from _firstObject on, the teapots are read again from the
+    /// scene file or the grid so only the objects drawn one at a time are kept on the CPU
+    /// @param [in] _firstObject m_numInstances when the teapots are instanced, 0 when they are drawn singly
+    //----------------------------------------------------------------------------------------------------------------------
+    void batchTransforms(size_t _firstObject);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief map the ground plane from the mesh cache, writing it first if it isn't there, or build it with
+    /// VAOPrimitives when there is no cache. Only the cached plane has levels of detail
+    //----------------------------------------------------------------------------------------------------------------------
+    void createPlane();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief index the VAOPrimitives teapot and build its levels of detail
+    //----------------------------------------------------------------------------------------------------------------------
+    void createTeapotLods();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief simplify a mesh to the coarser levels of detail, or read them from the mesh cache, reorder each
+    /// level for the vertex caches and load the levels as the parts of a mesh
+    /// @param [in] _name the mesh name used for the cache files
+    /// @param [in] _key the cache key of the full mesh
+    /// @param [in] _vertices the full mesh in the MeshFile layout
+    /// @param [in] _indices three per triangle
+    /// @param [out] o_mesh the mesh to load, the full mesh is its first part
+    /// @param [out] o_stats the cache misses of the full mesh
+    //----------------------------------------------------------------------------------------------------------------------
+    void createLods(const std::string &_name, uint64_t _key, const std::vector<float> &_vertices,
+                    const std::vector<uint32_t> &_indices, StaticMesh &o_mesh, CacheStats &o_stats);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief move the object bounds into eye space and choose the level of every teapot and the plane, with
+    /// the pre-pass sort the teapots front to back too
+    //----------------------------------------------------------------------------------------------------------------------
+    void updateLods();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the teapots of one of the culled lists using the current program
+    /// @param [in] _pass the visible teapots or every teapot for the shadows
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawTeapotLods(InstanceCuller::Pass _pass);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the visible teapots of the grid, with one indirect draw or an instanced call per level of detail
+    /// @param [in] _program the instanced program to draw with
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawTeapotsInstanced(const std::string &_program);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the plane at its level of detail
+    /// @param [in] _program the single object program to draw with
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawPlane(const char *_program);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the teapots, instanced or one at a time, front to back when they have been sorted
+    /// @param [in] _programs the single and instanced programs to draw with
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawTeapots(const char **_programs);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the plane and teapots
+    /// @param [in] _gbuffer true to draw with the G-buffer programs rather than forward shading
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawScene(bool _gbuffer);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write the depth of the teapots then the plane with colour writes off
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawDepthPrepass();
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief Qt Event called when a key is pressed
     /// @param [in] _event the Qt event to query for size etc
@@ -205,6 +939,91 @@ private:
     //----------------------------------------------------------------------------------------------------------------------
     void createLights();
     //----------------------------------------------------------------------------------------------------------------------
+    /// @brief fill in the values of a spot derived from its SpotState position and aim and set up its light
+    /// @param [in] _i the spot
+    /// @param [in] _cutoff the cone angle in degrees
+    /// @param [in] _innerCutoff the angle the falloff starts at in degrees
+    /// @param [in] _exponent the falloff exponent
+    //----------------------------------------------------------------------------------------------------------------------
+    void initSpot(size_t _i, float _cutoff, float _innerCutoff, float _exponent);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief work out the range of a spot from its height and cutoffs and set it on its light
+    /// @param [in] _i the spot
+    /// @param [in] _dirY the y of the spot's current direction
+    //----------------------------------------------------------------------------------------------------------------------
+    void setSpotRange(size_t _i, float _dirY);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief copy the animated direction, colour and range of every spot into the light block
+    //----------------------------------------------------------------------------------------------------------------------
+    void loadSpotsToLights();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief send the spots to the GPU animation and replace each CPU light by the cone it sweeps, which the
+    /// culling and shadow maps use while the GPU moves the real one
+    //----------------------------------------------------------------------------------------------------------------------
+    void loadSpotsToGpu();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief move the animation between the simulation and the GPU, the context must be current
+    /// @param [in] _gpu true to animate on the GPU
+    //----------------------------------------------------------------------------------------------------------------------
+    void switchAnimation(bool _gpu);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief send the lights changed since the last frame and bind the lights the shaders read
+    /// @returns true if the lights used for culling changed
+    //----------------------------------------------------------------------------------------------------------------------
+    bool uploadLights();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the half width of the area the spots are scattered over, grows with the light count so the
+    /// density of lights stays the same as the original 8 light demo
+    //----------------------------------------------------------------------------------------------------------------------
+    float lightSpread() const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the ATTENUATION define for the terms of m_attenuation in use
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string attenuationModel() const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief send the cluster light lists binned by the frame graph to the GPU, and the grid if it changed
+    //----------------------------------------------------------------------------------------------------------------------
+    void updateClusters();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief rebuild the per object light lists from the eye space bounds, no GL calls
+    //----------------------------------------------------------------------------------------------------------------------
+    void cullObjects();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief send the per object light lists to the GPU
+    //----------------------------------------------------------------------------------------------------------------------
+    void uploadObjectLists();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief add the CPU stages of a frame and their dependencies to m_frameGraph
+    //----------------------------------------------------------------------------------------------------------------------
+    void createFrameGraph();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief blend the spot lights towards the newest simulation tick or read the next recorded one
+    //----------------------------------------------------------------------------------------------------------------------
+    void packLights();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief redraw the stale shadow tiles and bind the atlas for the lighting passes
+    //----------------------------------------------------------------------------------------------------------------------
+    void updateShadows();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief print the frame counters accumulated since the last report with the CPU (and when profiling
+    /// the GPU) time used, called once a second
+    //----------------------------------------------------------------------------------------------------------------------
+    void reportStats();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief note what changed and ask for a frame, any number of requests before the frame is drawn
+    /// share one update
+    /// @param [in] _dirty the Dirty flags to raise
+    //----------------------------------------------------------------------------------------------------------------------
+    void requestRedraw(unsigned int _dirty);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the per phase timings over the scene
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawProfile();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief start the readback of the frame in the bound framebuffer when capturing
+    //----------------------------------------------------------------------------------------------------------------------
+    void captureFrame();
+    //----------------------------------------------------------------------------------------------------------------------
     /// @brief the timer event triggered from the timers
     /// @param _even the event of the timer triggered by Qt
     //----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,171 @@
+#ifndef OFFSCREENBENCHMARK_H_
+#define OFFSCREENBENCHMARK_H_
+#include <QJsonObject>
+#include <QString>
+#include <QSurfaceFormat>
+#include <memory>
+#include <string>
+#include <vector>
+#include "NGLScene.h"
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file OffscreenBenchmark.h
+/// @brief renders the scene into an offscreen framebuffer and times it
+/// @class OffscreenBenchmark
+/// @brief drives an NGLScene without a window, the scene is initialised, resized and painted into a
+/// framebuffer object on a QOffscreenSurface context so it runs anywhere Qt can create a GL context,
+/// including Mesa llvmpipe on machines with no GPU. The spot animation is stepped once per frame on the
+/// calling thread so a fixed seed gives the same frames every run. Each frame records the CPU time spent
+/// in paintGL and the GPU time from a GL_TIME_ELAPSED query, the results are reported as JSON.
+//----------------------------------------------------------------------------------------------------------------------
+class OffscreenBenchmark
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor
+  /// @param [in] _width the framebuffer width
+  /// @param [in] _height the framebuffer height
+  /// @param [in] _format the format used for the context and the framebuffer samples
+  //----------------------------------------------------------------------------------------------------------------------
+  OffscreenBenchmark(int _width, int _height, const QSurfaceFormat &_format);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the scene while the context is still current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~OffscreenBenchmark();
+  OffscreenBenchmark(const OffscreenBenchmark &)=delete;
+  OffscreenBenchmark &operator=(const OffscreenBenchmark &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the scene being benchmarked, configure it before calling run
+  //----------------------------------------------------------------------------------------------------------------------
+  inline NGLScene &scene() {return *m_scene;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief write a Chrome trace of the timed frames
+  /// @param [in] _fname the json file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setTraceFile(const std::string &_fname){m_traceFile=_fname;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief create the context, initialise the scene and render the frames
+  /// @param [in] _frames the number of frames timed
+  /// @param [in] _warmup the number of frames rendered first and not timed
+  /// @returns false if no context or framebuffer could be created
+  //----------------------------------------------------------------------------------------------------------------------
+  bool run(int _frames, int _warmup);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief time forward and deferred shading with the light count doubling from 8 to _maxLights and find
+  /// the count from which deferred is faster, the result is added to results() as "crossover"
+  /// @param [in] _maxLights the largest light count
+  /// @param [in] _frames the number of frames timed for each count and path
+  /// @param [in] _warmup the number of frames rendered first and not timed
+  /// @returns false if no context or framebuffer could be created
+  //----------------------------------------------------------------------------------------------------------------------
+  bool runCrossover(size_t _maxLights, int _frames, int _warmup);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the timings and settings of the last run
+  //----------------------------------------------------------------------------------------------------------------------
+  QJsonObject results() const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief save the last rendered frame, useful to check the benchmark is drawing what we think
+  /// @param [in] _fname the image to write, the format comes from the extension
+  //----------------------------------------------------------------------------------------------------------------------
+  bool saveFrame(const QString &_fname) const;
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief how many frames of timer queries are kept in flight before we wait on the oldest
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr int QUERYLATENCY=4;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief draws averaged over when timing the vertex stage of each mesh
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr int VERTEXREPEATS=32;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief create the context and framebuffer and initialise the scene, only the first call does anything
+  /// @returns false if no context or framebuffer could be created
+  //----------------------------------------------------------------------------------------------------------------------
+  bool initialize();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief render one frame, timing it if _record is set
+  //----------------------------------------------------------------------------------------------------------------------
+  void renderFrame(bool _record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief read back the timer query for frame _frame into m_gpuTimes
+  //----------------------------------------------------------------------------------------------------------------------
+  void collectQuery(size_t _frame);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief mean, min, max and percentiles of a set of times in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  static QJsonObject summarise(std::vector<double> _times);
+  int m_width;
+  int m_height;
+  QSurfaceFormat m_format;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the offscreen GL objects, declared before the scene so they are destroyed after it
+  //----------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<QOffscreenSurface> m_surface;
+  std::unique_ptr<QOpenGLContext> m_context;
+  std::unique_ptr<QOpenGLFramebufferObject> m_fbo;
+  std::unique_ptr<NGLScene> m_scene;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ring of GL_TIME_ELAPSED queries, empty if the context has no timer queries
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<GLuint> m_queries;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief per frame times in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<double> m_cpuTimes;
+  std::vector<double> m_gpuTimes;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief wall clock time of the timed frames including waiting for the GPU to finish
+  //----------------------------------------------------------------------------------------------------------------------
+  double m_totalTime;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief shadow tiles redrawn during the timed frames
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_shadowTiles;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief triangles submitted during the timed frames
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_triangles;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief teapots in the camera's list after the timed frames and how many of them the GPU got wrong
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_visibleInstances;
+  size_t m_cullMismatches;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the largest difference of the GPU animated lights from SpotCurve after the timed frames
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_animationError;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief GPU time in ms of the vertex stage alone for the full teapot and plane
+  //----------------------------------------------------------------------------------------------------------------------
+  double m_teapotVertexTime;
+  double m_planeVertexTime;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief timed frames that waited for their ring buffer region and the time they waited in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_ringWaits;
+  double m_ringWaitTime;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief timed frames shown from the copy of the last frame rather than drawn
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_cachedFrames;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the GL_RENDERER and GL_VERSION strings of the context
+  //----------------------------------------------------------------------------------------------------------------------
+  QString m_renderer;
+  QString m_version;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief trace file for the timed frames, empty for none
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_traceFile;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the forward / deferred timings of the last runCrossover
+  //----------------------------------------------------------------------------------------------------------------------
+  QJsonObject m_crossover;
+};
+
+#endif
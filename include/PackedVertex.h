@@ -0,0 +1,21 @@
+#ifndef PACKEDVERTEX_H_
+#define PACKEDVERTEX_H_
+#include <cstdint>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file PackedVertex.h
+/// @brief GPU layout of the compressed vertices, read with PACKEDNORMALS set in SpotlightVert.glsl
+/// @class PackedVertex
+/// @brief 12 bytes rather than the 32 of the MeshFile layout. The position is three half floats, good to 1/2048
+/// of its magnitude which is under 4mm anywhere on the 30 unit plane, and a fourth half pads the normal to a 4
+/// byte boundary. The normal is octahedral encoded in two snorm shorts, under 0.05 degrees out. The uv is
+/// dropped as no shader reads it
+//----------------------------------------------------------------------------------------------------------------------
+struct PackedVertex
+{
+  uint16_t m_position[4];
+  int16_t m_normal[2];
+};
+static_assert(sizeof(PackedVertex)==12,"PackedVertex must match the attribute layout of StaticMesh");
+
+#endif
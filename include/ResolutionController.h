@@ -0,0 +1,102 @@
+#ifndef RESOLUTIONCONTROLLER_H_
+#define RESOLUTIONCONTROLLER_H_
+#include <cstddef>
+#include <cstdint>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ResolutionController.h
+/// @brief picks the render scale that keeps the GPU frame time inside a budget
+/// @class ResolutionController
+/// @brief fed the measured GPU time of each frame, it smooths the times and once they leave the band between
+/// LOWFRACTION of the budget and the budget it moves the scale of each axis towards the one that would land on
+/// TARGETFRACTION of it, assuming the cost follows the pixel count. Steps down are allowed to be bigger than
+/// steps up so an overloaded frame recovers quickly, the scale is a multiple of STEP so the render size only
+/// takes a few values, and after a change the next COOLDOWN measurements are ignored as the timer results
+/// arrive a few frames late and would still show the old size. DynamicResolution owns one and resizes its
+/// render targets to the scale it picks.
+//----------------------------------------------------------------------------------------------------------------------
+class ResolutionController
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the scale is a multiple of this
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr float STEP=1.0f/32.0f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the fraction of the budget a change of scale aims for, the rest is headroom for spikes
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr double TARGETFRACTION=0.9;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames cheaper than this fraction of the budget are a reason to raise the scale
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr double LOWFRACTION=0.75;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief weight of each new time in the smoothed time
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr double SMOOTHING=0.25;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief measurements ignored after a change
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr int COOLDOWN=8;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the frame time to stay under, 0 or less keeps the scale at the maximum
+  /// @param [in] _ms the budget in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  void setBudget(double _ms);
+  inline double budget() const {return m_budget;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the range the scale of each axis is kept in, both are clamped to (0,1]
+  //----------------------------------------------------------------------------------------------------------------------
+  void setLimits(float _min, float _max);
+  inline float minScale() const {return m_min;}
+  inline float maxScale() const {return m_max;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start again from the maximum scale with no history
+  //----------------------------------------------------------------------------------------------------------------------
+  void reset();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief add the GPU time of a frame drawn at the current scale
+  /// @param [in] _ms the time in ms
+  /// @returns true if the scale changed
+  //----------------------------------------------------------------------------------------------------------------------
+  bool update(double _ms);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the scale of each axis of the render size
+  //----------------------------------------------------------------------------------------------------------------------
+  inline float scale() const {return m_scale;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the smoothed GPU time in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  inline double smoothedTime() const {return m_smoothed;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief measurements since the counters were cleared, their total time and scale, how many were over
+  /// the budget and how often the scale changed
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t samples() const {return m_samples;}
+  inline double meanTime() const {return m_samples ? m_timeSum/m_samples : 0.0;}
+  inline double meanScale() const {return m_samples ? m_scaleSum/m_samples : m_scale;}
+  inline uint64_t overBudget() const {return m_overBudget;}
+  inline uint64_t changes() const {return m_changes;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief clear the counters, the scale and smoothed time are kept
+  //----------------------------------------------------------------------------------------------------------------------
+  void clearCounters();
+
+private :
+  double m_budget=0.0;
+  float m_min=0.5f;
+  float m_max=1.0f;
+  float m_scale=1.0f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief 0 until the first measurement
+  //----------------------------------------------------------------------------------------------------------------------
+  double m_smoothed=0.0;
+  int m_cooldown=0;
+  uint64_t m_samples=0;
+  double m_timeSum=0.0;
+  double m_scaleSum=0.0;
+  uint64_t m_overBudget=0;
+  uint64_t m_changes=0;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef SCENEFILE_H_
+#define SCENEFILE_H_
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SceneFile.h
+/// @brief binary scene files holding the teapot instances and the spot lights
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SceneHeader
+/// @brief the start of every scene file. The instance matrices and the spot columns follow, each starting
+/// on an ALIGN byte boundary
+//----------------------------------------------------------------------------------------------------------------------
+struct SceneHeader
+{
+  uint32_t m_magic;
+  uint32_t m_version;
+  uint32_t m_instanceCount;
+  uint32_t m_spotCount;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief byte offset of the model matrices, 16 column major floats per instance
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_instanceOffset;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief byte offset of the first spot column
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_spotOffset;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief number of spot columns and the floats from the start of one to the next
+  //----------------------------------------------------------------------------------------------------------------------
+  uint32_t m_spotColumns;
+  uint32_t m_spotPitch;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SceneFile
+/// @brief a scene stored as arrays ready for use, the model matrices are in the layout of the instance
+/// buffer and each spot parameter is a column of floats in the layout of SpotState. Reading maps the file
+/// and hands out pointers into the mapping so nothing is parsed however big the scene is.
+//----------------------------------------------------------------------------------------------------------------------
+class SceneFile
+{
+public :
+  static constexpr uint32_t MAGIC=0x53535053; // SPSS
+  static constexpr uint32_t VERSION=1;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief alignment of the arrays in bytes
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t ALIGN=64;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief floats per instance
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t MATRIXFLOATS=16;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the spot columns, those up to TIMEOFFSET are SpotState arrays of the same name, the cone angles
+  /// are in degrees
+  //----------------------------------------------------------------------------------------------------------------------
+  enum SpotColumn : uint32_t
+  {
+    POSX,POSY,POSZ,
+    CENTREX,CENTREZ,
+    RADIUSX,RADIUSZ,
+    STARTR,STARTG,STARTB,
+    ENDR,ENDG,ENDB,
+    TIMEOFFSET,
+    CUTOFF,INNERCUTOFF,EXPONENT,
+    SPOTCOLUMNS
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief map a scene file
+  /// @param [in] _fname the file
+  /// @returns false if the file is missing, from another version or its arrays don't fit in it
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_fname);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief unmap the file
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void close(){m_file.close();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is a scene mapped
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isOpen() const {return m_file.isOpen();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the header of the mapped scene
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const SceneHeader &header() const {return *reinterpret_cast<const SceneHeader *>(m_file.data());}
+  inline size_t numInstances() const {return header().m_instanceCount;}
+  inline size_t numSpots() const {return header().m_spotCount;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the model matrices of all the instances
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const float *instances() const
+  {
+    return reinterpret_cast<const float *>(m_file.data()+header().m_instanceOffset);
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief one parameter of every spot
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const float *spotColumn(SpotColumn _column) const
+  {
+    return reinterpret_cast<const float *>(m_file.data()+header().m_spotOffset)+size_t(_column)*header().m_spotPitch;
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief drop the pages of instances that have been uploaded
+  /// @param [in] _first the first instance
+  /// @param [in] _count the number of instances
+  //----------------------------------------------------------------------------------------------------------------------
+  void releaseInstances(size_t _first, size_t _count) const;
+
+private :
+  MappedFile m_file;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SceneWriter
+/// @brief writes a scene file. Instances go straight to the file as they are added so they are never all
+/// held in memory, the spots are kept until finish as their columns can only be written once all are known.
+//----------------------------------------------------------------------------------------------------------------------
+class SceneWriter
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start writing a scene, it is written to a temporary next to the file until finish succeeds
+  /// @param [in] _fname the file to write
+  /// @returns false if the file can't be created
+  //----------------------------------------------------------------------------------------------------------------------
+  bool begin(const std::string &_fname);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief add an instance
+  /// @param [in] _model the model matrix, column major
+  //----------------------------------------------------------------------------------------------------------------------
+  void addInstance(const float _model[SceneFile::MATRIXFLOATS]);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief add a spot
+  /// @param [in] _spot the value of each column in SceneFile::SpotColumn order
+  //----------------------------------------------------------------------------------------------------------------------
+  void addSpot(const float _spot[SceneFile::SPOTCOLUMNS]);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief write the spots and the header and move the file into place
+  /// @returns false if anything failed to write, the temporary is removed
+  //----------------------------------------------------------------------------------------------------------------------
+  bool finish();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief give up on the scene and remove the temporary, any existing file is left alone
+  //----------------------------------------------------------------------------------------------------------------------
+  void abort();
+  inline size_t numInstances() const {return m_instanceCount;}
+  inline size_t numSpots() const {return m_spots[0].size();}
+
+private :
+  std::string m_fname;
+  std::string m_tmp;
+  std::ofstream m_out;
+  size_t m_instanceCount=0;
+  std::vector<float> m_spots[SceneFile::SPOTCOLUMNS];
+};
+
+#endif
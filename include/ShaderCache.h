@@ -0,0 +1,127 @@
+#ifndef SHADERCACHE_H_
+#define SHADERCACHE_H_
+#include <ngl/Types.h>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ShaderCache.h
+/// @brief builds specialised variants of a shader and caches the linked binaries on disk
+/// @class ShaderCache
+/// @brief each variant is the same vertex / fragment (or compute) source with a set of #defines injected
+/// after the #version line, so options fixed for the whole run (normalising, the attenuation model,
+/// instancing) are compiled out rather than branched on. The variants are created as ngl::ShaderLib programs so the rest
+/// of the code uses and sets them as normal. Linked programs are saved with glGetProgramBinary under a key
+/// hashed from the final source and the driver, warm starts load them with glProgramBinary and skip the
+/// compiler. Anything that does need compiling is submitted before any status is queried, with
+/// GL_KHR_parallel_shader_compile (or the ARB version) the driver builds them all at once.
+//----------------------------------------------------------------------------------------------------------------------
+class ShaderCache
+{
+public :
+  typedef std::vector<std::pair<std::string,std::string>> Defines;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief one program to build
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Variant
+  {
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the ShaderLib program name
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string m_program;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief name / value pairs injected as #define name value
+    //----------------------------------------------------------------------------------------------------------------------
+    Defines m_defines;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor
+  /// @param [in] _directory where the binaries are kept, empty to disable the cache
+  //----------------------------------------------------------------------------------------------------------------------
+  explicit ShaderCache(const std::string &_directory=std::string());
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the cache directory, empty disables the cache
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setDirectory(const std::string &_directory){m_directory=_directory;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief build every variant of a vertex / fragment pair, a GL context must be current
+  /// @param [in] _vertex path of the vertex shader source
+  /// @param [in] _fragment path of the fragment shader source
+  /// @param [in] _variants the programs to build
+  /// @returns false if any variant failed to build
+  //----------------------------------------------------------------------------------------------------------------------
+  bool build(const std::string &_vertex, const std::string &_fragment, const std::vector<Variant> &_variants);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief build every variant of a compute shader, the context must be GL 4.3 or later
+  /// @param [in] _compute path of the compute shader source
+  /// @param [in] _variants the programs to build
+  /// @returns false if any variant failed to build
+  //----------------------------------------------------------------------------------------------------------------------
+  bool buildCompute(const std::string &_compute, const std::vector<Variant> &_variants);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the time taken by the builds so far in ms
+  //----------------------------------------------------------------------------------------------------------------------
+  inline double buildTime() const {return m_buildMs;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief variants loaded from the cache
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t hits() const {return m_hits;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief variants that had to be compiled
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t misses() const {return m_misses;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief was parallel compilation available
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool parallel() const {return m_parallel;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief insert the defines on the line after #version
+  /// @param [in] _source the shader source
+  /// @param [in] _defines the defines to add
+  //----------------------------------------------------------------------------------------------------------------------
+  static std::string injectDefines(const std::string &_source, const Defines &_defines);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a float as a GLSL literal for a define, with every digit a float holds so the shader sees the
+  /// same value as the C++ constant it came from
+  //----------------------------------------------------------------------------------------------------------------------
+  static std::string floatDefine(float _value);
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief build every variant of a program from one source file per stage
+  /// @param [in] _stages the shader type and source path of each stage
+  /// @param [in] _variants the programs to build
+  //----------------------------------------------------------------------------------------------------------------------
+  bool buildStages(const std::vector<std::pair<GLenum,std::string>> &_stages, const std::vector<Variant> &_variants);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief compile a shader without waiting for the result
+  //----------------------------------------------------------------------------------------------------------------------
+  static GLuint compile(GLenum _type, const std::string &_source);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief print the info log of a shader or program
+  //----------------------------------------------------------------------------------------------------------------------
+  static void printLog(GLuint _object, bool _program);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief load a cached binary into _program
+  /// @returns false if there is no usable binary
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool loadBinary(GLuint _program, const std::string &_path);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief save the binary of a linked program
+  //----------------------------------------------------------------------------------------------------------------------
+  static void saveBinary(GLuint _program, const std::string &_path);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ask the driver to compile on background threads if it can
+  //----------------------------------------------------------------------------------------------------------------------
+  void enableParallelCompile();
+  std::string m_directory;
+  double m_buildMs;
+  size_t m_hits;
+  size_t m_misses;
+  bool m_parallel;
+  bool m_parallelChecked;
+};
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef SHADOWATLAS_H_
+#define SHADOWATLAS_H_
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "FrameStats.h"
+#include "LightStd140.h"
+#include "TextureBuffer.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ShadowAtlas.h
+/// @brief one depth texture shared by the shadow maps of every spot
+/// @class ShadowAtlas
+/// @brief each light gets a square tile of the atlas sized by how much of the screen its cone covers, so a
+/// spot filling the view gets a detailed map and a distant one a coarse map. A tile is only redrawn when its
+/// light or the shadow casters have changed since it was last drawn, and at most budget() tiles are redrawn
+/// each frame, the rest keep their last map (and the matrix it was drawn with) until their turn comes.
+/// The shaders read the atlas as a sampler2DShadow and the per light atlas matrix and tile from a texture
+/// buffer of TEXELS RGBA32F texels per light.
+//----------------------------------------------------------------------------------------------------------------------
+class ShadowAtlas
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief texture units of the per light data and the depth atlas
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr GLuint DATAUNIT=9;
+  static constexpr GLuint ATLASUNIT=10;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the smallest and largest tile edge in texels, tiles are powers of two between these
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr int MINTILE=128;
+  static constexpr int MAXTILE=1024;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief texels per light in the data buffer, the atlas matrix columns, (enabled,texel size) and the tile
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t TEXELS=6;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a square region of the atlas in texels, a size of 0 means the light has no shadow map
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Tile
+  {
+    int m_x;
+    int m_y;
+    int m_size;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief draws the shadow casters into the bound tile, the argument takes eye space to the light's clip space
+  //----------------------------------------------------------------------------------------------------------------------
+  typedef std::function<void(const ngl::Mat4 &)> DrawCasters;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until create is called
+  //----------------------------------------------------------------------------------------------------------------------
+  ShadowAtlas()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the atlas, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~ShadowAtlas();
+  ShadowAtlas(const ShadowAtlas &)=delete;
+  ShadowAtlas &operator=(const ShadowAtlas &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief allocate the depth texture and the data buffer
+  /// @param [in] _size the edge of the atlas in texels, rounded up to a power of two no smaller than MAXTILE
+  /// @returns false if the framebuffer is incomplete, shadows are then disabled
+  //----------------------------------------------------------------------------------------------------------------------
+  bool create(int _size);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief point the shadowAtlas and shadowData samplers of a program at our units
+  /// @param [in] _programID the linked shader program
+  //----------------------------------------------------------------------------------------------------------------------
+  void bindToProgram(GLuint _programID) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bind the atlas and data buffer to their units ready for drawing
+  //----------------------------------------------------------------------------------------------------------------------
+  void bind() const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief resize the tiles to the current view and redraw the stale ones within the budget
+  /// @param [in] _lights the lights in eye space
+  /// @param [in] _numLights the number of lights
+  /// @param [in] _view the camera view matrix the casters are drawn with, any change redraws every tile
+  /// @param [in] _project the camera projection used to measure each cone's screen coverage
+  /// @param [in] _height the viewport height in pixels
+  /// @param [in] _draw draws the casters, called once per tile redrawn
+  /// @param [in,out] _stats the frame counters to add the data upload to
+  /// @returns the number of tiles redrawn
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t update(const LightStd140 *_lights, size_t _numLights, const ngl::Mat4 &_view, const ngl::Mat4 &_project,
+                int _height, const DrawCasters &_draw, FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief throw away every tile, used when the lights are recreated
+  //----------------------------------------------------------------------------------------------------------------------
+  void invalidate();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the casters have moved so every tile must be redrawn, the cached maps are used until then
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void castersChanged(){++m_casterVersion;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the most tiles redrawn in one frame, 0 for no limit
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setBudget(size_t _tiles){m_budget=_tiles;}
+  inline size_t budget() const {return m_budget;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief turn shadows on or off, when off the shaders see every light as unshadowed and the tiles are
+  /// redrawn when they come back on
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setEnabled(bool _enabled){m_enabled=_enabled; invalidate();}
+  inline bool isEnabled() const {return m_enabled;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief tiles redrawn since creation, the difference over a run gives the redraw rate
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t tilesRendered() const {return m_tilesRendered;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief lights with a tile and a map drawn into it
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t numShadowed() const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief lights left with a map drawn for an older light or caster position by the last update
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t numStale() const {return m_numStale;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the tile edge a light wants for the view, the cone's bounding sphere diameter on screen rounded up
+  /// to a power of two between MINTILE and MAXTILE
+  /// @param [in] _light the light in eye space
+  /// @param [in] _project the camera projection
+  /// @param [in] _height the viewport height in pixels
+  /// @param [out] o_coverage the bounding sphere diameter in pixels, used to order the redraws
+  /// @returns the tile size, 0 if the cone is outside the view
+  //----------------------------------------------------------------------------------------------------------------------
+  static int tileSize(const LightStd140 &_light, const ngl::Mat4 &_project, int _height, float &o_coverage);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief pack the tiles into the atlas, sizes are halved largest first until they fit and if they still
+  /// don't the last lights go without
+  /// @param [in,out] io_sizes the wanted size of each light, returns the sizes used
+  /// @param [in] _atlasSize the atlas edge in texels
+  /// @param [out] o_tiles the tile of each light
+  //----------------------------------------------------------------------------------------------------------------------
+  static void layout(std::vector<int> &io_sizes, int _atlasSize, std::vector<Tile> &o_tiles);
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the cache state of one light's tile
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Slot
+  {
+    Tile m_tile;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the size asked of the layout, the tile may be smaller if the atlas is full
+    //----------------------------------------------------------------------------------------------------------------------
+    int m_request;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief position, direction, cutoff and range the map was drawn for
+    //----------------------------------------------------------------------------------------------------------------------
+    float m_key[8];
+    uint64_t m_casterVersion;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the frame the map was last drawn, 0 if the tile holds nothing yet
+    //----------------------------------------------------------------------------------------------------------------------
+    uint64_t m_drawnFrame;
+    float m_coverage;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the light's key for the cache
+  //----------------------------------------------------------------------------------------------------------------------
+  static void lightKey(const LightStd140 &_light, float o_key[8]);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the light's view projection, eye space to the clip space of the whole cone
+  //----------------------------------------------------------------------------------------------------------------------
+  static ngl::Mat4 lightViewProject(const LightStd140 &_light);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief write the atlas matrix and tile of a freshly drawn map to the data buffer
+  //----------------------------------------------------------------------------------------------------------------------
+  void setData(size_t _light, const ngl::Mat4 &_lightVP);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief mark a light as unshadowed in the data buffer
+  //----------------------------------------------------------------------------------------------------------------------
+  void clearData(size_t _light);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief send the data buffer if it has changed
+  //----------------------------------------------------------------------------------------------------------------------
+  void uploadData(FrameStats &_stats);
+  bool m_enabled=true;
+  size_t m_budget=8;
+  int m_size=0;
+  GLuint m_depth=0;
+  GLuint m_framebuffer=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief per light matrices and tiles read by the shaders
+  //----------------------------------------------------------------------------------------------------------------------
+  TextureBuffer m_dataBuffer;
+  std::vector<float> m_data;
+  bool m_dataDirty=true;
+  std::vector<Slot> m_slots;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief scratch for the tile sizes and layout
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<int> m_sizes;
+  std::vector<Tile> m_tiles;
+  std::vector<size_t> m_stale;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bumped whenever the casters or the view they're drawn with change
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_casterVersion=1;
+  ngl::Mat4 m_view;
+  uint64_t m_frame=0;
+  uint64_t m_tilesRendered=0;
+  size_t m_numStale=0;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SIMDSUPPORT_H_
+#define SIMDSUPPORT_H_
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SimdSupport.h
+/// @brief which of the hand vectorised kernels the build can compile
+/// SIMD_X86 is defined when the compiler targets SSE2, which every x86_64 build does but a 32 bit x86 build
+/// only with -msse2, so the SSE2 kernels can run on any CPU the build runs on. The AVX2 kernels are compiled
+/// with the GCC / clang target attribute SIMD_AVX2 and must only be called once __builtin_cpu_supports has
+/// said the CPU has AVX2 and FMA. Other compilers and CPUs get the scalar kernels alone.
+//----------------------------------------------------------------------------------------------------------------------
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+  #define SIMD_X86 1
+  #define SIMD_AVX2 __attribute__((target("avx2,fma")))
+  #include <immintrin.h>
+#endif
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef SPOTANIMATOR_H_
+#define SPOTANIMATOR_H_
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "SpotState.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpotAnimator.h
+/// @brief vectorised update of the spot light animation
+/// @class SpotAnimator
+/// @brief evaluates the spot animation (the point on the aim ellipse, the aim direction, the colour
+/// interpolation and the light range) for a range of spots in a SpotState. The kernel is chosen at runtime
+/// from the instruction sets the CPU supports, AVX2 processes 8 spots per step, SSE2 4 and the scalar
+/// fallback one. The vector kernels use a polynomial sin / cos accurate to a few ulp for |angle| < 8192
+/// so the caller should keep the animation time wrapped to a small range
+//----------------------------------------------------------------------------------------------------------------------
+class SpotAnimator
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the colour mix advances this much per tick and wraps at 1
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr float MIXSTEP=0.05f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the cone edge is clamped to 85 degrees from vertical so the range stays finite, and the range is
+  /// kept a little past where the edge meets the floor
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr float COSMAXEDGE=0.08715574274765817f;
+  static constexpr float RANGESCALE=1.01f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the aim goes once round its ellipse every TWOPI of animation time, the colour mix is eased over a
+  /// quarter turn of sin
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr double TWOPI=6.28318530717958647692;
+  static constexpr float HALFPI=1.57079632679489661923f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief cos(tilt+cutoff), the angle from straight down of the cone edge furthest from vertical
+  /// @param [in] _dirY the y of the unit spot direction, -1 is straight down
+  /// @param [in] _cosCutoff cos of the cone angle
+  /// @param [in] _sinCutoff sin of the cone angle
+  //----------------------------------------------------------------------------------------------------------------------
+  static inline float cosEdge(float _dirY, float _cosCutoff, float _sinCutoff)
+  {
+    float cosTilt=-_dirY;
+    float sinTilt=std::sqrt(std::max(0.0f,1.0f-cosTilt*cosTilt));
+    return cosTilt*_cosCutoff-sinTilt*_sinCutoff;
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the range of a spot, a little past where its furthest edge meets the floor
+  /// @param [in] _height the height of the spot above the floor
+  /// @param [in] _cosEdge cos of the angle of that edge from straight down, from cosEdge
+  //----------------------------------------------------------------------------------------------------------------------
+  static inline float range(float _height, float _cosEdge)
+  {
+    return RANGESCALE*_height/std::max(_cosEdge,COSMAXEDGE);
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief one spot of the animation with the libm trig functions, the scalar kernel and SpotCurve both
+  /// evaluate through it and the vector kernels do the same steps a lane at a time
+  /// @param [in] _angle the animation time plus the spot's time offset
+  /// @param [in] _mix the colour mix in [0,1)
+  /// @param [in] _position the spot position, the floor is at y=0
+  /// @param [in] _ellipse x and z of the aim ellipse centre then its x and z radius
+  /// @param [in] _start the colour at a mix of 0
+  /// @param [in] _end the colour at a mix of 1
+  /// @param [in] _cosCutoff cos of the cone angle
+  /// @param [in] _sinCutoff sin of the cone angle
+  /// @param [out] o_dir the unit direction
+  /// @param [out] o_colour the colour
+  /// @param [out] o_range the range
+  //----------------------------------------------------------------------------------------------------------------------
+  static inline void evaluate(float _angle, float _mix, const float _position[3], const float _ellipse[4],
+                              const float _start[3], const float _end[3], float _cosCutoff, float _sinCutoff,
+                              float o_dir[3], float o_colour[3], float &o_range)
+  {
+    // the point on the ellipse the spot aims at
+    float dx=_ellipse[0]+std::cos(_angle)*_ellipse[2]-_position[0];
+    float dy=-_position[1];
+    float dz=_ellipse[1]+std::sin(_angle)*_ellipse[3]-_position[2];
+    float inv=1.0f/std::sqrt(dx*dx+dy*dy+dz*dz);
+    o_dir[0]=dx*inv;
+    o_dir[1]=dy*inv;
+    o_dir[2]=dz*inv;
+    // same easing as ngl::trigInterp, lerp by sin of the mix mapped to 0-90 degrees
+    float t=std::sin(_mix*HALFPI);
+    for(int c=0; c<3; ++c)
+    {
+      o_colour[c]=_start[c]+(_end[c]-_start[c])*t;
+    }
+    o_range=range(_position[1],cosEdge(o_dir[1],_cosCutoff,_sinCutoff));
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the available kernels
+  //----------------------------------------------------------------------------------------------------------------------
+  enum class Kernel {SCALAR, SSE2, AVX2};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor selects the fastest kernel the CPU supports
+  //----------------------------------------------------------------------------------------------------------------------
+  SpotAnimator();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor using a specific kernel, falls back to scalar if the CPU can't run it
+  /// @param [in] _kernel the kernel to use
+  //----------------------------------------------------------------------------------------------------------------------
+  explicit SpotAnimator(Kernel _kernel);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief advance every spot to _time
+  /// @param [in,out] _state the spots to update, the mix values are advanced and the outputs written
+  /// @param [in] _time the animation time
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void update(SpotState &_state, float _time) const {m_update(_state,_time,0,_state.size());}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief advance the spots in [_begin,_end) to _time, used to split the work between threads
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void update(SpotState &_state, float _time, size_t _begin, size_t _end) const
+  {
+    m_update(_state,_time,_begin,_end);
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the kernel in use
+  //----------------------------------------------------------------------------------------------------------------------
+  inline Kernel kernel() const {return m_kernel;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief printable name of a kernel
+  //----------------------------------------------------------------------------------------------------------------------
+  static const char *kernelName(Kernel _kernel);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief can this CPU run a kernel
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool isSupported(Kernel _kernel);
+
+private :
+  typedef void (*UpdateFunc)(SpotState &, float, size_t, size_t);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the kernel in use
+  //----------------------------------------------------------------------------------------------------------------------
+  Kernel m_kernel;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the function implementing m_kernel
+  //----------------------------------------------------------------------------------------------------------------------
+  UpdateFunc m_update;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef SPOTCONE_H_
+#define SPOTCONE_H_
+#include <cmath>
+#include "LightStd140.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpotCone.h
+/// @brief bounding volume tests for spot light cones, shared by the cluster, object and instance culling and
+/// the shadow atlas
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class BoundingSphere
+/// @brief a sphere used to bound lights and objects
+//----------------------------------------------------------------------------------------------------------------------
+struct BoundingSphere
+{
+  float m_centre[3];
+  float m_radius;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SpotCone
+/// @brief the volume lit by a spot, a cone of half angle acos(m_cosAngle) cut off at m_range from the apex
+//----------------------------------------------------------------------------------------------------------------------
+struct SpotCone
+{
+  float m_apex[3];
+  /// @brief unit length axis of the cone
+  float m_axis[3];
+  float m_cosAngle;
+  float m_sinAngle;
+  float m_range;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief build the cone lit by a light
+/// @param [in] _light the light in GPU layout
+/// @returns the cone using the light's position, direction, outer cutoff and range
+//----------------------------------------------------------------------------------------------------------------------
+inline SpotCone spotConeFromLight(const LightStd140 &_light)
+{
+  SpotCone cone;
+  const float *d=_light.m_direction;
+  float len=std::sqrt(d[0]*d[0]+d[1]*d[1]+d[2]*d[2]);
+  float inv= len > 0.0f ? 1.0f/len : 0.0f;
+  for(int i=0; i<3; ++i)
+  {
+    cone.m_apex[i]=_light.m_position[i];
+    cone.m_axis[i]=d[i]*inv;
+  }
+  cone.m_cosAngle=_light.m_spotCosCutoff;
+  cone.m_sinAngle=std::sqrt(std::fmax(0.0f,1.0f-_light.m_spotCosCutoff*_light.m_spotCosCutoff));
+  cone.m_range=_light.m_range;
+  return cone;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the smallest sphere enclosing a cone (Wronski 2017), for wide cones this is the sphere around the
+/// cap, for narrow ones the sphere through the apex and the cap edge
+/// @param [in] _cone the cone to bound
+//----------------------------------------------------------------------------------------------------------------------
+inline BoundingSphere coneBoundingSphere(const SpotCone &_cone)
+{
+  BoundingSphere s;
+  float offset;
+  if(_cone.m_cosAngle < 0.70710678f)
+  {
+    offset=_cone.m_cosAngle*_cone.m_range;
+    s.m_radius=_cone.m_sinAngle*_cone.m_range;
+  }
+  else
+  {
+    offset=_cone.m_range/(2.0f*_cone.m_cosAngle);
+    s.m_radius=offset;
+  }
+  for(int i=0; i<3; ++i)
+  {
+    s.m_centre[i]=_cone.m_apex[i]+_cone.m_axis[i]*offset;
+  }
+  return s;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief conservative cone / sphere overlap test, may report an overlap near the cap edge that isn't there but
+/// never misses a real one
+/// @param [in] _cone the spot cone
+/// @param [in] _sphere the sphere to test
+/// @returns true if the sphere may be lit by the cone
+//----------------------------------------------------------------------------------------------------------------------
+inline bool coneIntersectsSphere(const SpotCone &_cone, const BoundingSphere &_sphere)
+{
+  float v[3]={_sphere.m_centre[0]-_cone.m_apex[0],
+              _sphere.m_centre[1]-_cone.m_apex[1],
+              _sphere.m_centre[2]-_cone.m_apex[2]};
+  float lenSq=v[0]*v[0]+v[1]*v[1]+v[2]*v[2];
+  // distance of the centre along the axis
+  float along=v[0]*_cone.m_axis[0]+v[1]*_cone.m_axis[1]+v[2]*_cone.m_axis[2];
+  // distance from the centre to the closest point on the cone surface
+  float across=std::sqrt(std::fmax(0.0f,lenSq-along*along));
+  float distanceToSurface=_cone.m_cosAngle*across-along*_cone.m_sinAngle;
+  bool outsideAngle=distanceToSurface > _sphere.m_radius;
+  bool beyondRange=along > _sphere.m_radius+_cone.m_range;
+  bool behindApex=along < -_sphere.m_radius;
+  return !(outsideAngle || beyondRange || behindApex);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief sphere / axis aligned box overlap test
+/// @param [in] _sphere the sphere to test
+/// @param [in] _min the minimum corner of the box
+/// @param [in] _max the maximum corner of the box
+//----------------------------------------------------------------------------------------------------------------------
+inline bool sphereIntersectsAABB(const BoundingSphere &_sphere, const float *_min, const float *_max)
+{
+  float distSq=0.0f;
+  for(int i=0; i<3; ++i)
+  {
+    float c=_sphere.m_centre[i];
+    float d= c < _min[i] ? _min[i]-c : (c > _max[i] ? c-_max[i] : 0.0f);
+    distSq+=d*d;
+  }
+  return distSq <= _sphere.m_radius*_sphere.m_radius;
+}
+
+#endif
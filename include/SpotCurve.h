@@ -0,0 +1,65 @@
+#ifndef SPOTCURVE_H_
+#define SPOTCURVE_H_
+#include <vector>
+#include "SpotCone.h"
+#include "SpotParamsStd430.h"
+#include "SpotState.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpotCurve.h
+/// @brief the spot animation as a closed form function of time
+/// @class SpotCurve
+/// @brief SpotAnimator advances the spots a tick at a time but nothing it computes depends on the tick before,
+/// the aim point goes round its ellipse with the animation time and the colour mix steps MIXSTEP a tick and
+/// wraps at 1. SpotCurve packs the parameters into the layout read by SpotAnimComp.glsl and evaluates a spot at
+/// any time the same way the shader does, so it is the CPU reference the GPU animation is checked against.
+/// It also bounds every cone a spot sweeps with a single cone, lights that stay still while the GPU animates
+/// them that the CPU culling and the shadow maps can use. Plain floats only, like SpotCone.
+//----------------------------------------------------------------------------------------------------------------------
+class SpotCurve
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the animated part of a spot at one time, as SpotAnimator writes it
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Sample
+  {
+    float m_dir[3];
+    float m_colour[3];
+    float m_range;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief copy the parameters of every spot into the GPU layout
+  /// @param [in] _state the spots, the mix values are taken as the mix at the tick they were set
+  /// @param [out] o_params the parameters, resized to the spot count
+  //----------------------------------------------------------------------------------------------------------------------
+  static void pack(const SpotState &_state, std::vector<SpotParamsStd430> &o_params);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the two phases the animation depends on, worked out in double so they stay exact however long
+  /// it runs
+  /// @param [in] _ticks the animation time in ticks, the fraction blends towards the next tick
+  /// @param [in] _baseTicks the tick the parameters were set at, the colour mix counts from there
+  /// @param [in] _timeStep the animation time advanced per tick
+  /// @param [out] o_angle the animation time wrapped to 2pi, SpotAnimator's _time
+  /// @param [out] o_mix the colour mix advanced since the parameters were set, wrapped to 1
+  //----------------------------------------------------------------------------------------------------------------------
+  static void phase(double _ticks, double _baseTicks, float _timeStep, float &o_angle, float &o_mix);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief evaluate a spot
+  /// @param [in] _spot the spot parameters
+  /// @param [in] _angle the animation time from phase
+  /// @param [in] _mix the colour mix from phase
+  /// @returns the world space direction, the colour and the range
+  //----------------------------------------------------------------------------------------------------------------------
+  static Sample evaluate(const SpotParamsStd430 &_spot, float _angle, float _mix);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a cone holding every cone the spot lights over a whole period. Its axis points at the centre of
+  /// the ellipse and it is widened by the angle the ellipse covers seen from the spot, if that reaches 90
+  /// degrees it becomes the half space below the spot, which holds everything in the scene
+  /// @param [in] _spot the spot parameters
+  /// @returns the cone in world space
+  //----------------------------------------------------------------------------------------------------------------------
+  static SpotCone envelope(const SpotParamsStd430 &_spot);
+};
+
+#endif
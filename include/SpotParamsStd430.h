@@ -0,0 +1,25 @@
+#ifndef SPOTPARAMSSTD430_H_
+#define SPOTPARAMSSTD430_H_
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpotParamsStd430.h
+/// @brief GPU layout of the animation parameters of a spot, this must match the Spot struct in SpotAnimComp.glsl
+/// @class SpotParamsStd430
+/// @brief five vec4s holding everything the animation of a spot depends on, all in world space
+//----------------------------------------------------------------------------------------------------------------------
+struct SpotParamsStd430
+{
+  /// @brief position of the spot, w is its time offset
+  float m_position[4];
+  /// @brief x and z of the centre of the aim ellipse then its x and z radius
+  float m_ellipse[4];
+  /// @brief start colour, w is the colour mix when the parameters were set
+  float m_start[4];
+  /// @brief end colour, w is unused
+  float m_end[4];
+  /// @brief cosine and sine of the outer cone angle, z and w are unused
+  float m_cutoff[4];
+};
+static_assert(sizeof(SpotParamsStd430)==80,"SpotParamsStd430 must match the layout of the Spot struct");
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef SPOTRECORDING_H_
+#define SPOTRECORDING_H_
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "LightStd140.h"
+#include "MappedFile.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpotRecording.h
+/// @brief recordings of the packed spot lights at every animation tick
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SpotRecordingHeader
+/// @brief the start of a recording, followed by m_tickCount ticks each stored as its byte count and the
+/// encoded words
+//----------------------------------------------------------------------------------------------------------------------
+struct SpotRecordingHeader
+{
+  uint32_t m_magic;
+  uint32_t m_version;
+  uint32_t m_lightCount;
+  uint32_t m_tickCount;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SpotRecorder
+/// @brief writes the light block of each tick as it is produced. A tick is stored as the difference of each
+/// 32 bit word of the lights from the tick before, the bit patterns are subtracted so decoding is exact, and
+/// the differences are written as variable length integers with runs of unchanged words collapsed to their
+/// length. Only the animated directions and colours change from one tick to the next so a tick costs a few
+/// bytes per light rather than the 112 of the block.
+//----------------------------------------------------------------------------------------------------------------------
+class SpotRecorder
+{
+public :
+  static constexpr uint32_t MAGIC=0x52525053; // SPRR
+  static constexpr uint32_t VERSION=1;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief 32 bit words per light
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr size_t WORDS=sizeof(LightStd140)/sizeof(uint32_t);
+  SpotRecorder()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor finishes the recording
+  //----------------------------------------------------------------------------------------------------------------------
+  ~SpotRecorder();
+  SpotRecorder(const SpotRecorder &)=delete;
+  SpotRecorder &operator=(const SpotRecorder &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start a recording, any previous one is finished first
+  /// @param [in] _fname the file to write
+  /// @param [in] _numLights the number of lights in every tick
+  /// @returns false if the file can't be created
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_fname, size_t _numLights);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief write the tick count into the header and close the file
+  //----------------------------------------------------------------------------------------------------------------------
+  void close();
+  inline bool isOpen() const {return m_out.is_open();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief add a tick
+  /// @param [in] _lights the packed lights
+  /// @param [in] _numLights the number of lights, must match the count the recording was opened with
+  /// @returns false if the count doesn't match
+  //----------------------------------------------------------------------------------------------------------------------
+  bool write(const LightStd140 *_lights, size_t _numLights);
+  inline uint32_t numTicks() const {return m_ticks;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bytes written so far including the header
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t bytesWritten() const {return m_bytes;}
+
+private :
+  std::ofstream m_out;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the words of the last tick, the next tick is encoded against it
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_previous;
+  std::vector<unsigned char> m_encoded;
+  uint32_t m_ticks=0;
+  uint64_t m_bytes=0;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SpotPlayer
+/// @brief maps a recording and decodes it a tick at a time, starting again from the first tick after the
+/// last so a replay can run for any number of frames
+//----------------------------------------------------------------------------------------------------------------------
+class SpotPlayer
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief map a recording
+  /// @param [in] _fname the file written by SpotRecorder
+  /// @returns false if the file is missing, from another version or holds no ticks
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_fname);
+  inline bool isOpen() const {return m_file.isOpen();}
+  inline size_t numLights() const {return m_lights.size();}
+  inline uint32_t numTicks() const {return m_header.m_tickCount;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief decode the next tick
+  /// @returns false if the recording is damaged, playback stops
+  //----------------------------------------------------------------------------------------------------------------------
+  bool next();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the lights of the current tick
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const LightStd140 *lights() const {return m_lights.data();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ticks decoded since opening, counting every pass through the recording
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t ticksPlayed() const {return m_played;}
+
+private :
+  MappedFile m_file;
+  SpotRecordingHeader m_header;
+  std::vector<LightStd140> m_lights;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief byte offset of the next tick and the tick it is
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_offset=0;
+  uint32_t m_tick=0;
+  uint64_t m_played=0;
+};
+
+#endif
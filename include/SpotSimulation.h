@@ -0,0 +1,205 @@
+#ifndef SPOTSIMULATION_H_
+#define SPOTSIMULATION_H_
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FrameProfiler.h"
+#include "SpotAnimator.h"
+#include "SpotState.h"
+#include "TripleBuffer.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpotSimulation.h
+/// @brief runs the spot animation on its own thread at a fixed timestep
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SpotFrame
+/// @brief the animated part of every spot at one simulation tick, this is all the renderer needs to
+/// pack the light block
+//----------------------------------------------------------------------------------------------------------------------
+struct SpotFrame
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief resize all of the arrays
+  //----------------------------------------------------------------------------------------------------------------------
+  void resize(size_t _count);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief number of spots in the frame
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t size() const {return m_range.size();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief copy the outputs of a SpotState, reusing the existing storage
+  //----------------------------------------------------------------------------------------------------------------------
+  void copyFrom(const SpotState &_state);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the simulation tick this frame was produced by
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_tick=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the time the tick was scheduled for, used to interpolate between frames
+  //----------------------------------------------------------------------------------------------------------------------
+  std::chrono::steady_clock::time_point m_time;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief world space aim direction
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_dirX;
+  std::vector<float> m_dirY;
+  std::vector<float> m_dirZ;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief light colour
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_colourR;
+  std::vector<float> m_colourG;
+  std::vector<float> m_colourB;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief light range
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_range;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SpotSimulation
+/// @brief owns the simulation copy of the SpotState and advances it by a fixed amount of animation time
+/// every tick, so the animation speed no longer depends on how busy the GUI thread is. Each tick publishes
+/// a SpotFrame through a lock free triple buffer, the render thread takes the newest one without ever
+/// blocking and blends it with the frame before so the lights move smoothly at any display rate.
+/// The simulation can also be stepped synchronously from the calling thread when it is not running.
+//----------------------------------------------------------------------------------------------------------------------
+class SpotSimulation
+{
+public :
+  typedef std::chrono::steady_clock Clock;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor
+  /// @param [in] _tickSeconds the wall clock length of one tick
+  /// @param [in] _timeStep the animation time advanced per tick
+  //----------------------------------------------------------------------------------------------------------------------
+  SpotSimulation(float _tickSeconds=0.03f, float _timeStep=0.2f);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor stops the thread
+  //----------------------------------------------------------------------------------------------------------------------
+  ~SpotSimulation();
+  SpotSimulation(const SpotSimulation &)=delete;
+  SpotSimulation &operator=(const SpotSimulation &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief hand new spot parameters to the simulation, picked up at the start of the next tick
+  /// @param [in] _state the spots to simulate from now on
+  //----------------------------------------------------------------------------------------------------------------------
+  void setState(const SpotState &_state);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start the simulation thread
+  //----------------------------------------------------------------------------------------------------------------------
+  void start();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief stop and join the simulation thread
+  //----------------------------------------------------------------------------------------------------------------------
+  void stop();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief is the simulation thread running
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isRunning() const {return m_thread.joinable();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief pause or resume the animation, the thread keeps its schedule but publishes nothing
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setPaused(bool _paused){m_paused.store(_paused,std::memory_order_relaxed);}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief advance one tick on the calling thread, only valid when the thread is not running
+  //----------------------------------------------------------------------------------------------------------------------
+  void step();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief render side, take the newest published frame
+  /// @returns true if a new frame was taken
+  //----------------------------------------------------------------------------------------------------------------------
+  bool acquire();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief render side, blend the last two acquired frames. The renderer runs one tick behind the
+  /// simulation so _now always falls between the two
+  /// @param [out] o_frame the blended spots
+  /// @param [in] _now the time being rendered
+  //----------------------------------------------------------------------------------------------------------------------
+  void interpolate(SpotFrame &o_frame, Clock::time_point _now) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief render side, the newest acquired frame as is, used when stepping synchronously
+  /// @param [out] o_frame the spots
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void latest(SpotFrame &o_frame) const {o_frame=m_frames.readBuffer();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of ticks simulated so far
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint64_t ticks() const {return m_ticks.load(std::memory_order_relaxed);}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief report the time spent in each tick, set before start
+  /// @param [in] _profiler the profiler to record to, null to stop recording
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setProfiler(FrameProfiler *_profiler){m_profiler=_profiler;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the wall clock length of a tick in seconds and the animation time advanced by each
+  //----------------------------------------------------------------------------------------------------------------------
+  inline float tickSeconds() const {return std::chrono::duration<float>(m_tickLength).count();}
+  inline float timeStep() const {return m_timeStep;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the kernel used to animate the spots
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const SpotAnimator &animator() const {return m_animator;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the thread function, ticks on a fixed schedule until stopped
+  //----------------------------------------------------------------------------------------------------------------------
+  void run();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief advance the spots and publish the result stamped with _time
+  //----------------------------------------------------------------------------------------------------------------------
+  void tick(Clock::time_point _time);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the vectorised kernel used to animate m_state
+  //----------------------------------------------------------------------------------------------------------------------
+  SpotAnimator m_animator;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the simulation copy of the spots, only touched by the simulation thread
+  //----------------------------------------------------------------------------------------------------------------------
+  SpotState m_state;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the animation time, wrapped to 2pi
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_time;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief animation time advanced per tick
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_timeStep;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief wall clock length of a tick
+  //----------------------------------------------------------------------------------------------------------------------
+  Clock::duration m_tickLength;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief parameters waiting to be swapped into m_state, guarded by m_pendingMutex
+  //----------------------------------------------------------------------------------------------------------------------
+  SpotState m_pending;
+  std::mutex m_pendingMutex;
+  std::atomic<bool> m_hasPending;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frames on their way from the simulation to the renderer
+  //----------------------------------------------------------------------------------------------------------------------
+  TripleBuffer<SpotFrame> m_frames;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief render side copy of the frame acquired before the current one
+  //----------------------------------------------------------------------------------------------------------------------
+  SpotFrame m_previous;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ticks simulated so far
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<uint64_t> m_ticks;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief optional profiler the ticks are recorded to
+  //----------------------------------------------------------------------------------------------------------------------
+  FrameProfiler *m_profiler;
+  std::atomic<bool> m_paused;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
+};
+
+#endif
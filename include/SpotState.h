@@ -0,0 +1,88 @@
+#ifndef SPOTSTATE_H_
+#define SPOTSTATE_H_
+#include <cstddef>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpotState.h
+/// @brief structure of arrays holding the animation state of every spot light
+/// @class SpotState
+/// @brief each attribute of the spots is stored in its own contiguous array so the animation kernel can
+/// load 4 or 8 lights at a time with plain vector loads. The first group of arrays are the parameters set
+/// by createLights / changeSpotParams, the second group are written by SpotAnimator every tick
+/// all values are in world space
+//----------------------------------------------------------------------------------------------------------------------
+class SpotState
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief resize every array to hold _count spots
+  /// @param [in] _count the number of spots
+  //----------------------------------------------------------------------------------------------------------------------
+  void resize(size_t _count);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of spots
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t size() const {return m_timeOffset.size();}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the time offset for each spot
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_timeOffset;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief x and z radius of the ellipse the spot aims around
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_radiusX;
+  std::vector<float> m_radiusZ;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief aim centre of the ellipse on the floor
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_centreX;
+  std::vector<float> m_centreZ;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief current mix factor of the light for the lerp of the colours
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_mix;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief start colour of the light interpolated to the end colour
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_startR;
+  std::vector<float> m_startG;
+  std::vector<float> m_startB;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief end colour of the light
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_endR;
+  std::vector<float> m_endG;
+  std::vector<float> m_endB;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief position of the spot
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_posX;
+  std::vector<float> m_posY;
+  std::vector<float> m_posZ;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief cosine and sine of the outer cone angle, used to work out the range of the light
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_cosCutoff;
+  std::vector<float> m_sinCutoff;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief output, unit direction from the spot to its current aim point
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_dirX;
+  std::vector<float> m_dirY;
+  std::vector<float> m_dirZ;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief output, current colour of the spot
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_colourR;
+  std::vector<float> m_colourG;
+  std::vector<float> m_colourB;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief output, distance to where the outer edge of the cone meets the floor
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_range;
+};
+
+#endif
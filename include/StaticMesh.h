@@ -0,0 +1,170 @@
+#ifndef STATICMESH_H_
+#define STATICMESH_H_
+#include <ngl/Types.h>
+#include <vector>
+#include "MeshFile.h"
+#include "PackedVertex.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file StaticMesh.h
+/// @brief an indexed mesh uploaded once from a MeshFile or built in memory
+/// @class StaticMesh
+/// @brief owns the VAO, vertex and index buffers of a mesh that never changes. The data is streamed to GL in
+/// chunks straight out of the file mapping so there is no intermediate copy and the upload can start
+/// before the whole file has been paged in. A mesh can hold several parts, such as its levels of detail,
+/// sharing the buffers so any of them can be drawn from one VAO and one indirect draw can cover them all.
+/// Meshes built in memory can be uploaded as PackedVertex rather than floats, see setLayout
+//----------------------------------------------------------------------------------------------------------------------
+class StaticMesh
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until load is called
+  //----------------------------------------------------------------------------------------------------------------------
+  StaticMesh()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the buffers, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~StaticMesh();
+  StaticMesh(const StaticMesh &)=delete;
+  StaticMesh &operator=(const StaticMesh &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the vertex layout in the buffer, FLOAT is the MeshFile layout and PACKED is PackedVertex which
+  /// needs the shaders built with PACKEDNORMALS and has no uv
+  //----------------------------------------------------------------------------------------------------------------------
+  enum class Layout {FLOAT,PACKED};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the layout the meshes built in memory are uploaded in, a MeshFile is always streamed as it is stored
+  /// and puts the layout back to FLOAT
+  /// @param [in] _layout the layout used by the next load
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setLayout(Layout _layout) {m_layout=_layout;}
+  inline Layout layout() const {return m_layout;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the bytes one vertex takes in a layout
+  //----------------------------------------------------------------------------------------------------------------------
+  static size_t vertexSize(Layout _layout);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief upload a mapped mesh, attributes use the NGL locations 0 position, 1 uv and 2 normal
+  /// @param [in] _mesh the open mesh file, it can be closed once this returns
+  //----------------------------------------------------------------------------------------------------------------------
+  void load(const MeshFile &_mesh);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief upload a mesh built in memory, such as a simplified level of detail
+  /// @param [in] _vertices MeshFile::VERTEXFLOATS floats per vertex
+  /// @param [in] _indices three per triangle
+  //----------------------------------------------------------------------------------------------------------------------
+  void load(const std::vector<float> &_vertices, const std::vector<uint32_t> &_indices);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief upload several meshes as the parts of this one, the vertices are packed one after another and each
+  /// part's indices stay relative to its own first vertex
+  /// @param [in] _vertices MeshFile::VERTEXFLOATS floats per vertex for each part
+  /// @param [in] _indices three per triangle for each part
+  //----------------------------------------------------------------------------------------------------------------------
+  void load(const std::vector<std::vector<float>> &_vertices, const std::vector<std::vector<uint32_t>> &_indices);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief where a part lies in the shared buffers
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Part
+  {
+    GLsizei m_indexCount;
+    GLuint m_firstIndex;
+    GLint m_baseVertex;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the layout glMultiDrawElementsIndirect reads each draw from
+  //----------------------------------------------------------------------------------------------------------------------
+  struct DrawCommand
+  {
+    GLuint m_count;
+    GLuint m_instanceCount;
+    GLuint m_firstIndex;
+    GLint m_baseVertex;
+    GLuint m_baseInstance;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the indirect command drawing a part
+  /// @param [in] _part the part
+  /// @param [in] _instanceCount the number of instances
+  /// @param [in] _baseInstance the first entry of the instance list
+  //----------------------------------------------------------------------------------------------------------------------
+  DrawCommand command(size_t _part, GLuint _instanceCount, GLuint _baseInstance) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief draw a part as triangles
+  //----------------------------------------------------------------------------------------------------------------------
+  void draw(size_t _part=0) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief draw a part once per entry of a range of an instance list, the entry is passed to attribute
+  /// INSTANCEATTRIB as an unsigned int so the shader can fetch the instance's own data with it
+  /// @param [in] _part the part
+  /// @param [in] _instances a buffer of uint32 instance indices
+  /// @param [in] _first the first entry drawn
+  /// @param [in] _count the number of entries drawn
+  //----------------------------------------------------------------------------------------------------------------------
+  void drawInstanced(size_t _part, GLuint _instances, size_t _first, size_t _count) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief draw a run of indirect commands with one glMultiDrawElementsIndirect, each command's base instance
+  /// picks where in the instance list its entries start. Needs GL 4.3
+  /// @param [in] _commands a GL_DRAW_INDIRECT_BUFFER of DrawCommand
+  /// @param [in] _first the first command drawn
+  /// @param [in] _count the number of commands
+  /// @param [in] _instances a buffer of uint32 instance indices fed to INSTANCEATTRIB
+  //----------------------------------------------------------------------------------------------------------------------
+  void drawIndirect(GLuint _commands, size_t _first, size_t _count, GLuint _instances) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief has a mesh been loaded
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isValid() const {return m_vao != 0;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of parts, 1 unless loaded from several meshes
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t numParts() const {return m_parts.size();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of indices drawn for a part
+  //----------------------------------------------------------------------------------------------------------------------
+  inline GLsizei numIndices(size_t _part=0) const {return m_parts[_part].m_indexCount;}
+  inline size_t numTriangles(size_t _part=0) const {return static_cast<size_t>(m_parts[_part].m_indexCount)/3;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the vertices of every part and the size of the vertex and index buffers in bytes
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t numVertices() const {return m_vertexCount;}
+  inline size_t vertexBytes() const {return m_vertexCount*vertexSize(m_layout);}
+  inline size_t indexBytes() const {return m_indexBytes;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the attribute location drawInstanced feeds the instance index to
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr GLuint INSTANCEATTRIB=3;
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief copy _bytes into the bound buffer a chunk at a time
+  //----------------------------------------------------------------------------------------------------------------------
+  static void stream(GLenum _target, const unsigned char *_data, size_t _bytes);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief create the buffers if needed and upload the vertices in m_layout and the indices
+  //----------------------------------------------------------------------------------------------------------------------
+  void upload(const unsigned char *_vertices, size_t _vertexBytes, GLsizei _stride,
+              const unsigned char *_indices, size_t _indexCount, size_t _indexSize);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief upload MeshFile::VERTEXFLOATS floats per vertex in m_layout
+  //----------------------------------------------------------------------------------------------------------------------
+  void uploadVertices(const std::vector<float> &_vertices, const unsigned char *_indices, size_t _indexCount,
+                      size_t _indexSize);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief point INSTANCEATTRIB at an instance list, the VAO must be bound
+  //----------------------------------------------------------------------------------------------------------------------
+  static void bindInstances(GLuint _instances, size_t _first);
+  GLuint m_vao=0;
+  GLuint m_vertexBuffer=0;
+  GLuint m_indexBuffer=0;
+  std::vector<Part> m_parts;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  //----------------------------------------------------------------------------------------------------------------------
+  GLenum m_indexType=GL_UNSIGNED_INT;
+  Layout m_layout=Layout::FLOAT;
+  size_t m_vertexCount=0;
+  size_t m_indexBytes=0;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef TEXTUREBUFFER_H_
+#define TEXTUREBUFFER_H_
+#include <ngl/Types.h>
+#include <string>
+#include "FrameStats.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file TextureBuffer.h
+/// @brief a buffer object exposed to the shaders as a samplerBuffer
+/// @class TextureBuffer
+/// @brief wraps a GL buffer and the buffer texture that views it, texture buffers are core in GL 3.3 and have
+/// no practical size limit so they are used for arrays too large for a uniform block
+//----------------------------------------------------------------------------------------------------------------------
+class TextureBuffer
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, no GL resources are created until create is called
+  //----------------------------------------------------------------------------------------------------------------------
+  TextureBuffer()=default;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor releases the buffer and texture, a GL context must be current
+  //----------------------------------------------------------------------------------------------------------------------
+  ~TextureBuffer();
+  TextureBuffer(const TextureBuffer &)=delete;
+  TextureBuffer &operator=(const TextureBuffer &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief create the buffer and texture
+  /// @param [in] _format the sized internal format of each texel (GL_RGBA32F, GL_R32UI etc)
+  /// @param [in] _unit the texture unit the buffer is bound to when drawing
+  //----------------------------------------------------------------------------------------------------------------------
+  void create(GLenum _format, GLuint _unit);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief point the named sampler in a program at our texture unit
+  /// @param [in] _programID the linked shader program
+  /// @param [in] _samplerName the name of the samplerBuffer uniform
+  //----------------------------------------------------------------------------------------------------------------------
+  void bindToProgram(GLuint _programID, const std::string &_samplerName) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bind the texture to its unit ready for drawing
+  //----------------------------------------------------------------------------------------------------------------------
+  void bind() const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief make sure the buffer can hold at least _bytes, the contents are lost if it grows
+  /// @param [in] _bytes the required size
+  //----------------------------------------------------------------------------------------------------------------------
+  void reserve(size_t _bytes);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief replace part of the buffer contents, the buffer must already be large enough
+  /// @param [in] _offset the byte offset to write at
+  /// @param [in] _bytes the number of bytes to write
+  /// @param [in] _data the source data
+  /// @param [in,out] _stats the frame counters to add the upload to
+  //----------------------------------------------------------------------------------------------------------------------
+  void update(size_t _offset, size_t _bytes, const void *_data, FrameStats &_stats);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief replace part of the buffer contents with a copy on the GPU from another buffer, the copy is queued
+  /// behind any draw still reading the old contents rather than waiting for it
+  /// @param [in] _buffer the buffer to copy from
+  /// @param [in] _sourceOffset the byte offset of the data in _buffer
+  /// @param [in] _offset the byte offset to copy it to
+  /// @param [in] _bytes the size of the data
+  //----------------------------------------------------------------------------------------------------------------------
+  void copy(GLuint _buffer, size_t _sourceOffset, size_t _offset, size_t _bytes);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the buffer object id
+  //----------------------------------------------------------------------------------------------------------------------
+  inline GLuint bufferID() const {return m_buffer;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the allocated size in bytes
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t capacity() const {return m_capacity;}
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the buffer object holding the data
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_buffer=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the buffer texture viewing m_buffer
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_texture=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the texel format
+  //----------------------------------------------------------------------------------------------------------------------
+  GLenum m_format=GL_RGBA32F;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the texture unit used when drawing
+  //----------------------------------------------------------------------------------------------------------------------
+  GLuint m_unit=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief allocated size of m_buffer in bytes
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_capacity=0;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef TRANSFORMBATCH_H_
+#define TRANSFORMBATCH_H_
+#include <cstddef>
+#include <vector>
+#include "TransformStd140.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file TransformBatch.h
+/// @brief vectorised per draw transforms of objects whose model matrices don't change
+/// @class TransformBatch
+/// @brief caches the affine part of each model matrix and the inverse transpose of its upper 3x3, which for a
+/// rigid model is the 3x3 itself so only scaled or sheared models pay for an inverse, once when they are added.
+/// Each frame transform then writes MV, MVP, the normal matrix and the object id of a range of objects as
+/// TransformStd140 blocks to one contiguous buffer, with a stride that suits glBindBufferRange, ready to be
+/// copied to the GPU in one go. The models are kept as a structure of arrays and the kernel is chosen at
+/// runtime from the instruction sets the CPU supports, AVX2 does 8 objects per step, SSE2 4 and the scalar
+/// fallback one. The view must be affine, as camera and mouse transforms are.
+//----------------------------------------------------------------------------------------------------------------------
+class TransformBatch
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the available kernels
+  //----------------------------------------------------------------------------------------------------------------------
+  enum class Kernel {SCALAR, SSE2, AVX2};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor selects the fastest kernel the CPU supports
+  //----------------------------------------------------------------------------------------------------------------------
+  TransformBatch();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor using a specific kernel, falls back to scalar if the CPU can't run it
+  /// @param [in] _kernel the kernel to use
+  //----------------------------------------------------------------------------------------------------------------------
+  explicit TransformBatch(Kernel _kernel);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief remove every model and free their storage
+  //----------------------------------------------------------------------------------------------------------------------
+  void clear();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief make room for _count models
+  //----------------------------------------------------------------------------------------------------------------------
+  void reserve(size_t _count);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief add a model, its object id is its index plus firstID()
+  /// @param [in] _model a column major 4x4 matrix, only the top three rows are kept
+  //----------------------------------------------------------------------------------------------------------------------
+  void addModel(const float *_model);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of models
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t size() const {return m_models[0].size();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the models that needed a full inverse for their normal matrix
+  //----------------------------------------------------------------------------------------------------------------------
+  inline size_t numInverted() const {return m_inverted;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the bytes between the blocks in the output, at least sizeof(TransformStd140)
+  //----------------------------------------------------------------------------------------------------------------------
+  void setStride(size_t _stride);
+  inline size_t stride() const {return m_stride;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief set the object id of the first model, so a batch can hold the tail of the scene's objects
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setFirstID(size_t _id){m_firstID=_id;}
+  inline size_t firstID() const {return m_firstID;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief compute the blocks of the models in [_begin,_end) for a view and projection, the output is sized as
+  /// models are added so disjoint ranges can be transformed on different threads at once
+  /// @param [in] _view the column major view matrix, affine
+  /// @param [in] _projection the column major projection matrix
+  //----------------------------------------------------------------------------------------------------------------------
+  void transform(const float *_view, const float *_projection, size_t _begin, size_t _end);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the output, the block of object i starts i*stride() bytes in
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const char *data() const {return m_output.data();}
+  inline const TransformStd140 &operator[](size_t _i) const
+  {
+    return *reinterpret_cast<const TransformStd140 *>(m_output.data()+_i*m_stride);
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the kernel in use
+  //----------------------------------------------------------------------------------------------------------------------
+  inline Kernel kernel() const {return m_kernel;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief printable name of a kernel
+  //----------------------------------------------------------------------------------------------------------------------
+  static const char *kernelName(Kernel _kernel);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief can this CPU run a kernel
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool isSupported(Kernel _kernel);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the per frame constants the kernels share
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Frame
+  {
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the view, the projection times the view and the inverse transpose of the view's 3x3, column major
+    //----------------------------------------------------------------------------------------------------------------------
+    float m_view[16];
+    float m_viewProjection[16];
+    float m_normalView[9];
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the object id of model 0
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_firstID;
+  };
+
+private :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a kernel reads the model and normal arrays and writes the blocks of [begin,end) stride bytes apart
+  //----------------------------------------------------------------------------------------------------------------------
+  typedef void (*TransformFunc)(const float *const *, const float *const *, const Frame &, char *, size_t, size_t,
+                                size_t);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the kernel in use
+  //----------------------------------------------------------------------------------------------------------------------
+  Kernel m_kernel;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the function implementing m_kernel
+  //----------------------------------------------------------------------------------------------------------------------
+  TransformFunc m_transform;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief element c*3+r of each model matrix, 4 columns of 3 rows
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_models[12];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief element c*3+r of the inverse transpose of each model's 3x3
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_normals[9];
+  size_t m_inverted=0;
+  size_t m_stride=sizeof(TransformStd140);
+  size_t m_firstID=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the TransformStd140 blocks, m_stride bytes apart
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<char> m_output;
+};
+
+#endif
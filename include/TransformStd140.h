@@ -0,0 +1,23 @@
+#ifndef TRANSFORMSTD140_H_
+#define TRANSFORMSTD140_H_
+#include <cstdint>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file TransformStd140.h
+/// @brief GPU layout of the per draw transforms, this must match the Transforms block in SpotlightVert.glsl
+/// @class TransformStd140
+/// @brief the matrices are column major, the mat3 takes a vec4 per column under std140. For the instanced
+/// draws MV and MVP hold the view and projection times view, the model comes from the instance matrices
+//----------------------------------------------------------------------------------------------------------------------
+struct TransformStd140
+{
+  float m_MV[16];
+  float m_MVP[16];
+  float m_normalMatrix[12];
+  /// @brief index of the object being drawn into objectCells
+  int32_t m_objectID;
+  int32_t m_pad[3];
+};
+static_assert(sizeof(TransformStd140)==192,"TransformStd140 must match the layout of the Transforms block");
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef TRIPLEBUFFER_H_
+#define TRIPLEBUFFER_H_
+#include <atomic>
+#include <cstdint>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file TripleBuffer.h
+/// @brief lock free single producer / single consumer triple buffer
+/// @class TripleBuffer
+/// @brief the writer owns one slot, the reader owns another and the third is shared. Publishing swaps the
+/// writer's slot with the shared one and flags it as new, the reader swaps its slot for the shared one only
+/// when something new has been published. Neither side ever waits for the other, the reader always sees the
+/// most recently completed value and the writer can run at any rate.
+//----------------------------------------------------------------------------------------------------------------------
+template <typename T>
+class TripleBuffer
+{
+public :
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor, slot 0 is the writer's, 1 is shared and 2 is the reader's
+  //----------------------------------------------------------------------------------------------------------------------
+  TripleBuffer() : m_shared(1), m_write(0), m_read(2) {}
+  TripleBuffer(const TripleBuffer &)=delete;
+  TripleBuffer &operator=(const TripleBuffer &)=delete;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief writer side, the slot to fill before calling publish
+  //----------------------------------------------------------------------------------------------------------------------
+  inline T &writeBuffer() {return m_buffers[m_write];}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief writer side, hand the filled slot to the reader and take the shared one to write next
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void publish()
+  {
+    uint8_t previous=m_shared.exchange(static_cast<uint8_t>(m_write | NEWDATA),std::memory_order_acq_rel);
+    m_write=previous & INDEXMASK;
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief reader side, has anything been published since the last update
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool hasUpdate() const {return (m_shared.load(std::memory_order_relaxed) & NEWDATA) != 0;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief reader side, take the latest published slot if there is one
+  /// @returns true if readBuffer now holds a newly published value
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool update()
+  {
+    if(!hasUpdate())
+    {
+      return false;
+    }
+    uint8_t previous=m_shared.exchange(m_read,std::memory_order_acq_rel);
+    m_read=previous & INDEXMASK;
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief reader side, the most recent value taken by update
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const T &readBuffer() const {return m_buffers[m_read];}
+
+private :
+  static constexpr uint8_t INDEXMASK=0x3;
+  static constexpr uint8_t NEWDATA=0x4;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the three slots
+  //----------------------------------------------------------------------------------------------------------------------
+  T m_buffers[3];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief index of the shared slot plus the NEWDATA flag
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<uint8_t> m_shared;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief slot owned by the writer thread
+  //----------------------------------------------------------------------------------------------------------------------
+  uint8_t m_write;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief slot owned by the reader thread
+  //----------------------------------------------------------------------------------------------------------------------
+  uint8_t m_read;
+};
+
+#endif
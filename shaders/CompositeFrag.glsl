@@ -0,0 +1,63 @@
+#version 330 core
+/// @brief 1 when the lights were evaluated at half resolution and are upsampled here
+#ifndef HALFRES
+  #define HALFRES 0
+#endif
+/// @brief the deferred lighting accumulation buffer
+uniform sampler2D lightingTex;
+#if HALFRES
+/// @brief the half resolution light, pixel q shaded the G-buffer pixel 2q
+uniform sampler2D halfLightingTex;
+/// @brief G-buffer eye space positions, w is 1 where there is geometry
+uniform sampler2D gPositionTex;
+/// @brief G-buffer normals
+uniform sampler2D gNormalTex;
+/// @brief how quickly a half resolution sample is rejected as its depth moves away from the pixel's,
+/// in units of the pixel's depth
+#define DEPTHSHARPNESS 40.0
+/// @brief power of the normal agreement
+#define NORMALSHARPNESS 8.0
+#endif
+/// @brief our output fragment colour
+layout (location=0) out vec4 fragColour;
+
+void main()
+{
+ivec2 texel=ivec2(gl_FragCoord.xy);
+fragColour=texelFetch(lightingTex,texel,0);
+#if HALFRES
+vec4 position=texelFetch(gPositionTex,texel,0);
+// the background has no light to add
+if (position.w == 0.0)
+{
+    return;
+}
+vec3 normal=texelFetch(gNormalTex,texel,0).xyz;
+ivec2 halfSize=textureSize(halfLightingTex,0);
+// the half resolution pixel centres are at the full resolution pixels 2q
+vec2 h=vec2(texel)*0.5;
+ivec2 base=ivec2(floor(h));
+vec2 f=h-vec2(base);
+vec4 sum=vec4(0.0);
+float total=0.0;
+for (int j=0; j<2; ++j)
+{
+    for (int i=0; i<2; ++i)
+    {
+        ivec2 q=min(base+ivec2(i,j),halfSize-1);
+        vec4 p=texelFetch(gPositionTex,q*2,0);
+        vec3 n=texelFetch(gNormalTex,q*2,0).xyz;
+        float bilinear=(i == 1 ? f.x : 1.0-f.x)*(j == 1 ? f.y : 1.0-f.y);
+        float dz=abs(p.z-position.z)/max(-position.z,0.0001);
+        // a small floor on the bilinear weight lets a neighbour stand in when the nearest sample is across an edge
+        float w=p.w*(bilinear+0.001)*exp(-dz*DEPTHSHARPNESS)*pow(max(dot(n,normal),0.0),NORMALSHARPNESS);
+        sum+=w*texelFetch(halfLightingTex,q,0);
+        total+=w;
+    }
+}
+if (total > 1e-5)
+{
+    fragColour+=sum/total;
+}
+#endif
+}
@@ -0,0 +1,83 @@
+#version 430 core
+// ShaderCache injects these after the #version line
+/// @brief the number of levels of detail, there is a draw command per level for each pass
+#ifndef LEVELS
+  #define LEVELS 4
+#endif
+/// @brief instances tested by each work group
+#ifndef GROUPSIZE
+  #define GROUPSIZE 64
+#endif
+layout (local_size_x=GROUPSIZE) in;
+
+/// @brief the layout glMultiDrawElementsIndirect reads, StaticMesh::DrawCommand
+struct DrawCommand
+{
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+};
+/// @brief world space centre and radius of every instance
+layout (std430,binding=0) readonly buffer Bounds
+{
+  vec4 bounds[];
+};
+/// @brief the level of detail of every instance, four to a word
+layout (std430,binding=1) readonly buffer Levels
+{
+  uint levels[];
+};
+/// @brief the camera commands then the shadow commands, one per level, instanceCount starts at 0
+layout (std430,binding=2) buffer Commands
+{
+  DrawCommand commands[];
+};
+/// @brief each command's instances start at its baseInstance
+layout (std430,binding=3) writeonly buffer Instances
+{
+  uint instances[];
+};
+/// @brief the instances front to back for the depth pre-pass, read when sorted is set
+layout (std430,binding=4) readonly buffer Order
+{
+  uint order[];
+};
+/// @brief the frustum planes in world space, inside is positive
+uniform vec4 planes[6];
+uniform uint numInstances;
+/// @brief test the instances in the order of the Order buffer, the appends follow the invocations which run in
+/// about dispatch order so each list comes out roughly front to back
+uniform bool sorted;
+
+void append(uint _command, uint _instance)
+{
+  uint slot=atomicAdd(commands[_command].instanceCount,1u);
+  instances[commands[_command].baseInstance+slot]=_instance;
+}
+
+void main()
+{
+  uint i=gl_GlobalInvocationID.x;
+  if(i >= numInstances)
+  {
+    return;
+  }
+  if(sorted)
+  {
+    i=order[i];
+  }
+  uint level=(levels[i>>2]>>((i&3u)*8u))&0xffu;
+  // everything casts a shadow whether the camera can see it or not
+  append(LEVELS+level,i);
+  vec4 b=bounds[i];
+  for(int p=0; p<6; ++p)
+  {
+    if(dot(planes[p].xyz,b.xyz)+planes[p].w < -b.w)
+    {
+      return;
+    }
+  }
+  append(level,i);
+}
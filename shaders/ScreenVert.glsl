@@ -0,0 +1,7 @@
+#version 330 core
+/// @brief a single triangle covering the screen generated from gl_VertexID, drawn with no vertex buffers
+void main()
+{
+vec2 corner=vec2(float((gl_VertexID << 1) & 2),float(gl_VertexID & 2));
+gl_Position=vec4(corner*2.0-1.0,0.0,1.0);
+}
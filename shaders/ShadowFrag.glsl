@@ -0,0 +1,5 @@
+#version 330 core
+/// @brief only depth is written, to the shadow atlas or by the depth pre-pass
+void main()
+{
+}
@@ -0,0 +1,18 @@
+#version 330 core
+/// @brief the teapot vertex passed in
+layout (location =0) in vec3 inVert;
+/// @brief index of the instance being drawn
+layout (location =3) in uint inInstance;
+/// @brief the model matrix of every instance, one column per texel
+uniform samplerBuffer instanceMatrices;
+/// @brief the light's view projection times the camera view, the casters are in the same eye space as the
+/// lights so the receivers can look up the map with their eye space position
+uniform mat4 VP;
+
+void main()
+{
+int instance=int(inInstance)*4;
+mat4 model=mat4(texelFetch(instanceMatrices,instance),texelFetch(instanceMatrices,instance+1),
+                texelFetch(instanceMatrices,instance+2),texelFetch(instanceMatrices,instance+3));
+gl_Position=VP*model*vec4(inVert,1.0);
+}
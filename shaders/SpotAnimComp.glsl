@@ -0,0 +1,79 @@
+#version 430 core
+// ShaderCache injects these after the #version line
+/// @brief spots evaluated by each work group
+#ifndef GROUPSIZE
+  #define GROUPSIZE 64
+#endif
+// COSMAXEDGE and RANGESCALE, the cone edge clamp and range margin, come from SpotAnimator
+layout (local_size_x=GROUPSIZE) in;
+
+/// @brief the animation parameters of a spot, SpotParamsStd430
+struct Spot
+{
+  /// @brief world space position, w the time offset
+  vec4 position;
+  /// @brief x and z of the aim ellipse centre then its x and z radius
+  vec4 ellipse;
+  /// @brief start colour, w the colour mix when the parameters were set
+  vec4 start;
+  vec4 end;
+  /// @brief cos and sin of the outer cone angle
+  vec4 cutoff;
+};
+/// @brief a light in the layout of LightStd140 and the lightData texels
+struct Light
+{
+  vec4 position;
+  vec4 direction;
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  /// @brief cos cutoff, cos inner cutoff, exponent, constant attenuation
+  vec4 cone;
+  /// @brief linear and quadratic attenuation, range
+  vec4 attenuation;
+};
+layout (std430,binding=0) readonly buffer Spots
+{
+  Spot spots[];
+};
+/// @brief only the animated members are written, the rest are left as they were uploaded
+layout (std430,binding=1) buffer Lights
+{
+  Light lights[];
+};
+/// @brief the animation time wrapped to 2pi and the colour mix since the parameters were set, SpotCurve::phase
+uniform vec2 phase;
+/// @brief takes world space directions to the eye space the lights are shaded in
+uniform mat3 lightRotation;
+uniform uint numSpots;
+#define HALFPI 1.57079632679489661923
+
+// the same steps as SpotCurve::evaluate and the SpotAnimator kernels
+void main()
+{
+  uint i=gl_GlobalInvocationID.x;
+  if(i >= numSpots)
+  {
+    return;
+  }
+  Spot s=spots[i];
+  float angle=phase.x+s.position.w;
+  // the point on the ellipse the spot aims at, the floor is at y=0
+  vec3 aim=vec3(s.ellipse.x+cos(angle)*s.ellipse.z,0.0,s.ellipse.y+sin(angle)*s.ellipse.w);
+  vec3 dir=normalize(aim-s.position.xyz);
+  float colourMix=s.start.w+phase.y;
+  colourMix-= colourMix >= 1.0 ? 1.0 : 0.0;
+  float t=sin(colourMix*HALFPI);
+  vec4 colour=vec4(s.start.rgb+(s.end.rgb-s.start.rgb)*t,1.0);
+  // cos(tilt+cutoff) where tilt is the angle of the axis from straight down
+  float cosTilt=-dir.y;
+  float sinTilt=sqrt(max(0.0,1.0-cosTilt*cosTilt));
+  float cosEdge=cosTilt*s.cutoff.x-sinTilt*s.cutoff.y;
+  lights[i].direction=vec4(lightRotation*dir,0.0);
+  lights[i].ambient=colour;
+  lights[i].diffuse=colour;
+  // the CPU copy holds the swept cone for culling so the real cutoff is written back
+  lights[i].cone.x=s.cutoff.x;
+  lights[i].attenuation.z=RANGESCALE*s.position.y/max(cosEdge,COSMAXEDGE);
+}
@@ -0,0 +1,28 @@
+#version 330 core
+/// @brief a unit cone with its apex at the origin opening along +z to a base of radius 1 at z=1, one
+/// instance is drawn per light and scaled to cover everything the light can reach
+layout (location =0) in vec3 inVert;
+/// @brief the lights packed as seven RGBA32F texels each, see LightStd140.h
+uniform samplerBuffer lightData;
+/// @brief projection matrix, the lights are already in eye space
+uniform mat4 P;
+/// @brief the light the fragment shader evaluates
+flat out int lightNum;
+// NGLScene injects COSMAXEDGE, SpotAnimator's clamp on the cone edge, after the #version line
+
+void main()
+{
+int base=gl_InstanceID*7;
+vec3 apex=texelFetch(lightData,base).xyz;
+vec3 axis=normalize(texelFetch(lightData,base+1).xyz);
+float cosCutoff=max(texelFetch(lightData,base+5).x,COSMAXEDGE);
+float range=texelFetch(lightData,base+6).z;
+// the lit region is inside the cone out to range along the axis, so a cone of that height bounds it
+float radius=range*sqrt(1.0-cosCutoff*cosCutoff)/cosCutoff;
+// right handed basis around the axis so the winding of the cone is kept
+vec3 u=normalize(cross(axis,abs(axis.y) < 0.99 ? vec3(0.0,1.0,0.0) : vec3(1.0,0.0,0.0)));
+vec3 v=cross(axis,u);
+vec3 eyePos=apex+axis*(inVert.z*range)+(u*inVert.x+v*inVert.y)*radius;
+lightNum=gl_InstanceID;
+gl_Position=P*vec4(eyePos,1.0);
+}
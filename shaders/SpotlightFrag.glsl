@@ -1,9 +1,34 @@
 #version 330 core
+/// @brief 0 constant attenuation only, 1 constant and linear, 2 constant linear and quadratic
+/// ShaderCache injects the model the lights actually use so the unused terms compile out
+#ifndef ATTENUATION
+  #define ATTENUATION 2
+#endif
+/// @brief 0 forward shading, 1 the deferred G-buffer pass, 2 one light of the deferred lighting pass
+#ifndef PASS
+  #define PASS 0
+#endif
+/// @brief size of the deferred material table
+#define MAXMATERIALS 4
 
+#if PASS == 2
+/// @brief the surface being lit, read from the G-buffer in main
+vec3 fragmentNormal;
+#else
 /// @brief[in] the vertex normal
 in vec3 fragmentNormal;
+#endif
+#if PASS == 1
+/// @brief eye space position, w is 1 where there is geometry
+layout (location=0) out vec4 gPosition;
+/// @brief eye space normal, w is the material ID + 1
+layout (location=1) out vec4 gNormal;
+/// @brief the lighting accumulation buffer, starts at the ambient term
+layout (location=2) out vec4 fragColour;
+#else
 /// @brief our output fragment colour
 layout (location=0) out vec4 fragColour;
+#endif
 /// @brief material structure
 struct Materials
 {
@@ -13,11 +38,11 @@ struct Materials
 	float shininess;
 };
 
-// @brief light structure
+// @brief light structure, layout must match LightStd140 in LightStd140.h
 struct Lights
 {
 		vec4 position;
-		vec3 direction;
+		vec4 direction;
 		vec4 ambient;
 		vec4 diffuse;
 		vec4 specular;
@@ -27,18 +52,119 @@ struct Lights
     float constantAttenuation;
     float linearAttenuation;
     float quadraticAttenuation;
+    float range;
 };
+#if PASS == 2
+/// @brief the materials the G-buffer material IDs index
+uniform Materials materials[MAXMATERIALS];
+/// @brief the material of the surface being lit
+Materials material;
+/// @brief G-buffer eye space positions
+uniform sampler2D gPositionTex;
+/// @brief G-buffer normals and material IDs
+uniform sampler2D gNormalTex;
+/// @brief the light whose volume is being drawn
+flat in int lightNum;
+/// @brief 1 at full resolution, 2 when each fragment lights the first G-buffer pixel of its 2x2 block
+uniform int lightScale;
+/// @brief the surface position read from the G-buffer
+vec3 vPosition;
+#else
 // @param material passed from our program
 uniform Materials material;
-/// @param lights passed from our program
-#define numLights 8
-
-uniform Lights light[numLights];
+#endif
+#if PASS == 1
+/// @brief the entry of materials used by the object being drawn
+uniform int materialID;
+#endif
+/// @brief the lights packed as seven RGBA32F texels each
+uniform samplerBuffer lightData;
+#if PASS != 1
+/// @brief the shadow maps of every light, see ShadowAtlas.h
+uniform sampler2DShadow shadowAtlas;
+/// @brief per light atlas matrix columns, (enabled,texel size) and the tile bounds as six RGBA32F texels
+uniform samplerBuffer shadowData;
+#endif
+#if PASS == 0
+/// @brief per cluster offset and count into clusterIndices
+uniform usamplerBuffer clusterCells;
+/// @brief the light index lists of all the clusters packed end to end
+uniform usamplerBuffer clusterIndices;
+/// @brief the per object light lists packed end to end
+uniform usamplerBuffer objectIndices;
+/// @brief (offset,count) into objectIndices for the object being drawn
+flat in uvec2 objectLights;
+/// @brief number of clusters in x, y and z
+uniform ivec3 clusterDims;
+/// @brief scale from gl_FragCoord.xy to the screen tile
+uniform vec2 clusterScale;
+/// @brief depth slice is log(depth)*clusterZScale+clusterZBias
+uniform float clusterZScale;
+uniform float clusterZBias;
+#endif
+#if PASS != 2
 // our vertex position calculated in vert shader
 in vec3 vPosition;
+#endif
+
+Lights fetchLight(int _lightNum)
+{
+	int base=_lightNum*7;
+	Lights light;
+	light.position=texelFetch(lightData,base);
+	light.direction=texelFetch(lightData,base+1);
+	light.ambient=texelFetch(lightData,base+2);
+	light.diffuse=texelFetch(lightData,base+3);
+	light.specular=texelFetch(lightData,base+4);
+	vec4 spot=texelFetch(lightData,base+5);
+	light.spotCosCutoff=spot.x;
+	light.spotCosInnerCutoff=spot.y;
+	light.spotExponent=spot.z;
+	light.constantAttenuation=spot.w;
+	vec4 atten=texelFetch(lightData,base+6);
+	light.linearAttenuation=atten.x;
+	light.quadraticAttenuation=atten.y;
+	light.range=atten.z;
+	return light;
+}
 
+#if PASS == 0
+int clusterIndex()
+{
+	ivec2 tile=min(ivec2(gl_FragCoord.xy*clusterScale),clusterDims.xy-1);
+	float depth=max(-vPosition.z,0.0001);
+	int slice=clamp(int(floor(log(depth)*clusterZScale+clusterZBias)),0,clusterDims.z-1);
+	return (slice*clusterDims.y+tile.y)*clusterDims.x+tile.x;
+}
+#endif
+
+#if PASS != 1
+/// @brief fraction of the light reaching vPosition, 1 for lights without a shadow map
+float shadow(int _lightNum)
+{
+	int base=_lightNum*6;
+	vec4 info=texelFetch(shadowData,base+4);
+	if (info.x == 0.0)
+	{
+		return 1.0;
+	}
+	mat4 atlas=mat4(texelFetch(shadowData,base),texelFetch(shadowData,base+1),
+	                texelFetch(shadowData,base+2),texelFetch(shadowData,base+3));
+	vec4 tile=texelFetch(shadowData,base+5);
+	vec4 p=atlas*vec4(vPosition,1.0);
+	p.xyz/=p.w;
+	// four compare lookups a texel apart, each already a 2x2 filter, clamped so they never read a
+	// neighbouring light's tile
+	float lit=0.0;
+	lit+=texture(shadowAtlas,vec3(clamp(p.xy+vec2(-0.5,-0.5)*info.y,tile.xy,tile.zw),p.z));
+	lit+=texture(shadowAtlas,vec3(clamp(p.xy+vec2( 0.5,-0.5)*info.y,tile.xy,tile.zw),p.z));
+	lit+=texture(shadowAtlas,vec3(clamp(p.xy+vec2(-0.5, 0.5)*info.y,tile.xy,tile.zw),p.z));
+	lit+=texture(shadowAtlas,vec3(clamp(p.xy+vec2( 0.5, 0.5)*info.y,tile.xy,tile.zw),p.z));
+	return lit*0.25;
+}
+#endif
 
-vec4 spotLight (int _lightNum)
+vec4 spotLight (Lights light, int lightNum)
 {
 		float nDotVP;       // normal * light direction
 		float nDotR;        // normal * light reflection vector
@@ -51,23 +177,35 @@ vec4 spotLight (int _lightNum)
 		vec3 reflection;    // direction of maximum highlights
 
 		// Compute vector from surface to light position
-		VP = vec3 (light[_lightNum].position) - vPosition;
+		VP = vec3 (light.position) - vPosition;
 
 		// Compute distance between surface and light position
 		d = length (VP);
+		// the light was culled at this range so it must not contribute beyond it
+		if (d > light.range)
+		{
+			return vec4(0.0);
+		}
 
 		// Normalize the vector from surface to light position
 		VP = normalize (VP);
 
 		// Compute attenuation
-    attenuation = 1.f / (light[_lightNum].constantAttenuation +
-                         light[_lightNum].linearAttenuation * d +
-                         light[_lightNum].quadraticAttenuation * d * d);
+#if ATTENUATION == 0
+    attenuation = 1.f / light.constantAttenuation;
+#elif ATTENUATION == 1
+    attenuation = 1.f / (light.constantAttenuation +
+                         light.linearAttenuation * d);
+#else
+    attenuation = 1.f / (light.constantAttenuation +
+                         light.linearAttenuation * d +
+                         light.quadraticAttenuation * d * d);
+#endif
 
     // See if point on surface is inside cone of illumination
-		spotDot = dot (-VP, normalize (light[_lightNum].direction));
+		spotDot = dot (-VP, normalize (light.direction.xyz));
 
-		if (spotDot < light[_lightNum].spotCosCutoff)
+		if (spotDot < light.spotCosCutoff)
 		{
 				spotAttenuation = 0.f;
 		}
@@ -75,8 +213,12 @@ vec4 spotLight (int _lightNum)
 		{
 				// we are going to ramp from the outer cone value to the inner using
 				// smoothstep to create a smooth value for the falloff
-				float spotValue=smoothstep(light[_lightNum].spotCosCutoff,light[_lightNum].spotCosInnerCutoff,spotDot);
-				spotAttenuation = pow (spotValue, light[_lightNum].spotExponent);
+				float spotValue=smoothstep(light.spotCosCutoff,light.spotCosInnerCutoff,spotDot);
+				spotAttenuation = pow (spotValue, light.spotExponent);
+#if PASS != 1
+				// only fragments inside the cone pay for the shadow lookup
+				spotAttenuation *= shadow(lightNum);
+#endif
 		}
 
 		// Combine the spot and distance attenuation
@@ -93,21 +235,59 @@ vec4 spotLight (int _lightNum)
 //        pf = pow (nDotR, material.shininess);
 		pf=clamp(nDotVP,0.0,pow (nDotR, material.shininess));
 		// combine the light / material values
-    vec4 ambient = material.ambient * light[_lightNum].ambient * attenuation;
-    vec4 diffuse = material.diffuse * light[_lightNum].diffuse * nDotVP * attenuation;
-    vec4 specular = material.specular * light[_lightNum].specular * pf * attenuation;
+    vec4 ambient = material.ambient * light.ambient * attenuation;
+    vec4 diffuse = material.diffuse * light.diffuse * nDotVP * attenuation;
+    vec4 specular = material.specular * light.specular * pf * attenuation;
 
 		return ambient + diffuse + specular;
 }
 
 void main(void)
 {
+#if PASS == 1
+    gPosition=vec4(vPosition,1.0);
+    gNormal=vec4(normalize(fragmentNormal),float(materialID+1));
+    fragColour=vec4(0.1);
+#elif PASS == 2
+    ivec2 texel=ivec2(gl_FragCoord.xy)*lightScale;
+    vec4 normal=texelFetch(gNormalTex,texel,0);
+    // the cone covers background pixels too
+    if (normal.w == 0.0)
+    {
+        discard;
+    }
+    vPosition=texelFetch(gPositionTex,texel,0).xyz;
+    fragmentNormal=normal.xyz;
+    material=materials[int(normal.w)-1];
+    fragColour=spotLight (fetchLight(lightNum),lightNum);
+#else
     fragColour=vec4(0.1);
-// loop for all the lights and add spotlight values
-for (int i = 0; i < numLights; ++i)
+// no spot reaches this object so there is nothing to loop over
+if (objectLights.y == 0u)
+{
+    return;
+}
+uvec2 cell=texelFetch(clusterCells,clusterIndex()).xy;
+// both lists hold every light that can reach the fragment so loop over the shorter, objects using
+// the clusters have a count larger than any cluster
+if (objectLights.y < cell.y)
+{
+    for (uint i = 0u; i < objectLights.y; ++i)
+    {
+        int lightNum=int(texelFetch(objectIndices,int(objectLights.x+i)).x);
+        fragColour += spotLight (fetchLight(lightNum),lightNum);
+    }
+}
+else
 {
-    fragColour += spotLight (i);
+    // loop for the lights assigned to this fragment's cluster and add spotlight values
+    for (uint i = 0u; i < cell.y; ++i)
+    {
+        int lightNum=int(texelFetch(clusterIndices,int(cell.x+i)).x);
+        fragColour += spotLight (fetchLight(lightNum),lightNum);
+    }
 }
+#endif
 }
 
 
@@ -1,73 +1,124 @@
-#version 330 core
-/// @brief flag to indicate if model has unit normals if not normalize
-uniform bool Normalize;
-/// @brief the current fragment normal for the vert being processed
-out vec3 fragmentNormal;
-// the eye position of the camera
-uniform vec3 viewerPos;
-/// @brief the vertex passed in
-layout (location =0) in vec3 inVert;
-/// @brief the normal passed in
-layout (location =2) in vec3 inNormal;
-/// @brief the in uv
-layout (location =1) in vec2 inUV;
-out vec3 eyeDirection;
-out vec3 eyeCord3;
-struct Materials
-{
-	vec4 ambient;
-	vec4 diffuse;
-	vec4 specular;
-	float shininess;
-};
-
-
-struct Lights
-{
-		vec4 position;
-		vec3 direction;
-		vec4 ambient;
-		vec4 diffuse;
-		vec4 specular;
-		float spotCosCutoff;
-		float spotCosInnerCutoff;
-		float spotExponent;
-    float constantAttenuation;
-    float linearAttenuation;
-    float quadraticAttenuation;
-};
-
-// our material
-uniform Materials material;
-// number of lights
-#define numLights 8
-// array of lights
-uniform Lights light[numLights];
-// the vertex position
-out vec3 vPosition;
-// Model * View matrix combined in app
-uniform mat4 MV;
-// Model View Projection shader combined in app
-uniform mat4 MVP;
-// our normal matrix
-uniform mat3 normalMatrix;
-
-void main()
-{
-// calculate the fragments surface normal
-fragmentNormal = (normalMatrix*inNormal);
-// if set normalize the fragment
-if (Normalize == true)
-{
-  fragmentNormal = normalize(fragmentNormal);
-}
-
-// Get vertex position in eye coordinates
-vec4 vertexPos = MV * vec4(inVert,1.0);
-vec3 vertexEyePos = vertexPos.xyz / vertexPos.w;
-
-vPosition = vertexEyePos;
-// calculate the vertex position
-gl_Position = MVP*vec4(inVert,1.0);
-
-}
+#version 330 core
+// ShaderCache injects these after the #version line, the defaults match the original uniforms
+/// @brief set to 1 if model doesn't have unit normals and they must be normalized
+#ifndef NORMALIZE
+  #define NORMALIZE 1
+#endif
+/// @brief set to 1 to take the model matrix from instanceMatrices with the per instance index
+#ifndef INSTANCED
+  #define INSTANCED 0
+#endif
+/// @brief set to 1 when the mesh is uploaded as PackedVertex, the normal is octahedral encoded in two snorm
+/// shorts and there is no uv
+#ifndef PACKEDNORMALS
+  #define PACKEDNORMALS 0
+#endif
+/// @brief the depth pre-pass runs this shader with an empty fragment shader and the lit pass then tests with
+/// GL_EQUAL, so both programs must compute exactly the same positions
+invariant gl_Position;
+/// @brief the current fragment normal for the vert being processed
+out vec3 fragmentNormal;
+// the eye position of the camera
+uniform vec3 viewerPos;
+/// @brief the vertex passed in
+layout (location =0) in vec3 inVert;
+#if PACKEDNORMALS
+/// @brief the octahedral encoded normal passed in, the up normal (0,1,0) of a float mesh reads as its own
+/// code so the primitive plane still shades correctly
+layout (location =2) in vec2 inNormal;
+#else
+/// @brief the normal passed in
+layout (location =2) in vec3 inNormal;
+#endif
+#if INSTANCED
+/// @brief index of the instance being drawn, the draws of each level of detail take a range of one list
+layout (location =3) in uint inInstance;
+/// @brief the model matrix of every instance, one column per texel
+uniform samplerBuffer instanceMatrices;
+#endif
+/// @brief (offset,count) of each object's light list, count is 0 for unlit objects and 0xffffffff
+/// when the object uses the cluster lists
+uniform usamplerBuffer objectCells;
+/// @brief the object's light list passed on unchanged to every fragment
+flat out uvec2 objectLights;
+out vec3 eyeDirection;
+out vec3 eyeCord3;
+struct Materials
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+};
+
+// our material
+uniform Materials material;
+// the vertex position
+out vec3 vPosition;
+/// @brief the per draw transforms sub-allocated from the frame's ring buffer, TransformStd140 on the CPU side.
+/// For instanced draws MV and MVP hold the view and projection times view and the model is per instance
+layout (std140) uniform Transforms
+{
+  // Model * View matrix combined in app
+  mat4 MV;
+  // Model View Projection shader combined in app
+  mat4 MVP;
+  // our normal matrix
+  mat3 normalMatrix;
+  /// @brief index of the object being drawn into objectCells
+  int objectID;
+};
+
+#if PACKEDNORMALS
+/// @brief unfold the lower hemisphere of an octahedral code, MeshOptimizer::octEncode does the reverse
+vec3 octDecode(vec2 e)
+{
+  vec3 n=vec3(e,1.0-abs(e.x)-abs(e.y));
+  float t=max(-n.z,0.0);
+  n.xy+=vec2(n.x>=0.0 ? -t : t,n.y>=0.0 ? -t : t);
+  return normalize(n);
+}
+#endif
+
+void main()
+{
+#if INSTANCED
+int instance=int(inInstance);
+mat4 model=mat4(texelFetch(instanceMatrices,instance*4),
+                texelFetch(instanceMatrices,instance*4+1),
+                texelFetch(instanceMatrices,instance*4+2),
+                texelFetch(instanceMatrices,instance*4+3));
+mat4 modelView = MV*model;
+mat4 modelViewProjection = MVP*model;
+objectLights = texelFetch(objectCells,instance).xy;
+// scene files can give an instance any matrix so its normals take the inverse transpose of the upper 3x3,
+// the columns of which are the cross products of the other two over the determinant. The view is rigid so
+// its own 3x3 is already its normal matrix
+mat3 m=mat3(model);
+mat3 cofactors=mat3(cross(m[1],m[2]),cross(m[2],m[0]),cross(m[0],m[1]));
+mat3 normalMat = mat3(MV)*cofactors/dot(m[0],cofactors[0]);
+#else
+mat4 modelView=MV;
+mat4 modelViewProjection=MVP;
+mat3 normalMat=normalMatrix;
+objectLights = texelFetch(objectCells,objectID).xy;
+#endif
+// calculate the fragments surface normal
+#if PACKEDNORMALS
+fragmentNormal = (normalMat*octDecode(inNormal));
+#else
+fragmentNormal = (normalMat*inNormal);
+#endif
+#if NORMALIZE
+fragmentNormal = normalize(fragmentNormal);
+#endif
+
+// Get vertex position in eye coordinates
+vec4 vertexPos = modelView * vec4(inVert,1.0);
+vec3 vertexEyePos = vertexPos.xyz / vertexPos.w;
+
+vPosition = vertexEyePos;
+// calculate the vertex position
+gl_Position = modelViewProjection*vec4(inVert,1.0);
+
+}
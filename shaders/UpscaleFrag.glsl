@@ -0,0 +1,65 @@
+#version 330 core
+/// @brief 1 to smooth the edges with FXAA while scaling, 0 for a plain bilinear upscale
+#ifndef FXAA
+  #define FXAA 0
+#endif
+/// @brief the target the scene was drawn into, only the bottom left renderSize pixels are valid
+uniform sampler2D sceneTex;
+/// @brief the size the scene was drawn at
+uniform vec2 renderSize;
+/// @brief the size of the framebuffer being drawn
+uniform vec2 outputSize;
+/// @brief one over the size of sceneTex
+uniform vec2 texelSize;
+/// @brief our output fragment colour
+layout (location=0) out vec4 fragColour;
+
+/// @brief a bilinear lookup kept half a texel inside the drawn part of the target
+vec3 tap(vec2 _uv)
+{
+return texture(sceneTex,clamp(_uv,0.5*texelSize,(renderSize-0.5)*texelSize)).rgb;
+}
+
+#if FXAA
+/// @brief the edge search limits of the original FXAA
+#define SPANMAX 8.0
+#define REDUCEMUL (1.0/8.0)
+#define REDUCEMIN (1.0/128.0)
+
+float luma(vec3 _colour)
+{
+return dot(_colour,vec3(0.299,0.587,0.114));
+}
+
+/// @brief blur along the edge direction estimated from the luma of the four diagonal neighbours, falling
+/// back to the narrower blur when the wider one picks up something outside the local range
+vec3 fxaa(vec2 _uv)
+{
+float nw=luma(tap(_uv+vec2(-1.0,-1.0)*texelSize));
+float ne=luma(tap(_uv+vec2( 1.0,-1.0)*texelSize));
+float sw=luma(tap(_uv+vec2(-1.0, 1.0)*texelSize));
+float se=luma(tap(_uv+vec2( 1.0, 1.0)*texelSize));
+vec3 centre=tap(_uv);
+float m=luma(centre);
+float lumaMin=min(m,min(min(nw,ne),min(sw,se)));
+float lumaMax=max(m,max(max(nw,ne),max(sw,se)));
+vec2 dir=vec2(-((nw+ne)-(sw+se)),(nw+sw)-(ne+se));
+float reduce=max((nw+ne+sw+se)*0.25*REDUCEMUL,REDUCEMIN);
+float rcpMin=1.0/(min(abs(dir.x),abs(dir.y))+reduce);
+dir=clamp(dir*rcpMin,vec2(-SPANMAX),vec2(SPANMAX))*texelSize;
+vec3 a=0.5*(tap(_uv+dir*(1.0/3.0-0.5))+tap(_uv+dir*(2.0/3.0-0.5)));
+vec3 b=a*0.5+0.25*(tap(_uv-dir*0.5)+tap(_uv+dir*0.5));
+float lumaB=luma(b);
+return (lumaB < lumaMin || lumaB > lumaMax) ? a : b;
+}
+#endif
+
+void main()
+{
+vec2 uv=gl_FragCoord.xy/outputSize*renderSize*texelSize;
+#if FXAA
+fragColour=vec4(fxaa(uv),1.0);
+#else
+fragColour=vec4(tap(uv),1.0);
+#endif
+}
@@ -0,0 +1,161 @@
+#include "ClusterGrid.h"
+#include <algorithm>
+#include <cmath>
+
+ClusterGrid::ClusterGrid(unsigned int _x, unsigned int _y, unsigned int _z) :
+  m_dimX(std::max(1u,_x)),
+  m_dimY(std::max(1u,_y)),
+  m_dimZ(std::max(1u,_z))
+{
+  buildBounds();
+}
+
+void ClusterGrid::setProjection(float _xScale, float _yScale, float _near, float _far)
+{
+  m_xScale=_xScale;
+  m_yScale=_yScale;
+  m_near=_near;
+  m_far=_far;
+  buildBounds();
+}
+
+void ClusterGrid::buildBounds()
+{
+  float logRatio=std::log(m_far/m_near);
+  m_zScale=m_dimZ/logRatio;
+  m_zBias=-(m_dimZ*std::log(m_near))/logRatio;
+  m_cellBounds.resize(static_cast<size_t>(m_dimX)*m_dimY*m_dimZ);
+  m_cells.assign(m_cellBounds.size()*2,0);
+
+  for(unsigned int z=0; z<m_dimZ; ++z)
+  {
+    // exponential slices keep the clusters roughly cubic in eye space
+    float d0=m_near*std::pow(m_far/m_near,static_cast<float>(z)/m_dimZ);
+    float d1=m_near*std::pow(m_far/m_near,static_cast<float>(z+1)/m_dimZ);
+    for(unsigned int y=0; y<m_dimY; ++y)
+    {
+      float ny0=-1.0f+2.0f*y/m_dimY;
+      float ny1=-1.0f+2.0f*(y+1)/m_dimY;
+      for(unsigned int x=0; x<m_dimX; ++x)
+      {
+        float nx0=-1.0f+2.0f*x/m_dimX;
+        float nx1=-1.0f+2.0f*(x+1)/m_dimX;
+        CellBounds &b=m_cellBounds[clusterIndex(x,y,z)];
+        // the extremes of a frustum slice are at the corners of its near and far faces
+        b.m_min[0]=std::min({nx0*d0,nx0*d1,nx1*d0,nx1*d1})/m_xScale;
+        b.m_max[0]=std::max({nx0*d0,nx0*d1,nx1*d0,nx1*d1})/m_xScale;
+        b.m_min[1]=std::min({ny0*d0,ny0*d1,ny1*d0,ny1*d1})/m_yScale;
+        b.m_max[1]=std::max({ny0*d0,ny0*d1,ny1*d0,ny1*d1})/m_yScale;
+        // the camera looks down -z
+        b.m_min[2]=-d1;
+        b.m_max[2]=-d0;
+        float halfDiagonalSq=0.0f;
+        for(int i=0; i<3; ++i)
+        {
+          b.m_sphere.m_centre[i]=0.5f*(b.m_min[i]+b.m_max[i]);
+          float h=0.5f*(b.m_max[i]-b.m_min[i]);
+          halfDiagonalSq+=h*h;
+        }
+        b.m_sphere.m_radius=std::sqrt(halfDiagonalSq);
+      }
+    }
+  }
+}
+
+unsigned int ClusterGrid::sliceForDepth(float _depth) const
+{
+  if(_depth <= m_near)
+  {
+    return 0;
+  }
+  float slice=std::floor(std::log(_depth)*m_zScale+m_zBias);
+  return static_cast<unsigned int>(std::min(std::max(slice,0.0f),static_cast<float>(m_dimZ-1)));
+}
+
+void ClusterGrid::tileRange(float _min, float _max, float _nearDepth, float _farDepth, float _scale,
+                            unsigned int _tiles, unsigned int &o_first, unsigned int &o_last)
+{
+  float lo=std::min(_scale*_min/_nearDepth,_scale*_min/_farDepth);
+  float hi=std::max(_scale*_max/_nearDepth,_scale*_max/_farDepth);
+  if(hi < -1.0f || lo > 1.0f)
+  {
+    // off screen, return an empty range
+    o_first=1;
+    o_last=0;
+    return;
+  }
+  float last=static_cast<float>(_tiles-1);
+  o_first=static_cast<unsigned int>(std::min(std::max(std::floor((lo+1.0f)*0.5f*_tiles),0.0f),last));
+  o_last=static_cast<unsigned int>(std::min(std::max(std::floor((hi+1.0f)*0.5f*_tiles),0.0f),last));
+}
+
+void ClusterGrid::assign(const LightStd140 *_lights, size_t _count)
+{
+  std::fill(m_cells.begin(),m_cells.end(),0);
+  m_hits.clear();
+
+  for(size_t i=0; i<_count; ++i)
+  {
+    SpotCone cone=spotConeFromLight(_lights[i]);
+    BoundingSphere sphere=coneBoundingSphere(cone);
+    float depth=-sphere.m_centre[2];
+    float nearDepth=depth-sphere.m_radius;
+    float farDepth=depth+sphere.m_radius;
+    if(farDepth < m_near || nearDepth > m_far)
+    {
+      continue;
+    }
+    unsigned int z0=sliceForDepth(nearDepth);
+    unsigned int z1=sliceForDepth(std::min(farDepth,m_far));
+    unsigned int x0=0;
+    unsigned int x1=m_dimX-1;
+    unsigned int y0=0;
+    unsigned int y1=m_dimY-1;
+    // if the sphere crosses the near plane its projection is unbounded so test every tile
+    if(nearDepth > m_near)
+    {
+      tileRange(sphere.m_centre[0]-sphere.m_radius,sphere.m_centre[0]+sphere.m_radius,
+                nearDepth,farDepth,m_xScale,m_dimX,x0,x1);
+      tileRange(sphere.m_centre[1]-sphere.m_radius,sphere.m_centre[1]+sphere.m_radius,
+                nearDepth,farDepth,m_yScale,m_dimY,y0,y1);
+    }
+    for(unsigned int z=z0; z<=z1; ++z)
+    {
+      for(unsigned int y=y0; y<=y1; ++y)
+      {
+        for(unsigned int x=x0; x<=x1; ++x)
+        {
+          size_t cell=clusterIndex(x,y,z);
+          const CellBounds &b=m_cellBounds[cell];
+          if(sphereIntersectsAABB(sphere,b.m_min,b.m_max) && coneIntersectsSphere(cone,b.m_sphere))
+          {
+            m_hits.push_back(static_cast<uint32_t>(cell));
+            m_hits.push_back(static_cast<uint32_t>(i));
+            ++m_cells[cell*2+1];
+          }
+        }
+      }
+    }
+  }
+
+  // prefix sum the counts into offsets then scatter the hits, lights stay in ascending order per cluster
+  uint32_t offset=0;
+  for(size_t c=0; c<m_cellBounds.size(); ++c)
+  {
+    m_cells[c*2]=offset;
+    offset+=m_cells[c*2+1];
+    m_cells[c*2+1]=0;
+  }
+  m_indices.resize(offset);
+  for(size_t h=0; h<m_hits.size(); h+=2)
+  {
+    uint32_t *cell=&m_cells[m_hits[h]*2];
+    m_indices[cell[0]+cell[1]++]=m_hits[h+1];
+  }
+}
+
+const uint32_t *ClusterGrid::lightsInCluster(size_t _cluster, uint32_t &o_count) const
+{
+  o_count=m_cells[_cluster*2+1];
+  return m_indices.data()+m_cells[_cluster*2];
+}
@@ -0,0 +1,248 @@
+#include "DeferredRenderer.h"
+#include <ngl/ShaderLib.h>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+constexpr GLuint DeferredRenderer::POSITIONUNIT;
+constexpr GLuint DeferredRenderer::NORMALUNIT;
+constexpr GLuint DeferredRenderer::LIGHTINGUNIT;
+constexpr GLuint DeferredRenderer::HALFLIGHTINGUNIT;
+constexpr int DeferredRenderer::CONESEGMENTS;
+
+DeferredRenderer::~DeferredRenderer()
+{
+  destroyTargets();
+  glDeleteBuffers(1,&m_coneIBO);
+  glDeleteBuffers(1,&m_coneVBO);
+  glDeleteVertexArrays(1,&m_coneVAO);
+  glDeleteVertexArrays(1,&m_screenVAO);
+}
+
+void DeferredRenderer::create()
+{
+  // apex, base centre then the base ring
+  std::vector<float> verts={0.0f,0.0f,0.0f,0.0f,0.0f,1.0f};
+  float ring=1.0f/std::cos(ngl::PI/CONESEGMENTS);
+  for(int i=0; i<CONESEGMENTS; ++i)
+  {
+    float angle=2.0f*ngl::PI*i/CONESEGMENTS;
+    verts.push_back(ring*std::cos(angle));
+    verts.push_back(ring*std::sin(angle));
+    verts.push_back(1.0f);
+  }
+  // wound anticlockwise seen from outside so culling the front faces leaves the far side of the cone,
+  // which still covers the right pixels when the camera is inside it
+  std::vector<GLushort> indices;
+  for(int i=0; i<CONESEGMENTS; ++i)
+  {
+    GLushort a=static_cast<GLushort>(2+i);
+    GLushort b=static_cast<GLushort>(2+(i+1)%CONESEGMENTS);
+    indices.insert(indices.end(),{0,b,a,1,a,b});
+  }
+  m_coneIndices=static_cast<GLsizei>(indices.size());
+  glGenVertexArrays(1,&m_coneVAO);
+  glGenBuffers(1,&m_coneVBO);
+  glGenBuffers(1,&m_coneIBO);
+  glBindVertexArray(m_coneVAO);
+  glBindBuffer(GL_ARRAY_BUFFER,m_coneVBO);
+  glBufferData(GL_ARRAY_BUFFER,verts.size()*sizeof(float),&verts[0],GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(float),nullptr);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,m_coneIBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,indices.size()*sizeof(GLushort),&indices[0],GL_STATIC_DRAW);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+  glGenVertexArrays(1,&m_screenVAO);
+
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  (*shader)["SpotVolume"]->use();
+  shader->setUniform("gPositionTex",static_cast<int>(POSITIONUNIT));
+  shader->setUniform("gNormalTex",static_cast<int>(NORMALUNIT));
+  shader->setUniform("lightScale",1);
+  (*shader)["Composite"]->use();
+  shader->setUniform("lightingTex",static_cast<int>(LIGHTINGUNIT));
+  (*shader)["CompositeHalf"]->use();
+  shader->setUniform("lightingTex",static_cast<int>(LIGHTINGUNIT));
+  shader->setUniform("halfLightingTex",static_cast<int>(HALFLIGHTINGUNIT));
+  shader->setUniform("gPositionTex",static_cast<int>(POSITIONUNIT));
+  shader->setUniform("gNormalTex",static_cast<int>(NORMALUNIT));
+}
+
+void DeferredRenderer::setHalfResLighting(bool _half)
+{
+  if(_half != m_halfRes)
+  {
+    m_halfRes=_half;
+    // makes the next resize rebuild the buffers
+    m_width=m_height=0;
+  }
+}
+
+GLuint DeferredRenderer::createTarget(GLenum _format, int _width, int _height) const
+{
+  GLuint texture;
+  glGenTextures(1,&texture);
+  glBindTexture(GL_TEXTURE_2D,texture);
+  // only ever read with texelFetch
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D,0,_format,_width,_height,0,GL_RGBA,GL_FLOAT,nullptr);
+  glBindTexture(GL_TEXTURE_2D,0);
+  return texture;
+}
+
+void DeferredRenderer::destroyTargets()
+{
+  glDeleteFramebuffers(1,&m_halfLightBuffer);
+  glDeleteFramebuffers(1,&m_lightBuffer);
+  glDeleteFramebuffers(1,&m_gbuffer);
+  glDeleteRenderbuffers(1,&m_depth);
+  GLuint textures[4]={m_position,m_normal,m_lighting,m_halfLighting};
+  glDeleteTextures(4,textures);
+  m_gbuffer=m_lightBuffer=m_halfLightBuffer=m_position=m_normal=m_lighting=m_halfLighting=m_depth=0;
+  m_valid=false;
+}
+
+bool DeferredRenderer::resize(int _width, int _height)
+{
+  // only try once at each size so a failure isn't reported every frame
+  if(_width == m_width && _height == m_height)
+  {
+    return m_valid;
+  }
+  GLint previous;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&previous);
+  destroyTargets();
+  m_width=_width;
+  m_height=_height;
+  // positions need full float precision at the far plane, normals and light sums don't
+  m_position=createTarget(GL_RGBA32F,m_width,m_height);
+  m_normal=createTarget(GL_RGBA16F,m_width,m_height);
+  m_lighting=createTarget(GL_RGBA16F,m_width,m_height);
+  glGenRenderbuffers(1,&m_depth);
+  glBindRenderbuffer(GL_RENDERBUFFER,m_depth);
+  glRenderbufferStorage(GL_RENDERBUFFER,GL_DEPTH_COMPONENT24,m_width,m_height);
+  glBindRenderbuffer(GL_RENDERBUFFER,0);
+
+  glGenFramebuffers(1,&m_gbuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER,m_gbuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,m_position,0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT1,GL_TEXTURE_2D,m_normal,0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT2,GL_TEXTURE_2D,m_lighting,0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,GL_RENDERBUFFER,m_depth);
+  const GLenum buffers[3]={GL_COLOR_ATTACHMENT0,GL_COLOR_ATTACHMENT1,GL_COLOR_ATTACHMENT2};
+  glDrawBuffers(3,buffers);
+  bool complete=glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+  glGenFramebuffers(1,&m_lightBuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER,m_lightBuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,m_lighting,0);
+  complete&=glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+  if(m_halfRes)
+  {
+    // rounded up so the last row and column of an odd size have a pixel
+    m_halfLighting=createTarget(GL_RGBA16F,(m_width+1)/2,(m_height+1)/2);
+    glGenFramebuffers(1,&m_halfLightBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER,m_halfLightBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,m_halfLighting,0);
+    complete&=glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER,static_cast<GLuint>(previous));
+  if(!complete)
+  {
+    std::cerr<<"unable to create a "<<m_width<<"x"<<m_height<<" G-buffer\n";
+    destroyTargets();
+    return false;
+  }
+  m_valid=true;
+  return true;
+}
+
+void DeferredRenderer::beginGeometry()
+{
+  GLint target;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&target);
+  m_target=static_cast<GLuint>(target);
+  glBindFramebuffer(GL_FRAMEBUFFER,m_gbuffer);
+  // w of 0 marks the pixels with no geometry, the lighting starts as the background
+  const GLfloat empty[4]={0.0f,0.0f,0.0f,0.0f};
+  GLfloat background[4];
+  glGetFloatv(GL_COLOR_CLEAR_VALUE,background);
+  const GLfloat depth=1.0f;
+  glClearBufferfv(GL_COLOR,0,empty);
+  glClearBufferfv(GL_COLOR,1,empty);
+  glClearBufferfv(GL_COLOR,2,background);
+  glClearBufferfv(GL_DEPTH,0,&depth);
+}
+
+void DeferredRenderer::lightPass(size_t _numLights, const ngl::Mat4 &_project)
+{
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT,viewport);
+  if(m_halfRes)
+  {
+    // the half resolution light starts at nothing, the ambient and background stay in the full buffer
+    glBindFramebuffer(GL_FRAMEBUFFER,m_halfLightBuffer);
+    const GLfloat empty[4]={0.0f,0.0f,0.0f,0.0f};
+    glClearBufferfv(GL_COLOR,0,empty);
+    glViewport(0,0,(viewport[2]+1)/2,(viewport[3]+1)/2);
+  }
+  else
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER,m_lightBuffer);
+  }
+  glActiveTexture(GL_TEXTURE0+POSITIONUNIT);
+  glBindTexture(GL_TEXTURE_2D,m_position);
+  glActiveTexture(GL_TEXTURE0+NORMALUNIT);
+  glBindTexture(GL_TEXTURE_2D,m_normal);
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  (*shader)["SpotVolume"]->use();
+  shader->setUniform("P",_project);
+  shader->setUniform("lightScale",m_halfRes ? 2 : 1);
+  // every light adds to the pixels its cone covers, the far faces are drawn with no depth test so each
+  // covered pixel is lit once whether the camera is inside the cone or not
+  GLint polygonMode[2];
+  glGetIntegerv(GL_POLYGON_MODE,polygonMode);
+  glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE,GL_ONE);
+  glEnable(GL_CULL_FACE);
+  glCullFace(GL_FRONT);
+  glBindVertexArray(m_coneVAO);
+  glDrawElementsInstanced(GL_TRIANGLES,m_coneIndices,GL_UNSIGNED_SHORT,nullptr,static_cast<GLsizei>(_numLights));
+  glBindVertexArray(0);
+  glCullFace(GL_BACK);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_BLEND);
+  glEnable(GL_DEPTH_TEST);
+  glPolygonMode(GL_FRONT_AND_BACK,static_cast<GLenum>(polygonMode[0]));
+  glViewport(viewport[0],viewport[1],viewport[2],viewport[3]);
+}
+
+void DeferredRenderer::composite()
+{
+  glBindFramebuffer(GL_FRAMEBUFFER,m_target);
+  glActiveTexture(GL_TEXTURE0+LIGHTINGUNIT);
+  glBindTexture(GL_TEXTURE_2D,m_lighting);
+  if(m_halfRes)
+  {
+    // the G-buffer is still bound from the light pass for the depths and normals
+    glActiveTexture(GL_TEXTURE0+HALFLIGHTINGUNIT);
+    glBindTexture(GL_TEXTURE_2D,m_halfLighting);
+  }
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  (*shader)[m_halfRes ? "CompositeHalf" : "Composite"]->use();
+  GLint polygonMode[2];
+  glGetIntegerv(GL_POLYGON_MODE,polygonMode);
+  glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
+  glDisable(GL_DEPTH_TEST);
+  glBindVertexArray(m_screenVAO);
+  glDrawArrays(GL_TRIANGLES,0,3);
+  glBindVertexArray(0);
+  glEnable(GL_DEPTH_TEST);
+  glPolygonMode(GL_FRONT_AND_BACK,static_cast<GLenum>(polygonMode[0]));
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,190 @@
+#include "DynamicBuffer.h"
+#include <algorithm>
+#include <iostream>
+#include "FenceWait.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the smallest region made, the ring grows by doubling from here
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static size_t MINREGION=64*1024;
+
+bool DynamicBuffer::persistentSupported()
+{
+  GLint major=0;
+  GLint minor=0;
+  glGetIntegerv(GL_MAJOR_VERSION,&major);
+  glGetIntegerv(GL_MINOR_VERSION,&minor);
+  return major > 4 || (major == 4 && minor >= 4);
+}
+
+DynamicBuffer::~DynamicBuffer()
+{
+  release();
+}
+
+void DynamicBuffer::create(bool _persistent)
+{
+  m_persistent=_persistent;
+  GLint alignment=0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT,&alignment);
+  m_uniformAlignment=static_cast<size_t>(std::max(alignment,16));
+}
+
+void DynamicBuffer::retire()
+{
+  // the fences only guard the old buffer's regions, every region of a new one is free
+  for(GLsync &fence : m_fences)
+  {
+    glDeleteSync(fence);
+    fence=nullptr;
+  }
+  if(m_buffer != 0)
+  {
+    m_retired.push_back(m_buffer);
+  }
+  m_buffer=0;
+  m_mapped=nullptr;
+}
+
+void DynamicBuffer::deleteRetired()
+{
+  if(!m_retired.empty())
+  {
+    glDeleteBuffers(static_cast<GLsizei>(m_retired.size()),m_retired.data());
+    m_retired.clear();
+  }
+}
+
+void DynamicBuffer::release()
+{
+  deleteRetired();
+  for(GLsync &fence : m_fences)
+  {
+    glDeleteSync(fence);
+    fence=nullptr;
+  }
+  if(m_mapped != nullptr)
+  {
+    glBindBuffer(GL_COPY_WRITE_BUFFER,m_buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+    m_mapped=nullptr;
+  }
+  glDeleteBuffers(1,&m_buffer);
+  m_buffer=0;
+}
+
+void DynamicBuffer::allocateStorage(size_t _regionSize)
+{
+  // anything already drawn keeps the old storage alive until the GPU is done with it, but bindings made this
+  // frame still name the old buffer so it is only deleted once the next frame begins
+  retire();
+  m_regionSize=_regionSize;
+  GLsizeiptr bytes=static_cast<GLsizeiptr>(m_regionSize*FRAMES);
+  glGenBuffers(1,&m_buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,m_buffer);
+  if(m_persistent)
+  {
+    GLbitfield flags=GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_COPY_WRITE_BUFFER,bytes,nullptr,flags);
+    m_mapped=static_cast<char *>(glMapBufferRange(GL_COPY_WRITE_BUFFER,0,bytes,flags));
+    if(m_mapped == nullptr)
+    {
+      std::cerr<<"unable to map the dynamic buffer, staging the per frame data instead\n";
+      m_persistent=false;
+      glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+      glDeleteBuffers(1,&m_buffer);
+      glGenBuffers(1,&m_buffer);
+      glBindBuffer(GL_COPY_WRITE_BUFFER,m_buffer);
+    }
+  }
+  if(!m_persistent)
+  {
+    glBufferData(GL_COPY_WRITE_BUFFER,bytes,nullptr,GL_STREAM_DRAW);
+    m_staging.resize(m_regionSize);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+}
+
+void DynamicBuffer::beginFrame(size_t _bytes)
+{
+  deleteRetired();
+  if(_bytes > m_regionSize)
+  {
+    allocateStorage(std::max(alignUp(_bytes,MINREGION),m_regionSize*2));
+  }
+  m_region=(m_region+1)%FRAMES;
+  m_head=m_flushed=0;
+  ++m_frames;
+  GLsync &fence=m_fences[m_region];
+  if(fence == nullptr)
+  {
+    return;
+  }
+  // two frames have gone since the region was used so the GPU should be done with it, FRAMES is too small if not
+  GLenum status;
+  double ms;
+  if(waitFence(fence,status,ms))
+  {
+    ++m_waits;
+    m_waitTime+=ms;
+    m_maxWait=std::max(m_maxWait,ms);
+  }
+  if(status == GL_WAIT_FAILED)
+  {
+    std::cerr<<"waiting for the dynamic buffer region failed\n";
+  }
+  glDeleteSync(fence);
+  fence=nullptr;
+}
+
+DynamicBuffer::Allocation DynamicBuffer::allocate(size_t _bytes, size_t _alignment, FrameStats &_stats)
+{
+  size_t offset=alignUp(m_head,_alignment);
+  if(offset+_bytes > m_regionSize)
+  {
+    // the frame asked for more than it said it would, what it has allocated so far is sent to the old buffer
+    // and the rest of the frame goes at the start of a bigger one
+    if(m_overflows++ == 0)
+    {
+      std::cerr<<"the dynamic buffer region of "<<m_regionSize<<" bytes overflowed, growing it\n";
+    }
+    flush(_stats);
+    allocateStorage(std::max(alignUp(m_head+_bytes,MINREGION),m_regionSize*2));
+    m_head=m_flushed=0;
+    offset=0;
+  }
+  m_head=offset+_bytes;
+  _stats.addStreamed(_bytes);
+  size_t start=m_region*m_regionSize+offset;
+  if(m_mapped != nullptr)
+  {
+    return {m_mapped+start,start};
+  }
+  return {m_staging.data()+offset,start};
+}
+
+void DynamicBuffer::flush(FrameStats &_stats)
+{
+  if(m_mapped != nullptr || m_head <= m_flushed)
+  {
+    return;
+  }
+  // the region is fenced so nothing the GPU is reading is overwritten
+  glBindBuffer(GL_COPY_WRITE_BUFFER,m_buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER,static_cast<GLintptr>(m_region*m_regionSize+m_flushed),
+                  static_cast<GLsizeiptr>(m_head-m_flushed),m_staging.data()+m_flushed);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+  _stats.addUpload(m_head-m_flushed);
+  m_flushed=m_head;
+}
+
+void DynamicBuffer::endFrame()
+{
+  if(m_buffer == 0)
+  {
+    return;
+  }
+  glDeleteSync(m_fences[m_region]);
+  m_fences[m_region]=glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+}
@@ -0,0 +1,186 @@
+#include "DynamicResolution.h"
+#include <ngl/ShaderLib.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+constexpr GLuint DynamicResolution::SCENEUNIT;
+constexpr size_t DynamicResolution::LATENCY;
+
+DynamicResolution::~DynamicResolution()
+{
+  destroyTarget();
+  if(m_queries[0] != 0)
+  {
+    glDeleteQueries(2*LATENCY,m_queries);
+  }
+  glDeleteVertexArrays(1,&m_screenVAO);
+}
+
+void DynamicResolution::create()
+{
+  glGenQueries(2*LATENCY,m_queries);
+  glGenVertexArrays(1,&m_screenVAO);
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  for(auto name : {"Upscale","UpscaleFxaa"})
+  {
+    (*shader)[name]->use();
+    shader->setUniform("sceneTex",static_cast<int>(SCENEUNIT));
+  }
+}
+
+bool DynamicResolution::setLog(const std::string &_fname)
+{
+  if(m_log.is_open())
+  {
+    m_log.close();
+  }
+  if(_fname.empty())
+  {
+    return true;
+  }
+  m_log.open(_fname,std::ios::out | std::ios::trunc);
+  if(!m_log)
+  {
+    std::cerr<<"unable to write the resolution log "<<_fname<<"\n";
+    return false;
+  }
+  m_log<<"frame,gpu_ms,smoothed_ms,render_width,render_height,next_scale\n";
+  return true;
+}
+
+void DynamicResolution::destroyTarget()
+{
+  glDeleteFramebuffers(1,&m_framebuffer);
+  glDeleteTextures(1,&m_colour);
+  glDeleteRenderbuffers(1,&m_depth);
+  m_framebuffer=m_colour=m_depth=0;
+  m_valid=false;
+}
+
+bool DynamicResolution::resize(int _width, int _height)
+{
+  // the target follows the output size and each scale draws into its corner, so a new scale never rebuilds
+  // it and a size that failed stays failed, with begin drawing straight to the framebuffer, until the window
+  // changes
+  if(_width == m_width && _height == m_height)
+  {
+    return m_valid;
+  }
+  GLint previous;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&previous);
+  destroyTarget();
+  m_width=_width;
+  m_height=_height;
+  glGenTextures(1,&m_colour);
+  glBindTexture(GL_TEXTURE_2D,m_colour);
+  // filtered by the upscale and the FXAA taps, which must never pick up the unused part of the target
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA8,m_width,m_height,0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+  glBindTexture(GL_TEXTURE_2D,0);
+  glGenRenderbuffers(1,&m_depth);
+  glBindRenderbuffer(GL_RENDERBUFFER,m_depth);
+  glRenderbufferStorage(GL_RENDERBUFFER,GL_DEPTH_COMPONENT24,m_width,m_height);
+  glBindRenderbuffer(GL_RENDERBUFFER,0);
+  glGenFramebuffers(1,&m_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER,m_framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,m_colour,0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,GL_RENDERBUFFER,m_depth);
+  bool complete=glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER,static_cast<GLuint>(previous));
+  if(!complete)
+  {
+    std::cerr<<"unable to create a "<<m_width<<"x"<<m_height<<" render target, drawing at the output size\n";
+    destroyTarget();
+    return false;
+  }
+  m_valid=true;
+  return true;
+}
+
+void DynamicResolution::collect()
+{
+  while(m_read < m_issued)
+  {
+    size_t slot=m_read%LATENCY;
+    GLint available=0;
+    glGetQueryObjectiv(m_queries[2*slot+1],GL_QUERY_RESULT_AVAILABLE,&available);
+    if(!available)
+    {
+      return;
+    }
+    GLuint64 start=0;
+    GLuint64 end=0;
+    glGetQueryObjectui64v(m_queries[2*slot],GL_QUERY_RESULT,&start);
+    glGetQueryObjectui64v(m_queries[2*slot+1],GL_QUERY_RESULT,&end);
+    m_lastTime=(end-start)/1.0e6;
+    m_controller.update(m_lastTime);
+    if(m_log.is_open())
+    {
+      m_log<<m_read<<","<<m_lastTime<<","<<m_controller.smoothedTime()<<","
+           <<m_sizes[slot][0]<<","<<m_sizes[slot][1]<<","<<m_controller.scale()<<"\n";
+    }
+    ++m_read;
+  }
+}
+
+bool DynamicResolution::begin(int _width, int _height)
+{
+  if(!isActive())
+  {
+    return false;
+  }
+  collect();
+  // a frame still in flight after LATENCY more is dropped rather than waited for
+  if(m_issued-m_read >= LATENCY)
+  {
+    ++m_read;
+  }
+  if(!resize(_width,_height))
+  {
+    return false;
+  }
+  float scale= isScaling() ? m_controller.scale() : 1.0f;
+  m_renderWidth=std::max(1,static_cast<int>(std::lround(_width*scale)));
+  m_renderHeight=std::max(1,static_cast<int>(std::lround(_height*scale)));
+  GLint target;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&target);
+  m_target=static_cast<GLuint>(target);
+  glGetIntegerv(GL_VIEWPORT,m_viewport);
+  glBindFramebuffer(GL_FRAMEBUFFER,m_framebuffer);
+  glViewport(0,0,m_renderWidth,m_renderHeight);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  size_t slot=m_issued%LATENCY;
+  m_sizes[slot][0]=m_renderWidth;
+  m_sizes[slot][1]=m_renderHeight;
+  glQueryCounter(m_queries[2*slot],GL_TIMESTAMP);
+  return true;
+}
+
+void DynamicResolution::end()
+{
+  glBindFramebuffer(GL_FRAMEBUFFER,m_target);
+  glViewport(m_viewport[0],m_viewport[1],m_viewport[2],m_viewport[3]);
+  glActiveTexture(GL_TEXTURE0+SCENEUNIT);
+  glBindTexture(GL_TEXTURE_2D,m_colour);
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  (*shader)[m_fxaa ? "UpscaleFxaa" : "Upscale"]->use();
+  shader->setUniform("renderSize",static_cast<float>(m_renderWidth),static_cast<float>(m_renderHeight));
+  shader->setUniform("outputSize",static_cast<float>(m_viewport[2]),static_cast<float>(m_viewport[3]));
+  shader->setUniform("texelSize",1.0f/m_width,1.0f/m_height);
+  GLint polygonMode[2];
+  glGetIntegerv(GL_POLYGON_MODE,polygonMode);
+  glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
+  glDisable(GL_DEPTH_TEST);
+  glBindVertexArray(m_screenVAO);
+  glDrawArrays(GL_TRIANGLES,0,3);
+  glBindVertexArray(0);
+  glEnable(GL_DEPTH_TEST);
+  glPolygonMode(GL_FRONT_AND_BACK,static_cast<GLenum>(polygonMode[0]));
+  glActiveTexture(GL_TEXTURE0);
+  glQueryCounter(m_queries[2*(m_issued%LATENCY)+1],GL_TIMESTAMP);
+  ++m_issued;
+}
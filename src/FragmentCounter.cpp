@@ -0,0 +1,76 @@
+#include "FragmentCounter.h"
+
+constexpr size_t FragmentCounter::LATENCY;
+
+FragmentCounter::~FragmentCounter()
+{
+  if(m_queries[0] != 0)
+  {
+    glDeleteQueries(LATENCY,m_queries);
+  }
+}
+
+void FragmentCounter::create()
+{
+  glGenQueries(LATENCY,m_queries);
+}
+
+void FragmentCounter::collect()
+{
+  while(m_read < m_issued)
+  {
+    size_t slot=m_read%LATENCY;
+    GLint available=0;
+    glGetQueryObjectiv(m_queries[slot],GL_QUERY_RESULT_AVAILABLE,&available);
+    if(!available)
+    {
+      return;
+    }
+    GLuint64 shaded=0;
+    glGetQueryObjectui64v(m_queries[slot],GL_QUERY_RESULT,&shaded);
+    m_lastShaded=shaded;
+    m_lastSamples=m_samples[slot];
+    if(m_read >= m_countFrom)
+    {
+      ++m_frames;
+      m_totalShaded+=shaded;
+      m_totalSamples+=m_samples[slot];
+    }
+    ++m_read;
+  }
+}
+
+void FragmentCounter::begin(uint64_t _samples)
+{
+  if(m_queries[0] == 0)
+  {
+    return;
+  }
+  collect();
+  // a frame still in flight after LATENCY more is dropped rather than waited for
+  if(m_issued-m_read >= LATENCY)
+  {
+    ++m_read;
+  }
+  size_t slot=m_issued%LATENCY;
+  m_samples[slot]=_samples;
+  glBeginQuery(GL_SAMPLES_PASSED,m_queries[slot]);
+}
+
+void FragmentCounter::end()
+{
+  if(m_queries[0] == 0)
+  {
+    return;
+  }
+  glEndQuery(GL_SAMPLES_PASSED);
+  ++m_issued;
+}
+
+void FragmentCounter::clearCounters()
+{
+  m_countFrom=m_issued;
+  m_frames=0;
+  m_totalShaded=0;
+  m_totalSamples=0;
+}
@@ -0,0 +1,97 @@
+#include "FrameCache.h"
+#include <ngl/ShaderLib.h>
+#include <iostream>
+
+constexpr GLuint FrameCache::UNIT;
+
+FrameCache::~FrameCache()
+{
+  glDeleteFramebuffers(1,&m_framebuffer);
+  glDeleteTextures(1,&m_colour);
+  glDeleteVertexArrays(1,&m_screenVAO);
+}
+
+bool FrameCache::resize(int _width, int _height)
+{
+  glDeleteFramebuffers(1,&m_framebuffer);
+  glDeleteTextures(1,&m_colour);
+  m_framebuffer=m_colour=0;
+  m_width=_width;
+  m_height=_height;
+  glGenTextures(1,&m_colour);
+  glBindTexture(GL_TEXTURE_2D,m_colour);
+  // only ever read with texelFetch
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA8,m_width,m_height,0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+  glBindTexture(GL_TEXTURE_2D,0);
+  glGenFramebuffers(1,&m_framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER,m_framebuffer);
+  glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,m_colour,0);
+  bool complete=glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  if(!complete)
+  {
+    std::cerr<<"unable to create a "<<m_width<<"x"<<m_height<<" frame cache\n";
+    glDeleteFramebuffers(1,&m_framebuffer);
+    glDeleteTextures(1,&m_colour);
+    m_framebuffer=m_colour=0;
+  }
+  return complete;
+}
+
+bool FrameCache::store(int _width, int _height)
+{
+  GLint target;
+  GLint read;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&target);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING,&read);
+  m_valid=false;
+  if(_width != m_width || _height != m_height || !m_framebuffer)
+  {
+    // a failed size is only retried when the size changes
+    if(_width == m_width && _height == m_height)
+    {
+      return false;
+    }
+    if(!resize(_width,_height))
+    {
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER,static_cast<GLuint>(target));
+      return false;
+    }
+  }
+  // resolves the samples when the target is multisampled
+  glBindFramebuffer(GL_READ_FRAMEBUFFER,static_cast<GLuint>(target));
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER,m_framebuffer);
+  glBlitFramebuffer(0,0,m_width,m_height,0,0,m_width,m_height,GL_COLOR_BUFFER_BIT,GL_NEAREST);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER,static_cast<GLuint>(target));
+  glBindFramebuffer(GL_READ_FRAMEBUFFER,static_cast<GLuint>(read));
+  m_valid=true;
+  return true;
+}
+
+bool FrameCache::restore(int _width, int _height)
+{
+  if(!m_valid || _width != m_width || _height != m_height)
+  {
+    return false;
+  }
+  if(!m_screenVAO)
+  {
+    glGenVertexArrays(1,&m_screenVAO);
+  }
+  glActiveTexture(GL_TEXTURE0+UNIT);
+  glBindTexture(GL_TEXTURE_2D,m_colour);
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  (*shader)["Composite"]->use();
+  GLint polygonMode[2];
+  glGetIntegerv(GL_POLYGON_MODE,polygonMode);
+  glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
+  glDisable(GL_DEPTH_TEST);
+  glBindVertexArray(m_screenVAO);
+  glDrawArrays(GL_TRIANGLES,0,3);
+  glBindVertexArray(0);
+  glEnable(GL_DEPTH_TEST);
+  glPolygonMode(GL_FRONT_AND_BACK,static_cast<GLenum>(polygonMode[0]));
+  glActiveTexture(GL_TEXTURE0);
+  return true;
+}
@@ -0,0 +1,163 @@
+#include "FrameCapture.h"
+#include <cstring>
+#include <iostream>
+#include "FenceWait.h"
+
+constexpr size_t FrameCapture::SLOTS;
+
+FrameCapture::~FrameCapture()
+{
+  close();
+}
+
+bool FrameCapture::open(const std::string &_fname, int _fps)
+{
+  close();
+  if(!m_writer.open(_fname,_fps))
+  {
+    return false;
+  }
+  for(auto &slot : m_slots)
+  {
+    glGenBuffers(1,&slot.m_buffer);
+  }
+  m_next=0;
+  m_frames=m_waits=0;
+  m_waitTime=0.0;
+  std::cout<<"Capturing the frames to "<<_fname<<"\n";
+  return true;
+}
+
+void FrameCapture::close()
+{
+  if(!isOpen())
+  {
+    return;
+  }
+  // oldest first so the frames reach the writer in order
+  for(size_t i=0; i<SLOTS; ++i)
+  {
+    Slot &slot=m_slots[(m_next+i)%SLOTS];
+    if(slot.m_fence)
+    {
+      collect(slot);
+    }
+    glDeleteBuffers(1,&slot.m_buffer);
+    slot=Slot();
+  }
+  m_writer.close();
+  glDeleteFramebuffers(1,&m_framebuffer);
+  glDeleteRenderbuffers(1,&m_colour);
+  m_framebuffer=m_colour=0;
+  m_width=m_height=0;
+}
+
+bool FrameCapture::resize(int _width, int _height)
+{
+  if(m_framebuffer && _width == m_width && _height == m_height)
+  {
+    return true;
+  }
+  glDeleteFramebuffers(1,&m_framebuffer);
+  glDeleteRenderbuffers(1,&m_colour);
+  m_width=_width;
+  m_height=_height;
+  glGenRenderbuffers(1,&m_colour);
+  glBindRenderbuffer(GL_RENDERBUFFER,m_colour);
+  glRenderbufferStorage(GL_RENDERBUFFER,GL_RGBA8,m_width,m_height);
+  glBindRenderbuffer(GL_RENDERBUFFER,0);
+  glGenFramebuffers(1,&m_framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER,m_framebuffer);
+  glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_RENDERBUFFER,m_colour);
+  bool complete=glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  if(!complete)
+  {
+    std::cerr<<"unable to create a "<<m_width<<"x"<<m_height<<" capture buffer\n";
+    glDeleteFramebuffers(1,&m_framebuffer);
+    glDeleteRenderbuffers(1,&m_colour);
+    m_framebuffer=m_colour=0;
+  }
+  return complete;
+}
+
+void FrameCapture::capture(int _width, int _height)
+{
+  if(!isOpen())
+  {
+    return;
+  }
+  Slot &slot=m_slots[m_next];
+  if(slot.m_fence)
+  {
+    collect(slot);
+  }
+  GLint target;
+  GLint read;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&target);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING,&read);
+  if(!resize(_width,_height))
+  {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER,static_cast<GLuint>(target));
+    return;
+  }
+  // resolves the samples when the target is multisampled, glReadPixels can't read those
+  glBindFramebuffer(GL_READ_FRAMEBUFFER,static_cast<GLuint>(target));
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER,m_framebuffer);
+  glBlitFramebuffer(0,0,_width,_height,0,0,_width,_height,GL_COLOR_BUFFER_BIT,GL_NEAREST);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER,m_framebuffer);
+  size_t bytes=static_cast<size_t>(_width)*_height*4;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER,slot.m_buffer);
+  if(bytes != slot.m_size)
+  {
+    glBufferData(GL_PIXEL_PACK_BUFFER,static_cast<GLsizeiptr>(bytes),nullptr,GL_STREAM_READ);
+    slot.m_size=bytes;
+  }
+  // into the buffer object so this only queues the copy
+  glPixelStorei(GL_PACK_ALIGNMENT,4);
+  glReadPixels(0,0,_width,_height,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+  slot.m_fence=glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+  slot.m_width=_width;
+  slot.m_height=_height;
+  slot.m_index=m_frames++;
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER,static_cast<GLuint>(target));
+  glBindFramebuffer(GL_READ_FRAMEBUFFER,static_cast<GLuint>(read));
+  m_next=(m_next+1)%SLOTS;
+}
+
+void FrameCapture::collect(Slot &_slot)
+{
+  // the readback went in SLOTS frames ago, one still running means the capture is holding the frame rate back
+  GLenum status;
+  double ms;
+  if(waitFence(_slot.m_fence,status,ms))
+  {
+    ++m_waits;
+    m_waitTime+=ms;
+  }
+  glDeleteSync(_slot.m_fence);
+  _slot.m_fence=nullptr;
+  if(status == GL_WAIT_FAILED)
+  {
+    std::cerr<<"waiting for captured frame "<<_slot.m_index<<" failed\n";
+    return;
+  }
+  FrameWriter::Frame frame=m_writer.acquire(_slot.m_width,_slot.m_height);
+  frame.m_index=_slot.m_index;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER,_slot.m_buffer);
+  const void *pixels=glMapBufferRange(GL_PIXEL_PACK_BUFFER,0,static_cast<GLsizeiptr>(frame.m_pixels.size()),
+                                      GL_MAP_READ_BIT);
+  if(pixels)
+  {
+    // the only copy on this thread, the buffer has to be unmapped before the next readback into it
+    std::memcpy(frame.m_pixels.data(),pixels,frame.m_pixels.size());
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+  if(!pixels)
+  {
+    std::cerr<<"unable to map captured frame "<<_slot.m_index<<"\n";
+    return;
+  }
+  m_writer.submit(std::move(frame));
+}
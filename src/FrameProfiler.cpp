@@ -0,0 +1,308 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+FrameProfiler::FrameProfiler() :
+  m_enabled(false),
+  m_inFrame(false),
+  m_active(false),
+  m_frameNumber(0),
+  m_windowFrames(0),
+  m_dropped(0),
+  m_droppedReported(0),
+  m_windowStart(Clock::now()),
+  m_epoch(Clock::now()),
+  m_gpuEpochNs(0),
+  m_captureFrames(0),
+  m_capturePending(0)
+{
+  // the whole frame is always the first phase
+  total("frame");
+}
+
+FrameProfiler::~FrameProfiler()
+{
+  for(auto &frame : m_frames)
+  {
+    if(!frame.m_queries.empty())
+    {
+      glDeleteQueries(static_cast<GLsizei>(frame.m_queries.size()),&frame.m_queries[0]);
+    }
+  }
+}
+
+void FrameProfiler::initializeGL()
+{
+  GLint64 gpuNow=0;
+  glGetInteger64v(GL_TIMESTAMP,&gpuNow);
+  m_epoch=Clock::now();
+  m_gpuEpochNs=gpuNow;
+}
+
+void FrameProfiler::beginFrame()
+{
+  m_active.store(isEnabled(),std::memory_order_relaxed);
+  if(!isEnabled())
+  {
+    return;
+  }
+  Frame &frame=m_frames[m_frameNumber%FRAMELAG];
+  if(frame.m_pending)
+  {
+    resolve(frame);
+  }
+  frame.m_scopes.clear();
+  frame.m_usedQueries=0;
+  frame.m_capture=m_captureFrames > 0;
+  if(frame.m_capture)
+  {
+    --m_captureFrames;
+    ++m_capturePending;
+  }
+  m_inFrame=true;
+  beginScope("frame",true);
+}
+
+void FrameProfiler::endFrame()
+{
+  if(!m_inFrame)
+  {
+    return;
+  }
+  endScope(0);
+  Frame &frame=m_frames[m_frameNumber%FRAMELAG];
+  frame.m_pending=true;
+  m_inFrame=false;
+  ++m_frameNumber;
+
+  std::vector<ThreadEvent> events;
+  {
+    std::lock_guard<std::mutex> lock(m_threadMutex);
+    events.swap(m_threadEvents);
+  }
+  for(auto &e : events)
+  {
+    Total &t=total(e.m_name);
+    t.m_cpuMs+=std::chrono::duration<double,std::milli>(e.m_end-e.m_begin).count();
+    ++t.m_calls;
+    if(frame.m_capture)
+    {
+      m_trace.push_back({e.m_name,e.m_thread,toUs(e.m_begin),toUs(e.m_end)-toUs(e.m_begin)});
+    }
+  }
+
+  Clock::time_point now=Clock::now();
+  if(now-m_windowStart >= std::chrono::seconds(1) && m_windowFrames > 0)
+  {
+    m_phases.clear();
+    double frames=static_cast<double>(m_windowFrames);
+    for(auto &t : m_totals)
+    {
+      m_phases.push_back({t.m_name,t.m_cpuMs/frames,t.m_gpuMs/frames,t.m_calls/frames});
+      t.m_cpuMs=0.0;
+      t.m_gpuMs=0.0;
+      t.m_calls=0;
+    }
+    m_droppedReported=m_dropped;
+    m_dropped=0;
+    m_windowFrames=0;
+    m_windowStart=now;
+  }
+}
+
+void FrameProfiler::finish()
+{
+  glFinish();
+  // oldest first so the trace stays in order
+  for(size_t i=0; i<FRAMELAG; ++i)
+  {
+    Frame &frame=m_frames[(m_frameNumber+i)%FRAMELAG];
+    if(frame.m_pending)
+    {
+      resolve(frame);
+    }
+  }
+}
+
+size_t FrameProfiler::beginScope(const char *_name, bool _gpu)
+{
+  if(!m_inFrame)
+  {
+    return NOSCOPE;
+  }
+  Frame &frame=m_frames[m_frameNumber%FRAMELAG];
+  Scope scope={_name,Clock::now(),Clock::time_point(),-1};
+  if(_gpu)
+  {
+    if(frame.m_usedQueries+2 > frame.m_queries.size())
+    {
+      // the ring only grows for the first few frames, after that every frame reuses its queries
+      size_t old=frame.m_queries.size();
+      frame.m_queries.resize(old+16);
+      glGenQueries(16,&frame.m_queries[old]);
+    }
+    scope.m_query=static_cast<int>(frame.m_usedQueries);
+    glQueryCounter(frame.m_queries[frame.m_usedQueries],GL_TIMESTAMP);
+    frame.m_usedQueries+=2;
+  }
+  frame.m_scopes.push_back(scope);
+  return frame.m_scopes.size()-1;
+}
+
+void FrameProfiler::endScope(size_t _id)
+{
+  if(_id == NOSCOPE || !m_inFrame)
+  {
+    return;
+  }
+  Frame &frame=m_frames[m_frameNumber%FRAMELAG];
+  Scope &scope=frame.m_scopes[_id];
+  if(scope.m_query >= 0)
+  {
+    glQueryCounter(frame.m_queries[scope.m_query+1],GL_TIMESTAMP);
+  }
+  scope.m_end=Clock::now();
+}
+
+void FrameProfiler::record(const char *_name, Thread _thread, Clock::time_point _begin, Clock::time_point _end)
+{
+  if(!m_active.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_threadMutex);
+  m_threadEvents.push_back({_name,_thread,_begin,_end});
+}
+
+void FrameProfiler::resolve(Frame &_frame)
+{
+  _frame.m_pending=false;
+  bool gpu=_frame.m_usedQueries > 0;
+  if(gpu)
+  {
+    // the timestamps land in order so if the last is ready they all are
+    GLint available=0;
+    glGetQueryObjectiv(_frame.m_queries[_frame.m_usedQueries-1],GL_QUERY_RESULT_AVAILABLE,&available);
+    if(available)
+    {
+      m_stamps.resize(_frame.m_usedQueries);
+      for(size_t i=0; i<_frame.m_usedQueries; ++i)
+      {
+        glGetQueryObjectui64v(_frame.m_queries[i],GL_QUERY_RESULT,&m_stamps[i]);
+      }
+    }
+    else
+    {
+      gpu=false;
+      ++m_dropped;
+    }
+  }
+  for(auto &scope : _frame.m_scopes)
+  {
+    Total &t=total(scope.m_name);
+    double begin=toUs(scope.m_begin);
+    double duration=toUs(scope.m_end)-begin;
+    t.m_cpuMs+=duration/1000.0;
+    ++t.m_calls;
+    if(_frame.m_capture)
+    {
+      m_trace.push_back({scope.m_name,RENDER,begin,duration});
+    }
+    if(gpu && scope.m_query >= 0)
+    {
+      GLuint64 gpuBegin=m_stamps[scope.m_query];
+      GLuint64 gpuEnd=m_stamps[scope.m_query+1];
+      t.m_gpuMs+=(gpuEnd-gpuBegin)/1.0e6;
+      if(_frame.m_capture)
+      {
+        m_trace.push_back({scope.m_name,GPU,(static_cast<int64_t>(gpuBegin)-m_gpuEpochNs)/1000.0,
+                           (gpuEnd-gpuBegin)/1000.0});
+      }
+    }
+  }
+  ++m_windowFrames;
+  if(_frame.m_capture)
+  {
+    _frame.m_capture=false;
+    if(--m_capturePending == 0 && m_captureFrames == 0)
+    {
+      writeTrace();
+    }
+  }
+}
+
+FrameProfiler::Total &FrameProfiler::total(const char *_name)
+{
+  for(auto &t : m_totals)
+  {
+    if(t.m_name == _name || std::strcmp(t.m_name,_name) == 0)
+    {
+      return t;
+    }
+  }
+  m_totals.push_back({_name,0.0,0.0,0});
+  return m_totals.back();
+}
+
+double FrameProfiler::toUs(Clock::time_point _time) const
+{
+  return std::chrono::duration<double,std::micro>(_time-m_epoch).count();
+}
+
+void FrameProfiler::captureTrace(const std::string &_fname, size_t _frames)
+{
+  if(isCapturing() || m_capturePending > 0)
+  {
+    return;
+  }
+  m_traceFile=_fname;
+  m_captureFrames=_frames;
+  m_trace.clear();
+  std::cout<<"capturing "<<_frames<<" frames to "<<_fname<<"\n";
+}
+
+void FrameProfiler::writeTrace()
+{
+  std::ofstream out(m_traceFile);
+  if(!out.is_open())
+  {
+    std::cerr<<"unable to write trace "<<m_traceFile<<"\n";
+    return;
+  }
+  out<<"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  const char *threads[]={"render","simulation","gpu"};
+  for(int i=0; i<3; ++i)
+  {
+    out<<(i ? ",\n" : "")<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<i+1
+       <<",\"args\":{\"name\":\""<<threads[i]<<"\"}}";
+  }
+  // the job system workers that ran something in the capture
+  std::vector<int> workers;
+  for(auto &e : m_trace)
+  {
+    if(e.m_thread >= WORKER && std::find(workers.begin(),workers.end(),e.m_thread) == workers.end())
+    {
+      workers.push_back(e.m_thread);
+    }
+  }
+  std::sort(workers.begin(),workers.end());
+  for(int tid : workers)
+  {
+    out<<",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<tid
+       <<",\"args\":{\"name\":\"worker "<<tid-WORKER+1<<"\"}}";
+  }
+  out.precision(3);
+  out<<std::fixed;
+  for(auto &e : m_trace)
+  {
+    out<<",\n{\"name\":\""<<e.m_name<<"\",\"cat\":\""<<(e.m_thread == GPU ? "gpu" : "cpu")
+       <<"\",\"ph\":\"X\",\"pid\":1,\"tid\":"<<e.m_thread
+       <<",\"ts\":"<<e.m_beginUs<<",\"dur\":"<<e.m_durationUs<<"}";
+  }
+  out<<"\n]}\n";
+  std::cout<<"wrote "<<m_trace.size()<<" trace events to "<<m_traceFile<<"\n";
+  m_trace.clear();
+  m_trace.shrink_to_fit();
+}
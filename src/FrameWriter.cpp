@@ -0,0 +1,404 @@
+#include "FrameWriter.h"
+#include <QImage>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the 8 bit channel values as half floats
+//----------------------------------------------------------------------------------------------------------------------
+static std::array<uint16_t,256> buildHalfTable()
+{
+  std::array<uint16_t,256> table;
+  table[0]=0;
+  for(int i=1; i<256; ++i)
+  {
+    // every value from 1/255 to 1 is a normal half, round the 23 bit mantissa to 10
+    float f=i/255.0f;
+    uint32_t bits;
+    std::memcpy(&bits,&f,sizeof(bits));
+    uint32_t exponent=((bits>>23)&0xff)-127+15;
+    uint32_t mantissa=(bits&0x7fffff)+0x1000;
+    if(mantissa & 0x800000)
+    {
+      mantissa=0;
+      ++exponent;
+    }
+    table[i]=static_cast<uint16_t>((exponent<<10) | (mantissa>>13));
+  }
+  return table;
+}
+
+template <typename T>
+static void put(std::string &o_bytes, T _value)
+{
+  // EXR is little endian, as is everything we build for
+  o_bytes.append(reinterpret_cast<const char *>(&_value),sizeof(T));
+}
+
+static void putAttribute(std::string &o_bytes, const char *_name, const char *_type, const std::string &_value)
+{
+  o_bytes.append(_name,std::strlen(_name)+1);
+  o_bytes.append(_type,std::strlen(_type)+1);
+  put(o_bytes,static_cast<int32_t>(_value.size()));
+  o_bytes+=_value;
+}
+
+FrameWriter::~FrameWriter()
+{
+  close();
+}
+
+bool FrameWriter::formatOf(const std::string &_fname, Format &o_format)
+{
+  size_t dot=_fname.rfind('.');
+  if(dot == std::string::npos)
+  {
+    return false;
+  }
+  std::string ext=_fname.substr(dot+1);
+  std::transform(ext.begin(),ext.end(),ext.begin(),[](char _c){return static_cast<char>(std::tolower(_c));});
+  if(ext == "png")
+  {
+    o_format=Format::PNG;
+  }
+  else if(ext == "exr")
+  {
+    o_format=Format::EXR;
+  }
+  else if(ext == "y4m")
+  {
+    o_format=Format::Y4M;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+std::string FrameWriter::frameName(const std::string &_pattern, uint64_t _index)
+{
+  // only %d with an optional zero padded width is understood, the name is never used as a format string
+  size_t percent=_pattern.find('%');
+  size_t end=percent;
+  size_t width=0;
+  bool numbered=false;
+  if(percent != std::string::npos)
+  {
+    end=percent+1;
+    while(end < _pattern.size() && std::isdigit(static_cast<unsigned char>(_pattern[end])))
+    {
+      ++end;
+    }
+    if(end < _pattern.size() && _pattern[end] == 'd')
+    {
+      numbered=true;
+      width= end > percent+1 ? std::stoul(_pattern.substr(percent+1,end-percent-1)) : 0;
+      ++end;
+    }
+  }
+  std::string number=std::to_string(_index);
+  if(!numbered)
+  {
+    // add _0000 before the extension
+    width=4;
+    percent=end=_pattern.rfind('.');
+  }
+  if(number.size() < width)
+  {
+    number.insert(0,width-number.size(),'0');
+  }
+  return _pattern.substr(0,percent)+(numbered ? "" : "_")+number+_pattern.substr(end);
+}
+
+bool FrameWriter::open(const std::string &_fname, int _fps, size_t _maxQueue)
+{
+  close();
+  if(!formatOf(_fname,m_format))
+  {
+    std::cerr<<"can't capture to "<<_fname<<", the name should end in .png, .exr or .y4m\n";
+    return false;
+  }
+  m_fname=_fname;
+  m_fps=std::max(1,_fps);
+  m_maxQueue=std::max<size_t>(1,_maxQueue);
+  if(m_format == Format::Y4M)
+  {
+    m_stream.open(m_fname,std::ios::binary | std::ios::trunc);
+    if(!m_stream.is_open())
+    {
+      std::cerr<<"unable to write "<<m_fname<<"\n";
+      return false;
+    }
+    m_streamWidth=m_streamHeight=0;
+  }
+  m_closing=false;
+  m_framesWritten=m_framesFailed=0;
+  m_maxDepth=0;
+  m_stalls=0;
+  m_stallTime=0.0;
+  m_thread=std::thread(&FrameWriter::run,this);
+  return true;
+}
+
+void FrameWriter::close()
+{
+  if(!m_thread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closing=true;
+  }
+  m_queued.notify_one();
+  m_thread.join();
+  if(m_stream.is_open())
+  {
+    m_stream.close();
+  }
+  std::cout<<"Captured "<<m_framesWritten<<" frames to "<<m_fname<<" at "<<framesPerSecond()<<" fps\n";
+}
+
+FrameWriter::Frame FrameWriter::acquire(int _width, int _height)
+{
+  Frame frame;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_pool.empty())
+    {
+      frame.m_pixels.swap(m_pool.back());
+      m_pool.pop_back();
+    }
+  }
+  frame.m_width=_width;
+  frame.m_height=_height;
+  frame.m_pixels.resize(static_cast<size_t>(_width)*_height*4);
+  return frame;
+}
+
+void FrameWriter::submit(Frame &&_frame)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if(m_framesWritten+m_framesFailed+m_queue.size() == 0)
+  {
+    m_firstSubmit=Clock::now();
+  }
+  if(m_queue.size() >= m_maxQueue)
+  {
+    // the disk is behind, waiting is the only way not to lose frames
+    ++m_stalls;
+    auto start=Clock::now();
+    m_written.wait(lock,[this](){return m_queue.size() < m_maxQueue;});
+    m_stallTime+=std::chrono::duration<double,std::milli>(Clock::now()-start).count();
+  }
+  m_queue.push_back(std::move(_frame));
+  m_maxDepth=std::max(m_maxDepth,m_queue.size());
+  lock.unlock();
+  m_queued.notify_one();
+}
+
+size_t FrameWriter::queueDepth() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_queue.size();
+}
+
+uint64_t FrameWriter::framesWritten() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_framesWritten;
+}
+
+uint64_t FrameWriter::framesFailed() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_framesFailed;
+}
+
+double FrameWriter::framesPerSecond() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  double seconds=std::chrono::duration<double>(m_lastWrite-m_firstSubmit).count();
+  return m_framesWritten > 0 && seconds > 0.0 ? m_framesWritten/seconds : 0.0;
+}
+
+void FrameWriter::run()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for(;;)
+  {
+    m_queued.wait(lock,[this](){return m_closing || !m_queue.empty();});
+    if(m_queue.empty())
+    {
+      return;
+    }
+    Frame frame=std::move(m_queue.front());
+    m_queue.pop_front();
+    // the encoding and the disk are the slow part, the render thread can queue more meanwhile
+    lock.unlock();
+    m_written.notify_one();
+    bool ok=write(frame);
+    lock.lock();
+    if(ok)
+    {
+      ++m_framesWritten;
+    }
+    else if(m_framesFailed++ == 0)
+    {
+      std::cerr<<"unable to write captured frame "<<frame.m_index<<"\n";
+    }
+    m_lastWrite=Clock::now();
+    m_pool.push_back(std::move(frame.m_pixels));
+  }
+}
+
+bool FrameWriter::write(const Frame &_frame)
+{
+  switch(m_format)
+  {
+    case Format::PNG : return writePng(_frame,frameName(m_fname,_frame.m_index));
+    case Format::EXR : return writeExr(_frame,frameName(m_fname,_frame.m_index));
+    case Format::Y4M : return writeY4m(_frame);
+  }
+  return false;
+}
+
+bool FrameWriter::writePng(const Frame &_frame, const std::string &_fname) const
+{
+  // QImage is reentrant so can encode off the GUI thread, the rows are flipped to top down on the way
+  QImage image(_frame.m_pixels.data(),_frame.m_width,_frame.m_height,_frame.m_width*4,QImage::Format_RGBA8888);
+  return image.mirrored().convertToFormat(QImage::Format_RGB888).save(QString::fromStdString(_fname),"PNG");
+}
+
+bool FrameWriter::writeExr(const Frame &_frame, const std::string &_fname) const
+{
+  const int width=_frame.m_width;
+  const int height=_frame.m_height;
+  // a single part scanline file with no compression, the channels in alphabetical order
+  std::string header;
+  put(header,static_cast<int32_t>(20000630));
+  put(header,static_cast<int32_t>(2));
+  std::string channels;
+  for(const char *name : {"B","G","R"})
+  {
+    channels.append(name,2);
+    // HALF, not linear and 1:1 sampling
+    put(channels,static_cast<int32_t>(1));
+    put(channels,static_cast<int32_t>(0));
+    put(channels,static_cast<int32_t>(1));
+    put(channels,static_cast<int32_t>(1));
+  }
+  channels.push_back('\0');
+  putAttribute(header,"channels","chlist",channels);
+  putAttribute(header,"compression","compression",std::string(1,'\0'));
+  std::string window;
+  put(window,static_cast<int32_t>(0));
+  put(window,static_cast<int32_t>(0));
+  put(window,static_cast<int32_t>(width-1));
+  put(window,static_cast<int32_t>(height-1));
+  putAttribute(header,"dataWindow","box2i",window);
+  putAttribute(header,"displayWindow","box2i",window);
+  putAttribute(header,"lineOrder","lineOrder",std::string(1,'\0'));
+  std::string value;
+  put(value,1.0f);
+  putAttribute(header,"pixelAspectRatio","float",value);
+  putAttribute(header,"screenWindowWidth","float",value);
+  value.clear();
+  put(value,0.0f);
+  put(value,0.0f);
+  putAttribute(header,"screenWindowCenter","v2f",value);
+  header.push_back('\0');
+
+  std::ofstream out(_fname,std::ios::binary | std::ios::trunc);
+  if(!out.is_open())
+  {
+    return false;
+  }
+  // the offset table points at each scanline, all the same size
+  const int32_t lineBytes=width*3*static_cast<int32_t>(sizeof(uint16_t));
+  uint64_t offset=header.size()+static_cast<uint64_t>(height)*sizeof(uint64_t);
+  std::string table;
+  for(int y=0; y<height; ++y)
+  {
+    put(table,offset);
+    offset+=2*sizeof(int32_t)+lineBytes;
+  }
+  out.write(header.data(),static_cast<std::streamsize>(header.size()));
+  out.write(table.data(),static_cast<std::streamsize>(table.size()));
+  static const std::array<uint16_t,256> half=buildHalfTable();
+  std::vector<uint16_t> line(static_cast<size_t>(width)*3+4);
+  for(int y=0; y<height; ++y)
+  {
+    // EXR is top down
+    const unsigned char *row=&_frame.m_pixels[static_cast<size_t>(height-1-y)*width*4];
+    int32_t prefix[2]={y,lineBytes};
+    std::memcpy(line.data(),prefix,sizeof(prefix));
+    uint16_t *b=line.data()+4;
+    uint16_t *g=b+width;
+    uint16_t *r=g+width;
+    for(int x=0; x<width; ++x)
+    {
+      r[x]=half[row[x*4]];
+      g[x]=half[row[x*4+1]];
+      b[x]=half[row[x*4+2]];
+    }
+    out.write(reinterpret_cast<const char *>(line.data()),static_cast<std::streamsize>(sizeof(prefix)+lineBytes));
+  }
+  return out.good();
+}
+
+bool FrameWriter::writeY4m(const Frame &_frame)
+{
+  const int width=_frame.m_width & ~1;
+  const int height=_frame.m_height & ~1;
+  if(m_streamWidth == 0)
+  {
+    // 4:2:0 needs an even size, an odd row or column is dropped
+    m_streamWidth=width;
+    m_streamHeight=height;
+    m_stream<<"YUV4MPEG2 W"<<width<<" H"<<height<<" F"<<m_fps<<":1 Ip A1:1 C420jpeg\n";
+  }
+  else if(width != m_streamWidth || height != m_streamHeight)
+  {
+    // a stream can't change size
+    return false;
+  }
+  const size_t lumaSize=static_cast<size_t>(width)*height;
+  const size_t chromaSize=lumaSize/4;
+  m_yuv.resize(lumaSize+2*chromaSize);
+  unsigned char *luma=m_yuv.data();
+  unsigned char *u=luma+lumaSize;
+  unsigned char *v=u+chromaSize;
+  const size_t stride=static_cast<size_t>(_frame.m_width)*4;
+  // BT.601 studio range, the chroma of each 2x2 block from its average
+  for(int y=0; y<height; y+=2)
+  {
+    const unsigned char *rows[2]={&_frame.m_pixels[(_frame.m_height-1-y)*stride],
+                                  &_frame.m_pixels[(_frame.m_height-2-y)*stride]};
+    for(int x=0; x<width; x+=2)
+    {
+      int sum[3]={0,0,0};
+      for(int j=0; j<2; ++j)
+      {
+        for(int i=0; i<2; ++i)
+        {
+          const unsigned char *p=rows[j]+(x+i)*4;
+          luma[(y+j)*width+x+i]=static_cast<unsigned char>(((66*p[0]+129*p[1]+25*p[2]+128)>>8)+16);
+          sum[0]+=p[0];
+          sum[1]+=p[1];
+          sum[2]+=p[2];
+        }
+      }
+      size_t c=static_cast<size_t>(y/2)*(width/2)+x/2;
+      u[c]=static_cast<unsigned char>(((-38*sum[0]-74*sum[1]+112*sum[2]+512)>>10)+128);
+      v[c]=static_cast<unsigned char>(((112*sum[0]-94*sum[1]-18*sum[2]+512)>>10)+128);
+    }
+  }
+  m_stream<<"FRAME\n";
+  m_stream.write(reinterpret_cast<const char *>(m_yuv.data()),static_cast<std::streamsize>(m_yuv.size()));
+  return m_stream.good();
+}
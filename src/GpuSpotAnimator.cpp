@@ -0,0 +1,116 @@
+#include "GpuSpotAnimator.h"
+#include <ngl/Vec4.h>
+#include <algorithm>
+#include <cmath>
+#include "LightStd140.h"
+#include "SpotCurve.h"
+
+constexpr GLuint GpuSpotAnimator::GROUPSIZE;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the shader storage bindings of the parameters and the lights
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static GLuint SPOTSBINDING=0;
+constexpr static GLuint LIGHTSBINDING=1;
+
+GpuSpotAnimator::~GpuSpotAnimator()
+{
+  glDeleteBuffers(1,&m_spotsBuffer);
+}
+
+void GpuSpotAnimator::create(GLuint _program, GLuint _unit, float _timeStep)
+{
+  m_program=_program;
+  m_timeStep=_timeStep;
+  if(m_program == 0)
+  {
+    return;
+  }
+  m_phaseLocation=glGetUniformLocation(m_program,"phase");
+  m_rotationLocation=glGetUniformLocation(m_program,"lightRotation");
+  m_countLocation=glGetUniformLocation(m_program,"numSpots");
+  glGenBuffers(1,&m_spotsBuffer);
+  m_lights.create(GL_RGBA32F,_unit);
+}
+
+void GpuSpotAnimator::setSpots(const SpotState &_state, const LightBlock &_lights, double _ticks, FrameStats &_stats)
+{
+  if(m_program == 0)
+  {
+    return;
+  }
+  SpotCurve::pack(_state,m_params);
+  size_t paramBytes=m_params.size()*sizeof(SpotParamsStd430);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,m_spotsBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,static_cast<GLsizeiptr>(std::max<size_t>(sizeof(SpotParamsStd430),paramBytes)),
+               nullptr,GL_STATIC_DRAW);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER,0,static_cast<GLsizeiptr>(paramBytes),m_params.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,0);
+  // the position, specular, inner cone and attenuation never animate so they are sent once with the rest
+  size_t lightBytes=_lights.size()*sizeof(LightStd140);
+  m_lights.reserve(lightBytes);
+  m_lights.update(0,lightBytes,_lights.data(),_stats);
+  _stats.addUpload(paramBytes);
+  m_baseTicks=_ticks;
+  m_stale=true;
+}
+
+void GpuSpotAnimator::update(double _ticks, const ngl::Mat4 &_lightTransform, FrameStats &_stats)
+{
+  if(m_program == 0 || m_params.empty() || (!m_stale && _ticks == m_ticks))
+  {
+    return;
+  }
+  m_stale=false;
+  m_ticks=_ticks;
+  float phase[2];
+  SpotCurve::phase(_ticks,m_baseTicks,m_timeStep,phase[0],phase[1]);
+  // the columns of the rotation are the transformed axes, the same product the CPU path uses
+  float rotation[9];
+  for(int c=0; c<3; ++c)
+  {
+    ngl::Vec4 axis=_lightTransform*ngl::Vec4(c == 0 ? 1.0f : 0.0f,c == 1 ? 1.0f : 0.0f,c == 2 ? 1.0f : 0.0f,0.0f);
+    rotation[c*3]=axis.m_x;
+    rotation[c*3+1]=axis.m_y;
+    rotation[c*3+2]=axis.m_z;
+  }
+  glUseProgram(m_program);
+  glUniform2fv(m_phaseLocation,1,phase);
+  glUniformMatrix3fv(m_rotationLocation,1,GL_FALSE,rotation);
+  glUniform1ui(m_countLocation,static_cast<GLuint>(m_params.size()));
+  _stats.addUpload(sizeof(phase)+sizeof(rotation)+sizeof(GLuint));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,SPOTSBINDING,m_spotsBuffer);
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER,LIGHTSBINDING,m_lights.bufferID(),0,
+                    static_cast<GLsizeiptr>(m_params.size()*sizeof(LightStd140)));
+  glDispatchCompute(static_cast<GLuint>((m_params.size()+GROUPSIZE-1)/GROUPSIZE),1,1);
+  // the lights are read through the buffer texture by the lighting shaders
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+float GpuSpotAnimator::verify(const ngl::Mat4 &_lightTransform) const
+{
+  if(m_program == 0 || m_params.empty() || m_ticks < 0.0)
+  {
+    return 0.0f;
+  }
+  std::vector<LightStd140> lights(m_params.size());
+  // reading the buffer waits for the dispatch
+  glBindBuffer(GL_COPY_READ_BUFFER,m_lights.bufferID());
+  glGetBufferSubData(GL_COPY_READ_BUFFER,0,static_cast<GLsizeiptr>(lights.size()*sizeof(LightStd140)),lights.data());
+  glBindBuffer(GL_COPY_READ_BUFFER,0);
+  float angle;
+  float mix;
+  SpotCurve::phase(m_ticks,m_baseTicks,m_timeStep,angle,mix);
+  float maxError=0.0f;
+  for(size_t i=0; i<lights.size(); ++i)
+  {
+    SpotCurve::Sample s=SpotCurve::evaluate(m_params[i],angle,mix);
+    ngl::Vec4 dir=_lightTransform*ngl::Vec4(s.m_dir[0],s.m_dir[1],s.m_dir[2],0.0f);
+    const LightStd140 &l=lights[i];
+    maxError=std::max({maxError,std::fabs(l.m_direction[0]-dir.m_x),std::fabs(l.m_direction[1]-dir.m_y),
+                       std::fabs(l.m_direction[2]-dir.m_z),std::fabs(l.m_diffuse[0]-s.m_colour[0]),
+                       std::fabs(l.m_diffuse[1]-s.m_colour[1]),std::fabs(l.m_diffuse[2]-s.m_colour[2]),
+                       std::fabs(l.m_range-s.m_range)/s.m_range});
+  }
+  return maxError;
+}
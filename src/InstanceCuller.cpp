@@ -0,0 +1,416 @@
+#include "InstanceCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+static_assert(sizeof(BoundingSphere) == 4*sizeof(float),"the bounds are read by the cull shader as vec4");
+static_assert(sizeof(StaticMesh::DrawCommand) == 5*sizeof(GLuint),"indirect commands must be tightly packed");
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the shader storage binding points of the cull shader
+//----------------------------------------------------------------------------------------------------------------------
+enum CullBinding : GLuint {BOUNDSBINDING=0, LEVELSBINDING=1, COMMANDSBINDING=2, INSTANCESBINDING=3, ORDERBINDING=4};
+
+bool InstanceCuller::gpuSupported()
+{
+  GLint major=0;
+  GLint minor=0;
+  glGetIntegerv(GL_MAJOR_VERSION,&major);
+  glGetIntegerv(GL_MINOR_VERSION,&minor);
+  return major > 4 || (major == 4 && minor >= 3);
+}
+
+void InstanceCuller::frustumPlanes(const ngl::Mat4 &_clip, float o_planes[6][4])
+{
+  // m_m is column major, each plane is the w row plus or minus the x, y or z row
+  for(int axis=0; axis<3; ++axis)
+  {
+    for(int side=0; side<2; ++side)
+    {
+      float *p=o_planes[2*axis+side];
+      float sign= side ? -1.0f : 1.0f;
+      for(int c=0; c<4; ++c)
+      {
+        p[c]=_clip.m_m[c][3]+sign*_clip.m_m[c][axis];
+      }
+      float length=std::sqrt(p[0]*p[0]+p[1]*p[1]+p[2]*p[2]);
+      float inv= length > 0.0f ? 1.0f/length : 0.0f;
+      for(int c=0; c<4; ++c)
+      {
+        p[c]*=inv;
+      }
+    }
+  }
+}
+
+bool InstanceCuller::isVisible(const float _planes[6][4], const BoundingSphere &_bound)
+{
+  const float *c=_bound.m_centre;
+  for(int i=0; i<6; ++i)
+  {
+    const float *p=_planes[i];
+    if(p[0]*c[0]+p[1]*c[1]+p[2]*c[2]+p[3] < -_bound.m_radius)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool InstanceCuller::onPlane(const BoundingSphere &_bound) const
+{
+  const float *c=_bound.m_centre;
+  float scale=std::fabs(c[0])+std::fabs(c[1])+std::fabs(c[2])+_bound.m_radius;
+  for(int i=0; i<6; ++i)
+  {
+    const float *p=m_planes[i];
+    if(std::fabs(p[0]*c[0]+p[1]*c[1]+p[2]*c[2]+p[3]+_bound.m_radius) <= 1e-5f*(scale+std::fabs(p[3])))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+InstanceCuller::~InstanceCuller()
+{
+  glDeleteSync(m_fence);
+  glDeleteBuffers(1,&m_orderBuffer);
+  glDeleteBuffers(1,&m_readbackBuffer);
+  glDeleteBuffers(1,&m_commandBuffer);
+  glDeleteBuffers(1,&m_levelsBuffer);
+  glDeleteBuffers(1,&m_boundsBuffer);
+  glDeleteBuffers(1,&m_listBuffer);
+}
+
+void InstanceCuller::create(const StaticMesh &_mesh, GLuint _program, DynamicBuffer &_ring)
+{
+  m_mesh=&_mesh;
+  m_ring=&_ring;
+  m_program=_program;
+  glGenBuffers(1,&m_listBuffer);
+  m_commands.clear();
+  for(size_t pass=0; pass<PASSES; ++pass)
+  {
+    for(size_t level=0; level<LEVELS; ++level)
+    {
+      m_commands.push_back(_mesh.command(level,0,0));
+    }
+  }
+  if(m_program == 0)
+  {
+    return;
+  }
+  m_planesLocation=glGetUniformLocation(m_program,"planes");
+  m_countLocation=glGetUniformLocation(m_program,"numInstances");
+  m_sortedLocation=glGetUniformLocation(m_program,"sorted");
+  glGenBuffers(1,&m_boundsBuffer);
+  glGenBuffers(1,&m_levelsBuffer);
+  glGenBuffers(1,&m_commandBuffer);
+  glGenBuffers(1,&m_readbackBuffer);
+  glGenBuffers(1,&m_orderBuffer);
+  size_t commandBytes=m_commands.size()*sizeof(StaticMesh::DrawCommand);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER,m_commandBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER,static_cast<GLsizeiptr>(commandBytes),m_commands.data(),GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER,0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,m_readbackBuffer);
+  glBufferData(GL_COPY_WRITE_BUFFER,static_cast<GLsizeiptr>(commandBytes),nullptr,GL_STREAM_READ);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+}
+
+void InstanceCuller::setInstances(const BoundingSphere *_bounds, size_t _count, FrameStats &_stats)
+{
+  m_bounds.assign(_bounds,_bounds+_count);
+  m_levelsStale=true;
+  // room for every instance in every list so nothing can overflow whatever the GPU appends
+  size_t lists= m_program ? PASSES*LEVELS : 1;
+  glBindBuffer(GL_ARRAY_BUFFER,m_listBuffer);
+  glBufferData(GL_ARRAY_BUFFER,static_cast<GLsizeiptr>(std::max<size_t>(1,lists*_count)*sizeof(uint32_t)),nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+  for(size_t pass=0; pass<PASSES; ++pass)
+  {
+    for(size_t level=0; level<LEVELS; ++level)
+    {
+      m_count[pass][level]=0;
+      m_first[pass][level]=0;
+    }
+  }
+  if(m_program == 0)
+  {
+    return;
+  }
+  for(size_t i=0; i<m_commands.size(); ++i)
+  {
+    m_commands[i].m_baseInstance=static_cast<GLuint>(i*_count);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,m_boundsBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,static_cast<GLsizeiptr>(std::max<size_t>(1,_count)*sizeof(BoundingSphere)),
+               nullptr,GL_STATIC_DRAW);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER,0,static_cast<GLsizeiptr>(_count*sizeof(BoundingSphere)),_bounds);
+  // a byte per level, padded to whole words
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,m_levelsBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,static_cast<GLsizeiptr>(std::max<size_t>(4,(_count+3)&~size_t(3))),nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,m_orderBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,static_cast<GLsizeiptr>(std::max<size_t>(1,_count)*sizeof(uint32_t)),nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,0);
+  _stats.addUpload(_count*sizeof(BoundingSphere));
+}
+
+void InstanceCuller::prepare(const LodSelector &_lod, const ngl::Mat4 &_clip, const std::vector<uint32_t> &_frontToBack)
+{
+  frustumPlanes(_clip,m_planes);
+  m_lod=&_lod;
+  m_frontToBack=&_frontToBack;
+  size_t numInstances=m_bounds.size();
+  if(numInstances == 0)
+  {
+    return;
+  }
+  bool sorted=_frontToBack.size() == numInstances;
+  m_levelsChanged=m_levelsStale || _lod.orderChanged();
+  m_levelsStale=false;
+  if(m_program != 0)
+  {
+    return;
+  }
+  const std::vector<uint32_t> &order=_lod.order();
+  m_visible.clear();
+  if(sorted)
+  {
+    // test front to back then a stable counting sort by level keeps each level's list nearest first
+    m_sorted.clear();
+    size_t next[LEVELS]={};
+    for(uint32_t i : _frontToBack)
+    {
+      if(isVisible(m_planes,m_bounds[i]))
+      {
+        m_sorted.push_back(i);
+        ++next[_lod.level(i)];
+      }
+    }
+    size_t first=0;
+    for(size_t level=0; level<LEVELS; ++level)
+    {
+      m_first[SHADOW][level]=_lod.first(level);
+      m_count[SHADOW][level]=_lod.count(level);
+      m_first[CAMERA][level]=first;
+      m_count[CAMERA][level]=next[level];
+      next[level]=first;
+      first+=m_count[CAMERA][level];
+    }
+    m_visible.resize(m_sorted.size());
+    for(uint32_t i : m_sorted)
+    {
+      m_visible[next[_lod.level(i)]++]=i;
+    }
+    return;
+  }
+  for(size_t level=0; level<LEVELS; ++level)
+  {
+    m_first[SHADOW][level]=_lod.first(level);
+    m_count[SHADOW][level]=_lod.count(level);
+    m_first[CAMERA][level]=m_visible.size();
+    const uint32_t *begin=order.data()+_lod.first(level);
+    for(const uint32_t *i=begin; i<begin+_lod.count(level); ++i)
+    {
+      if(isVisible(m_planes,m_bounds[*i]))
+      {
+        m_visible.push_back(*i);
+      }
+    }
+    m_count[CAMERA][level]=m_visible.size()-m_first[CAMERA][level];
+  }
+}
+
+void InstanceCuller::submit(FrameStats &_stats)
+{
+  size_t numInstances=m_bounds.size();
+  if(numInstances == 0 || m_lod == nullptr)
+  {
+    return;
+  }
+  if(m_program == 0)
+  {
+    // every instance casts a shadow so the shadow list is the selector's own, only sent when it changes
+    if(m_levelsChanged)
+    {
+      const std::vector<uint32_t> &order=m_lod->order();
+      glBindBuffer(GL_ARRAY_BUFFER,m_listBuffer);
+      glBufferSubData(GL_ARRAY_BUFFER,0,static_cast<GLsizeiptr>(order.size()*sizeof(uint32_t)),order.data());
+      glBindBuffer(GL_ARRAY_BUFFER,0);
+      _stats.addUpload(order.size()*sizeof(uint32_t));
+    }
+    return;
+  }
+  bool sorted=m_frontToBack->size() == numInstances;
+  if(m_levelsChanged)
+  {
+    const std::vector<uint8_t> &levels=m_lod->levels();
+    copyFromRing(m_levelsBuffer,levels.data(),levels.size(),_stats);
+  }
+  // the counts start from 0 each cull, the rest of every command is fixed
+  size_t commandBytes=m_commands.size()*sizeof(StaticMesh::DrawCommand);
+  copyFromRing(m_commandBuffer,m_commands.data(),commandBytes,_stats);
+  if(sorted)
+  {
+    copyFromRing(m_orderBuffer,m_frontToBack->data(),numInstances*sizeof(uint32_t),_stats);
+  }
+  glUseProgram(m_program);
+  glUniform4fv(m_planesLocation,6,&m_planes[0][0]);
+  glUniform1ui(m_countLocation,static_cast<GLuint>(numInstances));
+  glUniform1i(m_sortedLocation,sorted ? 1 : 0);
+  _stats.addUpload(sizeof(m_planes));
+  _stats.addUpload(sizeof(GLuint));
+  _stats.addUpload(sizeof(GLint));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,BOUNDSBINDING,m_boundsBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,LEVELSBINDING,m_levelsBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,COMMANDSBINDING,m_commandBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,INSTANCESBINDING,m_listBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,ORDERBINDING,m_orderBuffer);
+  glDispatchCompute(static_cast<GLuint>((numInstances+GROUPSIZE-1)/GROUPSIZE),1,1);
+  // the commands are read by the indirect draws and the copy, the lists by the instance attribute
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+  glBindBuffer(GL_COPY_READ_BUFFER,m_commandBuffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,m_readbackBuffer);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,0,0,static_cast<GLsizeiptr>(commandBytes));
+  glBindBuffer(GL_COPY_READ_BUFFER,0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+  // an older cull's counts are never wanted once a newer one is on its way
+  glDeleteSync(m_fence);
+  m_fence=glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+}
+
+void InstanceCuller::copyFromRing(GLuint _buffer, const void *_data, size_t _bytes, FrameStats &_stats)
+{
+  // the last frame's cull and draws may still be reading _buffer, the copy is queued behind them on the GPU
+  // where writing it from here could have the driver wait for them or copy it aside
+  DynamicBuffer::Allocation staged=m_ring->allocate(_bytes,sizeof(GLuint),_stats);
+  std::memcpy(staged.m_data,_data,_bytes);
+  m_ring->flush(_stats);
+  glBindBuffer(GL_COPY_READ_BUFFER,m_ring->bufferID());
+  glBindBuffer(GL_COPY_WRITE_BUFFER,_buffer);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,static_cast<GLintptr>(staged.m_offset),0,
+                      static_cast<GLsizeiptr>(_bytes));
+  glBindBuffer(GL_COPY_READ_BUFFER,0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+}
+
+void InstanceCuller::readCounts()
+{
+  if(m_fence == nullptr)
+  {
+    return;
+  }
+  GLenum status=glClientWaitSync(m_fence,0,0);
+  if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+  {
+    return;
+  }
+  glDeleteSync(m_fence);
+  m_fence=nullptr;
+  std::vector<StaticMesh::DrawCommand> commands(m_commands.size());
+  glBindBuffer(GL_COPY_READ_BUFFER,m_readbackBuffer);
+  glGetBufferSubData(GL_COPY_READ_BUFFER,0,static_cast<GLsizeiptr>(commands.size()*sizeof(StaticMesh::DrawCommand)),
+                     commands.data());
+  glBindBuffer(GL_COPY_READ_BUFFER,0);
+  for(size_t i=0; i<commands.size(); ++i)
+  {
+    m_count[i/LEVELS][i%LEVELS]=commands[i].m_instanceCount;
+  }
+}
+
+void InstanceCuller::draw(Pass _pass, FrameStats &_stats)
+{
+  if(m_bounds.empty())
+  {
+    return;
+  }
+  if(m_program)
+  {
+    readCounts();
+    m_mesh->drawIndirect(m_commandBuffer,_pass*LEVELS,LEVELS,m_listBuffer);
+  }
+  else
+  {
+    GLuint list=m_listBuffer;
+    size_t first=0;
+    if(_pass == CAMERA)
+    {
+      // the visible list changes with the view so it goes in the frame's region rather than a buffer the
+      // last frame may still be drawing from
+      size_t bytes=std::max<size_t>(1,m_visible.size())*sizeof(uint32_t);
+      DynamicBuffer::Allocation visible=m_ring->allocate(bytes,sizeof(uint32_t),_stats);
+      std::memcpy(visible.m_data,m_visible.data(),m_visible.size()*sizeof(uint32_t));
+      m_ring->flush(_stats);
+      list=m_ring->bufferID();
+      first=visible.m_offset/sizeof(uint32_t);
+    }
+    for(size_t level=0; level<LEVELS; ++level)
+    {
+      m_mesh->drawInstanced(level,list,first+m_first[_pass][level],m_count[_pass][level]);
+    }
+  }
+  for(size_t level=0; level<LEVELS; ++level)
+  {
+    _stats.addTriangles(m_count[_pass][level]*m_mesh->numTriangles(level));
+  }
+}
+
+size_t InstanceCuller::count(Pass _pass) const
+{
+  size_t total=0;
+  for(size_t level=0; level<LEVELS; ++level)
+  {
+    total+=m_count[_pass][level];
+  }
+  return total;
+}
+
+size_t InstanceCuller::verify(const LodSelector &_lod)
+{
+  if(m_program == 0 || m_bounds.empty())
+  {
+    return 0;
+  }
+  size_t numInstances=m_bounds.size();
+  std::vector<StaticMesh::DrawCommand> commands(m_commands.size());
+  std::vector<uint32_t> lists(commands.size()*numInstances);
+  // reading the buffers waits for the cull
+  glBindBuffer(GL_COPY_READ_BUFFER,m_commandBuffer);
+  glGetBufferSubData(GL_COPY_READ_BUFFER,0,static_cast<GLsizeiptr>(commands.size()*sizeof(StaticMesh::DrawCommand)),
+                     commands.data());
+  glBindBuffer(GL_COPY_READ_BUFFER,m_listBuffer);
+  glGetBufferSubData(GL_COPY_READ_BUFFER,0,static_cast<GLsizeiptr>(lists.size()*sizeof(uint32_t)),lists.data());
+  glBindBuffer(GL_COPY_READ_BUFFER,0);
+  size_t mismatches=0;
+  for(size_t i=0; i<commands.size(); ++i)
+  {
+    size_t pass=i/LEVELS;
+    size_t level=i%LEVELS;
+    m_count[pass][level]=commands[i].m_instanceCount;
+    // the GPU appends in whatever order the invocations ran
+    const uint32_t *begin=lists.data()+commands[i].m_baseInstance;
+    std::vector<uint32_t> gpu(begin,begin+std::min<size_t>(commands[i].m_instanceCount,numInstances));
+    std::sort(gpu.begin(),gpu.end());
+    std::vector<uint32_t> cpu;
+    for(uint32_t j=0; j<numInstances; ++j)
+    {
+      if(_lod.level(j) == level && (pass == SHADOW || isVisible(m_planes,m_bounds[j])))
+      {
+        cpu.push_back(j);
+      }
+    }
+    std::vector<uint32_t> difference;
+    std::set_symmetric_difference(gpu.begin(),gpu.end(),cpu.begin(),cpu.end(),std::back_inserter(difference));
+    for(uint32_t j : difference)
+    {
+      // spheres touching a plane can round either way on the GPU
+      mismatches+= onPlane(m_bounds[j]) ? 0 : 1;
+    }
+  }
+  return mismatches;
+}
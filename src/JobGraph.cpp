@@ -0,0 +1,77 @@
+#include "JobGraph.h"
+
+size_t JobGraph::add(const char *_name, Func _func)
+{
+  Node node;
+  node.m_name=_name;
+  node.m_func=std::move(_func);
+  m_nodes.push_back(std::move(node));
+  return m_nodes.size()-1;
+}
+
+void JobGraph::depend(size_t _node, size_t _on)
+{
+  // dependencies only point back so the graph can't have a cycle
+  if(_on >= _node || _node >= m_nodes.size())
+  {
+    return;
+  }
+  m_nodes[_on].m_next.push_back(_node);
+  ++m_nodes[_node].m_dependencies;
+}
+
+void JobGraph::clear()
+{
+  m_nodes.clear();
+}
+
+void JobGraph::run(JobSystem &_jobs)
+{
+  if(m_nodes.empty())
+  {
+    return;
+  }
+  if(m_waitingSize != m_nodes.size())
+  {
+    m_waiting.reset(new std::atomic<size_t>[m_nodes.size()]);
+    m_waitingSize=m_nodes.size();
+  }
+  for(size_t i=0; i<m_nodes.size(); ++i)
+  {
+    m_waiting[i].store(m_nodes[i].m_dependencies,std::memory_order_relaxed);
+    m_nodes[i].m_didWork=false;
+  }
+  m_jobs=&_jobs;
+  m_remaining.store(m_nodes.size(),std::memory_order_relaxed);
+  for(size_t i=0; i<m_nodes.size(); ++i)
+  {
+    if(m_nodes[i].m_dependencies == 0)
+    {
+      queue(i);
+    }
+  }
+  _jobs.wait(m_remaining);
+}
+
+void JobGraph::queue(size_t _node)
+{
+  m_jobs->push({&JobGraph::runNode,this,_node,_node+1,1,&m_remaining});
+}
+
+void JobGraph::runNode(void *_graph, size_t _begin, size_t)
+{
+  JobGraph &graph=*static_cast<JobGraph *>(_graph);
+  Node &node=graph.m_nodes[_begin];
+  node.m_thread=JobSystem::currentThread();
+  node.m_begin=Clock::now();
+  node.m_didWork=node.m_func();
+  node.m_end=Clock::now();
+  // the nodes waiting on this one are queued before it counts as done so run can't return first
+  for(size_t next : node.m_next)
+  {
+    if(graph.m_waiting[next].fetch_sub(1,std::memory_order_acq_rel) == 1)
+    {
+      graph.queue(next);
+    }
+  }
+}
@@ -0,0 +1,181 @@
+#include "JobSystem.h"
+
+constexpr size_t JobSystem::QUEUESIZE;
+constexpr unsigned JobSystem::SPINS;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the index of the thread running, set once by each worker
+//----------------------------------------------------------------------------------------------------------------------
+static thread_local size_t t_thread=0;
+
+JobSystem::~JobSystem()
+{
+  stop();
+}
+
+size_t JobSystem::currentThread()
+{
+  return t_thread;
+}
+
+void JobSystem::start(size_t _threads)
+{
+  stop();
+  if(_threads == 0)
+  {
+    _threads=std::max(1u,std::thread::hardware_concurrency());
+  }
+  for(size_t i=0; i<_threads; ++i)
+  {
+    m_queues.emplace_back(new Queue);
+  }
+  m_running=true;
+  for(size_t i=1; i<_threads; ++i)
+  {
+    m_workers.emplace_back(&JobSystem::run,this,i);
+  }
+}
+
+void JobSystem::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_running=false;
+  }
+  m_wake.notify_all();
+  for(auto &worker : m_workers)
+  {
+    worker.join();
+  }
+  m_workers.clear();
+  m_queues.clear();
+}
+
+void JobSystem::push(const Job &_job)
+{
+  if(m_queues.empty())
+  {
+    execute(_job);
+    return;
+  }
+  // a thread that isn't one of ours shares the deque of the thread that called start
+  size_t thread=currentThread() < m_queues.size() ? currentThread() : 0;
+  Queue &queue=*m_queues[thread];
+  bool queued=false;
+  {
+    std::lock_guard<std::mutex> lock(queue.m_mutex);
+    if(queue.m_back-queue.m_front < QUEUESIZE)
+    {
+      queue.m_jobs[queue.m_back++%QUEUESIZE]=_job;
+      m_queued.fetch_add(1);
+      queued=true;
+    }
+  }
+  // the deque is full so nobody would get to it soon anyway
+  if(!queued)
+  {
+    execute(_job);
+    return;
+  }
+  // seen with m_queued by a worker about to sleep, one or the other sees the change
+  if(m_sleeping.load() != 0)
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_wake.notify_one();
+  }
+}
+
+void JobSystem::execute(Job _job)
+{
+  // the upper half goes where a thief can find it, the lower half is split again here
+  while(_job.m_end-_job.m_begin > _job.m_grain)
+  {
+    Job upper=_job;
+    upper.m_begin=_job.m_begin+(_job.m_end-_job.m_begin)/2;
+    _job.m_end=upper.m_begin;
+    _job.m_pending->fetch_add(1,std::memory_order_relaxed);
+    push(upper);
+  }
+  _job.m_func(_job.m_context,_job.m_begin,_job.m_end);
+  m_jobsRun.fetch_add(1,std::memory_order_relaxed);
+  _job.m_pending->fetch_sub(1,std::memory_order_release);
+}
+
+bool JobSystem::pop(size_t _thread, Job &o_job)
+{
+  Queue &queue=*m_queues[_thread];
+  std::lock_guard<std::mutex> lock(queue.m_mutex);
+  if(queue.m_back == queue.m_front)
+  {
+    return false;
+  }
+  o_job=queue.m_jobs[--queue.m_back%QUEUESIZE];
+  m_queued.fetch_sub(1);
+  return true;
+}
+
+bool JobSystem::steal(size_t _thread, Job &o_job)
+{
+  size_t threads=m_queues.size();
+  for(size_t i=1; i<threads; ++i)
+  {
+    Queue &queue=*m_queues[(_thread+i)%threads];
+    std::lock_guard<std::mutex> lock(queue.m_mutex);
+    if(queue.m_back != queue.m_front)
+    {
+      o_job=queue.m_jobs[queue.m_front++%QUEUESIZE];
+      m_queued.fetch_sub(1);
+      m_steals.fetch_add(1,std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::wait(const std::atomic<size_t> &_pending)
+{
+  if(m_queues.empty())
+  {
+    return;
+  }
+  size_t thread=currentThread() < m_queues.size() ? currentThread() : 0;
+  while(_pending.load(std::memory_order_acquire) != 0)
+  {
+    Job job;
+    if(pop(thread,job) || steal(thread,job))
+    {
+      execute(job);
+    }
+    else
+    {
+      // what is left is running on other threads
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::run(size_t _thread)
+{
+  t_thread=_thread;
+  unsigned idle=0;
+  while(m_running.load(std::memory_order_acquire))
+  {
+    Job job;
+    if(pop(_thread,job) || steal(_thread,job))
+    {
+      execute(job);
+      idle=0;
+      continue;
+    }
+    if(++idle < SPINS)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    ++m_sleeping;
+    m_wake.wait(lock,[this](){return !m_running || m_queued.load() != 0;});
+    --m_sleeping;
+    idle=0;
+  }
+}
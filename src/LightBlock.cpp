@@ -0,0 +1,143 @@
+#include "LightBlock.h"
+#include <ngl/Util.h>
+#include <cmath>
+#include <cstring>
+
+void LightBlock::create(size_t _count, GLuint _unit)
+{
+  LightStd140 defaultLight;
+  std::memset(&defaultLight,0,sizeof(LightStd140));
+  defaultLight.m_position[3]=1.0f;
+  defaultLight.m_direction[1]=-1.0f;
+  defaultLight.m_constantAttenuation=1.0f;
+  defaultLight.m_range=std::numeric_limits<float>::max();
+  m_lights.assign(_count,defaultLight);
+  if(m_buffer.bufferID()==0)
+  {
+    m_buffer.create(GL_RGBA32F,_unit);
+  }
+  m_buffer.reserve(m_lights.size()*sizeof(LightStd140));
+  markAllDirty();
+}
+
+bool LightBlock::upload(DynamicBuffer &_ring, FrameStats &_stats)
+{
+  if(!hasChanges())
+  {
+    return false;
+  }
+  // one write covering the range of lights that changed
+  size_t offset=m_dirtyBegin*sizeof(LightStd140);
+  size_t bytes=(m_dirtyEnd-m_dirtyBegin)*sizeof(LightStd140);
+  if(_ring.isPersistent())
+  {
+    // written straight into the mapped ring and copied across on the GPU, where a glBufferSubData into a
+    // buffer the last frame may still be reading could have the driver wait or copy it aside
+    DynamicBuffer::Allocation staged=_ring.allocate(bytes,sizeof(GLuint),_stats);
+    std::memcpy(staged.m_data,&m_lights[m_dirtyBegin],bytes);
+    m_buffer.copy(_ring.bufferID(),staged.m_offset,offset,bytes);
+  }
+  else
+  {
+    m_buffer.update(offset,bytes,&m_lights[m_dirtyBegin],_stats);
+  }
+  m_dirtyBegin=std::numeric_limits<size_t>::max();
+  m_dirtyEnd=0;
+  return true;
+}
+
+bool LightBlock::takeChanges()
+{
+  bool changed=hasChanges();
+  m_dirtyBegin=std::numeric_limits<size_t>::max();
+  m_dirtyEnd=0;
+  return changed;
+}
+
+void LightBlock::markAllDirty()
+{
+  m_dirtyBegin=0;
+  m_dirtyEnd=m_lights.size();
+}
+
+void LightBlock::setPosition(size_t _i, const ngl::Vec4 &_pos)
+{
+  float *p=m_lights[_i].m_position;
+  p[0]=_pos.m_x;
+  p[1]=_pos.m_y;
+  p[2]=_pos.m_z;
+  p[3]=1.0f;
+  markDirty(_i);
+}
+
+void LightBlock::setDirection(size_t _i, const ngl::Vec4 &_dir)
+{
+  float *d=m_lights[_i].m_direction;
+  d[0]=_dir.m_x;
+  d[1]=_dir.m_y;
+  d[2]=_dir.m_z;
+  d[3]=0.0f;
+  markDirty(_i);
+}
+
+void LightBlock::setColour(size_t _i, const ngl::Colour &_colour)
+{
+  float *a=m_lights[_i].m_ambient;
+  float *d=m_lights[_i].m_diffuse;
+  a[0]=d[0]=_colour.m_r;
+  a[1]=d[1]=_colour.m_g;
+  a[2]=d[2]=_colour.m_b;
+  a[3]=d[3]=_colour.m_a;
+  markDirty(_i);
+}
+
+void LightBlock::setSpecColour(size_t _i, const ngl::Colour &_colour)
+{
+  float *s=m_lights[_i].m_specular;
+  s[0]=_colour.m_r;
+  s[1]=_colour.m_g;
+  s[2]=_colour.m_b;
+  s[3]=_colour.m_a;
+  markDirty(_i);
+}
+
+void LightBlock::setCutoff(size_t _i, float _degrees)
+{
+  m_lights[_i].m_spotCosCutoff=cosf(ngl::radians(_degrees));
+  markDirty(_i);
+}
+
+void LightBlock::setInnerCutoff(size_t _i, float _degrees)
+{
+  m_lights[_i].m_spotCosInnerCutoff=cosf(ngl::radians(_degrees));
+  markDirty(_i);
+}
+
+void LightBlock::setExponent(size_t _i, float _exponent)
+{
+  m_lights[_i].m_spotExponent=_exponent;
+  markDirty(_i);
+}
+
+void LightBlock::setAttenuation(size_t _i, float _constant, float _linear, float _quadratic)
+{
+  m_lights[_i].m_constantAttenuation=_constant;
+  m_lights[_i].m_linearAttenuation=_linear;
+  m_lights[_i].m_quadraticAttenuation=_quadratic;
+  markDirty(_i);
+}
+
+void LightBlock::setRange(size_t _i, float _range)
+{
+  m_lights[_i].m_range=_range;
+  markDirty(_i);
+}
+
+void LightBlock::set(size_t _i, const LightStd140 &_light)
+{
+  if(std::memcmp(&m_lights[_i],&_light,sizeof(LightStd140)) != 0)
+  {
+    m_lights[_i]=_light;
+    markDirty(_i);
+  }
+}
@@ -0,0 +1,127 @@
+#include "LightCuller.h"
+#include <algorithm>
+#include "JobSystem.h"
+
+constexpr uint32_t LightCuller::USECLUSTERS;
+constexpr size_t LightCuller::OBJECTGRAIN;
+
+LightCuller::LightCuller(size_t _maxLights) :
+  m_maxLights(_maxLights)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief cheap sphere / sphere rejection run before the cone test
+//----------------------------------------------------------------------------------------------------------------------
+static inline bool spheresOverlap(const BoundingSphere &_a, const BoundingSphere &_b)
+{
+  float d[3]={_a.m_centre[0]-_b.m_centre[0],_a.m_centre[1]-_b.m_centre[1],_a.m_centre[2]-_b.m_centre[2]};
+  float r=_a.m_radius+_b.m_radius;
+  return d[0]*d[0]+d[1]*d[1]+d[2]*d[2] <= r*r;
+}
+
+bool LightCuller::reaches(const LightStd140 &_light, const BoundingSphere &_object)
+{
+  SpotCone cone=spotConeFromLight(_light);
+  return spheresOverlap(coneBoundingSphere(cone),_object) && coneIntersectsSphere(cone,_object);
+}
+
+uint32_t LightCuller::lightsReaching(const BoundingSphere &_object, uint32_t *o_lights) const
+{
+  uint32_t count=0;
+  for(size_t i=0; i<m_cones.size(); ++i)
+  {
+    if(spheresOverlap(m_coneBounds[i],_object) && coneIntersectsSphere(m_cones[i],_object))
+    {
+      if(count == m_maxLights)
+      {
+        return count+1;
+      }
+      o_lights[count++]=static_cast<uint32_t>(i);
+    }
+  }
+  return count;
+}
+
+void LightCuller::cull(const LightStd140 *_lights, size_t _numLights, const BoundingSphere *_objects, size_t _numObjects)
+{
+  m_cones.resize(_numLights);
+  m_coneBounds.resize(_numLights);
+  for(size_t i=0; i<_numLights; ++i)
+  {
+    m_cones[i]=spotConeFromLight(_lights[i]);
+    m_coneBounds[i]=coneBoundingSphere(m_cones[i]);
+  }
+  m_cells.resize(_numObjects*2);
+  m_indices.clear();
+  m_unlit=0;
+  m_overflowed=0;
+  bool parallel=m_jobs != nullptr && m_jobs->numThreads() > 1 && _numObjects > OBJECTGRAIN;
+  if(parallel)
+  {
+    // every object gets a slot of its own so the tests can run in any order on any thread
+    m_slots.resize(_numObjects*m_maxLights);
+    m_counts.resize(_numObjects);
+    m_jobs->parallelFor(0,_numObjects,OBJECTGRAIN,[&](size_t _begin, size_t _end)
+    {
+      for(size_t o=_begin; o<_end; ++o)
+      {
+        m_counts[o]=lightsReaching(_objects[o],m_slots.data()+o*m_maxLights);
+      }
+    });
+  }
+  else
+  {
+    m_slots.resize(m_maxLights);
+  }
+  for(size_t o=0; o<_numObjects; ++o)
+  {
+    const uint32_t *lights=m_slots.data();
+    uint32_t count;
+    if(parallel)
+    {
+      lights+=o*m_maxLights;
+      count=m_counts[o];
+    }
+    else
+    {
+      count=lightsReaching(_objects[o],m_slots.data());
+    }
+    uint32_t offset=static_cast<uint32_t>(m_indices.size());
+    if(count > m_maxLights)
+    {
+      // too many to be worth a list of its own, the clusters already bound the per fragment cost
+      count=USECLUSTERS;
+      ++m_overflowed;
+    }
+    else if(count == 0)
+    {
+      ++m_unlit;
+    }
+    else
+    {
+      m_indices.insert(m_indices.end(),lights,lights+count);
+    }
+    m_cells[o*2]=offset;
+    m_cells[o*2+1]=count;
+  }
+}
+
+void LightCuller::reset(size_t _numObjects)
+{
+  m_cells.resize(_numObjects*2);
+  for(size_t o=0; o<_numObjects; ++o)
+  {
+    m_cells[o*2]=0;
+    m_cells[o*2+1]=USECLUSTERS;
+  }
+  m_indices.clear();
+  m_unlit=0;
+  m_overflowed=_numObjects;
+}
+
+const uint32_t *LightCuller::lightsForObject(size_t _object, uint32_t &o_count) const
+{
+  o_count=m_cells[_object*2+1];
+  return m_indices.data()+m_cells[_object*2];
+}
@@ -0,0 +1,83 @@
+#include "LodSelector.h"
+#include <algorithm>
+#include <cmath>
+
+float LodSelector::projectedSize(const BoundingSphere &_eyeBound, float _pixelScale)
+{
+  // the distance rather than the depth so turning the view doesn't change the level of anything
+  const float *c=_eyeBound.m_centre;
+  float distance=std::sqrt(c[0]*c[0]+c[1]*c[1]+c[2]*c[2]);
+  // anything around the eye is as big as it gets
+  return 2.0f*_eyeBound.m_radius*_pixelScale/std::max(distance,_eyeBound.m_radius);
+}
+
+void LodSelector::setSwitchSizes(const float _sizes[LEVELS-1])
+{
+  std::copy(_sizes,_sizes+LEVELS-1,m_switchSizes);
+  // every object is placed again from scratch
+  m_levels.clear();
+}
+
+size_t LodSelector::chooseLevel(size_t _current, float _size) const
+{
+  if(_current >= LEVELS)
+  {
+    size_t level=0;
+    while(level < LEVELS-1 && _size < m_switchSizes[level])
+    {
+      ++level;
+    }
+    return level;
+  }
+  size_t level=_current;
+  while(level > 0 && _size > m_switchSizes[level-1]*(1.0f+HYSTERESIS))
+  {
+    --level;
+  }
+  while(level < LEVELS-1 && _size < m_switchSizes[level]*(1.0f-HYSTERESIS))
+  {
+    ++level;
+  }
+  return level;
+}
+
+void LodSelector::select(const BoundingSphere *_eyeBounds, size_t _count, float _pixelScale)
+{
+  bool changed=m_levels.size() != _count;
+  if(changed)
+  {
+    m_levels.assign(_count,static_cast<uint8_t>(LEVELS));
+  }
+  for(size_t i=0; i<_count; ++i)
+  {
+    size_t level= m_enabled ? chooseLevel(m_levels[i],projectedSize(_eyeBounds[i],_pixelScale)) : 0;
+    if(level != m_levels[i])
+    {
+      m_levels[i]=static_cast<uint8_t>(level);
+      changed=true;
+    }
+  }
+  m_orderChanged=changed;
+  if(!changed)
+  {
+    return;
+  }
+  // counting sort by level, each level keeps the objects in index order
+  std::fill(m_count,m_count+LEVELS,0);
+  for(uint8_t level : m_levels)
+  {
+    ++m_count[level];
+  }
+  m_first[0]=0;
+  for(size_t l=1; l<LEVELS; ++l)
+  {
+    m_first[l]=m_first[l-1]+m_count[l-1];
+  }
+  size_t next[LEVELS];
+  std::copy(m_first,m_first+LEVELS,next);
+  m_order.resize(_count);
+  for(size_t i=0; i<_count; ++i)
+  {
+    m_order[next[m_levels[i]]++]=static_cast<uint32_t>(i);
+  }
+}
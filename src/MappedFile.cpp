@@ -0,0 +1,66 @@
+#include "MappedFile.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+bool MappedFile::open(const std::string &_fname)
+{
+  close();
+  int fd=::open(_fname.c_str(),O_RDONLY);
+  if(fd < 0)
+  {
+    return false;
+  }
+  struct stat info;
+  if(fstat(fd,&info) != 0 || info.st_size <= 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  void *data=mmap(nullptr,static_cast<size_t>(info.st_size),PROT_READ,MAP_PRIVATE,fd,0);
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+  if(data == MAP_FAILED)
+  {
+    return false;
+  }
+  // we read front to back so let the kernel read ahead
+  madvise(data,static_cast<size_t>(info.st_size),MADV_SEQUENTIAL);
+  m_data=static_cast<const unsigned char *>(data);
+  m_size=static_cast<size_t>(info.st_size);
+  return true;
+}
+
+void MappedFile::close()
+{
+  if(m_data)
+  {
+    munmap(const_cast<unsigned char *>(m_data),m_size);
+    m_data=nullptr;
+    m_size=0;
+  }
+}
+
+void MappedFile::release(size_t _offset, size_t _bytes) const
+{
+  if(!m_data || _offset >= m_size)
+  {
+    return;
+  }
+  // the mapping is read only so the pages are clean and can simply be thrown away
+  size_t page=static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t begin=(_offset+page-1)/page*page;
+  size_t end=std::min(m_size-_offset,_bytes)+_offset;
+  end=end/page*page;
+  if(end > begin)
+  {
+    madvise(const_cast<unsigned char *>(m_data)+begin,end-begin,MADV_DONTNEED);
+  }
+}
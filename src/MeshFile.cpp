@@ -0,0 +1,184 @@
+#include "MeshFile.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "Fnv1a.h"
+
+uint64_t MeshFile::planeKey(float _width, float _depth, int _wSteps, int _dSteps)
+{
+  // the parameters and the format version
+  const float dims[2]={_width,_depth};
+  const int32_t steps[3]={_wSteps,_dSteps,static_cast<int32_t>(VERSION)};
+  unsigned char bytes[sizeof(dims)+sizeof(steps)];
+  memcpy(bytes,dims,sizeof(dims));
+  memcpy(bytes+sizeof(dims),steps,sizeof(steps));
+  return fnv1a(bytes,sizeof(bytes));
+}
+
+std::string MeshFile::cachePath(const std::string &_dir, const std::string &_name, uint64_t _key)
+{
+  char key[17];
+  snprintf(key,sizeof(key),"%016llx",static_cast<unsigned long long>(_key));
+  return _dir+"/"+_name+"-"+key+".mesh";
+}
+
+bool MeshFile::writePlane(const std::string &_fname, float _width, float _depth, int _wSteps, int _dSteps)
+{
+  if(_wSteps < 1 || _dSteps < 1)
+  {
+    return false;
+  }
+  uint32_t columns=static_cast<uint32_t>(_wSteps)+1;
+  uint32_t rows=static_cast<uint32_t>(_dSteps)+1;
+  MeshHeader header;
+  header.m_magic=MAGIC;
+  header.m_version=VERSION;
+  header.m_vertexCount=columns*rows;
+  header.m_indexCount=static_cast<uint32_t>(_wSteps)*static_cast<uint32_t>(_dSteps)*6;
+  header.m_indexSize=header.m_vertexCount <= 65536 ? 2 : 4;
+  header.m_stride=VERTEXFLOATS*sizeof(float);
+  header.m_key=planeKey(_width,_depth,_wSteps,_dSteps);
+
+  // write to a temporary and rename so a crash never leaves a half written cache behind
+  std::string tmp=_fname+".tmp";
+  std::ofstream out(tmp,std::ios::binary | std::ios::trunc);
+  if(!out.is_open())
+  {
+    return false;
+  }
+  out.write(reinterpret_cast<const char *>(&header),sizeof(header));
+  // one row at a time so memory use doesn't grow with the mesh
+  std::vector<float> row(columns*VERTEXFLOATS);
+  for(uint32_t z=0; z<rows; ++z)
+  {
+    float v=static_cast<float>(z)/_dSteps;
+    float *vert=&row[0];
+    for(uint32_t x=0; x<columns; ++x)
+    {
+      float u=static_cast<float>(x)/_wSteps;
+      *vert++=(u-0.5f)*_width;
+      *vert++=0.0f;
+      *vert++=(v-0.5f)*_depth;
+      *vert++=0.0f;
+      *vert++=1.0f;
+      *vert++=0.0f;
+      *vert++=u;
+      *vert++=v;
+    }
+    out.write(reinterpret_cast<const char *>(&row[0]),static_cast<std::streamsize>(row.size()*sizeof(float)));
+  }
+  std::vector<uint32_t> quads(static_cast<size_t>(_wSteps)*6);
+  std::vector<uint16_t> shortQuads(quads.size());
+  for(uint32_t z=0; z<rows-1; ++z)
+  {
+    uint32_t *index=&quads[0];
+    for(uint32_t x=0; x<columns-1; ++x)
+    {
+      uint32_t i=z*columns+x;
+      // both triangles wind anticlockwise seen from +y
+      *index++=i;
+      *index++=i+columns;
+      *index++=i+1;
+      *index++=i+1;
+      *index++=i+columns;
+      *index++=i+columns+1;
+    }
+    if(header.m_indexSize == 2)
+    {
+      for(size_t i=0; i<quads.size(); ++i)
+      {
+        shortQuads[i]=static_cast<uint16_t>(quads[i]);
+      }
+      out.write(reinterpret_cast<const char *>(&shortQuads[0]),static_cast<std::streamsize>(shortQuads.size()*2));
+    }
+    else
+    {
+      out.write(reinterpret_cast<const char *>(&quads[0]),static_cast<std::streamsize>(quads.size()*4));
+    }
+  }
+  out.close();
+  if(!out)
+  {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return std::rename(tmp.c_str(),_fname.c_str()) == 0;
+}
+
+bool MeshFile::write(const std::string &_fname, uint64_t _key, const std::vector<float> &_vertices,
+                     const std::vector<uint32_t> &_indices)
+{
+  MeshHeader header;
+  header.m_magic=MAGIC;
+  header.m_version=VERSION;
+  header.m_vertexCount=static_cast<uint32_t>(_vertices.size()/VERTEXFLOATS);
+  header.m_indexCount=static_cast<uint32_t>(_indices.size());
+  header.m_indexSize=header.m_vertexCount <= 65536 ? 2 : 4;
+  header.m_stride=VERTEXFLOATS*sizeof(float);
+  header.m_key=_key;
+  std::string tmp=_fname+".tmp";
+  std::ofstream out(tmp,std::ios::binary | std::ios::trunc);
+  if(!out.is_open())
+  {
+    return false;
+  }
+  out.write(reinterpret_cast<const char *>(&header),sizeof(header));
+  out.write(reinterpret_cast<const char *>(_vertices.data()),
+            static_cast<std::streamsize>(size_t(header.m_vertexCount)*header.m_stride));
+  if(header.m_indexSize == 2)
+  {
+    std::vector<uint16_t> shortIndices(_indices.begin(),_indices.end());
+    out.write(reinterpret_cast<const char *>(shortIndices.data()),static_cast<std::streamsize>(shortIndices.size()*2));
+  }
+  else
+  {
+    out.write(reinterpret_cast<const char *>(_indices.data()),static_cast<std::streamsize>(_indices.size()*4));
+  }
+  out.close();
+  if(!out)
+  {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return std::rename(tmp.c_str(),_fname.c_str()) == 0;
+}
+
+bool MeshFile::open(const std::string &_fname, uint64_t _key)
+{
+  if(!m_file.open(_fname) || m_file.size() < sizeof(MeshHeader))
+  {
+    m_file.close();
+    return false;
+  }
+  const MeshHeader &h=header();
+  bool valid=h.m_magic == MAGIC && h.m_version == VERSION && h.m_key == _key &&
+             (h.m_indexSize == 2 || h.m_indexSize == 4) &&
+             m_file.size() == sizeof(MeshHeader)+vertexBytes()+indexBytes();
+  if(!valid)
+  {
+    m_file.close();
+  }
+  return valid;
+}
+
+bool MeshFile::read(std::vector<float> &o_vertices, std::vector<uint32_t> &o_indices) const
+{
+  if(!isOpen() || header().m_stride != VERTEXFLOATS*sizeof(float))
+  {
+    return false;
+  }
+  const float *vertices=reinterpret_cast<const float *>(this->vertices());
+  o_vertices.assign(vertices,vertices+size_t(header().m_vertexCount)*VERTEXFLOATS);
+  // the indices are always widened, the mesh they are loaded into picks its own size
+  if(header().m_indexSize == 2)
+  {
+    const uint16_t *indices=reinterpret_cast<const uint16_t *>(this->indices());
+    o_indices.assign(indices,indices+header().m_indexCount);
+  }
+  else
+  {
+    const uint32_t *indices=reinterpret_cast<const uint32_t *>(this->indices());
+    o_indices.assign(indices,indices+header().m_indexCount);
+  }
+  return true;
+}
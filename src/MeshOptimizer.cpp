@@ -0,0 +1,268 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+constexpr size_t MeshOptimizer::CACHESIZE;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief floats per vertex of the MeshFile layout, position, normal and uv
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static size_t VERTEXFLOATS=8;
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &io_indices, size_t _vertexCount, size_t _cacheSize)
+{
+  const std::vector<uint32_t> &indices=io_indices;
+  size_t triangles=indices.size()/3;
+  if(triangles == 0)
+  {
+    return;
+  }
+  // the triangles around each vertex
+  std::vector<uint32_t> offsets(_vertexCount+1,0);
+  for(uint32_t v : indices)
+  {
+    ++offsets[v+1];
+  }
+  for(size_t v=0; v<_vertexCount; ++v)
+  {
+    offsets[v+1]+=offsets[v];
+  }
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> fill(offsets.begin(),offsets.end()-1);
+  for(size_t i=0; i<indices.size(); ++i)
+  {
+    adjacency[fill[indices[i]]++]=static_cast<uint32_t>(i/3);
+  }
+  std::vector<uint32_t> live(_vertexCount);
+  for(size_t v=0; v<_vertexCount; ++v)
+  {
+    live[v]=offsets[v+1]-offsets[v];
+  }
+  // when each vertex last entered the cache, anything stamped more than _cacheSize ago has been pushed out
+  std::vector<size_t> stamp(_vertexCount,0);
+  size_t time=_cacheSize+1;
+  std::vector<bool> emitted(triangles,false);
+  std::vector<uint32_t> deadEnds;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> out;
+  out.reserve(indices.size());
+  size_t cursor=0;
+  const uint32_t NONE=std::numeric_limits<uint32_t>::max();
+  uint32_t fan=indices[0];
+  while(fan != NONE)
+  {
+    // emit every triangle left around the fanning vertex
+    candidates.clear();
+    for(uint32_t a=offsets[fan]; a<offsets[fan+1]; ++a)
+    {
+      uint32_t t=adjacency[a];
+      if(emitted[t])
+      {
+        continue;
+      }
+      emitted[t]=true;
+      for(size_t c=0; c<3; ++c)
+      {
+        uint32_t v=indices[t*3+c];
+        out.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+        if(time-stamp[v] > _cacheSize)
+        {
+          stamp[v]=time++;
+        }
+      }
+    }
+    // fan next around the oldest vertex of this fan that will still be in the cache once its own triangles are
+    // done, any vertex with triangles left if none will
+    fan=NONE;
+    size_t best=0;
+    for(uint32_t v : candidates)
+    {
+      if(live[v] == 0)
+      {
+        continue;
+      }
+      size_t priority= time-stamp[v]+2*live[v] <= _cacheSize ? time-stamp[v] : 0;
+      if(fan == NONE || priority > best)
+      {
+        best=priority;
+        fan=v;
+      }
+    }
+    // a dead end, go back to the most recent vertex with triangles left and after that the next in order
+    while(fan == NONE && !deadEnds.empty())
+    {
+      uint32_t v=deadEnds.back();
+      deadEnds.pop_back();
+      if(live[v] > 0)
+      {
+        fan=v;
+      }
+    }
+    while(fan == NONE && cursor < _vertexCount)
+    {
+      if(live[cursor] > 0)
+      {
+        fan=static_cast<uint32_t>(cursor);
+      }
+      ++cursor;
+    }
+  }
+  io_indices.swap(out);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<float> &io_vertices, std::vector<uint32_t> &io_indices)
+{
+  size_t vertexCount=io_vertices.size()/VERTEXFLOATS;
+  const uint32_t NONE=std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> remap(vertexCount,NONE);
+  uint32_t next=0;
+  for(uint32_t &index : io_indices)
+  {
+    if(remap[index] == NONE)
+    {
+      remap[index]=next++;
+    }
+    index=remap[index];
+  }
+  std::vector<float> vertices(static_cast<size_t>(next)*VERTEXFLOATS);
+  for(size_t v=0; v<vertexCount; ++v)
+  {
+    if(remap[v] != NONE)
+    {
+      std::copy_n(&io_vertices[v*VERTEXFLOATS],VERTEXFLOATS,&vertices[remap[v]*VERTEXFLOATS]);
+    }
+  }
+  io_vertices.swap(vertices);
+}
+
+float MeshOptimizer::acmr(const std::vector<uint32_t> &_indices, size_t _vertexCount, size_t _cacheSize)
+{
+  if(_indices.size() < 3)
+  {
+    return 0.0f;
+  }
+  // a FIFO holds a vertex until _cacheSize misses after its own
+  std::vector<size_t> entered(_vertexCount,0);
+  size_t misses=0;
+  for(uint32_t v : _indices)
+  {
+    if(entered[v] == 0 || misses+1-entered[v] >= _cacheSize)
+    {
+      ++misses;
+      entered[v]=misses;
+    }
+  }
+  return static_cast<float>(misses)/(_indices.size()/3);
+}
+
+void MeshOptimizer::pack(const std::vector<float> &_vertices, std::vector<PackedVertex> &o_vertices)
+{
+  size_t count=_vertices.size()/VERTEXFLOATS;
+  o_vertices.resize(count);
+  for(size_t i=0; i<count; ++i)
+  {
+    const float *v=&_vertices[i*VERTEXFLOATS];
+    PackedVertex &p=o_vertices[i];
+    for(int c=0; c<3; ++c)
+    {
+      p.m_position[c]=toHalf(v[c]);
+    }
+    p.m_position[3]=toHalf(1.0f);
+    octEncode(v+3,p.m_normal);
+  }
+}
+
+uint16_t MeshOptimizer::toHalf(float _value)
+{
+  uint32_t bits;
+  std::memcpy(&bits,&_value,sizeof(bits));
+  uint32_t sign=(bits>>16)&0x8000;
+  uint32_t biased=(bits>>23)&0xff;
+  uint32_t mantissa=bits&0x7fffff;
+  if(biased == 0xff)
+  {
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  }
+  int exponent=static_cast<int>(biased)-127+15;
+  if(exponent >= 31)
+  {
+    return static_cast<uint16_t>(sign | 0x7c00);
+  }
+  // round to nearest even, a carry out of the mantissa moves up the exponent as it should
+  uint32_t shift=13;
+  uint32_t half;
+  if(exponent <= 0)
+  {
+    if(exponent < -10)
+    {
+      return static_cast<uint16_t>(sign);
+    }
+    mantissa|=0x800000;
+    shift=static_cast<uint32_t>(14-exponent);
+    half=mantissa>>shift;
+  }
+  else
+  {
+    half=(static_cast<uint32_t>(exponent)<<10) | (mantissa>>shift);
+  }
+  uint32_t rest=mantissa&((1u<<shift)-1);
+  uint32_t middle=1u<<(shift-1);
+  if(rest > middle || (rest == middle && (half&1)))
+  {
+    ++half;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+float MeshOptimizer::fromHalf(uint16_t _half)
+{
+  uint32_t sign=static_cast<uint32_t>(_half&0x8000)<<16;
+  uint32_t exponent=(_half>>10)&0x1f;
+  uint32_t mantissa=_half&0x3ff;
+  if(exponent == 0)
+  {
+    float value=std::ldexp(static_cast<float>(mantissa),-24);
+    return sign ? -value : value;
+  }
+  uint32_t bits= exponent == 31 ? sign | 0x7f800000 | (mantissa<<13) : sign | ((exponent+112)<<23) | (mantissa<<13);
+  float value;
+  std::memcpy(&value,&bits,sizeof(value));
+  return value;
+}
+
+void MeshOptimizer::octEncode(const float _n[3], int16_t o_e[2])
+{
+  // project onto the octahedron then fold the lower half over the upper
+  float l1=std::fabs(_n[0])+std::fabs(_n[1])+std::fabs(_n[2]);
+  float x= l1 > 0.0f ? _n[0]/l1 : 0.0f;
+  float y= l1 > 0.0f ? _n[1]/l1 : 0.0f;
+  if(_n[2] < 0.0f)
+  {
+    float fx=(1.0f-std::fabs(y))*(x >= 0.0f ? 1.0f : -1.0f);
+    float fy=(1.0f-std::fabs(x))*(y >= 0.0f ? 1.0f : -1.0f);
+    x=fx;
+    y=fy;
+  }
+  o_e[0]=static_cast<int16_t>(std::lround(std::min(std::max(x,-1.0f),1.0f)*32767.0f));
+  o_e[1]=static_cast<int16_t>(std::lround(std::min(std::max(y,-1.0f),1.0f)*32767.0f));
+}
+
+void MeshOptimizer::octDecode(const int16_t _e[2], float o_n[3])
+{
+  // as snorm attributes are read, -32768 clamps to -1
+  float x=std::max(_e[0]/32767.0f,-1.0f);
+  float y=std::max(_e[1]/32767.0f,-1.0f);
+  float z=1.0f-std::fabs(x)-std::fabs(y);
+  float t=std::max(-z,0.0f);
+  x+= x >= 0.0f ? -t : t;
+  y+= y >= 0.0f ? -t : t;
+  float length=std::sqrt(x*x+y*y+z*z);
+  o_n[0]=x/length;
+  o_n[1]=y/length;
+  o_n[2]=z/length;
+}
@@ -0,0 +1,396 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief weight of the planes along open edges against the triangle planes, large enough that borders are
+/// only collapsed once the interior can't be
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static double BOUNDARYWEIGHT=100.0;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief cosine of the most a triangle may turn in one collapse, anything more is treated as a fold
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static double FLIPCOS=0.2;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief welding tolerance, positions within 1e-4 and normals within 1e-2 are the same
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static float WELDPOSITION=1.0e4f;
+constexpr static float WELDNORMAL=1.0e2f;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the unnormalised normal of a triangle, its length is twice the area
+//----------------------------------------------------------------------------------------------------------------------
+static void triangleNormal(const float *_a, const float *_b, const float *_c, double o_n[3])
+{
+  double e1[3]={double(_b[0])-_a[0],double(_b[1])-_a[1],double(_b[2])-_a[2]};
+  double e2[3]={double(_c[0])-_a[0],double(_c[1])-_a[1],double(_c[2])-_a[2]};
+  o_n[0]=e1[1]*e2[2]-e1[2]*e2[1];
+  o_n[1]=e1[2]*e2[0]-e1[0]*e2[2];
+  o_n[2]=e1[0]*e2[1]-e1[1]*e2[0];
+}
+
+static double length(const double _v[3])
+{
+  return std::sqrt(_v[0]*_v[0]+_v[1]*_v[1]+_v[2]*_v[2]);
+}
+
+void MeshSimplifier::Quadric::addPlane(double _a, double _b, double _c, double _d, double _weight)
+{
+  m_q[0]+=_weight*_a*_a; m_q[1]+=_weight*_a*_b; m_q[2]+=_weight*_a*_c; m_q[3]+=_weight*_a*_d;
+  m_q[4]+=_weight*_b*_b; m_q[5]+=_weight*_b*_c; m_q[6]+=_weight*_b*_d;
+  m_q[7]+=_weight*_c*_c; m_q[8]+=_weight*_c*_d;
+  m_q[9]+=_weight*_d*_d;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric &_q)
+{
+  for(int i=0; i<10; ++i)
+  {
+    m_q[i]+=_q.m_q[i];
+  }
+}
+
+double MeshSimplifier::Quadric::error(const float *_p) const
+{
+  double x=_p[0];
+  double y=_p[1];
+  double z=_p[2];
+  double e=m_q[0]*x*x + 2.0*m_q[1]*x*y + 2.0*m_q[2]*x*z + 2.0*m_q[3]*x +
+           m_q[4]*y*y + 2.0*m_q[5]*y*z + 2.0*m_q[6]*y +
+           m_q[7]*z*z + 2.0*m_q[8]*z +
+           m_q[9];
+  // rounding can take a zero error just below
+  return std::max(e,0.0);
+}
+
+void MeshSimplifier::weld(const float *_vertices, size_t _count, std::vector<float> &o_vertices,
+                          std::vector<uint32_t> &o_indices)
+{
+  o_vertices.clear();
+  o_indices.clear();
+  std::map<std::array<long,6>,uint32_t> ids;
+  std::vector<uint32_t> corners(_count);
+  for(size_t i=0; i<_count; ++i)
+  {
+    const float *v=_vertices+i*VERTEXFLOATS;
+    std::array<long,6> key;
+    for(int k=0; k<3; ++k)
+    {
+      key[k]=std::lround(v[k]*WELDPOSITION);
+      key[3+k]=std::lround(v[3+k]*WELDNORMAL);
+    }
+    auto found=ids.find(key);
+    if(found == ids.end())
+    {
+      found=ids.insert({key,static_cast<uint32_t>(ids.size())}).first;
+      o_vertices.insert(o_vertices.end(),v,v+VERTEXFLOATS);
+    }
+    corners[i]=found->second;
+  }
+  for(size_t i=0; i+2<_count; i+=3)
+  {
+    uint32_t a=corners[i];
+    uint32_t b=corners[i+1];
+    uint32_t c=corners[i+2];
+    if(a != b && b != c && a != c)
+    {
+      o_indices.push_back(a);
+      o_indices.push_back(b);
+      o_indices.push_back(c);
+    }
+  }
+}
+
+void MeshSimplifier::pushEdge(uint32_t _a, uint32_t _b)
+{
+  Quadric q=m_quadrics[_a];
+  q.add(m_quadrics[_b]);
+  const float *a=position(_a);
+  const float *b=position(_b);
+  float length=(a[0]-b[0])*(a[0]-b[0])+(a[1]-b[1])*(a[1]-b[1])+(a[2]-b[2])*(a[2]-b[2]);
+  // a border vertex may only move along the border
+  if(!m_boundary[_a] || m_boundary[_b])
+  {
+    m_heap.push_back({q.error(b),length,_a,_b,m_version[_a],m_version[_b]});
+    std::push_heap(m_heap.begin(),m_heap.end(),std::greater<Collapse>());
+  }
+  if(!m_boundary[_b] || m_boundary[_a])
+  {
+    m_heap.push_back({q.error(a),length,_b,_a,m_version[_b],m_version[_a]});
+    std::push_heap(m_heap.begin(),m_heap.end(),std::greater<Collapse>());
+  }
+}
+
+bool MeshSimplifier::canCollapse(uint32_t _from, uint32_t _to)
+{
+  if(++m_stamp == 0)
+  {
+    std::fill(m_mark.begin(),m_mark.end(),0);
+    m_stamp=1;
+  }
+  size_t edgeTriangles=0;
+  for(uint32_t t : m_vertexTriangles[_from])
+  {
+    if(m_triangleRemoved[t])
+    {
+      continue;
+    }
+    const uint32_t *tri=&m_triangles[size_t(t)*3];
+    for(int k=0; k<3; ++k)
+    {
+      m_mark[tri[k]]=m_stamp;
+    }
+    edgeTriangles+= (tri[0] == _to || tri[1] == _to || tri[2] == _to);
+  }
+  // a border vertex can't be pulled across the surface, nor two borders joined through it
+  if(edgeTriangles == 0 || (m_boundary[_from] && edgeTriangles != 1))
+  {
+    return false;
+  }
+  // the ends may only share the vertices opposite the edge, any other would leave an edge with three triangles
+  m_mark[_from]=0;
+  m_mark[_to]=0;
+  size_t common=0;
+  for(uint32_t t : m_vertexTriangles[_to])
+  {
+    if(m_triangleRemoved[t])
+    {
+      continue;
+    }
+    const uint32_t *tri=&m_triangles[size_t(t)*3];
+    for(int k=0; k<3; ++k)
+    {
+      if(m_mark[tri[k]] == m_stamp)
+      {
+        ++common;
+        m_mark[tri[k]]=0;
+      }
+    }
+  }
+  if(common != edgeTriangles)
+  {
+    return false;
+  }
+  // the triangles that survive must not flip or collapse to a line
+  for(uint32_t t : m_vertexTriangles[_from])
+  {
+    const uint32_t *tri=&m_triangles[size_t(t)*3];
+    if(m_triangleRemoved[t] || tri[0] == _to || tri[1] == _to || tri[2] == _to)
+    {
+      continue;
+    }
+    const float *p[3];
+    const float *moved[3];
+    for(int k=0; k<3; ++k)
+    {
+      p[k]=position(tri[k]);
+      moved[k]= tri[k] == _from ? position(_to) : p[k];
+    }
+    double before[3];
+    double after[3];
+    triangleNormal(p[0],p[1],p[2],before);
+    triangleNormal(moved[0],moved[1],moved[2],after);
+    double lenBefore=length(before);
+    double lenAfter=length(after);
+    if(lenBefore == 0.0)
+    {
+      continue;
+    }
+    if(lenAfter == 0.0 ||
+       before[0]*after[0]+before[1]*after[1]+before[2]*after[2] < FLIPCOS*lenBefore*lenAfter)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t MeshSimplifier::collapse(uint32_t _from, uint32_t _to)
+{
+  std::vector<uint32_t> &toTriangles=m_vertexTriangles[_to];
+  size_t removed=0;
+  for(uint32_t t : m_vertexTriangles[_from])
+  {
+    if(m_triangleRemoved[t])
+    {
+      continue;
+    }
+    uint32_t *tri=&m_triangles[size_t(t)*3];
+    if(tri[0] == _to || tri[1] == _to || tri[2] == _to)
+    {
+      m_triangleRemoved[t]=1;
+      ++removed;
+      continue;
+    }
+    std::replace(tri,tri+3,_from,_to);
+    toTriangles.push_back(t);
+  }
+  m_quadrics[_to].add(m_quadrics[_from]);
+  m_vertexRemoved[_from]=1;
+  std::vector<uint32_t>().swap(m_vertexTriangles[_from]);
+  ++m_version[_to];
+  toTriangles.erase(std::remove_if(toTriangles.begin(),toTriangles.end(),
+                                   [this](uint32_t _t){return m_triangleRemoved[_t] != 0;}),
+                    toTriangles.end());
+  // every edge at _to has a new cost, the queued ones are stale now its version has changed
+  if(++m_stamp == 0)
+  {
+    std::fill(m_mark.begin(),m_mark.end(),0);
+    m_stamp=1;
+  }
+  m_mark[_to]=m_stamp;
+  for(uint32_t t : toTriangles)
+  {
+    const uint32_t *tri=&m_triangles[size_t(t)*3];
+    for(int k=0; k<3; ++k)
+    {
+      if(m_mark[tri[k]] != m_stamp)
+      {
+        m_mark[tri[k]]=m_stamp;
+        pushEdge(_to,tri[k]);
+      }
+    }
+  }
+  return removed;
+}
+
+void MeshSimplifier::simplify(const std::vector<float> &_vertices, const std::vector<uint32_t> &_indices,
+                              size_t _targetTriangles, std::vector<float> &o_vertices,
+                              std::vector<uint32_t> &o_indices)
+{
+  const size_t numVertices=_vertices.size()/VERTEXFLOATS;
+  const size_t numTriangles=_indices.size()/3;
+  m_vertices=&_vertices;
+  m_triangles.assign(_indices.begin(),_indices.begin()+numTriangles*3);
+  m_triangleRemoved.assign(numTriangles,0);
+  m_vertexRemoved.assign(numVertices,0);
+  m_boundary.assign(numVertices,0);
+  m_version.assign(numVertices,0);
+  m_quadrics.assign(numVertices,Quadric());
+  m_vertexTriangles.assign(numVertices,std::vector<uint32_t>());
+  m_mark.assign(numVertices,0);
+  m_stamp=0;
+  m_heap.clear();
+  double maxCost=0.0;
+  // the plane of each triangle, and how many triangles use each edge
+  std::vector<double> normals(numTriangles*3);
+  std::unordered_map<uint64_t,uint32_t> edges;
+  size_t live=numTriangles;
+  for(size_t t=0; t<numTriangles; ++t)
+  {
+    const uint32_t *tri=&m_triangles[t*3];
+    double *n=&normals[t*3];
+    triangleNormal(position(tri[0]),position(tri[1]),position(tri[2]),n);
+    double len=length(n);
+    if(len != 0.0)
+    {
+      n[0]/=len;
+      n[1]/=len;
+      n[2]/=len;
+      const float *p=position(tri[0]);
+      double d=-(n[0]*p[0]+n[1]*p[1]+n[2]*p[2]);
+      for(int k=0; k<3; ++k)
+      {
+        m_quadrics[tri[k]].addPlane(n[0],n[1],n[2],d,1.0);
+      }
+    }
+    for(int k=0; k<3; ++k)
+    {
+      m_vertexTriangles[tri[k]].push_back(static_cast<uint32_t>(t));
+      uint32_t a=std::min(tri[k],tri[(k+1)%3]);
+      uint32_t b=std::max(tri[k],tri[(k+1)%3]);
+      ++edges[uint64_t(a)<<32 | b];
+    }
+  }
+  // open edges get a plane through them at right angles to their triangle
+  for(size_t t=0; t<numTriangles; ++t)
+  {
+    const uint32_t *tri=&m_triangles[t*3];
+    const double *n=&normals[t*3];
+    for(int k=0; k<3; ++k)
+    {
+      uint32_t a=tri[k];
+      uint32_t b=tri[(k+1)%3];
+      if(edges[uint64_t(std::min(a,b))<<32 | std::max(a,b)] == 2)
+      {
+        continue;
+      }
+      m_boundary[a]=1;
+      m_boundary[b]=1;
+      const float *pa=position(a);
+      const float *pb=position(b);
+      double e[3]={double(pb[0])-pa[0],double(pb[1])-pa[1],double(pb[2])-pa[2]};
+      double m[3]={e[1]*n[2]-e[2]*n[1],e[2]*n[0]-e[0]*n[2],e[0]*n[1]-e[1]*n[0]};
+      double len=length(m);
+      if(len == 0.0)
+      {
+        continue;
+      }
+      m[0]/=len;
+      m[1]/=len;
+      m[2]/=len;
+      double d=-(m[0]*pa[0]+m[1]*pa[1]+m[2]*pa[2]);
+      m_quadrics[a].addPlane(m[0],m[1],m[2],d,BOUNDARYWEIGHT);
+      m_quadrics[b].addPlane(m[0],m[1],m[2],d,BOUNDARYWEIGHT);
+    }
+  }
+  for(const auto &edge : edges)
+  {
+    pushEdge(static_cast<uint32_t>(edge.first >> 32),static_cast<uint32_t>(edge.first));
+  }
+  // cheapest first, entries made stale by an earlier collapse are skipped as they come up
+  while(live > _targetTriangles && !m_heap.empty())
+  {
+    std::pop_heap(m_heap.begin(),m_heap.end(),std::greater<Collapse>());
+    Collapse c=m_heap.back();
+    m_heap.pop_back();
+    if(m_vertexRemoved[c.m_from] || m_vertexRemoved[c.m_to] ||
+       m_version[c.m_from] != c.m_fromVersion || m_version[c.m_to] != c.m_toVersion ||
+       !canCollapse(c.m_from,c.m_to))
+    {
+      continue;
+    }
+    live-=collapse(c.m_from,c.m_to);
+    maxCost=std::max(maxCost,c.m_cost);
+  }
+  m_error=static_cast<float>(std::sqrt(maxCost));
+
+  // keep the vertices still used in their original order
+  std::vector<uint32_t> remap(numVertices,0);
+  for(size_t t=0; t<numTriangles; ++t)
+  {
+    if(!m_triangleRemoved[t])
+    {
+      for(int k=0; k<3; ++k)
+      {
+        remap[m_triangles[t*3+k]]=1;
+      }
+    }
+  }
+  o_vertices.clear();
+  uint32_t next=0;
+  for(size_t v=0; v<numVertices; ++v)
+  {
+    if(remap[v])
+    {
+      remap[v]=next++;
+      o_vertices.insert(o_vertices.end(),&_vertices[v*VERTEXFLOATS],&_vertices[v*VERTEXFLOATS]+VERTEXFLOATS);
+    }
+  }
+  o_indices.clear();
+  for(size_t t=0; t<numTriangles; ++t)
+  {
+    if(!m_triangleRemoved[t])
+    {
+      for(int k=0; k<3; ++k)
+      {
+        o_indices.push_back(remap[m_triangles[t*3+k]]);
+      }
+    }
+  }
+  m_vertices=nullptr;
+}
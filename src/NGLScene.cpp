@@ -1,7 +1,13 @@
 #include <QMouseEvent>
 #include <QGuiApplication>
+#include <QFont>
 
 #include "NGLScene.h"
+#include "Fnv1a.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "SpotCurve.h"
+#include "TransformStd140.h"
 #include <ngl/Camera.h>
 #include <ngl/Light.h>
 #include <ngl/Transformation.h>
@@ -10,6 +16,12 @@
 #include <ngl/VAOPrimitives.h>
 #include <ngl/ShaderLib.h>
 #include <ngl/Random.h>
+#include <ngl/AbstractVAO.h>
+#include <ngl/Util.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
 
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -20,6 +32,81 @@ const static float INCREMENT=0.01;
 /// @brief the increment for the wheel zoom
 //----------------------------------------------------------------------------------------------------------------------
 const static float ZOOM=0.1;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the variants of the spotlight shader, the first draws single objects and the second the instanced grid
+//----------------------------------------------------------------------------------------------------------------------
+const static char *SPOTPROGRAMS[]={"Spotlight","SpotlightInstanced"};
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the same variants writing the deferred G-buffer
+//----------------------------------------------------------------------------------------------------------------------
+const static char *GBUFFERPROGRAMS[]={"GBuffer","GBufferInstanced"};
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the same vertex shader with only depth written for the pre-pass
+//----------------------------------------------------------------------------------------------------------------------
+const static char *DEPTHPROGRAMS[]={"DepthPrepass","DepthPrepassInstanced"};
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief size and subdivisions of the ground plane
+//----------------------------------------------------------------------------------------------------------------------
+const static float PLANESIZE=30.0f;
+const static int PLANESTEPS=180;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief radius of a sphere around the teapot origin enclosing the NGL teapot, with a little to spare
+//----------------------------------------------------------------------------------------------------------------------
+const static float TEAPOTRADIUS=1.25f;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief edge of the shadow atlas in texels, room for 16 tiles at the largest size or 1024 at the smallest
+//----------------------------------------------------------------------------------------------------------------------
+const static int SHADOWATLASSIZE=4096;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief instance matrices sent per glBufferSubData when streaming a scene file, 1MB at a time
+//----------------------------------------------------------------------------------------------------------------------
+const static size_t INSTANCECHUNK=16384;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief uniform buffer binding of the Transforms block
+//----------------------------------------------------------------------------------------------------------------------
+const static GLuint TRANSFORMBINDING=0;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief texture unit of the instance matrices, the units below are taken by the lights, lists, G-buffer and shadows
+//----------------------------------------------------------------------------------------------------------------------
+const static GLuint INSTANCEUNIT=11;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the fraction of the full mesh's triangles kept by each level of detail, and the fewest any keeps
+//----------------------------------------------------------------------------------------------------------------------
+const static float LODRATIO[LodSelector::LEVELS]={1.0f,0.4f,0.15f,0.05f};
+const static size_t LODMINTRIANGLES=32;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the projected teapot diameters in pixels at which it drops to the next level
+//----------------------------------------------------------------------------------------------------------------------
+const static float TEAPOTSWITCHSIZES[LodSelector::LEVELS-1]={150.0f,60.0f,24.0f};
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the plane is flat so every level is exact and the shading is per fragment, the coarsest always does
+//----------------------------------------------------------------------------------------------------------------------
+const static float PLANESWITCHSIZES[LodSelector::LEVELS-1]={0.0f,0.0f,0.0f};
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the camera's field of view and clip planes, the clusters are built for the same projection
+//----------------------------------------------------------------------------------------------------------------------
+const static float CAMERAFOV=45.0f;
+const static float CAMERANEAR=0.05f;
+const static float CAMERAFAR=350.0f;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the fewest objects whose bounds or transforms are worth handing to another job thread
+//----------------------------------------------------------------------------------------------------------------------
+const static size_t BOUNDSGRAIN=1024;
+const static size_t TRANSFORMGRAIN=256;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the SpotState arrays the spot columns of a scene file are copied to, in SceneFile::SpotColumn order
+//----------------------------------------------------------------------------------------------------------------------
+static std::vector<float> SpotState::*const SCENESPOTSTATE[]=
+{
+  &SpotState::m_posX,&SpotState::m_posY,&SpotState::m_posZ,
+  &SpotState::m_centreX,&SpotState::m_centreZ,
+  &SpotState::m_radiusX,&SpotState::m_radiusZ,
+  &SpotState::m_startR,&SpotState::m_startG,&SpotState::m_startB,
+  &SpotState::m_endR,&SpotState::m_endG,&SpotState::m_endB,
+  &SpotState::m_timeOffset
+};
+static_assert(sizeof(SCENESPOTSTATE)/sizeof(SCENESPOTSTATE[0]) == SceneFile::TIMEOFFSET+1,
+              "every SpotState column of a scene file needs an array");
 
 NGLScene::NGLScene()
 {
@@ -29,6 +116,60 @@ NGLScene::NGLScene()
   m_spinXFace=0;
   m_spinYFace=0;
   m_animate=true;
+  m_threadedAnimation=true;
+  m_gpuAnimation=false;
+  m_lightsOnGpu=false;
+  m_gpuSpotsStale=true;
+  m_animationTicks=0.0;
+  m_seed=0;
+  m_fixedSeed=false;
+  m_showProfile=false;
+  // the original demo lights only use the constant term
+  m_attenuation.set(1.0f,0.0f,0.0f);
+  // default to the original 8x8 grid of teapots drawn with instancing
+  m_gridX=8;
+  m_gridZ=8;
+  m_numInstances=m_gridX*m_gridZ;
+  m_sceneLoadTime=0.0;
+  m_instanced=true;
+  m_gpuCulling=true;
+  m_packedVertices=false;
+  m_depthPrepass=false;
+  m_jobThreads=0;
+  m_trianglesDrawn=0;
+  m_teapotLod.setSwitchSizes(TEAPOTSWITCHSIZES);
+  m_planeLod.setSwitchSizes(PLANESWITCHSIZES);
+  m_statsFrames=0;
+  m_statsTicks=0;
+  m_statsShadowTiles=0;
+  m_statsRingWaits=0;
+  m_statsRingWaitTime=0.0;
+  m_captureRate=30;
+  m_statsCaptured=0;
+  m_statsCaptureWaits=0;
+  m_firstTransform=0;
+  m_transformsOffset=0;
+  m_renderWidth=0;
+  m_renderHeight=0;
+  // a 60Hz frame for the R key when no budget was given
+  m_frameBudget=1000.0/60.0;
+  m_statsCached=0;
+  m_statsClock=0;
+  m_redrawTimer=0;
+  m_statsTimerID=0;
+  m_dirty=DIRTYALL;
+  m_updatePending=false;
+  m_objectListsDirty=true;
+  m_framesDrawn=0;
+  m_framesCached=0;
+  m_printStats=false;
+  m_numLights=8;
+  m_clustersDirty=true;
+  m_objectCulling=true;
+  m_deferred=false;
+  m_planeTime=0.0;
+  m_firstFrameTime=-1.0;
+  m_startupTimer.start();
 
   setTitle("ngl::SpotLight demo");
 }
@@ -37,14 +178,69 @@ NGLScene::NGLScene()
 NGLScene::~NGLScene()
 {
   std::cout<<"Shutting down NGL, removing VAO's and Shaders\n";
+  m_simulation.stop();
+  makeCurrent();
+}
+
+void NGLScene::setSeed(unsigned int _seed)
+{
+  m_seed=_seed;
+  m_fixedSeed=true;
+}
+
+void NGLScene::setNumLights(int _count)
+{
+  m_numLights=static_cast<size_t>(std::max(1,_count));
+  // once running the lights are rebuilt straight away, the context must be current
+  if(m_lights.size() != 0 && m_lights.size() != m_numLights)
+  {
+    createLights();
+  }
+}
+
+void NGLScene::setLod(bool _lod)
+{
+  m_teapotLod.setEnabled(_lod);
+  m_planeLod.setEnabled(_lod);
+}
+
+void NGLScene::setFrameBudget(double _ms)
+{
+  if(_ms > 0.0)
+  {
+    m_frameBudget=_ms;
+  }
+  m_resolution.setBudget(_ms);
+}
+
+void NGLScene::toggleDynamicResolution()
+{
+  m_resolution.setBudget(m_resolution.isScaling() ? 0.0 : m_frameBudget);
+}
+
+void NGLScene::setGridSize(int _x, int _z)
+{
+  m_gridX=std::max(1,_x);
+  m_gridZ=std::max(1,_z);
 }
 
 
 void NGLScene::resizeGL(int _w , int _h)
 {
-  m_cam.setShape(45.0f,(float)_w/_h,0.05f,350.0f);
+  m_cam.setShape(CAMERAFOV,(float)_w/_h,CAMERANEAR,CAMERAFAR);
   m_width=_w*devicePixelRatio();
   m_height=_h*devicePixelRatio();
+  if(m_text)
+  {
+    m_text->setScreenSize(_w,_h);
+  }
+  // the clusters are built from the projection so must follow any change to it
+  const ngl::Mat4 &project=m_cam.getProjectionMatrix();
+  m_clusters.setProjection(project.m_m[0][0],project.m_m[1][1],CAMERANEAR,CAMERAFAR);
+  m_clustersDirty=true;
+  // Qt paints straight after a resize so there is no need to ask
+  m_dirty|=DIRTYALL;
+  m_frameCache.invalidate();
 }
 
 void NGLScene::initializeGL()
@@ -70,106 +266,1078 @@ void NGLScene::initializeGL()
   // now to load the shader and set the values
   // grab an instance of shader manager
   ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  // we are creating a shader called Spotlight
-  shader->createShaderProgram("Spotlight");
-  // now we are going to create empty shaders for Frag and Vert
-  shader->attachShader("SpotlightVertex",ngl::ShaderType::VERTEX);
-  shader->attachShader("SpotlightFragment",ngl::ShaderType::FRAGMENT);
-  // attach the source
-  shader->loadShaderSource("SpotlightVertex","shaders/SpotlightVert.glsl");
-  shader->loadShaderSource("SpotlightFragment","shaders/SpotlightFrag.glsl");
-  // compile the shaders
-  shader->compileShader("SpotlightVertex");
-  shader->compileShader("SpotlightFragment");
-  // add them to the program
-  shader->attachShaderToProgram("Spotlight","SpotlightVertex");
-  shader->attachShaderToProgram("Spotlight","SpotlightFragment");
-
-  // now we have associated this data we can link the shader
-  shader->linkProgramObject("Spotlight");
-  // and make it active ready to load values
-  (*shader)["Spotlight"]->use();
-  shader->setUniform("Normalize",1.0f);
+  // build a Spotlight variant for single and instanced draws, everything fixed for the run is a
+  // define so it compiles out rather than being branched on per vertex / fragment
+  ShaderCache::Defines defines={{"NORMALIZE","1"},{"ATTENUATION",attenuationModel()}};
+  std::vector<ShaderCache::Variant> variants;
+  std::vector<ShaderCache::Variant> depthVariants;
+  for(size_t i=0; i<2; ++i)
+  {
+    variants.push_back({SPOTPROGRAMS[i],defines});
+    variants.back().m_defines.push_back({"PACKEDNORMALS",m_packedVertices ? "1" : "0"});
+    variants.back().m_defines.push_back({"INSTANCED",i ? "1" : "0"});
+    // the pre-pass positions must match the lit pass exactly so it runs the same vertex shader
+    depthVariants.push_back({DEPTHPROGRAMS[i],variants.back().m_defines});
+    variants.push_back({GBUFFERPROGRAMS[i],variants.back().m_defines});
+    variants.back().m_defines.push_back({"PASS","1"});
+  }
+  m_shaderCache.build("shaders/SpotlightVert.glsl","shaders/SpotlightFrag.glsl",variants);
+  m_shaderCache.build("shaders/SpotlightVert.glsl","shaders/ShadowFrag.glsl",depthVariants);
+  // the deferred light volumes share the lighting code of the forward shader
+  defines.push_back({"PASS","2"});
+  defines.push_back({"COSMAXEDGE",ShaderCache::floatDefine(SpotAnimator::COSMAXEDGE)});
+  m_shaderCache.build("shaders/SpotVolumeVert.glsl","shaders/SpotlightFrag.glsl",{{"SpotVolume",defines}});
+  m_shaderCache.build("shaders/ScreenVert.glsl","shaders/CompositeFrag.glsl",
+                      {{"Composite",{}},{"CompositeHalf",{{"HALFRES","1"}}}});
+  m_shaderCache.build("shaders/ScreenVert.glsl","shaders/UpscaleFrag.glsl",
+                      {{"Upscale",{}},{"UpscaleFxaa",{{"FXAA","1"}}}});
+  m_shaderCache.build("shaders/ShadowVert.glsl","shaders/ShadowFrag.glsl",{{"ShadowDepth",{}}});
   glEnable(GL_DEPTH_TEST); // for removal of hidden surfaces
   // the shader will use the currently active material and light0 so set them
   ngl::Material m(ngl::STDMAT::GOLD);
-  // load our material values to the shader into the structure material (see Vertex shader)
-  m.loadToShader("material");
-  ngl::VAOPrimitives *prim =  ngl::VAOPrimitives::instance();
-  prim->createTrianglePlane("plane",30,30,180,180,ngl::Vec3(0,1,0));
+  for(auto name : SPOTPROGRAMS)
+  {
+    (*shader)[name]->use();
+    // load our material values to the shader into the structure material (see Vertex shader)
+    m.loadToShader("material");
+  }
+  // the G-buffer stores an index into the material table of the light pass
+  for(auto name : GBUFFERPROGRAMS)
+  {
+    (*shader)[name]->use();
+    shader->setUniform("materialID",0);
+  }
+  (*shader)["SpotVolume"]->use();
+  m.loadToShader("materials[0]");
+  m_deferredRenderer.create();
+  m_resolution.create();
+  m_fragmentCounter.create();
+  if(m_resolution.isScaling())
+  {
+    std::cout<<"Scaling the render size between "<<m_resolution.controller().minScale()<<" and 1 to hold "
+             <<m_resolution.controller().budget()<<" ms per frame\n";
+  }
+  if(m_resolution.isFxaa())
+  {
+    std::cout<<"Anti-aliasing with FXAA\n";
+  }
+  // both the forward and light volume passes read the shadow maps
+  m_shadowAtlas.create(SHADOWATLASSIZE);
+  for(auto name : SPOTPROGRAMS)
+  {
+    m_shadowAtlas.bindToProgram(shader->getProgramID(name));
+  }
+  m_shadowAtlas.bindToProgram(shader->getProgramID("SpotVolume"));
+  // the transforms of every draw come from the ring buffer through the one binding
+  for(const char **programs : {SPOTPROGRAMS,GBUFFERPROGRAMS,DEPTHPROGRAMS})
+  {
+    for(size_t i=0; i<2; ++i)
+    {
+      GLuint id=shader->getProgramID(programs[i]);
+      glUniformBlockBinding(id,glGetUniformBlockIndex(id,"Transforms"),TRANSFORMBINDING);
+    }
+  }
+  m_dynamicBuffer.create(DynamicBuffer::persistentSupported());
+  std::cout<<"Streaming the per frame data through a "
+           <<(m_dynamicBuffer.isPersistent() ? "persistent mapped" : "staged")<<" ring buffer\n";
+  // each object's block is bound on its own so they are spaced by the uniform offset alignment
+  m_transformBatch.setStride(DynamicBuffer::alignUp(sizeof(TransformStd140),m_dynamicBuffer.uniformAlignment()));
+  std::cout<<"Computing the transforms with the "<<TransformBatch::kernelName(m_transformBatch.kernel())<<" kernel\n";
+  createPlane();
+  createTeapotLods();
+  // the teapots are culled by a compute shader when the context can run one
+  GLuint cullProgram=0;
+  if(m_gpuCulling && InstanceCuller::gpuSupported() &&
+     m_shaderCache.buildCompute("shaders/CullComp.glsl",
+                                {{"InstanceCull",{{"LEVELS",std::to_string(InstanceCuller::LEVELS)},
+                                                  {"GROUPSIZE",std::to_string(InstanceCuller::GROUPSIZE)}}}}))
+  {
+    cullProgram=shader->getProgramID("InstanceCull");
+  }
+  m_instanceCuller.create(m_teapot,cullProgram,m_dynamicBuffer);
+  std::cout<<"Culling the teapots on the "<<(m_instanceCuller.isGpu() ? "GPU" : "CPU")<<"\n";
+  // as can the spot animation, the G key switches to it so it is built whether it was asked for or not
+  GLuint animateProgram=0;
+  if(InstanceCuller::gpuSupported() &&
+     m_shaderCache.buildCompute("shaders/SpotAnimComp.glsl",
+                                {{"SpotAnimate",{{"GROUPSIZE",std::to_string(GpuSpotAnimator::GROUPSIZE)},
+                                                 {"COSMAXEDGE",ShaderCache::floatDefine(SpotAnimator::COSMAXEDGE)},
+                                                 {"RANGESCALE",ShaderCache::floatDefine(SpotAnimator::RANGESCALE)}}}}))
+  {
+    animateProgram=shader->getProgramID("SpotAnimate");
+  }
+  // the animated lights are read from the unit of the light block
+  m_gpuSpots.create(animateProgram,1,m_simulation.timeStep());
+  // a scene file replaces the grid and sets the light count
+  openScene();
+  // build the instance matrices for the teapot grid
+  createInstances();
+  // a replay sets the light count so is opened before the lights are made
+  if(!m_replayPath.empty())
+  {
+    if(m_player.open(m_replayPath))
+    {
+      m_numLights=m_player.numLights();
+      std::cout<<"Replaying "<<m_player.numTicks()<<" ticks of "<<m_numLights<<" spots from "<<m_replayPath<<"\n";
+    }
+    else
+    {
+      std::cerr<<"unable to replay "<<m_replayPath<<"\n";
+    }
+  }
   // create the lights
   createLights();
-  // start some timers for the lights
-  m_lightChangeTimer=startTimer(30);
-  m_lightParamChangeTimer=startTimer(10);
+  if(!m_recordPath.empty() && !m_recorder.open(m_recordPath,m_lights.size()))
+  {
+    std::cerr<<"unable to record to "<<m_recordPath<<"\n";
+  }
+  if(!m_capturePath.empty())
+  {
+    m_capture.open(m_capturePath,m_captureRate);
+  }
+  m_profiler.initializeGL();
+  m_text.reset(new ngl::Text(QFont("Arial",12)));
+  m_text->setScreenSize(width(),height());
+  m_simulation.setProfiler(&m_profiler);
+  m_jobs.start(static_cast<size_t>(std::max(0,m_jobThreads)));
+  std::cout<<"Running the frame's CPU work on "<<m_jobs.numThreads()<<" thread"<<(m_jobs.numThreads() > 1 ? "s" : "")
+           <<"\n";
+  m_culler.setJobSystem(&m_jobs);
+  createFrameGraph();
+  // the lights animate on their own thread, the timer just keeps the frames coming. A recording needs every
+  // tick drawn as it was simulated so steps on the timer instead, and a replay doesn't animate at all
+  if(m_threadedAnimation && !m_recorder.isOpen() && !m_player.isOpen() && !m_gpuAnimation)
+  {
+    m_simulation.start();
+  }
+  // nothing changes on its own while paused so the redraw timer only runs while animating
+  if(m_animate)
+  {
+    m_redrawTimer=startTimer(16);
+  }
+  if(m_printStats)
+  {
+    m_statsTimerID=startTimer(1000);
+  }
+  m_statsTimer.start();
+  m_statsClock=std::clock();
+}
+
+
+void NGLScene::createPlane()
+{
+  QElapsedTimer timer;
+  timer.start();
+  const float size=PLANESIZE;
+  const int steps=PLANESTEPS;
+  if(!m_meshCacheDir.empty())
+  {
+    uint64_t key=MeshFile::planeKey(size,size,steps,steps);
+    std::string fname=MeshFile::cachePath(m_meshCacheDir,"plane",key);
+    MeshFile mesh;
+    m_planeSource="cache";
+    if(!mesh.open(fname,key))
+    {
+      m_planeSource="generated";
+      if(!MeshFile::writePlane(fname,size,size,steps,steps) || !mesh.open(fname,key))
+      {
+        std::cerr<<"unable to cache the plane mesh in "<<fname<<"\n";
+      }
+    }
+    // the levels are built from the shared vertices of the cached mesh
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    if(mesh.read(vertices,indices))
+    {
+      createLods("plane",key,vertices,indices,m_plane,m_planeCacheStats);
+    }
+  }
+  if(!m_plane.isValid())
+  {
+    m_planeSource="primitives";
+    ngl::VAOPrimitives::instance()->createTrianglePlane("plane",size,size,steps,steps,ngl::Vec3(0,1,0));
+  }
+  m_planeTime=timer.nsecsElapsed()/1.0e6;
+}
+
+void NGLScene::createTeapotLods()
+{
+  // the NGL teapot is a triangle soup of u,v,nx,ny,nz,x,y,z vertices, read it back in the MeshFile layout
+  ngl::AbstractVAO *teapot=ngl::VAOPrimitives::instance()->getVAOFromName("teapot");
+  size_t corners=teapot->numIndices();
+  std::vector<float> soup(corners*MeshFile::VERTEXFLOATS);
+  glBindBuffer(GL_ARRAY_BUFFER,teapot->getBufferID(0));
+  glGetBufferSubData(GL_ARRAY_BUFFER,0,static_cast<GLsizeiptr>(soup.size()*sizeof(float)),soup.data());
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+  uint64_t key=fnv1a(soup.data(),soup.size()*sizeof(float));
+  for(size_t i=0; i<corners; ++i)
+  {
+    float *v=&soup[i*MeshFile::VERTEXFLOATS];
+    const float layout[MeshFile::VERTEXFLOATS]={v[5],v[6],v[7],v[2],v[3],v[4],v[0],v[1]};
+    std::copy(layout,layout+MeshFile::VERTEXFLOATS,v);
+  }
+  std::vector<float> vertices;
+  std::vector<uint32_t> indices;
+  MeshSimplifier::weld(soup.data(),corners,vertices,indices);
+  createLods("teapot",key,vertices,indices,m_teapot,m_teapotCacheStats);
+}
+
+void NGLScene::createLods(const std::string &_name, uint64_t _key, const std::vector<float> &_vertices,
+                          const std::vector<uint32_t> &_indices, StaticMesh &o_mesh, CacheStats &o_stats)
+{
+  QElapsedTimer timer;
+  timer.start();
+  MeshSimplifier simplifier;
+  std::vector<std::vector<float>> vertices(LodSelector::LEVELS);
+  std::vector<std::vector<uint32_t>> indices(LodSelector::LEVELS);
+  vertices[0]=_vertices;
+  indices[0]=_indices;
+  size_t triangles=_indices.size()/3;
+  size_t built=0;
+  for(size_t level=1; level<LodSelector::LEVELS; ++level)
+  {
+    size_t target=std::max(LODMINTRIANGLES,static_cast<size_t>(triangles*LODRATIO[level]));
+    // a level is identified by the full mesh, its target and the simplifier that made it
+    const uint64_t params[3]={level,target,MeshSimplifier::VERSION};
+    uint64_t key=fnv1a(params,sizeof(params),_key);
+    std::string fname;
+    MeshFile mesh;
+    if(!m_meshCacheDir.empty())
+    {
+      fname=MeshFile::cachePath(m_meshCacheDir,_name+"-lod"+std::to_string(level),key);
+      mesh.open(fname,key);
+    }
+    if(mesh.read(vertices[level],indices[level]))
+    {
+      continue;
+    }
+    simplifier.simplify(_vertices,_indices,target,vertices[level],indices[level]);
+    ++built;
+    if(!fname.empty() && !MeshFile::write(fname,key,vertices[level],indices[level]))
+    {
+      std::cerr<<"unable to cache the "<<_name<<" level of detail in "<<fname<<"\n";
+    }
+  }
+  // the cache holds the levels as simplified, reordering is linear so it is done on every load
+  o_stats.m_before=MeshOptimizer::acmr(indices[0],vertices[0].size()/MeshFile::VERTEXFLOATS);
+  for(size_t level=0; level<LodSelector::LEVELS; ++level)
+  {
+    MeshOptimizer::optimizeVertexCache(indices[level],vertices[level].size()/MeshFile::VERTEXFLOATS);
+    MeshOptimizer::optimizeVertexFetch(vertices[level],indices[level]);
+  }
+  o_stats.m_after=MeshOptimizer::acmr(indices[0],vertices[0].size()/MeshFile::VERTEXFLOATS);
+  // every level shares one set of buffers so a single indirect draw can pick from all of them
+  o_mesh.setLayout(m_packedVertices ? StaticMesh::Layout::PACKED : StaticMesh::Layout::FLOAT);
+  o_mesh.load(vertices,indices);
+  std::cout<<_name<<" levels of detail";
+  for(size_t level=0; level<o_mesh.numParts(); ++level)
+  {
+    std::cout<<" "<<o_mesh.numTriangles(level);
+  }
+  std::cout<<" triangles, "<<built<<" simplified in "<<timer.nsecsElapsed()/1.0e6<<" ms\n";
+  size_t floatBytes=o_mesh.numVertices()*StaticMesh::vertexSize(StaticMesh::Layout::FLOAT)+o_mesh.indexBytes();
+  std::cout<<_name<<" "<<(o_mesh.vertexBytes()+o_mesh.indexBytes())/1024.0<<" KB ";
+  if(m_packedVertices)
+  {
+    std::cout<<"packed, "<<floatBytes/1024.0<<" KB as floats, ";
+  }
+  std::cout<<o_stats.m_before<<" cache misses per triangle reordered to "<<o_stats.m_after<<"\n";
+}
+
+double NGLScene::vertexStageTime(const StaticMesh &_mesh, int _repeats)
+{
+  if(!_mesh.isValid() || _repeats < 1)
+  {
+    return 0.0;
+  }
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  shader->use(SPOTPROGRAMS[0]);
+  // a frame of its own in the ring for the one transform block, the positions don't matter as nothing is drawn
+  m_dynamicBuffer.beginFrame(DynamicBuffer::alignUp(sizeof(TransformStd140),m_dynamicBuffer.uniformAlignment()));
+  ngl::Mat4 identity;
+  loadTransforms(identity,identity,ngl::Mat3(),0);
+  GLuint query;
+  glGenQueries(1,&query);
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBeginQuery(GL_TIME_ELAPSED,query);
+  for(int i=0; i<_repeats; ++i)
+  {
+    _mesh.draw(0);
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  glDisable(GL_RASTERIZER_DISCARD);
+  m_dynamicBuffer.endFrame();
+  GLuint64 elapsed=0;
+  glGetQueryObjectui64v(query,GL_QUERY_RESULT,&elapsed);
+  glDeleteQueries(1,&query);
+  return elapsed/1.0e6/_repeats;
+}
+
+void NGLScene::updateTransforms()
+{
+  ngl::Mat4 V=m_cam.getViewMatrix()*m_mouseGlobalTX;
+  ngl::Mat4 P=m_cam.getProjectionMatrix();
+  m_jobs.parallelFor(0,m_transformBatch.size(),TRANSFORMGRAIN,[&](size_t _begin, size_t _end)
+  {
+    m_transformBatch.transform(&V.m_openGL[0],&P.m_openGL[0],_begin,_end);
+  });
+}
+
+void NGLScene::uploadTransforms()
+{
+  // the blocks live in the ring for this frame only so they are copied every frame, in one go
+  size_t stride=m_transformBatch.stride();
+  size_t bytes=m_transformBatch.size()*stride;
+  DynamicBuffer::Allocation blocks=m_dynamicBuffer.allocate(bytes,m_dynamicBuffer.uniformAlignment(),m_frameStats);
+  std::memcpy(blocks.m_data,m_transformBatch.data(),bytes);
+  m_dynamicBuffer.flush(m_frameStats);
+  m_transformsOffset=blocks.m_offset;
+}
+
+void NGLScene::bindTransforms(size_t _object)
+{
+  size_t offset=m_transformsOffset+(_object-m_firstTransform)*m_transformBatch.stride();
+  glBindBufferRange(GL_UNIFORM_BUFFER,TRANSFORMBINDING,m_dynamicBuffer.bufferID(),static_cast<GLintptr>(offset),
+                    sizeof(TransformStd140));
+}
+
+void NGLScene::loadTransforms(const ngl::Mat4 &_MV, const ngl::Mat4 &_MVP, const ngl::Mat3 &_normalMatrix, int _objectID)
+{
+  DynamicBuffer::Allocation block=m_dynamicBuffer.allocate(sizeof(TransformStd140),m_dynamicBuffer.uniformAlignment(),
+                                                           m_frameStats);
+  TransformStd140 *transforms=static_cast<TransformStd140 *>(block.m_data);
+  std::copy(&_MV.m_openGL[0],&_MV.m_openGL[0]+16,transforms->m_MV);
+  std::copy(&_MVP.m_openGL[0],&_MVP.m_openGL[0]+16,transforms->m_MVP);
+  // std140 pads each column of a mat3 to a vec4
+  for(int c=0; c<3; ++c)
+  {
+    for(int r=0; r<3; ++r)
+    {
+      transforms->m_normalMatrix[c*4+r]=_normalMatrix.m_m[c][r];
+    }
+  }
+  transforms->m_objectID=_objectID;
+  m_dynamicBuffer.flush(m_frameStats);
+  glBindBufferRange(GL_UNIFORM_BUFFER,TRANSFORMBINDING,m_dynamicBuffer.bufferID(),
+                    static_cast<GLintptr>(block.m_offset),sizeof(TransformStd140));
+}
+
+size_t NGLScene::frameBytes() const
+{
+  // a transform for the plane and for each teapot drawn on its own or one for all the instanced teapots
+  size_t draws= m_instanced ? 2 : static_cast<size_t>(m_numInstances)+1;
+  size_t bytes=draws*DynamicBuffer::alignUp(sizeof(TransformStd140),m_dynamicBuffer.uniformAlignment());
+  // the lights that changed, at most all of them
+  bytes+=m_lights.size()*sizeof(LightStd140);
+  // the visible teapots of the CPU cull, or the levels and fresh commands of the GPU one
+  bytes+=m_numInstances*(sizeof(uint32_t)+sizeof(uint8_t));
+  bytes+=InstanceCuller::PASSES*InstanceCuller::LEVELS*sizeof(StaticMesh::DrawCommand)+4*sizeof(uint32_t);
+  // the pre-pass draws the instanced teapots with a transform of its own and the visible list again, the GPU
+  // cull sends the front to back order instead
+  if(m_depthPrepass)
+  {
+    bytes+=DynamicBuffer::alignUp(sizeof(TransformStd140),m_dynamicBuffer.uniformAlignment());
+    bytes+=m_numInstances*sizeof(uint32_t)+sizeof(uint32_t);
+  }
+  // the transform blocks are whole multiples of the uniform alignment, but the lights, levels, commands, order
+  // and both visible lists end anywhere and whatever comes next is padded up to its alignment
+  bytes+=6*m_dynamicBuffer.uniformAlignment();
+  return bytes;
+}
+
+void NGLScene::updateClusters()
+{
+  const std::vector<uint32_t> &cells=m_clusters.cells();
+  const std::vector<uint32_t> &indices=m_clusters.indices();
+  m_clusterCells.reserve(cells.size()*sizeof(uint32_t));
+  m_clusterCells.update(0,cells.size()*sizeof(uint32_t),cells.data(),m_frameStats);
+  m_clusterIndices.reserve(indices.size()*sizeof(uint32_t));
+  m_clusterIndices.update(0,indices.size()*sizeof(uint32_t),indices.data(),m_frameStats);
+  if(m_clustersDirty)
+  {
+    ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+    for(auto name : SPOTPROGRAMS)
+    {
+      (*shader)[name]->use();
+      shader->setUniform("clusterDims",static_cast<int>(m_clusters.dimX()),
+                                       static_cast<int>(m_clusters.dimY()),
+                                       static_cast<int>(m_clusters.dimZ()));
+      shader->setUniform("clusterScale",static_cast<float>(m_clusters.dimX())/m_renderWidth,
+                                        static_cast<float>(m_clusters.dimY())/m_renderHeight);
+      shader->setUniform("clusterZScale",m_clusters.zScale());
+      shader->setUniform("clusterZBias",m_clusters.zBias());
+      m_frameStats.addUpload(3*sizeof(int));
+      m_frameStats.addUpload(2*sizeof(float));
+      m_frameStats.addUpload(sizeof(float));
+      m_frameStats.addUpload(sizeof(float));
+    }
+    (*shader)["Spotlight"]->use();
+    m_clustersDirty=false;
+  }
+}
+
+void NGLScene::updateLods()
+{
+  ngl::Mat4 VM=m_cam.getViewMatrix()*m_mouseGlobalTX;
+  m_eyeBounds.resize(m_objectBounds.size());
+  m_jobs.parallelFor(0,m_objectBounds.size(),BOUNDSGRAIN,[&](size_t _begin, size_t _end)
+  {
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      // the view and mouse transforms are rigid so only the centre moves
+      const float *c=m_objectBounds[i].m_centre;
+      ngl::Vec4 eye=VM*ngl::Vec4(c[0],c[1],c[2],1.0f);
+      m_eyeBounds[i]={{eye.m_x,eye.m_y,eye.m_z},m_objectBounds[i].m_radius};
+    }
+  });
+  float pixelScale=0.5f*m_cam.getProjectionMatrix().m_m[1][1]*m_height;
+  m_teapotLod.select(m_eyeBounds.data(),static_cast<size_t>(m_numInstances),pixelScale);
+  m_planeLod.select(&m_eyeBounds.back(),1,pixelScale);
+  // the nearest teapots go first in the pre-pass so they hide as much as they can of the ones behind
+  m_frontToBack.clear();
+  if(m_depthPrepass)
+  {
+    m_frontToBack.resize(static_cast<size_t>(m_numInstances));
+    for(size_t i=0; i<m_frontToBack.size(); ++i)
+    {
+      m_frontToBack[i]=static_cast<uint32_t>(i);
+    }
+    // the camera looks down -z so the nearest have the largest z
+    const std::vector<BoundingSphere> &eye=m_eyeBounds;
+    std::sort(m_frontToBack.begin(),m_frontToBack.end(),[&eye](uint32_t _a, uint32_t _b)
+    {
+      return eye[_a].m_centre[2] > eye[_b].m_centre[2];
+    });
+  }
+  // a resize can change the levels without moving the view, the shadow tiles hold the old meshes
+  if(m_teapotLod.orderChanged())
+  {
+    m_shadowAtlas.castersChanged();
+  }
+}
+
+void NGLScene::cullObjects()
+{
+  if(m_objectCulling)
+  {
+    m_culler.cull(m_lights.data(),m_lights.size(),m_eyeBounds.data(),m_eyeBounds.size());
+  }
+  else
+  {
+    m_culler.reset(m_eyeBounds.size());
+  }
+}
+
+void NGLScene::uploadObjectLists()
+{
+  const std::vector<uint32_t> &cells=m_culler.cells();
+  const std::vector<uint32_t> &indices=m_culler.indices();
+  m_objectCells.reserve(cells.size()*sizeof(uint32_t));
+  m_objectCells.update(0,cells.size()*sizeof(uint32_t),cells.data(),m_frameStats);
+  m_objectIndices.reserve(indices.size()*sizeof(uint32_t));
+  m_objectIndices.update(0,indices.size()*sizeof(uint32_t),indices.data(),m_frameStats);
+}
+
+void NGLScene::packLights()
+{
+  if(m_player.isOpen() && m_player.numLights() == m_lights.size())
+  {
+    // a recorded tick replaces everything the animation and createLights set
+    if(m_player.next())
+    {
+      for(size_t i=0; i<m_lights.size(); ++i)
+      {
+        m_lights.set(i,m_player.lights()[i]);
+      }
+    }
+    else
+    {
+      std::cerr<<"the recording "<<m_replayPath<<" is damaged, replay stopped\n";
+    }
+  }
+  else
+  {
+    if(m_simulation.isRunning())
+    {
+      m_simulation.interpolate(m_spotFrame,SpotSimulation::Clock::now());
+    }
+    else
+    {
+      m_simulation.latest(m_spotFrame);
+    }
+    loadSpotsToLights();
+  }
+}
+
+void NGLScene::createFrameGraph()
+{
+  // each stage only reads what those it depends on write, the GL side of each follows on the render thread
+  m_frameGraph.clear();
+  size_t lightPack=m_frameGraph.add("lightPack",[this]()
+  {
+    if(!m_frameWork.m_lightPack)
+    {
+      return false;
+    }
+    packLights();
+    return true;
+  });
+  size_t lod=m_frameGraph.add("lod",[this]()
+  {
+    if(!m_frameWork.m_viewChanged)
+    {
+      return false;
+    }
+    updateLods();
+    return true;
+  });
+  size_t cull=m_frameGraph.add("cullPrepare",[this]()
+  {
+    if(!m_frameWork.m_viewChanged)
+    {
+      return false;
+    }
+    m_instanceCuller.prepare(m_teapotLod,m_cam.getProjectionMatrix()*m_cam.getViewMatrix()*m_mouseGlobalTX,
+                             m_frontToBack);
+    return true;
+  });
+  m_frameGraph.add("transforms",[this]()
+  {
+    if(!m_frameWork.m_viewChanged)
+    {
+      return false;
+    }
+    updateTransforms();
+    return true;
+  });
+  // the same test uploadLights makes for whether to re-bin, the deferred path has nothing to bin
+  size_t lightBin=m_frameGraph.add("lightBin",[this]()
+  {
+    if(!m_frameWork.m_forward || !(m_lights.hasChanges() || m_clustersDirty))
+    {
+      return false;
+    }
+    m_clusters.assign(m_lights.data(),m_lights.size());
+    return true;
+  });
+  size_t lightCull=m_frameGraph.add("lightCull",[this]()
+  {
+    if(!m_frameWork.m_forward || !m_objectListsDirty)
+    {
+      return false;
+    }
+    cullObjects();
+    return true;
+  });
+  m_frameGraph.depend(cull,lod);
+  m_frameGraph.depend(lightBin,lightPack);
+  m_frameGraph.depend(lightCull,lightPack);
+  m_frameGraph.depend(lightCull,lod);
+}
+
+void NGLScene::openScene()
+{
+  if(m_scenePath.empty())
+  {
+    return;
+  }
+  QElapsedTimer timer;
+  timer.start();
+  if(!m_scene.open(m_scenePath))
+  {
+    std::cerr<<"unable to load the scene "<<m_scenePath<<", drawing the grid instead\n";
+    return;
+  }
+  if(m_scene.numSpots() != 0)
+  {
+    m_numLights=m_scene.numSpots();
+  }
+  m_sceneLoadTime+=timer.nsecsElapsed()/1.0e6;
+}
+
+void NGLScene::createInstances()
+{
+  // the instanced shaders fetch their matrix with the instance index so each level of detail can draw any
+  // subset of the teapots
+  m_instanceMatrices.create(GL_RGBA32F,INSTANCEUNIT);
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  const char *programs[]={SPOTPROGRAMS[1],GBUFFERPROGRAMS[1],DEPTHPROGRAMS[1],"ShadowDepth"};
+  for(auto name : programs)
+  {
+    m_instanceMatrices.bindToProgram(shader->getProgramID(name),"instanceMatrices");
+  }
+  m_objectBounds.clear();
+  m_transformBatch.clear();
+  if(m_scene.isOpen())
+  {
+    QElapsedTimer timer;
+    timer.start();
+    const size_t numInstances=m_scene.numInstances();
+    const size_t stride=SceneFile::MATRIXFLOATS*sizeof(float);
+    const float *models=m_scene.instances();
+    m_numInstances=static_cast<int>(numInstances);
+    m_objectBounds.reserve(numInstances+1);
+    m_instanceMatrices.reserve(numInstances*stride);
+    // the matrices go straight from the mapping to the buffer a chunk at a time, and each chunk's pages are
+    // dropped once copied so the resident size doesn't grow with the scene
+    for(size_t first=0; first<numInstances; first+=INSTANCECHUNK)
+    {
+      size_t count=std::min(INSTANCECHUNK,numInstances-first);
+      const float *chunk=models+first*SceneFile::MATRIXFLOATS;
+      m_instanceMatrices.update(first*stride,count*stride,chunk,m_frameStats);
+      for(size_t i=0; i<count; ++i)
+      {
+        const float *m=chunk+i*SceneFile::MATRIXFLOATS;
+        // the bound is centred on the teapot origin and grows with the largest axis scale
+        float scale=0.0f;
+        for(int axis=0; axis<3; ++axis)
+        {
+          const float *c=m+4*axis;
+          scale=std::max(scale,c[0]*c[0]+c[1]*c[1]+c[2]*c[2]);
+        }
+        m_objectBounds.push_back({{m[12],m[13],m[14]},TEAPOTRADIUS*std::sqrt(scale)});
+      }
+      m_scene.releaseInstances(first,count);
+    }
+    m_sceneLoadTime+=timer.nsecsElapsed()/1.0e6;
+  }
+  else
+  {
+    // the single draws take their models from gridModel too so both paths produce identical matrices
+    std::vector<ngl::Mat4> models;
+    models.reserve(m_gridX*m_gridZ);
+    for(int iz=0; iz<m_gridZ; ++iz)
+    {
+      for(int ix=0; ix<m_gridX; ++ix)
+      {
+        models.push_back(gridModel(ix,iz));
+        m_objectBounds.push_back({{models.back().m_openGL[12],0.49f,models.back().m_openGL[14]},TEAPOTRADIUS});
+      }
+    }
+    m_transform.reset();
+    m_numInstances=m_gridX*m_gridZ;
+    m_instanceMatrices.reserve(models.size()*sizeof(ngl::Mat4));
+    m_instanceMatrices.update(0,models.size()*sizeof(ngl::Mat4),&models[0].m_openGL[0],m_frameStats);
+  }
+  m_instanceCuller.setInstances(m_objectBounds.data(),static_cast<size_t>(m_numInstances),m_frameStats);
+  // the plane is the last object, it lies in y=0 centred on the origin
+  m_objectBounds.push_back({{0.0f,0.0f,0.0f},0.5f*std::sqrt(2.0f)*PLANESIZE});
+  // the teapots are the shadow casters
+  m_shadowAtlas.castersChanged();
+  m_dirty|=DIRTYINSTANCES;
+  std::cout<<"Created "<<m_numInstances<<" teapot instances\n";
+}
+
+ngl::Mat4 NGLScene::gridModel(int _ix, int _iz)
+{
+  int x=2*_ix-m_gridX;
+  int z=2*_iz-m_gridZ;
+  m_transform.setRotation(0,(x*z)*20,0);
+  m_transform.setPosition(x,0.49,z);
+  return m_transform.getMatrix();
+}
+
+void NGLScene::batchTransforms(size_t _firstObject)
+{
+  m_transformBatch.clear();
+  m_transformBatch.setFirstID(_firstObject);
+  const size_t numInstances=static_cast<size_t>(m_numInstances);
+  m_transformBatch.reserve(numInstances-std::min(_firstObject,numInstances)+1);
+  if(_firstObject == 0 && m_scene.isOpen())
+  {
+    // read from the mapping a chunk at a time and dropped again, as when the instances were made
+    const float *models=m_scene.instances();
+    for(size_t first=0; first<numInstances; first+=INSTANCECHUNK)
+    {
+      size_t count=std::min(INSTANCECHUNK,numInstances-first);
+      for(size_t i=0; i<count; ++i)
+      {
+        m_transformBatch.addModel(models+(first+i)*SceneFile::MATRIXFLOATS);
+      }
+      m_scene.releaseInstances(first,count);
+    }
+  }
+  else if(_firstObject == 0)
+  {
+    for(int iz=0; iz<m_gridZ; ++iz)
+    {
+      for(int ix=0; ix<m_gridX; ++ix)
+      {
+        ngl::Mat4 model=gridModel(ix,iz);
+        m_transformBatch.addModel(&model.m_openGL[0]);
+      }
+    }
+    m_transform.reset();
+  }
+  ngl::Mat4 planeModel;
+  m_transformBatch.addModel(&planeModel.m_openGL[0]);
+  m_firstTransform=_firstObject;
+}
+
+void NGLScene::updateShadows()
+{
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  (*shader)["ShadowDepth"]->use();
+  // the casters are drawn in the eye space the lights are in, as the lighting passes see them
+  ngl::Mat4 V=m_cam.getViewMatrix()*m_mouseGlobalTX;
+  // only the teapots cast shadows, nothing is below the plane. Those out of view still cast into it so every
+  // teapot is drawn, with the levels picked for the camera, the tiles are small next to the screen so that is
+  // never too coarse
+  m_shadowAtlas.update(m_lights.data(),m_lights.size(),V,m_cam.getProjectionMatrix(),m_height,
+                       [&](const ngl::Mat4 &_lightVP)
+                       {
+                         shader->setUniform("VP",_lightVP*V);
+                         m_frameStats.addUpload(sizeof(ngl::Mat4));
+                         drawTeapotLods(InstanceCuller::SHADOW);
+                       },m_frameStats);
+  m_shadowAtlas.bind();
+}
+
+void NGLScene::drawTeapotsInstanced(const std::string &_program)
+{
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  (*shader)[_program]->use();
+  // the per instance model matrix is applied in the shader so only the global view is needed here
+  ngl::Mat4 V=m_cam.getViewMatrix()*m_mouseGlobalTX;
+  loadTransforms(V,m_cam.getProjectionMatrix()*V,ngl::Mat3(),0);
+  drawTeapotLods(InstanceCuller::CAMERA);
+}
+
+void NGLScene::drawTeapotLods(InstanceCuller::Pass _pass)
+{
+  m_instanceMatrices.bind();
+  m_instanceCuller.draw(_pass,m_frameStats);
+}
+
+void NGLScene::drawPlane(const char *_program)
+{
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  (*shader)[_program]->use();
+  bindTransforms(m_objectBounds.size()-1);
+  if(m_plane.isValid())
+  {
+    size_t level=m_planeLod.level(0);
+    m_plane.draw(level);
+    m_frameStats.addTriangles(m_plane.numTriangles(level));
+  }
+  else
+  {
+    ngl::VAOPrimitives::instance()->draw("plane");
+    m_frameStats.addTriangles(2*PLANESTEPS*PLANESTEPS);
+  }
+}
+
+void NGLScene::drawTeapots(const char **_programs)
+{
+  if(m_instanced)
+  {
+    drawTeapotsInstanced(_programs[1]);
+    return;
+  }
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  (*shader)[_programs[0]]->use();
+  // the grid and scene models were cached in draw order so the object id is the index
+  bool sorted=m_frontToBack.size() == static_cast<size_t>(m_numInstances);
+  for(int n=0; n<m_numInstances; ++n)
+  {
+    size_t i= sorted ? m_frontToBack[n] : static_cast<size_t>(n);
+    bindTransforms(i);
+    size_t level=m_teapotLod.level(i);
+    m_teapot.draw(level);
+    m_frameStats.addTriangles(m_teapot.numTriangles(level));
+  }
 }
 
+void NGLScene::drawScene(bool _gbuffer)
+{
+  // the object ids are in every transform block, only the forward shader reads the per object light lists
+  const char **programs= _gbuffer ? GBUFFERPROGRAMS : SPOTPROGRAMS;
+  // load the values to the shader and draw the plane
+  {
+    ProfileScope scope(m_profiler,"plane");
+    drawPlane(programs[0]);
+  }
+  {
+    ProfileScope scope(m_profiler,"teapots");
+    drawTeapots(programs);
+  }
+}
 
-void NGLScene::loadMatricesToShader()
+void NGLScene::drawDepthPrepass()
 {
-  // grab an instance of the shader manager
-  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  // these are used to hold our pre-computed matrix values
-  ngl::Mat4 MV;
-  ngl::Mat4 MVP;
-  ngl::Mat3 normalMatrix;
-  // our model view matrix
-  MV=m_cam.getViewMatrix() *
-     m_mouseGlobalTX*
-     m_transform.getMatrix();
-  // our model view ;rojection matrix
-  MVP=m_cam.getProjectionMatrix()*MV;
-  // calculate normal matrix by getting the top 3x3 of the MV
-  normalMatrix=MV;
-  // then calculate the inverse
-  normalMatrix.inverse().transpose();
-  // now load them to the current shader
-  shader->setUniform("MV",MV);
-  shader->setUniform("MVP",MVP);
-  shader->setUniform("normalMatrix",normalMatrix);
+  glColorMask(GL_FALSE,GL_FALSE,GL_FALSE,GL_FALSE);
+  // the plane is behind most of the teapots so it goes last
+  drawTeapots(DEPTHPROGRAMS);
+  drawPlane(DEPTHPROGRAMS[0]);
+  glColorMask(GL_TRUE,GL_TRUE,GL_TRUE,GL_TRUE);
 }
 
 void NGLScene::paintGL()
 {
+  m_updatePending=false;
+  glViewport(0,0,m_width,m_height);
+  m_frameStats.reset();
+  m_profiler.beginFrame();
+  // the last tick can still arrive after pausing
+  bool newTick=m_simulation.acquire();
+  if(newTick || m_animate)
+  {
+    m_dirty|=DIRTYLIGHTS;
+  }
+  // Qt repaints on expose as well as when asked, if nothing has changed show the last frame again
+  if(m_dirty == 0 && m_frameCache.isValid())
+  {
+    {
+      ProfileScope scope(m_profiler,"cachedFrame");
+      m_frameCache.restore(m_width,m_height);
+    }
+    captureFrame();
+    // the cache holds the picture without the overlay so its numbers stay live while paused
+    if(m_showProfile)
+    {
+      ProfileScope scope(m_profiler,"overlay");
+      drawProfile();
+    }
+    m_profiler.endFrame();
+    ++m_framesCached;
+    ++m_statsCached;
+    return;
+  }
   // clear the screen and depth buffer
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glViewport(0,0,m_width,m_height);
-  // Rotation based on the mouse position for our global
-  // transform
-  ngl::Mat4 rotX;
-  ngl::Mat4 rotY;
-  // create the rotation matrices
-  rotX.rotateX(m_spinXFace);
-  rotY.rotateY(m_spinYFace);
-  // multiply the rotations
-  m_mouseGlobalTX=rotY*rotX;
-  // add the translations
-  m_mouseGlobalTX.m_m[3][0] = m_modelPos.m_x;
-  m_mouseGlobalTX.m_m[3][1] = m_modelPos.m_y;
-  m_mouseGlobalTX.m_m[3][2] = m_modelPos.m_z;
-  // grab an instance of the primitives for drawing
-  ngl::VAOPrimitives *prim=ngl::VAOPrimitives::instance();
-  // Rotation based on the mouse position for our global
-  // transform
+  // everything written for this frame goes in the next region of the ring, once the GPU is done with it
+  {
+    ProfileScope scope(m_profiler,"ringWait",false);
+    m_dynamicBuffer.beginFrame(frameBytes());
+  }
+  // the animation moves to or from the GPU here, where the context is current
+  bool gpuAnimation=m_gpuAnimation && m_gpuSpots.isAvailable() && !m_recorder.isOpen() && !m_player.isOpen();
+  if(gpuAnimation != m_lightsOnGpu)
+  {
+    switchAnimation(gpuAnimation);
+  }
+  else if(m_lightsOnGpu && m_gpuSpotsStale)
+  {
+    loadSpotsToGpu();
+  }
+  // with a budget or FXAA the scene is drawn into a target of the size the controller picked and scaled
+  // up to the window at the end
+  bool scaled=m_resolution.begin(m_width,m_height);
+  int renderWidth= scaled ? m_resolution.renderWidth() : m_width;
+  int renderHeight= scaled ? m_resolution.renderHeight() : m_height;
+  if(renderWidth != m_renderWidth || renderHeight != m_renderHeight)
+  {
+    // the cluster tiles are found from gl_FragCoord
+    m_renderWidth=renderWidth;
+    m_renderHeight=renderHeight;
+    m_clustersDirty=true;
+  }
+  if(m_dirty & DIRTYVIEW)
+  {
+    // Rotation based on the mouse position for our global
+    // transform
+    ngl::Mat4 rotX;
+    ngl::Mat4 rotY;
+    // create the rotation matrices
+    rotX.rotateX(m_spinXFace);
+    rotY.rotateY(m_spinYFace);
+    // multiply the rotations
+    m_mouseGlobalTX=rotY*rotX;
+    // add the translations
+    m_mouseGlobalTX.m_m[3][0] = m_modelPos.m_x;
+    m_mouseGlobalTX.m_m[3][1] = m_modelPos.m_y;
+    m_mouseGlobalTX.m_m[3][2] = m_modelPos.m_z;
+  }
+  // animated on the GPU the culled lights only change with new spots, which uploadLights picks up
+  unsigned int listsMoved=DIRTYVIEW | DIRTYINSTANCES;
+  if(!m_lightsOnGpu)
+  {
+    listsMoved|=DIRTYLIGHTS;
+  }
+  if(m_dirty & listsMoved)
+  {
+    m_objectListsDirty=true;
+  }
+  // animated on the GPU the lights changed since the last frame are only taken when they are bound, the
+  // object lists are rebuilt for them before then
+  if(m_lightsOnGpu && m_lights.hasChanges())
+  {
+    m_objectListsDirty=true;
+  }
+  // the G-buffer is only allocated once the deferred path is used, it follows the viewport size
+  bool deferred=m_deferred && m_deferredRenderer.resize(m_width,m_height);
+  // the instanced teapots apply their model in the shader so only the plane is batched, the teapots are only
+  // batched while they are drawn one at a time and the transforms are recomputed whenever the mode changes
+  size_t firstTransform= m_instanced ? static_cast<size_t>(m_numInstances) : 0;
+  if(m_transformBatch.size() == 0 || firstTransform != m_firstTransform)
+  {
+    batchTransforms(firstTransform);
+  }
+  // the CPU work of the frame is shared across the job threads, blending the lights, choosing the levels from
+  // the size of each object on screen then listing the teapots in view, the per draw matrices which only
+  // change with the view, the instances or the projection, and the light lists of the forward path
+  m_frameWork.m_lightPack=!m_lightsOnGpu && (newTick || m_animate);
+  m_frameWork.m_viewChanged=(m_dirty & (DIRTYVIEW | DIRTYINSTANCES | DIRTYSETTINGS)) != 0;
+  m_frameWork.m_forward=!deferred;
+  {
+    ProfileScope scope(m_profiler,"frameJobs",false);
+    m_frameGraph.run(m_jobs);
+  }
+  for(size_t i=0; i<m_frameGraph.size(); ++i)
+  {
+    if(m_frameGraph.didWork(i))
+    {
+      m_profiler.record(m_frameGraph.name(i),FrameProfiler::jobThread(m_frameGraph.thread(i)),m_frameGraph.begin(i),
+                        m_frameGraph.end(i));
+    }
+  }
+  // what the jobs built goes to GL from here, on the thread the context is current on
+  if(m_frameWork.m_viewChanged)
+  {
+    ProfileScope scope(m_profiler,"cull");
+    m_instanceCuller.submit(m_frameStats);
+  }
+  {
+    ProfileScope scope(m_profiler,"transformUpload",false);
+    uploadTransforms();
+  }
   // grab an instance of the shader manager
   ngl::ShaderLib *shader=ngl::ShaderLib::instance();
   (*shader)["Spotlight"]->use();
-  // load the values to the shader and draw the plane
-  m_transform.reset();
-  loadMatricesToShader();
-  prim->draw("plane");
-
-  for (int z=-8; z<8; z+=2)
+  // the GPU evaluates the spots for exactly this frame, the animation time following the clock while
+  // the simulation thread would have been ticking
+  if(m_lightsOnGpu)
   {
-    for (int x=-8; x<8; x+=2)
+    SpotSimulation::Clock::time_point now=SpotSimulation::Clock::now();
+    if(m_animate && m_threadedAnimation)
     {
-      // set the teapot position and roation
-      m_transform.setRotation(0,(x*z)*20,0);
-      m_transform.setPosition(x,0.49,z);
-      // load the current transform to the shader
-      loadMatricesToShader();
-      prim->draw("teapot");
-   }
+      m_animationTicks+=std::chrono::duration<double>(now-m_animationClock).count()/m_simulation.tickSeconds();
+    }
+    m_animationClock=now;
+    ProfileScope scope(m_profiler,"spotAnimate");
+    m_gpuSpots.update(m_animationTicks,m_lightTransform,m_frameStats);
+  }
+  // each tick is recorded as it is first drawn
+  if(newTick && m_recorder.isOpen() && !m_recorder.write(m_lights.data(),m_lights.size()))
+  {
+    std::cerr<<"the light count changed, recording to "<<m_recordPath<<" stopped\n";
+    m_recorder.close();
+  }
+  // only the tiles whose light or casters moved are redrawn, within the budget
+  {
+    ProfileScope scope(m_profiler,"shadows");
+    updateShadows();
+  }
+  if(deferred)
+  {
+    // the light volumes read the light buffer directly so there is nothing to bin
+    {
+      ProfileScope scope(m_profiler,"lightUpload");
+      if(uploadLights())
+      {
+        m_clustersDirty=true;
+      }
+    }
+    {
+      ProfileScope scope(m_profiler,"gbuffer");
+      m_deferredRenderer.beginGeometry();
+      drawScene(true);
+    }
+    {
+      ProfileScope scope(m_profiler,"lightVolumes");
+      m_deferredRenderer.lightPass(m_lights.size(),m_cam.getProjectionMatrix());
+    }
+    {
+      ProfileScope scope(m_profiler,"composite");
+      m_deferredRenderer.composite();
+    }
+  }
+  else
+  {
+    // send any lights changed since the last frame and the lists they were binned to
+    {
+      ProfileScope scope(m_profiler,"lightUpload");
+      if(uploadLights() || m_clustersDirty)
+      {
+        updateClusters();
+      }
+      m_clusterCells.bind();
+      m_clusterIndices.bind();
+    }
+    // rebuilt whenever the objects or lights have moved
+    {
+      ProfileScope scope(m_profiler,"lightListUpload");
+      if(m_objectListsDirty)
+      {
+        uploadObjectLists();
+        m_objectListsDirty=false;
+      }
+      m_objectCells.bind();
+      m_objectIndices.bind();
+    }
+    if(m_depthPrepass)
+    {
+      {
+        ProfileScope scope(m_profiler,"depthPrepass");
+        drawDepthPrepass();
+      }
+      // only the nearest sample at each pixel passes now, there is no depth left to write
+      glDepthFunc(GL_EQUAL);
+      glDepthMask(GL_FALSE);
+    }
+    // the samples the lit pass shades against those the target has, with no multisampling GL_SAMPLES is 0
+    GLint samples=0;
+    glGetIntegerv(GL_SAMPLES,&samples);
+    m_fragmentCounter.begin(static_cast<uint64_t>(m_renderWidth)*m_renderHeight*std::max(1,samples));
+    drawScene(false);
+    m_fragmentCounter.end();
+    if(m_depthPrepass)
+    {
+      glDepthFunc(GL_LESS);
+      glDepthMask(GL_TRUE);
+    }
+  }
+  if(scaled)
+  {
+    ProfileScope scope(m_profiler,"upscale");
+    m_resolution.end();
+  }
+  // before the overlay, which isn't part of the picture
+  captureFrame();
+  // while paused the next frames are likely to be repaints of this one so keep a copy
+  if(m_animate)
+  {
+    m_frameCache.invalidate();
+  }
+  else
+  {
+    m_frameCache.store(m_width,m_height);
+  }
+  if(m_showProfile)
+  {
+    ProfileScope scope(m_profiler,"overlay");
+    drawProfile();
+  }
+  m_dynamicBuffer.endFrame();
+  m_profiler.endFrame();
+  m_dirty=0;
+  ++m_framesDrawn;
+  m_trianglesDrawn+=m_frameStats.m_triangles;
+  if(m_firstFrameTime < 0.0)
+  {
+    // wait for the GPU so the time covers everything needed to get the first image out
+    glFinish();
+    m_firstFrameTime=m_startupTimer.nsecsElapsed()/1.0e6;
+    std::cout<<"First frame after "<<m_firstFrameTime<<" ms, plane mesh ("<<m_planeSource<<") took "
+             <<m_planeTime<<" ms\n";
+  }
+  if(m_printStats)
+  {
+    m_statsTotal.m_bytesUploaded+=m_frameStats.m_bytesUploaded;
+    m_statsTotal.m_uniformCalls+=m_frameStats.m_uniformCalls;
+    m_statsTotal.m_bytesStreamed+=m_frameStats.m_bytesStreamed;
+    m_statsTotal.m_triangles+=m_frameStats.m_triangles;
+    ++m_statsFrames;
   }
 }
 
@@ -187,8 +1355,10 @@ void NGLScene::mouseMoveEvent (QMouseEvent * _event)
     m_spinYFace += (float) 0.5f * diffx;
     m_origX = _event->x();
     m_origY = _event->y();
-    update();
-
+    if(diffx || diffy)
+    {
+      requestRedraw(DIRTYVIEW);
+    }
   }
         // right mouse translate code
   else if(m_translate && _event->buttons() == Qt::RightButton)
@@ -199,8 +1369,10 @@ void NGLScene::mouseMoveEvent (QMouseEvent * _event)
     m_origYPos=_event->y();
     m_modelPos.m_x += INCREMENT * diffX;
     m_modelPos.m_y -= INCREMENT * diffY;
-    update();
-
+    if(diffX || diffY)
+    {
+      requestRedraw(DIRTYVIEW);
+    }
    }
 }
 
@@ -255,7 +1427,7 @@ void NGLScene::wheelEvent(QWheelEvent *_event)
 	{
 		m_modelPos.m_z-=ZOOM;
 	}
-	update();
+	requestRedraw(DIRTYVIEW);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -263,26 +1435,52 @@ void NGLScene::keyPressEvent(QKeyEvent *_event)
 {
   // this method is called every time the main window recives a key event.
   // we then switch on the key value and set the camera in the GLWindow
+  // only keys that change what is drawn ask for a frame, the window size changes repaint by themselves
+  unsigned int dirty=0;
   switch (_event->key())
   {
   // escape key to quite
   case Qt::Key_Escape : QGuiApplication::exit(EXIT_SUCCESS); break;
   // turn on wirframe rendering
-  case Qt::Key_W : glPolygonMode(GL_FRONT_AND_BACK,GL_LINE); break;
+  case Qt::Key_W : glPolygonMode(GL_FRONT_AND_BACK,GL_LINE); dirty=DIRTYSETTINGS; break;
   // turn off wire frame
-  case Qt::Key_S : glPolygonMode(GL_FRONT_AND_BACK,GL_FILL); break;
+  case Qt::Key_S : glPolygonMode(GL_FRONT_AND_BACK,GL_FILL); dirty=DIRTYSETTINGS; break;
   // show full screen
   case Qt::Key_F : showFullScreen(); break;
   // show windowed
   case Qt::Key_N : showNormal(); break;
-  case Qt::Key_Space : changeSpotParams(); break;
-  case Qt::Key_A : toggleAnimation(); break;
+  case Qt::Key_Space : changeSpotParams(); dirty=DIRTYLIGHTS; break;
+  case Qt::Key_A : toggleAnimation(); dirty=DIRTYLIGHTS; break;
+  case Qt::Key_I : toggleInstancing(); dirty=DIRTYSETTINGS; break;
+  case Qt::Key_P : setShowProfile(!m_showProfile); dirty=DIRTYSETTINGS; break;
+  case Qt::Key_T : captureTrace("SpotLight_trace.json",120); dirty=DIRTYSETTINGS; break;
+  // the light lists change with the culling mode
+  case Qt::Key_C : m_objectCulling^=true; dirty=DIRTYLIGHTS; break;
+  case Qt::Key_D : toggleDeferred(); dirty=DIRTYSETTINGS; break;
+  case Qt::Key_H : setShadowMapping(!isShadowMapping()); dirty=DIRTYSETTINGS; break;
+  case Qt::Key_L : setLod(!isLod()); dirty=DIRTYSETTINGS; break;
+  case Qt::Key_R : toggleDynamicResolution(); dirty=DIRTYSETTINGS; break;
+  case Qt::Key_G : setGpuAnimation(!m_gpuAnimation); dirty=DIRTYLIGHTS; break;
+  case Qt::Key_Z : setDepthPrepass(!m_depthPrepass); dirty=DIRTYSETTINGS; break;
 
   default : break;
   }
-  // finally update the GLWindow and re-draw
-  //if (isExposed())
+  if(dirty)
+  {
+    requestRedraw(dirty);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::requestRedraw(unsigned int _dirty)
+{
+  m_dirty|=_dirty;
+  // any number of input events before the next frame share one update request
+  if(!m_updatePending)
+  {
+    m_updatePending=true;
     update();
+  }
 }
 
 
@@ -292,114 +1490,501 @@ void NGLScene::keyPressEvent(QKeyEvent *_event)
 void NGLScene::createLights()
 {
   ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  (*shader)["Spotlight"]->use();
-  ngl::Real x=0;
-  ngl::Real z=0;
-  // loop an set the spot values
-  ngl::Random *rand=ngl::Random::instance();
-  rand->setSeed(time(NULL));
-  for(int i=0; i<8; ++i)
-  {
-    // create a random position for the spot
-    x=rand->randomNumber(3);
-    z=rand->randomNumber(3);
-    ngl::Vec3 pos(x,3,z);
-    // shine down
-    ngl::Vec3 dir(0,-1,0);
-    // now load this to the spot data class
-    SpotData d;
-    d.m_aimCenter=rand->getRandomPoint(x*4,0,z*4);
-    d.m_radiusX=rand->randomNumber(2)+0.5;
-    d.m_radiusZ=rand->randomNumber(2)+0.5;
-    d.m_startColour =rand->getRandomColour();
-    d.m_endColour =rand->getRandomColour();
-    d.m_startColour.clamp(0.4,1.0);
-    d.m_endColour.clamp(0.4,1.0);
-
-    d.m_mix=0.0;
-    d.m_time=rand->randomPositiveNumber(4)+0.6;
-    m_spotData.push_back(d);
-    m_spots.push_back(ngl::SpotLight(pos,dir,d.m_startColour));
+  // all the lights live in one texture buffer, the clusters index into it
+  bool created=m_lights.size() != 0;
+  m_lights.create(m_numLights,1);
+  // the light count can change while running, the buffers only need creating once
+  if(!created)
+  {
+    m_clusterCells.create(GL_RG32UI,2);
+    m_clusterIndices.create(GL_R32UI,3);
+    m_objectCells.create(GL_RG32UI,4);
+    m_objectIndices.create(GL_R32UI,5);
+    for(auto name : SPOTPROGRAMS)
+    {
+      GLuint program=shader->getProgramID(name);
+      m_lights.bindToProgram(program,"lightData");
+      m_clusterCells.bindToProgram(program,"clusterCells");
+      m_clusterIndices.bindToProgram(program,"clusterIndices");
+      m_objectCells.bindToProgram(program,"objectCells");
+      m_objectIndices.bindToProgram(program,"objectIndices");
+    }
+    // the pre-pass runs the same vertex shader which reads the object lists even though nothing uses them
+    for(auto name : DEPTHPROGRAMS)
+    {
+      m_objectCells.bindToProgram(shader->getProgramID(name),"objectCells");
+    }
+    m_lights.bindToProgram(shader->getProgramID("SpotVolume"),"lightData");
   }
+  m_clustersDirty=true;
+  // the tiles are shared out again for the new lights
+  m_shadowAtlas.invalidate();
+  m_dirty|=DIRTYLIGHTS;
+  (*shader)["Spotlight"]->use();
   // get the inverse view matrix and load this to the light shader
   // we use this as we do the light calculations in eye space in the shader
-  ngl::Mat4 iv=m_cam.getViewMatrix();
-  iv.inverse().transpose();
-  int i=0;
-  for(auto &spot : m_spots)
+  m_lightTransform=m_cam.getViewMatrix();
+  m_lightTransform.inverse().transpose();
+  m_spotState.resize(m_lights.size());
+  SpotState &s=m_spotState;
+  if(m_scene.isOpen() && m_scene.numSpots() == m_lights.size())
+  {
+    QElapsedTimer timer;
+    timer.start();
+    // the scene's columns are laid out like our arrays so each is a single copy
+    for(size_t c=0; c<=SceneFile::TIMEOFFSET; ++c)
+    {
+      const float *column=m_scene.spotColumn(static_cast<SceneFile::SpotColumn>(c));
+      std::copy(column,column+s.size(),(s.*SCENESPOTSTATE[c]).begin());
+    }
+    const float *cutoff=m_scene.spotColumn(SceneFile::CUTOFF);
+    const float *innerCutoff=m_scene.spotColumn(SceneFile::INNERCUTOFF);
+    const float *exponent=m_scene.spotColumn(SceneFile::EXPONENT);
+    for(size_t i=0; i<s.size(); ++i)
+    {
+      initSpot(i,cutoff[i],innerCutoff[i],exponent[i]);
+    }
+    m_sceneLoadTime+=timer.nsecsElapsed()/1.0e6;
+  }
+  else
+  {
+    // loop an set the spot values
+    ngl::Random *rand=ngl::Random::instance();
+    rand->setSeed(m_fixedSeed ? m_seed : time(NULL));
+    float spread=lightSpread();
+    for(size_t i=0; i<s.size(); ++i)
+    {
+      // create a random position for the spot
+      float x=rand->randomNumber(spread);
+      float z=rand->randomNumber(spread);
+      ngl::Vec3 aimCenter=rand->getRandomPoint(x*4,0,z*4);
+      ngl::Colour start=rand->getRandomColour();
+      ngl::Colour end=rand->getRandomColour();
+      start.clamp(0.4,1.0);
+      end.clamp(0.4,1.0);
+      float cutoff=rand->randomPositiveNumber(24.0f)+0.5f;
+      s.m_posX[i]=x;
+      s.m_posY[i]=3.0f;
+      s.m_posZ[i]=z;
+      s.m_centreX[i]=aimCenter.m_x;
+      s.m_centreZ[i]=aimCenter.m_z;
+      s.m_radiusX[i]=rand->randomNumber(2)+0.5;
+      s.m_radiusZ[i]=rand->randomNumber(2)+0.5;
+      s.m_startR[i]=start.m_r;
+      s.m_startG[i]=start.m_g;
+      s.m_startB[i]=start.m_b;
+      s.m_endR[i]=end.m_r;
+      s.m_endG[i]=end.m_g;
+      s.m_endB[i]=end.m_b;
+      s.m_timeOffset[i]=rand->randomPositiveNumber(4)+0.6;
+      float innerCutoff=rand->randomPositiveNumber(12)+0.1f;
+      float exponent=rand->randomPositiveNumber(2)+1.0f;
+      initSpot(i,cutoff,innerCutoff,exponent);
+    }
+  }
+  m_spotFrame.copyFrom(m_spotState);
+  loadSpotsToLights();
+  m_simulation.setState(m_spotState);
+  m_gpuSpotsStale=true;
+  std::cout<<"Animating "<<m_lights.size()<<" spots with the "
+           <<SpotAnimator::kernelName(m_simulation.animator().kernel())<<" kernel\n";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::initSpot(size_t _i, float _cutoff, float _innerCutoff, float _exponent)
+{
+  SpotState &s=m_spotState;
+  s.m_mix[_i]=0.0f;
+  s.m_cosCutoff[_i]=cosf(ngl::radians(_cutoff));
+  s.m_sinCutoff[_i]=sinf(ngl::radians(_cutoff));
+  // shine straight down until the first animation tick
+  s.m_dirX[_i]=0.0f;
+  s.m_dirY[_i]=-1.0f;
+  s.m_dirZ[_i]=0.0f;
+  s.m_colourR[_i]=s.m_startR[_i];
+  s.m_colourG[_i]=s.m_startG[_i];
+  s.m_colourB[_i]=s.m_startB[_i];
+  setSpotRange(_i,s.m_dirY[_i]);
+  // set the spot values that don't animate
+  m_lights.setPosition(_i,m_lightTransform*ngl::Vec4(s.m_posX[_i],s.m_posY[_i],s.m_posZ[_i],1.0f));
+  m_lights.setSpecColour(_i,ngl::Colour(1.0f,1.0f,1.0f,1.0f));
+  m_lights.setCutoff(_i,_cutoff);
+  m_lights.setInnerCutoff(_i,_innerCutoff);
+  m_lights.setExponent(_i,_exponent);
+  m_lights.setAttenuation(_i,m_attenuation.m_x,m_attenuation.m_y,m_attenuation.m_z);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::setSpotRange(size_t _i, float _dirY)
+{
+  SpotState &s=m_spotState;
+  s.m_range[_i]=SpotAnimator::range(s.m_posY[_i],SpotAnimator::cosEdge(_dirY,s.m_cosCutoff[_i],s.m_sinCutoff[_i]));
+  m_lights.setRange(_i,s.m_range[_i]);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string NGLScene::attenuationModel() const
+{
+  // matches the ATTENUATION define in SpotlightFrag.glsl
+  if(m_attenuation.m_z != 0.0f)
+  {
+    return "2";
+  }
+  return m_attenuation.m_y != 0.0f ? "1" : "0";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float NGLScene::lightSpread() const
+{
+  return 3.0f*std::sqrt(std::max(1.0f,m_numLights/8.0f));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::loadSpotsToLights()
+{
+  const SpotFrame &s=m_spotFrame;
+  for(size_t i=0; i<s.size(); ++i)
+  {
+    m_lights.setDirection(i,m_lightTransform*ngl::Vec4(s.m_dirX[i],s.m_dirY[i],s.m_dirZ[i],0.0f));
+    m_lights.setColour(i,ngl::Colour(s.m_colourR[i],s.m_colourG[i],s.m_colourB[i],1.0f));
+    m_lights.setRange(i,s.m_range[i]);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::loadSpotsToGpu()
+{
+  m_gpuSpots.setSpots(m_spotState,m_lights,m_animationTicks,m_frameStats);
+  m_gpuSpotsStale=false;
+  const std::vector<SpotParamsStd430> &params=m_gpuSpots.params();
+  for(size_t i=0; i<params.size(); ++i)
+  {
+    SpotCone cone=SpotCurve::envelope(params[i]);
+    ngl::Vec4 axis=m_lightTransform*ngl::Vec4(cone.m_axis[0],cone.m_axis[1],cone.m_axis[2],0.0f);
+    LightStd140 light=m_lights[i];
+    light.m_direction[0]=axis.m_x;
+    light.m_direction[1]=axis.m_y;
+    light.m_direction[2]=axis.m_z;
+    light.m_spotCosCutoff=cone.m_cosAngle;
+    light.m_range=cone.m_range;
+    m_lights.set(i,light);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::switchAnimation(bool _gpu)
+{
+  m_lightsOnGpu=_gpu;
+  if(_gpu)
+  {
+    // carry on from the simulation's time
+    m_animationTicks=static_cast<double>(m_simulation.ticks());
+    m_animationClock=SpotSimulation::Clock::now();
+    m_simulation.stop();
+    loadSpotsToGpu();
+  }
+  else
   {
-    // set the spot values
-    spot.setSpecColour(ngl::Colour(1.0f,1.0f,1.0f,1.0f));
-    spot.setCutoff(rand->randomPositiveNumber(24.0f)+0.5f);
-    spot.setInnerCutoff(rand->randomPositiveNumber(12)+0.1f);
-    spot.setExponent(rand->randomPositiveNumber(2)+1.0f);
-    spot.setAttenuation(1.0f,0.0f,0.0f);
-    spot.enable();
-    spot.setTransform(iv);
+    // put back the real cones, the spots pick up from the last tick simulated
+    for(size_t i=0; i<m_lights.size(); ++i)
+    {
+      LightStd140 light=m_lights[i];
+      light.m_spotCosCutoff=m_spotState.m_cosCutoff[i];
+      m_lights.set(i,light);
+    }
+    loadSpotsToLights();
+    m_lights.markAllDirty();
+    if(m_threadedAnimation && !m_recorder.isOpen() && !m_player.isOpen())
+    {
+      m_simulation.start();
+    }
+  }
+  m_clustersDirty=true;
+  m_objectListsDirty=true;
+  std::cout<<"Animating "<<m_lights.size()<<" spots on the "<<(_gpu ? "GPU" : "CPU")<<"\n";
+}
 
-    QString light=QString("light[%1]").arg(i++);
-    spot.loadToShader(light.toStdString());
+//----------------------------------------------------------------------------------------------------------------------
+bool NGLScene::uploadLights()
+{
+  if(!m_lightsOnGpu)
+  {
+    bool changed=m_lights.upload(m_dynamicBuffer,m_frameStats);
+    m_lights.bind();
+    return changed;
   }
+  // the shaders read the GPU animation's lights, the CPU copy only feeds the culling and the shadows
+  bool changed=m_lights.takeChanges();
+  m_gpuSpots.bind();
+  if(changed)
+  {
+    m_objectListsDirty=true;
+  }
+  return changed;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void NGLScene::changeSpotParams()
 {
   ngl::Random *rand=ngl::Random::instance();
-  rand->setSeed(time(nullptr));
+  // with a fixed seed we carry on the same sequence so a run can be repeated
+  if(!m_fixedSeed)
+  {
+    rand->setSeed(time(nullptr));
+  }
+  float spread=lightSpread();
+  SpotState &s=m_spotState;
   // change the spot positions
 
-  for(size_t i=0; i<8; ++i)
+  for(size_t i=0; i<m_lights.size(); ++i)
   {
-    float x=rand->randomNumber(3);
-    float z=rand->randomNumber(3);
-    m_spots[i].setPosition(ngl::Vec3(x,4,z));
-    m_spots[i].setCutoff(rand->randomPositiveNumber(24)+0.5f);
-    m_spots[i].setInnerCutoff(rand->randomPositiveNumber(12)+0.1f);
+    float x=rand->randomNumber(spread);
+    float z=rand->randomNumber(spread);
+    float cutoff=rand->randomPositiveNumber(24)+0.5f;
+    s.m_posX[i]=x;
+    s.m_posY[i]=4.0f;
+    s.m_posZ[i]=z;
+    s.m_cosCutoff[i]=cosf(ngl::radians(cutoff));
+    s.m_sinCutoff[i]=sinf(ngl::radians(cutoff));
+    m_lights.setPosition(i,m_lightTransform*ngl::Vec4(x,4,z,1.0f));
+    m_lights.setCutoff(i,cutoff);
+    m_lights.setInnerCutoff(i,rand->randomPositiveNumber(12)+0.1f);
+    // the spot keeps its current aim until the next tick, which while paused could be a while
+    setSpotRange(i,m_spotFrame.m_dirY[i]);
 
     // now we update the spot values
-    m_spotData[i].m_aimCenter=rand->getRandomPoint(x*4,0,z*4);
-    m_spotData[i].m_radiusX=rand->randomNumber(2)+0.5f;
-    m_spotData[i].m_radiusZ=rand->randomNumber(2)+0.5f;
-    m_spotData[i].m_time=rand->randomPositiveNumber(4)+0.6f;
-    m_spotData[i].m_startColour =rand->getRandomColour();
-    m_spotData[i].m_endColour =rand->getRandomColour();
-    m_spotData[i].m_mix=0.0f;
+    ngl::Vec3 aimCenter=rand->getRandomPoint(x*4,0,z*4);
+    s.m_centreX[i]=aimCenter.m_x;
+    s.m_centreZ[i]=aimCenter.m_z;
+    s.m_radiusX[i]=rand->randomNumber(2)+0.5f;
+    s.m_radiusZ[i]=rand->randomNumber(2)+0.5f;
+    s.m_timeOffset[i]=rand->randomPositiveNumber(4)+0.6f;
+    ngl::Colour start=rand->getRandomColour();
+    ngl::Colour end=rand->getRandomColour();
+    s.m_startR[i]=start.m_r;
+    s.m_startG[i]=start.m_g;
+    s.m_startB[i]=start.m_b;
+    s.m_endR[i]=end.m_r;
+    s.m_endG[i]=end.m_g;
+    s.m_endB[i]=end.m_b;
+    s.m_mix[i]=0.0f;
   }
+  m_simulation.setState(m_spotState);
+  m_gpuSpotsStale=true;
 }
-void NGLScene::timerEvent(QTimerEvent *_event )
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::setGpuAnimation(bool _gpu)
+{
+  // the switch needs the context so paintGL makes it
+  m_gpuAnimation=_gpu;
+  if(isValid())
+  {
+    update();
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::toggleAnimation()
+{
+  setAnimate(!m_animate);
+}
+
+void NGLScene::setAnimate(bool _animate)
 {
-  if(_event->timerId() == m_lightChangeTimer)
+  m_animate=_animate;
+  // the GPU animation time doesn't include the pause
+  m_animationClock=SpotSimulation::Clock::now();
+  m_simulation.setPaused(!m_animate);
+  // the timer only starts once initializeGL has run
+  if(!isValid())
   {
-   if (m_animate !=true)
-   {
     return;
-   }
-   static float time=0.0;
-   // create pointers to the begining and end of the spot vector
-    auto size=m_spots.size();
-    for(size_t i=0; i<size; ++i)
-    {
-      float pointOnCircleX= cosf(time+m_spotData[i].m_time)*m_spotData[i].m_radiusX;
-      float pointOnCircleZ= sinf(time+m_spotData[i].m_time)*m_spotData[i].m_radiusZ;
-      // get the points value we need
-      ngl::Vec4 p(m_spotData[i].m_aimCenter.m_x+pointOnCircleX,0,m_spotData[i].m_aimCenter.m_z+pointOnCircleZ,0.0f);
-      m_spots[i].setColour(trigInterp(m_spotData[i].m_startColour,m_spotData[i].m_endColour,m_spotData[i].m_mix ));
-      // do the colour mixing
-      m_spotData[i].m_mix+=0.05f;
-      if (m_spotData[i].m_mix >=1.0f)
-      {
-        m_spotData[i].m_mix=0.0f;
-      }
-      // set spot aim
-      m_spots[i].aim(p);
-      // now load to shader
-      QString light=QString("light[%1]").arg(i);
-      m_spots[i].loadToShader(light.toStdString());
+  }
+  if(m_animate && !m_redrawTimer)
+  {
+    m_redrawTimer=startTimer(16);
+  }
+  else if(!m_animate && m_redrawTimer)
+  {
+    killTimer(m_redrawTimer);
+    m_redrawTimer=0;
+  }
+}
+
+void NGLScene::stepAnimation()
+{
+  // the GPU animation takes a tick per step too, unless its time follows the clock
+  if(m_lightsOnGpu)
+  {
+    if(m_animate && !m_threadedAnimation)
+    {
+      m_animationTicks+=1.0;
     }
-    time+=0.2f;
-    update();
+    return;
+  }
+  if(m_animate && !m_simulation.isRunning() && !m_player.isOpen())
+  {
+    m_simulation.step();
+  }
+}
+
+void NGLScene::timerEvent(QTimerEvent *_event )
+{
+  if(_event->timerId() == m_redrawTimer)
+  {
+    // without the simulation thread the animation advances a tick per redraw
+    stepAnimation();
+    requestRedraw(DIRTYLIGHTS);
+  }
+  else if(_event->timerId() == m_statsTimerID)
+  {
+    reportStats();
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::setShowProfile(bool _show)
+{
+  m_showProfile=_show;
+  m_profiler.setEnabled(_show);
+}
 
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::captureFrame()
+{
+  if(m_capture.isOpen())
+  {
+    ProfileScope scope(m_profiler,"capture");
+    m_capture.capture(m_width,m_height);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::drawProfile()
+{
+  const std::vector<FrameProfiler::Phase> &phases=m_profiler.phases();
+  float y=20.0f;
+  m_text->setColour(1.0f,1.0f,1.0f);
+  m_text->renderText(10,y,"phase        cpu ms   gpu ms   calls/frame");
+  for(auto &p : phases)
+  {
+    y+=18.0f;
+    m_text->renderText(10,y,QString("%1 %2 %3 %4").arg(QString(p.m_name).leftJustified(12))
+                                                  .arg(p.m_cpuMs,8,'f',3)
+                                                  .arg(p.m_gpuMs,8,'f',3)
+                                                  .arg(p.m_calls,8,'f',1));
+  }
+  y+=18.0f;
+  m_text->renderText(10,y,QString("triangles/frame %1 %2").arg(static_cast<qulonglong>(m_frameStats.m_triangles))
+                                                          .arg(isLod() ? "(lod)" : "(full meshes)"));
+  y+=18.0f;
+  m_text->renderText(10,y,QString("teapots in view %1/%2 (%3 culling)")
+                          .arg(static_cast<qulonglong>(m_instanceCuller.count(InstanceCuller::CAMERA)))
+                          .arg(m_numInstances).arg(m_instanceCuller.isGpu() ? "gpu" : "cpu"));
+  y+=18.0f;
+  m_text->renderText(10,y,QString("ring %1 KB/frame, %2 of %3 frames waited %4 ms (%5)")
+                          .arg(m_frameStats.m_bytesStreamed/1024.0,0,'f',1)
+                          .arg(static_cast<qulonglong>(m_dynamicBuffer.waits()))
+                          .arg(static_cast<qulonglong>(m_dynamicBuffer.frames()))
+                          .arg(m_dynamicBuffer.waitTime(),0,'f',2)
+                          .arg(m_dynamicBuffer.isPersistent() ? "persistent" : "staged"));
+  if(m_resolution.isActive())
+  {
+    y+=18.0f;
+    m_text->renderText(10,y,QString("render %1x%2 (scale %3) gpu %4 ms, budget %5 ms%6")
+                            .arg(m_renderWidth).arg(m_renderHeight)
+                            .arg(m_resolution.controller().scale(),0,'f',3)
+                            .arg(m_resolution.controller().smoothedTime(),0,'f',2)
+                            .arg(m_resolution.controller().budget(),0,'f',1)
+                            .arg(m_resolution.isFxaa() ? ", fxaa" : ""));
+  }
+  // counted in the forward pass only, the deferred lighting runs once per pixel anyway
+  if(!m_deferred)
+  {
+    y+=18.0f;
+    m_text->renderText(10,y,QString("shaded samples/frame %1, overdraw %2 (depth pre-pass %3)")
+                            .arg(static_cast<qulonglong>(m_fragmentCounter.shaded()))
+                            .arg(m_fragmentCounter.overdraw(),0,'f',2)
+                            .arg(m_depthPrepass ? "on" : "off"));
+  }
+  if(m_profiler.droppedFrames())
+  {
+    y+=18.0f;
+    m_text->renderText(10,y,QString("%1 frames had no GPU timings").arg(static_cast<int>(m_profiler.droppedFrames())));
   }
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::reportStats()
+{
+  double seconds=m_statsTimer.nsecsElapsed()/1.0e9;
+  std::clock_t clock=std::clock();
+  uint64_t ticks=m_simulation.ticks();
+  uint64_t shadowTiles=m_shadowAtlas.tilesRendered();
+  uint64_t ringWaits=m_dynamicBuffer.waits();
+  double ringWaitTime=m_dynamicBuffer.waitTime();
+  // process time so the simulation thread is included, idle should be close to 0%
+  double cpu=100.0*(clock-m_statsClock)/CLOCKS_PER_SEC/seconds;
+  std::cout<<"frames drawn "<<m_statsFrames
+           <<" cached "<<m_statsCached
+           <<" sim ticks "<<ticks-m_statsTicks<<(m_lightsOnGpu ? " (spots animated on the gpu)" : "")
+           <<" cpu "<<cpu<<"%";
+  // the GPU time is only known while the profiler is running, the phases are averaged over every frame
+  if(m_profiler.isEnabled())
+  {
+    double gpuMs=0.0;
+    for(auto &p : m_profiler.phases())
+    {
+      gpuMs+=p.m_gpuMs;
+    }
+    std::cout<<" gpu "<<gpuMs*(m_statsFrames+m_statsCached)/(10.0*seconds)<<"%";
+  }
+  if(m_statsFrames)
+  {
+    std::cout<<" uniform calls/frame "<<m_statsTotal.m_uniformCalls/m_statsFrames
+             <<" bytes uploaded/frame "<<m_statsTotal.m_bytesUploaded/m_statsFrames
+             <<" bytes streamed/frame "<<m_statsTotal.m_bytesStreamed/m_statsFrames
+             <<" ring waits "<<ringWaits-m_statsRingWaits<<" ("<<ringWaitTime-m_statsRingWaitTime<<" ms)"
+             <<" triangles/frame "<<m_statsTotal.m_triangles/m_statsFrames
+             <<" shadow tiles/frame "<<static_cast<double>(shadowTiles-m_statsShadowTiles)/m_statsFrames;
+  }
+  if(m_capture.isOpen())
+  {
+    uint64_t captured=m_capture.framesCaptured();
+    const FrameWriter &writer=m_capture.writer();
+    std::cout<<" captured "<<captured-m_statsCaptured<<" (written at "<<writer.framesPerSecond()<<" fps, queue "
+             <<writer.queueDepth()<<" max "<<writer.maxQueueDepth()<<", readback waits "
+             <<m_capture.waits()-m_statsCaptureWaits<<")";
+    m_statsCaptured=captured;
+    m_statsCaptureWaits=m_capture.waits();
+  }
+  // the GPU times the render scale was chosen from, a second late as they are read back
+  ResolutionController &controller=m_resolution.controller();
+  if(m_resolution.isActive() && controller.samples())
+  {
+    std::cout<<" render scale "<<controller.meanScale()<<" gpu "<<controller.meanTime()<<" ms";
+    if(m_resolution.isScaling())
+    {
+      std::cout<<" (budget "<<controller.budget()<<" ms, "<<controller.overBudget()<<" frames over, "
+               <<controller.changes()<<" changes)";
+    }
+    controller.clearCounters();
+  }
+  if(!m_deferred && m_fragmentCounter.frames())
+  {
+    std::cout<<" shaded samples/frame "<<m_fragmentCounter.totalShaded()/m_fragmentCounter.frames()
+             <<" overdraw "<<m_fragmentCounter.meanOverdraw()<<(m_depthPrepass ? " (depth pre-pass)" : "");
+  }
+  m_fragmentCounter.clearCounters();
+  std::cout<<"\n";
+  m_statsTotal.reset();
+  m_statsFrames=0;
+  m_statsCached=0;
+  m_statsClock=clock;
+  m_statsTicks=ticks;
+  m_statsShadowTiles=shadowTiles;
+  m_statsRingWaits=ringWaits;
+  m_statsRingWaitTime=ringWaitTime;
+  m_statsTimer.restart();
+}
@@ -0,0 +1,406 @@
+#include "OffscreenBenchmark.h"
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <utility>
+#include <sys/resource.h>
+
+OffscreenBenchmark::OffscreenBenchmark(int _width, int _height, const QSurfaceFormat &_format) :
+  m_width(std::max(1,_width)),
+  m_height(std::max(1,_height)),
+  m_format(_format),
+  m_scene(new NGLScene),
+  m_totalTime(0.0),
+  m_shadowTiles(0),
+  m_triangles(0),
+  m_visibleInstances(0),
+  m_cullMismatches(0),
+  m_animationError(0.0f),
+  m_teapotVertexTime(0.0),
+  m_planeVertexTime(0.0),
+  m_ringWaits(0),
+  m_ringWaitTime(0.0),
+  m_cachedFrames(0)
+{
+  // the animation is stepped once per frame so the frames don't depend on how fast the machine is
+  m_scene->setThreadedAnimation(false);
+}
+
+OffscreenBenchmark::~OffscreenBenchmark()
+{
+  if(m_context)
+  {
+    m_context->makeCurrent(m_surface.get());
+    if(!m_queries.empty())
+    {
+      glDeleteQueries(static_cast<GLsizei>(m_queries.size()),&m_queries[0]);
+    }
+    // the scene frees its GL objects so must go while the context is still current
+    m_scene.reset();
+    m_fbo.reset();
+    m_context->doneCurrent();
+  }
+}
+
+bool OffscreenBenchmark::initialize()
+{
+  if(m_context)
+  {
+    return m_fbo && m_fbo->isValid();
+  }
+  m_surface.reset(new QOffscreenSurface);
+  m_surface->setFormat(m_format);
+  m_surface->create();
+  m_context.reset(new QOpenGLContext);
+  m_context->setFormat(m_format);
+  if(!m_surface->isValid() || !m_context->create() || !m_context->makeCurrent(m_surface.get()))
+  {
+    std::cerr<<"unable to create an offscreen OpenGL context\n";
+    return false;
+  }
+  QOpenGLFramebufferObjectFormat fboFormat;
+  fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+  fboFormat.setSamples(m_format.samples());
+  m_fbo.reset(new QOpenGLFramebufferObject(m_width,m_height,fboFormat));
+  if(!m_fbo->isValid())
+  {
+    std::cerr<<"unable to create a "<<m_width<<"x"<<m_height<<" framebuffer\n";
+    return false;
+  }
+  m_fbo->bind();
+  // same order the window would call them in
+  m_scene->initializeGL();
+  m_scene->resizeGL(m_width,m_height);
+  m_renderer=reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+  m_version=reinterpret_cast<const char *>(glGetString(GL_VERSION));
+  // timer queries are core in 3.3, everything we run on has them
+  m_queries.resize(QUERYLATENCY);
+  glGenQueries(QUERYLATENCY,&m_queries[0]);
+  return true;
+}
+
+bool OffscreenBenchmark::run(int _frames, int _warmup)
+{
+  if(!initialize())
+  {
+    return false;
+  }
+  for(int i=0; i<_warmup; ++i)
+  {
+    renderFrame(false);
+  }
+  glFinish();
+  m_cpuTimes.clear();
+  m_gpuTimes.clear();
+  m_cpuTimes.reserve(_frames);
+  m_gpuTimes.reserve(_frames);
+  if(!m_traceFile.empty())
+  {
+    m_scene->captureTrace(m_traceFile,_frames);
+  }
+  uint64_t shadowTiles=m_scene->shadowAtlas().tilesRendered();
+  uint64_t triangles=m_scene->trianglesDrawn();
+  uint64_t cachedFrames=m_scene->framesCached();
+  uint64_t ringWaits=m_scene->dynamicBuffer().waits();
+  double ringWaitTime=m_scene->dynamicBuffer().waitTime();
+  m_scene->resolution().controller().clearCounters();
+  m_scene->fragmentCounter().clearCounters();
+  QElapsedTimer total;
+  total.start();
+  for(int i=0; i<_frames; ++i)
+  {
+    renderFrame(true);
+  }
+  m_shadowTiles=m_scene->shadowAtlas().tilesRendered()-shadowTiles;
+  m_triangles=m_scene->trianglesDrawn()-triangles;
+  m_cachedFrames=m_scene->framesCached()-cachedFrames;
+  m_ringWaits=m_scene->dynamicBuffer().waits()-ringWaits;
+  m_ringWaitTime=m_scene->dynamicBuffer().waitTime()-ringWaitTime;
+  // reads the GPU lists back so it waits for the last cull
+  m_cullMismatches=m_scene->verifyCulling();
+  m_visibleInstances=m_scene->instanceCuller().count(InstanceCuller::CAMERA);
+  m_animationError=m_scene->verifyAnimation();
+  m_teapotVertexTime=m_scene->vertexStageTime(m_scene->teapotMesh(),VERTEXREPEATS);
+  m_planeVertexTime=m_scene->vertexStageTime(m_scene->planeMesh(),VERTEXREPEATS);
+  // pick up the queries still in flight
+  size_t frames=m_cpuTimes.size();
+  for(size_t f=frames-std::min(frames,static_cast<size_t>(QUERYLATENCY)); f<frames; ++f)
+  {
+    collectQuery(f);
+  }
+  glFinish();
+  m_totalTime=total.nsecsElapsed()/1.0e6;
+  // every sample count is ready after the finish
+  m_scene->fragmentCounter().collect();
+  // outside the timing, waits for the writer to get the last frames to disk
+  m_scene->finishCapture();
+  // writes the trace if one was asked for
+  m_scene->profiler().finish();
+  return true;
+}
+
+bool OffscreenBenchmark::runCrossover(size_t _maxLights, int _frames, int _warmup)
+{
+  if(!initialize())
+  {
+    return false;
+  }
+  NGLScene &scene=*m_scene;
+  bool deferred=scene.isDeferred();
+  size_t lights=scene.numLights();
+  QJsonArray counts;
+  QJsonArray forward;
+  QJsonArray deferredTimes;
+  double forwardMs=0.0;
+  double deferredMs=0.0;
+  int crossover=-1;
+  for(size_t count=8; count<=std::max<size_t>(_maxLights,8); count*=2)
+  {
+    scene.setNumLights(static_cast<int>(count));
+    double ms[2];
+    for(int path=0; path<2; ++path)
+    {
+      scene.setDeferred(path == 1);
+      run(_frames,_warmup);
+      // the GPU time is what the two paths trade off, fall back to the CPU time without timer queries
+      ms[path]=summarise(m_gpuTimes.empty() ? m_cpuTimes : m_gpuTimes).value("p50").toDouble();
+    }
+    counts.append(static_cast<int>(count));
+    forward.append(ms[0]);
+    deferredTimes.append(ms[1]);
+    // the crossover is the first count from which deferred stays ahead
+    if(ms[1] < ms[0])
+    {
+      if(crossover < 0)
+      {
+        crossover=static_cast<int>(count);
+      }
+    }
+    else
+    {
+      crossover=-1;
+    }
+    forwardMs=ms[0];
+    deferredMs=ms[1];
+  }
+  m_crossover=QJsonObject();
+  m_crossover["lights"]=counts;
+  m_crossover["forward_p50_ms"]=forward;
+  m_crossover["deferred_p50_ms"]=deferredTimes;
+  m_crossover["deferred_wins_from"]=crossover < 0 ? QJsonValue() : QJsonValue(crossover);
+  std::cerr<<"deferred "<<(crossover < 0 ? std::string("never wins") : "wins from "+std::to_string(crossover)+" lights")
+           <<" (at the largest count forward "<<forwardMs<<" ms, deferred "<<deferredMs<<" ms)\n";
+  // leave the scene as it was configured
+  scene.setDeferred(deferred);
+  scene.setNumLights(static_cast<int>(lights));
+  return true;
+}
+
+void OffscreenBenchmark::renderFrame(bool _record)
+{
+  size_t frame=m_cpuTimes.size();
+  GLuint query=0;
+  if(_record)
+  {
+    // reuse the oldest query in the ring, by now its result should be ready so this rarely stalls
+    if(frame >= QUERYLATENCY)
+    {
+      collectQuery(frame-QUERYLATENCY);
+    }
+    query=m_queries[frame%QUERYLATENCY];
+  }
+  QElapsedTimer timer;
+  timer.start();
+  m_scene->stepAnimation();
+  if(query)
+  {
+    glBeginQuery(GL_TIME_ELAPSED,query);
+  }
+  m_scene->paintGL();
+  if(query)
+  {
+    glEndQuery(GL_TIME_ELAPSED);
+  }
+  double cpu=timer.nsecsElapsed()/1.0e6;
+  // stands in for the buffer swap so the driver doesn't batch up several frames
+  glFlush();
+  if(_record)
+  {
+    m_cpuTimes.push_back(cpu);
+  }
+}
+
+void OffscreenBenchmark::collectQuery(size_t _frame)
+{
+  GLuint64 elapsed=0;
+  glGetQueryObjectui64v(m_queries[_frame%QUERYLATENCY],GL_QUERY_RESULT,&elapsed);
+  m_gpuTimes.push_back(elapsed/1.0e6);
+}
+
+QJsonObject OffscreenBenchmark::summarise(std::vector<double> _times)
+{
+  QJsonObject summary;
+  if(_times.empty())
+  {
+    return summary;
+  }
+  std::sort(_times.begin(),_times.end());
+  // nearest rank percentile
+  auto percentile=[&_times](double _p)
+  {
+    size_t rank=static_cast<size_t>(std::ceil(_p/100.0*_times.size()));
+    return _times[std::max<size_t>(rank,1)-1];
+  };
+  summary["mean"]=std::accumulate(_times.begin(),_times.end(),0.0)/_times.size();
+  summary["min"]=_times.front();
+  summary["max"]=_times.back();
+  summary["p50"]=percentile(50.0);
+  summary["p95"]=percentile(95.0);
+  summary["p99"]=percentile(99.0);
+  return summary;
+}
+
+QJsonObject OffscreenBenchmark::results() const
+{
+  QJsonObject results;
+  results["renderer"]=m_renderer;
+  results["version"]=m_version;
+  results["width"]=m_width;
+  results["height"]=m_height;
+  results["samples"]=m_format.samples();
+  results["lights"]=static_cast<int>(m_scene->numLights());
+  results["instances"]=m_scene->numInstances();
+  results["instanced"]=m_scene->isInstanced();
+  results["deferred"]=m_scene->isDeferred();
+  // per object light lists of the last frame, lit objects using the cluster lists aren't counted
+  const LightCuller &culler=m_scene->lightCuller();
+  size_t listed=0;
+  for(size_t o=0; o<culler.numObjects(); ++o)
+  {
+    uint32_t count;
+    culler.lightsForObject(o,count);
+    if(count != LightCuller::USECLUSTERS)
+    {
+      listed+=count;
+    }
+  }
+  size_t withLists=culler.numObjects()-culler.numOverflowed();
+  results["object_culling"]=m_scene->isObjectCulling();
+  results["unlit_objects"]=static_cast<int>(culler.numUnlit());
+  results["cluster_objects"]=static_cast<int>(culler.numOverflowed());
+  results["lights_per_object"]=withLists ? static_cast<double>(listed)/withLists : 0.0;
+  const ShadowAtlas &shadows=m_scene->shadowAtlas();
+  results["shadows"]=shadows.isEnabled();
+  results["shadow_budget"]=static_cast<int>(shadows.budget());
+  results["shadowed_lights"]=static_cast<int>(shadows.numShadowed());
+  results["stale_shadows"]=static_cast<int>(shadows.numStale());
+  results["shadow_tiles_per_frame"]=m_cpuTimes.empty() ? 0.0 : static_cast<double>(m_shadowTiles)/m_cpuTimes.size();
+  results["lod"]=m_scene->isLod();
+  results["gpu_culling"]=m_scene->instanceCuller().isGpu();
+  results["visible_instances"]=static_cast<int>(m_visibleInstances);
+  results["cull_mismatches"]=static_cast<int>(m_cullMismatches);
+  results["gpu_animation"]=m_scene->isGpuAnimation();
+  const FrameCapture &capture=m_scene->frameCapture();
+  results["capture_frames"]=static_cast<qint64>(capture.writer().framesWritten());
+  results["capture_fps"]=capture.writer().framesPerSecond();
+  results["capture_max_queue"]=static_cast<int>(capture.writer().maxQueueDepth());
+  results["capture_writer_stalls"]=static_cast<qint64>(capture.writer().stalls());
+  results["capture_readback_waits"]=static_cast<qint64>(capture.waits());
+  results["capture_readback_wait_ms"]=capture.waitTime();
+  results["gpu_animation_max_error"]=static_cast<double>(m_animationError);
+  // the size of each mesh in both layouts, only the one in use is timed
+  results["vertex_layout"]=m_scene->isPackedVertices() ? "packed" : "float";
+  const std::pair<const char *,const StaticMesh *> meshes[]={{"teapot",&m_scene->teapotMesh()},
+                                                             {"plane",&m_scene->planeMesh()}};
+  for(const auto &mesh : meshes)
+  {
+    QString name(mesh.first);
+    for(StaticMesh::Layout layout : {StaticMesh::Layout::FLOAT,StaticMesh::Layout::PACKED})
+    {
+      size_t bytes=mesh.second->numVertices()*StaticMesh::vertexSize(layout)+mesh.second->indexBytes();
+      results[name+(layout == StaticMesh::Layout::PACKED ? "_packed_kb" : "_float_kb")]=bytes/1024.0;
+    }
+  }
+  results["teapot_acmr_before"]=static_cast<double>(m_scene->teapotCacheStats().m_before);
+  results["teapot_acmr"]=static_cast<double>(m_scene->teapotCacheStats().m_after);
+  results["plane_acmr_before"]=static_cast<double>(m_scene->planeCacheStats().m_before);
+  results["plane_acmr"]=static_cast<double>(m_scene->planeCacheStats().m_after);
+  results["teapot_vertex_ms"]=m_teapotVertexTime;
+  results["plane_vertex_ms"]=m_planeVertexTime;
+  const FragmentCounter &fragments=m_scene->fragmentCounter();
+  results["depth_prepass"]=m_scene->isDepthPrepass();
+  results["shaded_samples_per_frame"]= fragments.frames() ? static_cast<double>(fragments.totalShaded())/fragments.frames()
+                                                          : 0.0;
+  results["overdraw"]=fragments.meanOverdraw();
+  results["job_threads"]=static_cast<qint64>(m_scene->jobSystem().numThreads());
+  results["job_steals"]=static_cast<qint64>(m_scene->jobSystem().steals());
+  results["ring_persistent"]=m_scene->dynamicBuffer().isPersistent();
+  results["ring_region_kb"]=m_scene->dynamicBuffer().regionSize()/1024.0;
+  results["ring_fence_waits"]=static_cast<qint64>(m_ringWaits);
+  results["ring_wait_ms"]=m_ringWaitTime;
+  results["ring_max_wait_ms"]=m_scene->dynamicBuffer().maxWait();
+  // the scale the controller held over the timed frames and how often the frames went over the budget
+  const DynamicResolution &resolution=m_scene->resolution();
+  results["frame_budget_ms"]=resolution.controller().budget();
+  results["fxaa"]=resolution.isFxaa();
+  results["half_res_lighting"]=m_scene->isHalfResLighting();
+  results["render_scale_mean"]=resolution.isScaling() ? resolution.controller().meanScale() : 1.0;
+  results["render_scale_final"]=resolution.isScaling() ? resolution.controller().scale() : 1.0;
+  results["render_size_final"]=QString("%1x%2").arg(resolution.isActive() ? resolution.renderWidth() : m_width)
+                                               .arg(resolution.isActive() ? resolution.renderHeight() : m_height);
+  results["resolution_changes"]=static_cast<qint64>(resolution.controller().changes());
+  results["over_budget_frames"]=static_cast<qint64>(resolution.controller().overBudget());
+  results["triangles_per_frame"]=m_cpuTimes.empty() ? 0.0 : static_cast<double>(m_triangles)/m_cpuTimes.size();
+  results["animated"]=m_scene->isAnimating();
+  results["frames"]=static_cast<int>(m_cpuTimes.size());
+  results["cached_frames"]=static_cast<int>(m_cachedFrames);
+  results["total_ms"]=m_totalTime;
+  results["fps"]=m_totalTime > 0.0 ? m_cpuTimes.size()*1000.0/m_totalTime : 0.0;
+  const ShaderCache &shaders=m_scene->shaderCache();
+  results["shader_build_ms"]=shaders.buildTime();
+  results["shaders_cached"]=static_cast<int>(shaders.hits());
+  results["shaders_compiled"]=static_cast<int>(shaders.misses());
+  results["plane_mesh_ms"]=m_scene->planeTime();
+  results["plane_mesh_source"]=QString::fromStdString(m_scene->planeSource());
+  results["first_frame_ms"]=m_scene->firstFrameTime();
+  results["scene"]=QString::fromStdString(m_scene->sceneFile());
+  results["scene_load_ms"]=m_scene->sceneLoadTime();
+  results["record"]=QString::fromStdString(m_scene->recordFile());
+  results["recorded_ticks"]=static_cast<int>(m_scene->recorder().numTicks());
+  results["record_bytes_per_tick"]=m_scene->recorder().numTicks() ?
+                                   static_cast<double>(m_scene->recorder().bytesWritten())/m_scene->recorder().numTicks() : 0.0;
+  results["replay"]=QString::fromStdString(m_scene->replayFile());
+  results["replayed_ticks"]=static_cast<qint64>(m_scene->player().ticksPlayed());
+  // the high water mark of the whole run, ru_maxrss is in KB on Linux and bytes on macOS
+  struct rusage usage;
+  getrusage(RUSAGE_SELF,&usage);
+#if defined(__APPLE__)
+  results["peak_rss_mb"]=usage.ru_maxrss/(1024.0*1024.0);
+#else
+  results["peak_rss_mb"]=usage.ru_maxrss/1024.0;
+#endif
+  results["cpu_ms"]=summarise(m_cpuTimes);
+  results["gpu_ms"]=summarise(m_gpuTimes);
+  if(!m_crossover.isEmpty())
+  {
+    results["crossover"]=m_crossover;
+  }
+  return results;
+}
+
+bool OffscreenBenchmark::saveFrame(const QString &_fname) const
+{
+  if(!m_fbo)
+  {
+    return false;
+  }
+  // toImage resolves the multisampled buffer for us
+  return m_fbo->toImage().save(_fname);
+}
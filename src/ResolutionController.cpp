@@ -0,0 +1,92 @@
+#include "ResolutionController.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr float ResolutionController::STEP;
+constexpr double ResolutionController::TARGETFRACTION;
+constexpr double ResolutionController::LOWFRACTION;
+constexpr double ResolutionController::SMOOTHING;
+constexpr int ResolutionController::COOLDOWN;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the most the scale moves in one change, down then up
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static float MAXDROP=0.75f;
+constexpr static float MAXRISE=1.1f;
+
+void ResolutionController::setBudget(double _ms)
+{
+  m_budget=_ms;
+  reset();
+}
+
+void ResolutionController::setLimits(float _min, float _max)
+{
+  m_max=std::min(std::max(_max,STEP),1.0f);
+  m_min=std::min(std::max(_min,STEP),m_max);
+  m_scale=std::min(std::max(m_scale,m_min),m_max);
+}
+
+void ResolutionController::reset()
+{
+  m_scale=m_max;
+  m_smoothed=0.0;
+  m_cooldown=0;
+}
+
+void ResolutionController::clearCounters()
+{
+  m_samples=0;
+  m_timeSum=0.0;
+  m_scaleSum=0.0;
+  m_overBudget=0;
+  m_changes=0;
+}
+
+bool ResolutionController::update(double _ms)
+{
+  ++m_samples;
+  m_timeSum+=_ms;
+  m_scaleSum+=m_scale;
+  if(m_budget > 0.0 && _ms > m_budget)
+  {
+    ++m_overBudget;
+  }
+  m_smoothed= m_smoothed > 0.0 ? m_smoothed+SMOOTHING*(_ms-m_smoothed) : _ms;
+  if(m_budget <= 0.0 || m_smoothed <= 0.0)
+  {
+    return false;
+  }
+  if(m_cooldown > 0)
+  {
+    --m_cooldown;
+    return false;
+  }
+  bool over=m_smoothed > m_budget;
+  bool under=m_smoothed < m_budget*LOWFRACTION && m_scale < m_max;
+  if(!over && !under)
+  {
+    return false;
+  }
+  // the time follows the pixel count, the square of the scale
+  float wanted=m_scale*static_cast<float>(std::sqrt(m_budget*TARGETFRACTION/m_smoothed));
+  wanted=std::min(std::max(wanted,m_scale*MAXDROP),m_scale*MAXRISE);
+  wanted=std::min(std::max(wanted,m_min),m_max);
+  // round down so a rise never lands just over the target, a drop always moves at least a step
+  float stepped=std::floor(wanted/STEP)*STEP;
+  if(over && stepped >= m_scale)
+  {
+    stepped=m_scale-STEP;
+  }
+  stepped=std::min(std::max(stepped,m_min),m_max);
+  if(stepped == m_scale)
+  {
+    return false;
+  }
+  // expect the new size's time until it has been measured
+  m_smoothed*=(stepped*stepped)/(m_scale*m_scale);
+  m_scale=stepped;
+  m_cooldown=COOLDOWN;
+  ++m_changes;
+  return true;
+}
@@ -0,0 +1,125 @@
+#include "SceneFile.h"
+#include <cstdio>
+#include <limits>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief round up to the array alignment
+//----------------------------------------------------------------------------------------------------------------------
+static uint64_t alignUp(uint64_t _bytes)
+{
+  return (_bytes+SceneFile::ALIGN-1)/SceneFile::ALIGN*SceneFile::ALIGN;
+}
+
+bool SceneFile::open(const std::string &_fname)
+{
+  if(!m_file.open(_fname) || m_file.size() < sizeof(SceneHeader))
+  {
+    m_file.close();
+    return false;
+  }
+  const SceneHeader &h=header();
+  uint64_t size=m_file.size();
+  uint64_t instanceBytes=uint64_t(h.m_instanceCount)*MATRIXFLOATS*sizeof(float);
+  uint64_t spotBytes=uint64_t(h.m_spotColumns)*h.m_spotPitch*sizeof(float);
+  // the offsets are checked against the size before anything is added to them so nothing can overflow
+  bool valid=h.m_magic == MAGIC && h.m_version == VERSION && h.m_spotColumns == SPOTCOLUMNS &&
+             h.m_spotPitch >= h.m_spotCount &&
+             h.m_instanceOffset%ALIGN == 0 && h.m_spotOffset%ALIGN == 0 &&
+             h.m_instanceOffset >= sizeof(SceneHeader) && h.m_instanceOffset <= size && h.m_spotOffset <= size &&
+             instanceBytes <= size-h.m_instanceOffset && spotBytes <= size-h.m_spotOffset &&
+             h.m_spotOffset >= h.m_instanceOffset+instanceBytes;
+  if(!valid)
+  {
+    m_file.close();
+  }
+  return valid;
+}
+
+void SceneFile::releaseInstances(size_t _first, size_t _count) const
+{
+  const size_t stride=MATRIXFLOATS*sizeof(float);
+  m_file.release(header().m_instanceOffset+_first*stride,_count*stride);
+}
+
+bool SceneWriter::begin(const std::string &_fname)
+{
+  m_fname=_fname;
+  // write to a temporary and rename so a failed conversion never leaves a half written scene behind
+  m_tmp=_fname+".tmp";
+  m_out.open(m_tmp,std::ios::binary | std::ios::trunc);
+  if(!m_out.is_open())
+  {
+    return false;
+  }
+  m_instanceCount=0;
+  for(auto &column : m_spots)
+  {
+    column.clear();
+  }
+  // the header is filled in by finish, until then reserve its space up to the first array
+  const char zeros[SceneFile::ALIGN]={};
+  m_out.write(zeros,static_cast<std::streamsize>(alignUp(sizeof(SceneHeader))));
+  return true;
+}
+
+void SceneWriter::addInstance(const float _model[SceneFile::MATRIXFLOATS])
+{
+  m_out.write(reinterpret_cast<const char *>(_model),SceneFile::MATRIXFLOATS*sizeof(float));
+  ++m_instanceCount;
+}
+
+void SceneWriter::addSpot(const float _spot[SceneFile::SPOTCOLUMNS])
+{
+  for(size_t i=0; i<SceneFile::SPOTCOLUMNS; ++i)
+  {
+    m_spots[i].push_back(_spot[i]);
+  }
+}
+
+bool SceneWriter::finish()
+{
+  if(m_instanceCount > std::numeric_limits<uint32_t>::max() || numSpots() > std::numeric_limits<uint32_t>::max())
+  {
+    abort();
+    return false;
+  }
+  SceneHeader header;
+  header.m_magic=SceneFile::MAGIC;
+  header.m_version=SceneFile::VERSION;
+  header.m_instanceCount=static_cast<uint32_t>(m_instanceCount);
+  header.m_spotCount=static_cast<uint32_t>(numSpots());
+  header.m_instanceOffset=alignUp(sizeof(SceneHeader));
+  // a matrix is exactly ALIGN bytes so the spots already start aligned
+  header.m_spotOffset=alignUp(header.m_instanceOffset+m_instanceCount*SceneFile::MATRIXFLOATS*sizeof(float));
+  header.m_spotColumns=SceneFile::SPOTCOLUMNS;
+  // pad each column so the next one is aligned too
+  const size_t alignFloats=SceneFile::ALIGN/sizeof(float);
+  header.m_spotPitch=static_cast<uint32_t>((numSpots()+alignFloats-1)/alignFloats*alignFloats);
+  std::vector<float> padding(header.m_spotPitch-numSpots(),0.0f);
+  for(const auto &column : m_spots)
+  {
+    if(!column.empty())
+    {
+      m_out.write(reinterpret_cast<const char *>(&column[0]),static_cast<std::streamsize>(column.size()*sizeof(float)));
+    }
+    if(!padding.empty())
+    {
+      m_out.write(reinterpret_cast<const char *>(&padding[0]),static_cast<std::streamsize>(padding.size()*sizeof(float)));
+    }
+  }
+  m_out.seekp(0);
+  m_out.write(reinterpret_cast<const char *>(&header),sizeof(header));
+  m_out.close();
+  if(!m_out)
+  {
+    std::remove(m_tmp.c_str());
+    return false;
+  }
+  return std::rename(m_tmp.c_str(),m_fname.c_str()) == 0;
+}
+
+void SceneWriter::abort()
+{
+  m_out.close();
+  std::remove(m_tmp.c_str());
+}
@@ -0,0 +1,318 @@
+#include "ShaderCache.h"
+#include <ngl/ShaderLib.h>
+#include <QOpenGLContext>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "Fnv1a.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief tag at the start of every cache file
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static uint32_t CACHEMAGIC=0x43425053; // SPBC
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the KHR and ARB parallel compile extensions share their enums and entry point signature
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static GLuint MAXCOMPILERTHREADS=0xFFFFFFFF;
+typedef void (APIENTRY *MaxShaderCompilerThreadsProc)(GLuint _count);
+
+namespace
+{
+std::string readFile(const std::string &_fname)
+{
+  std::ifstream in(_fname);
+  if(!in.is_open())
+  {
+    std::cerr<<"unable to open shader source "<<_fname<<"\n";
+    return std::string();
+  }
+  std::stringstream source;
+  source<<in.rdbuf();
+  return source.str();
+}
+}
+
+ShaderCache::ShaderCache(const std::string &_directory) :
+  m_directory(_directory),
+  m_buildMs(0.0),
+  m_hits(0),
+  m_misses(0),
+  m_parallel(false),
+  m_parallelChecked(false)
+{
+}
+
+std::string ShaderCache::injectDefines(const std::string &_source, const Defines &_defines)
+{
+  std::string defines;
+  for(auto &d : _defines)
+  {
+    defines+="#define "+d.first+" "+d.second+"\n";
+  }
+  // #version must stay the first line, everything else can follow it
+  size_t version=_source.find("#version");
+  if(version == std::string::npos)
+  {
+    return defines+_source;
+  }
+  size_t eol=_source.find('\n',version);
+  if(eol == std::string::npos)
+  {
+    return _source+"\n"+defines;
+  }
+  return _source.substr(0,eol+1)+defines+_source.substr(eol+1);
+}
+
+std::string ShaderCache::floatDefine(float _value)
+{
+  char literal[32];
+  snprintf(literal,sizeof(literal),"%.9g",_value);
+  std::string value=literal;
+  // a whole number would be read as an int
+  if(value.find_first_of(".e") == std::string::npos)
+  {
+    value+=".0";
+  }
+  return value;
+}
+
+GLuint ShaderCache::compile(GLenum _type, const std::string &_source)
+{
+  GLuint shader=glCreateShader(_type);
+  const char *source=_source.c_str();
+  glShaderSource(shader,1,&source,nullptr);
+  glCompileShader(shader);
+  return shader;
+}
+
+void ShaderCache::printLog(GLuint _object, bool _program)
+{
+  GLint length=0;
+  if(_program)
+  {
+    glGetProgramiv(_object,GL_INFO_LOG_LENGTH,&length);
+  }
+  else
+  {
+    glGetShaderiv(_object,GL_INFO_LOG_LENGTH,&length);
+  }
+  if(length <= 1)
+  {
+    return;
+  }
+  std::string log(static_cast<size_t>(length),'\0');
+  if(_program)
+  {
+    glGetProgramInfoLog(_object,length,nullptr,&log[0]);
+  }
+  else
+  {
+    glGetShaderInfoLog(_object,length,nullptr,&log[0]);
+  }
+  std::cerr<<log<<"\n";
+}
+
+bool ShaderCache::loadBinary(GLuint _program, const std::string &_path)
+{
+  std::ifstream in(_path,std::ios::binary);
+  if(!in.is_open())
+  {
+    return false;
+  }
+  uint32_t header[3]={0,0,0};
+  in.read(reinterpret_cast<char *>(header),sizeof(header));
+  if(!in || header[0] != CACHEMAGIC || header[2] == 0)
+  {
+    return false;
+  }
+  std::vector<char> binary(header[2]);
+  in.read(&binary[0],static_cast<std::streamsize>(binary.size()));
+  if(!in)
+  {
+    return false;
+  }
+  glProgramBinary(_program,header[1],&binary[0],static_cast<GLsizei>(binary.size()));
+  // a driver update can reject an old binary even though our key matched, we just rebuild
+  GLint linked=GL_FALSE;
+  glGetProgramiv(_program,GL_LINK_STATUS,&linked);
+  return linked == GL_TRUE;
+}
+
+void ShaderCache::saveBinary(GLuint _program, const std::string &_path)
+{
+  GLint length=0;
+  glGetProgramiv(_program,GL_PROGRAM_BINARY_LENGTH,&length);
+  if(length <= 0)
+  {
+    return;
+  }
+  std::vector<char> binary(static_cast<size_t>(length));
+  GLenum format=0;
+  glGetProgramBinary(_program,length,nullptr,&format,&binary[0]);
+  std::ofstream out(_path,std::ios::binary | std::ios::trunc);
+  if(!out.is_open())
+  {
+    std::cerr<<"unable to write shader cache "<<_path<<"\n";
+    return;
+  }
+  uint32_t header[3]={CACHEMAGIC,format,static_cast<uint32_t>(length)};
+  out.write(reinterpret_cast<const char *>(header),sizeof(header));
+  out.write(&binary[0],length);
+}
+
+void ShaderCache::enableParallelCompile()
+{
+  if(m_parallelChecked)
+  {
+    return;
+  }
+  m_parallelChecked=true;
+  QOpenGLContext *context=QOpenGLContext::currentContext();
+  if(context == nullptr)
+  {
+    return;
+  }
+  const char *entry=nullptr;
+  if(context->hasExtension("GL_KHR_parallel_shader_compile"))
+  {
+    entry="glMaxShaderCompilerThreadsKHR";
+  }
+  else if(context->hasExtension("GL_ARB_parallel_shader_compile"))
+  {
+    entry="glMaxShaderCompilerThreadsARB";
+  }
+  if(entry == nullptr)
+  {
+    return;
+  }
+  MaxShaderCompilerThreadsProc maxThreads=
+      reinterpret_cast<MaxShaderCompilerThreadsProc>(context->getProcAddress(entry));
+  if(maxThreads)
+  {
+    // let the driver pick the number of threads
+    maxThreads(MAXCOMPILERTHREADS);
+    m_parallel=true;
+  }
+}
+
+bool ShaderCache::build(const std::string &_vertex, const std::string &_fragment,
+                        const std::vector<Variant> &_variants)
+{
+  return buildStages({{GL_VERTEX_SHADER,_vertex},{GL_FRAGMENT_SHADER,_fragment}},_variants);
+}
+
+bool ShaderCache::buildCompute(const std::string &_compute, const std::vector<Variant> &_variants)
+{
+  return buildStages({{GL_COMPUTE_SHADER,_compute}},_variants);
+}
+
+bool ShaderCache::buildStages(const std::vector<std::pair<GLenum,std::string>> &_stages,
+                              const std::vector<Variant> &_variants)
+{
+  std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+  std::vector<std::string> sources;
+  for(auto &stage : _stages)
+  {
+    sources.push_back(readFile(stage.second));
+    if(sources.back().empty())
+    {
+      return false;
+    }
+  }
+  GLint formats=0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS,&formats);
+  bool useCache=!m_directory.empty() && formats > 0;
+  // binaries are only valid for the driver that made them
+  std::string driver=std::string(reinterpret_cast<const char *>(glGetString(GL_RENDERER)))+
+                     reinterpret_cast<const char *>(glGetString(GL_VERSION));
+  uint64_t driverKey=fnv1a(driver);
+
+  struct Pending
+  {
+    GLuint m_program;
+    std::vector<GLuint> m_shaders;
+    const std::string *m_name;
+    std::string m_path;
+  };
+  std::vector<Pending> pending;
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  for(auto &v : _variants)
+  {
+    shader->createShaderProgram(v.m_program);
+    GLuint program=shader->getProgramID(v.m_program);
+    std::vector<std::string> stages;
+    // the key chains the final source of every stage in order
+    uint64_t key=driverKey;
+    for(auto &source : sources)
+    {
+      stages.push_back(injectDefines(source,v.m_defines));
+      key=fnv1a(stages.back(),key);
+    }
+    std::string path;
+    if(useCache)
+    {
+      char name[17];
+      snprintf(name,sizeof(name),"%016llx",static_cast<unsigned long long>(key));
+      path=m_directory+"/"+v.m_program+"-"+name+".bin";
+      if(loadBinary(program,path))
+      {
+        ++m_hits;
+        continue;
+      }
+    }
+    enableParallelCompile();
+    Pending p={program,{},&v.m_program,path};
+    for(size_t i=0; i<stages.size(); ++i)
+    {
+      p.m_shaders.push_back(compile(_stages[i].first,stages[i]));
+      glAttachShader(program,p.m_shaders.back());
+    }
+    if(useCache)
+    {
+      glProgramParameteri(program,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
+    }
+    glLinkProgram(program);
+    pending.push_back(p);
+  }
+
+  // nothing above waited on the compiler, the first status query is where we block
+  bool ok=true;
+  for(auto &p : pending)
+  {
+    ++m_misses;
+    GLint linked=GL_FALSE;
+    glGetProgramiv(p.m_program,GL_LINK_STATUS,&linked);
+    if(linked != GL_TRUE)
+    {
+      std::cerr<<"failed to build shader variant "<<*p.m_name<<"\n";
+      for(GLuint s : p.m_shaders)
+      {
+        printLog(s,false);
+      }
+      printLog(p.m_program,true);
+      ok=false;
+    }
+    for(GLuint s : p.m_shaders)
+    {
+      glDetachShader(p.m_program,s);
+      glDeleteShader(s);
+    }
+    if(linked == GL_TRUE && !p.m_path.empty())
+    {
+      saveBinary(p.m_program,p.m_path);
+    }
+  }
+  // ShaderLib didn't link these itself so tell it to look up their uniforms
+  for(auto &v : _variants)
+  {
+    shader->autoRegisterUniforms(v.m_program);
+  }
+  double ms=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+  m_buildMs+=ms;
+  std::cout<<"built "<<_variants.size()<<" shader variants in "<<ms<<" ms ("
+           <<_variants.size()-pending.size()<<" from cache, "<<pending.size()<<" compiled"
+           <<(m_parallel ? " in parallel" : "")<<")\n";
+  return ok;
+}
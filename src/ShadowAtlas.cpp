@@ -0,0 +1,381 @@
+#include "ShadowAtlas.h"
+#include <ngl/Util.h>
+#include <ngl/Vec3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include "SpotCone.h"
+
+constexpr GLuint ShadowAtlas::DATAUNIT;
+constexpr GLuint ShadowAtlas::ATLASUNIT;
+constexpr int ShadowAtlas::MINTILE;
+constexpr int ShadowAtlas::MAXTILE;
+constexpr size_t ShadowAtlas::TEXELS;
+
+ShadowAtlas::~ShadowAtlas()
+{
+  glDeleteFramebuffers(1,&m_framebuffer);
+  glDeleteTextures(1,&m_depth);
+}
+
+bool ShadowAtlas::create(int _size)
+{
+  // the layout needs a power of two number of the smallest tiles along each edge
+  m_size=MAXTILE;
+  while(m_size < _size)
+  {
+    m_size*=2;
+  }
+  m_dataBuffer.create(GL_RGBA32F,DATAUNIT);
+  glGenTextures(1,&m_depth);
+  glBindTexture(GL_TEXTURE_2D,m_depth);
+  glTexImage2D(GL_TEXTURE_2D,0,GL_DEPTH_COMPONENT24,m_size,m_size,0,GL_DEPTH_COMPONENT,GL_FLOAT,nullptr);
+  // compare mode with linear filtering gives a 2x2 percentage closer filter from each lookup
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_COMPARE_MODE,GL_COMPARE_REF_TO_TEXTURE);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_COMPARE_FUNC,GL_LEQUAL);
+  glBindTexture(GL_TEXTURE_2D,0);
+
+  GLint previous;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&previous);
+  glGenFramebuffers(1,&m_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER,m_framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,GL_TEXTURE_2D,m_depth,0);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+  bool complete=glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER,static_cast<GLuint>(previous));
+  invalidate();
+  if(!complete)
+  {
+    std::cerr<<"unable to create a "<<m_size<<"x"<<m_size<<" shadow atlas, shadows are disabled\n";
+    glDeleteFramebuffers(1,&m_framebuffer);
+    glDeleteTextures(1,&m_depth);
+    m_framebuffer=m_depth=0;
+    m_enabled=false;
+    return false;
+  }
+  return true;
+}
+
+void ShadowAtlas::bindToProgram(GLuint _programID) const
+{
+  m_dataBuffer.bindToProgram(_programID,"shadowData");
+  GLint location=glGetUniformLocation(_programID,"shadowAtlas");
+  if(location == -1)
+  {
+    std::cerr<<"sampler shadowAtlas not found in program "<<_programID<<"\n";
+    return;
+  }
+  glUseProgram(_programID);
+  glUniform1i(location,static_cast<GLint>(ATLASUNIT));
+}
+
+void ShadowAtlas::bind() const
+{
+  m_dataBuffer.bind();
+  glActiveTexture(GL_TEXTURE0+ATLASUNIT);
+  glBindTexture(GL_TEXTURE_2D,m_depth);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowAtlas::invalidate()
+{
+  for(auto &s : m_slots)
+  {
+    s.m_tile={0,0,0};
+    s.m_request=0;
+    s.m_drawnFrame=0;
+  }
+  std::fill(m_data.begin(),m_data.end(),0.0f);
+  m_dataDirty=true;
+}
+
+size_t ShadowAtlas::numShadowed() const
+{
+  size_t count=0;
+  for(auto &s : m_slots)
+  {
+    count+= s.m_tile.m_size && s.m_drawnFrame ? 1 : 0;
+  }
+  return count;
+}
+
+int ShadowAtlas::tileSize(const LightStd140 &_light, const ngl::Mat4 &_project, int _height, float &o_coverage)
+{
+  o_coverage=0.0f;
+  BoundingSphere bounds=coneBoundingSphere(spotConeFromLight(_light));
+  const float *c=bounds.m_centre;
+  float r=bounds.m_radius;
+  float depth=-c[2];
+  if(depth+r <= 0.0f)
+  {
+    return 0;
+  }
+  // outside a side plane of the symmetric frustum
+  float sx=_project.m_m[0][0];
+  float sy=_project.m_m[1][1];
+  if(std::fabs(c[0])*sx-depth > r*std::sqrt(sx*sx+1.0f) || std::fabs(c[1])*sy-depth > r*std::sqrt(sy*sy+1.0f))
+  {
+    return 0;
+  }
+  // the projected diameter, once the camera is inside the sphere it covers the whole screen
+  o_coverage=r*sy/std::max(depth,r)*_height;
+  int size=MINTILE;
+  while(size < o_coverage && size < MAXTILE)
+  {
+    size*=2;
+  }
+  return size;
+}
+
+void ShadowAtlas::layout(std::vector<int> &io_sizes, int _atlasSize, std::vector<Tile> &o_tiles)
+{
+  auto cells=[](int _size)
+  {
+    size_t edge=static_cast<size_t>(_size/MINTILE);
+    return edge*edge;
+  };
+  auto largestFirst=[&io_sizes](size_t _a, size_t _b){return io_sizes[_a] > io_sizes[_b];};
+  std::vector<size_t> order(io_sizes.size());
+  std::iota(order.begin(),order.end(),0);
+  std::stable_sort(order.begin(),order.end(),largestFirst);
+  size_t capacity=cells(_atlasSize);
+  size_t used=0;
+  for(int size : io_sizes)
+  {
+    used+=cells(size);
+  }
+  // halve the largest tiles until everything fits, then drop the last lights
+  for(int size=MAXTILE; size > MINTILE && used > capacity; size/=2)
+  {
+    for(auto i=order.rbegin(); i!=order.rend() && used > capacity; ++i)
+    {
+      if(io_sizes[*i] == size)
+      {
+        io_sizes[*i]=size/2;
+        used-=cells(size)-cells(size/2);
+      }
+    }
+  }
+  for(auto i=order.rbegin(); i!=order.rend() && used > capacity; ++i)
+  {
+    used-=cells(io_sizes[*i]);
+    io_sizes[*i]=0;
+  }
+  std::stable_sort(order.begin(),order.end(),largestFirst);
+  // placing the tiles largest first along a Morton curve of the smallest tiles keeps every tile square and
+  // aligned to its own size, so there are no gaps
+  o_tiles.assign(io_sizes.size(),{0,0,0});
+  size_t cursor=0;
+  for(size_t i : order)
+  {
+    if(io_sizes[i] == 0)
+    {
+      break;
+    }
+    int x=0;
+    int y=0;
+    for(int bit=0; bit<16; ++bit)
+    {
+      x|=static_cast<int>((cursor>>(2*bit))&1)<<bit;
+      y|=static_cast<int>((cursor>>(2*bit+1))&1)<<bit;
+    }
+    o_tiles[i]={x*MINTILE,y*MINTILE,io_sizes[i]};
+    cursor+=cells(io_sizes[i]);
+  }
+}
+
+void ShadowAtlas::lightKey(const LightStd140 &_light, float o_key[8])
+{
+  std::copy(_light.m_position,_light.m_position+3,o_key);
+  std::copy(_light.m_direction,_light.m_direction+3,o_key+3);
+  o_key[6]=_light.m_spotCosCutoff;
+  o_key[7]=_light.m_range;
+}
+
+ngl::Mat4 ShadowAtlas::lightViewProject(const LightStd140 &_light)
+{
+  const float *p=_light.m_position;
+  ngl::Vec3 eye(p[0],p[1],p[2]);
+  ngl::Vec3 dir(_light.m_direction[0],_light.m_direction[1],_light.m_direction[2]);
+  dir.normalize();
+  ngl::Vec3 up= std::fabs(dir.m_y) > 0.99f ? ngl::Vec3(1.0f,0.0f,0.0f) : ngl::Vec3(0.0f,1.0f,0.0f);
+  // a couple of degrees wider than the cone so the filter taps at its edge stay inside the tile
+  float cosCutoff=std::min(std::max(_light.m_spotCosCutoff,-1.0f),1.0f);
+  float fov=std::min(2.0f*std::acos(cosCutoff)*180.0f/ngl::PI+2.0f,170.0f);
+  float range=std::max(_light.m_range,0.1f);
+  return ngl::perspective(fov,1.0f,0.01f*range,range)*ngl::lookAt(eye,eye+dir,up);
+}
+
+void ShadowAtlas::setData(size_t _light, const ngl::Mat4 &_lightVP)
+{
+  const Tile &t=m_slots[_light].m_tile;
+  float texel=1.0f/m_size;
+  float scale=t.m_size*texel;
+  // clip space to the tile's texture coordinates and depth range
+  ngl::Mat4 tile;
+  tile.m_m[0][0]=0.5f*scale;
+  tile.m_m[1][1]=0.5f*scale;
+  tile.m_m[2][2]=0.5f;
+  tile.m_m[3][0]=0.5f*scale+t.m_x*texel;
+  tile.m_m[3][1]=0.5f*scale+t.m_y*texel;
+  tile.m_m[3][2]=0.5f;
+  ngl::Mat4 atlas=tile*_lightVP;
+  float *data=&m_data[_light*TEXELS*4];
+  std::copy(atlas.m_openGL,atlas.m_openGL+16,data);
+  data[16]=1.0f;
+  data[17]=texel;
+  data[18]=0.0f;
+  data[19]=0.0f;
+  // the filter reads a texel and a half either side so keep the lookups that far inside the tile
+  data[20]=(t.m_x+1.5f)*texel;
+  data[21]=(t.m_y+1.5f)*texel;
+  data[22]=(t.m_x+t.m_size-1.5f)*texel;
+  data[23]=(t.m_y+t.m_size-1.5f)*texel;
+  m_dataDirty=true;
+}
+
+void ShadowAtlas::clearData(size_t _light)
+{
+  float *data=&m_data[_light*TEXELS*4];
+  std::fill(data,data+TEXELS*4,0.0f);
+  m_dataDirty=true;
+}
+
+void ShadowAtlas::uploadData(FrameStats &_stats)
+{
+  if(!m_dataDirty)
+  {
+    return;
+  }
+  size_t bytes=m_data.size()*sizeof(float);
+  m_dataBuffer.reserve(bytes);
+  m_dataBuffer.update(0,bytes,m_data.data(),_stats);
+  m_dataDirty=false;
+}
+
+size_t ShadowAtlas::update(const LightStd140 *_lights, size_t _numLights, const ngl::Mat4 &_view,
+                           const ngl::Mat4 &_project, int _height, const DrawCasters &_draw, FrameStats &_stats)
+{
+  if(m_slots.size() != _numLights)
+  {
+    m_slots.assign(_numLights,Slot());
+    m_data.assign(_numLights*TEXELS*4,0.0f);
+    invalidate();
+  }
+  m_numStale=0;
+  if(!m_enabled || !m_framebuffer)
+  {
+    uploadData(_stats);
+    return 0;
+  }
+  ++m_frame;
+  if(std::memcmp(_view.m_openGL,m_view.m_openGL,sizeof(m_view.m_openGL)) != 0)
+  {
+    m_view=_view;
+    ++m_casterVersion;
+  }
+  // tiles grow as soon as a light needs more detail but only shrink once it needs a quarter of the size,
+  // so small camera moves don't keep repacking the atlas and throwing the maps away
+  bool repack=false;
+  m_sizes.resize(_numLights);
+  for(size_t i=0; i<_numLights; ++i)
+  {
+    Slot &s=m_slots[i];
+    int wanted=tileSize(_lights[i],_project,_height,s.m_coverage);
+    if(wanted > s.m_request || wanted*4 <= s.m_request)
+    {
+      s.m_request=wanted;
+      repack=true;
+    }
+    m_sizes[i]=s.m_request;
+  }
+  if(repack)
+  {
+    layout(m_sizes,m_size,m_tiles);
+    for(size_t i=0; i<_numLights; ++i)
+    {
+      Tile &t=m_slots[i].m_tile;
+      if(t.m_x != m_tiles[i].m_x || t.m_y != m_tiles[i].m_y || t.m_size != m_tiles[i].m_size)
+      {
+        t=m_tiles[i];
+        m_slots[i].m_drawnFrame=0;
+        clearData(i);
+      }
+    }
+  }
+  m_stale.clear();
+  for(size_t i=0; i<_numLights; ++i)
+  {
+    const Slot &s=m_slots[i];
+    if(s.m_tile.m_size == 0)
+    {
+      continue;
+    }
+    float key[8];
+    lightKey(_lights[i],key);
+    if(s.m_drawnFrame == 0 || s.m_casterVersion != m_casterVersion || std::memcmp(key,s.m_key,sizeof(key)) != 0)
+    {
+      m_stale.push_back(i);
+    }
+  }
+  // empty tiles first, then by how long each map has been waiting weighted by its size on screen so the
+  // large spots refresh most often without the small ones being starved
+  uint64_t frame=m_frame;
+  std::sort(m_stale.begin(),m_stale.end(),[this,frame](size_t _a, size_t _b)
+  {
+    const Slot &a=m_slots[_a];
+    const Slot &b=m_slots[_b];
+    if((a.m_drawnFrame == 0) != (b.m_drawnFrame == 0))
+    {
+      return a.m_drawnFrame == 0;
+    }
+    return (frame-a.m_drawnFrame)*a.m_coverage > (frame-b.m_drawnFrame)*b.m_coverage;
+  });
+  size_t count= m_budget ? std::min(m_budget,m_stale.size()) : m_stale.size();
+  m_numStale=m_stale.size()-count;
+  if(count)
+  {
+    GLint previous;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&previous);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT,viewport);
+    GLint polygonMode[2];
+    glGetIntegerv(GL_POLYGON_MODE,polygonMode);
+    glBindFramebuffer(GL_FRAMEBUFFER,m_framebuffer);
+    glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
+    glEnable(GL_SCISSOR_TEST);
+    // slope scaled bias against self shadowing, the lookups aren't offset
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f,4.0f);
+    for(size_t j=0; j<count; ++j)
+    {
+      size_t i=m_stale[j];
+      Slot &s=m_slots[i];
+      const Tile &t=s.m_tile;
+      glViewport(t.m_x,t.m_y,t.m_size,t.m_size);
+      glScissor(t.m_x,t.m_y,t.m_size,t.m_size);
+      glClear(GL_DEPTH_BUFFER_BIT);
+      ngl::Mat4 lightVP=lightViewProject(_lights[i]);
+      _draw(lightVP);
+      lightKey(_lights[i],s.m_key);
+      s.m_casterVersion=m_casterVersion;
+      s.m_drawnFrame=m_frame;
+      setData(i,lightVP);
+    }
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_SCISSOR_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK,static_cast<GLenum>(polygonMode[0]));
+    glBindFramebuffer(GL_FRAMEBUFFER,static_cast<GLuint>(previous));
+    glViewport(viewport[0],viewport[1],viewport[2],viewport[3]);
+    m_tilesRendered+=count;
+  }
+  uploadData(_stats);
+  return count;
+}
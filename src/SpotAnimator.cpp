@@ -0,0 +1,294 @@
+#include "SpotAnimator.h"
+#include <algorithm>
+#include <cmath>
+#include "SimdSupport.h"
+
+constexpr float SpotAnimator::MIXSTEP;
+constexpr float SpotAnimator::COSMAXEDGE;
+constexpr float SpotAnimator::RANGESCALE;
+constexpr double SpotAnimator::TWOPI;
+constexpr float SpotAnimator::HALFPI;
+
+constexpr static float MIXSTEP=SpotAnimator::MIXSTEP;
+constexpr static float HALFPI=SpotAnimator::HALFPI;
+constexpr static float COSMAXEDGE=SpotAnimator::COSMAXEDGE;
+constexpr static float RANGESCALE=SpotAnimator::RANGESCALE;
+
+namespace
+{
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief reference implementation, one spot at a time with the libm trig functions
+//----------------------------------------------------------------------------------------------------------------------
+void updateScalar(SpotState &_s, float _time, size_t _begin, size_t _end)
+{
+  for(size_t i=_begin; i<_end; ++i)
+  {
+    // gathered from the SoA arrays, the compiler keeps these in registers
+    const float position[3]={_s.m_posX[i],_s.m_posY[i],_s.m_posZ[i]};
+    const float ellipse[4]={_s.m_centreX[i],_s.m_centreZ[i],_s.m_radiusX[i],_s.m_radiusZ[i]};
+    const float start[3]={_s.m_startR[i],_s.m_startG[i],_s.m_startB[i]};
+    const float end[3]={_s.m_endR[i],_s.m_endG[i],_s.m_endB[i]};
+    float dir[3];
+    float colour[3];
+    SpotAnimator::evaluate(_time+_s.m_timeOffset[i],_s.m_mix[i],position,ellipse,start,end,_s.m_cosCutoff[i],
+                           _s.m_sinCutoff[i],dir,colour,_s.m_range[i]);
+    _s.m_dirX[i]=dir[0];
+    _s.m_dirY[i]=dir[1];
+    _s.m_dirZ[i]=dir[2];
+    _s.m_colourR[i]=colour[0];
+    _s.m_colourG[i]=colour[1];
+    _s.m_colourB[i]=colour[2];
+    float mix=_s.m_mix[i]+MIXSTEP;
+    _s.m_mix[i]= mix >= 1.0f ? 0.0f : mix;
+  }
+}
+
+#if defined(SIMD_X86)
+
+// Cephes single precision sin / cos constants as used in sse_mathfun
+constexpr static float FOPI=1.27323954473516f;
+constexpr static float DP1=-0.78515625f;
+constexpr static float DP2=-2.4187564849853515625e-4f;
+constexpr static float DP3=-3.77489497744594108e-8f;
+constexpr static float COSCOF0=2.443315711809948e-5f;
+constexpr static float COSCOF1=-1.388731625493765e-3f;
+constexpr static float COSCOF2=4.166664568298827e-2f;
+constexpr static float SINCOF0=-1.9515295891e-4f;
+constexpr static float SINCOF1=8.3321608736e-3f;
+constexpr static float SINCOF2=-1.6666654611e-1f;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief sin and cos of 4 angles, reduce to [-pi/4,pi/4] then pick the sin or cos polynomial per octant
+//----------------------------------------------------------------------------------------------------------------------
+inline void sincos4(__m128 _x, __m128 &o_sin, __m128 &o_cos)
+{
+  const __m128 signMask=_mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000)));
+  __m128 signSin=_mm_and_ps(_x,signMask);
+  __m128 x=_mm_andnot_ps(signMask,_x);
+  __m128i j=_mm_cvttps_epi32(_mm_mul_ps(x,_mm_set1_ps(FOPI)));
+  j=_mm_and_si128(_mm_add_epi32(j,_mm_set1_epi32(1)),_mm_set1_epi32(~1));
+  __m128 y=_mm_cvtepi32_ps(j);
+  __m128 swapSignSin=_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j,_mm_set1_epi32(4)),29));
+  __m128 polyMask=_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j,_mm_set1_epi32(2)),_mm_setzero_si128()));
+  __m128i jc=_mm_sub_epi32(j,_mm_set1_epi32(2));
+  __m128 signCos=_mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(jc,_mm_set1_epi32(4)),29));
+  signSin=_mm_xor_ps(signSin,swapSignSin);
+  // extended precision modular arithmetic
+  x=_mm_add_ps(x,_mm_mul_ps(y,_mm_set1_ps(DP1)));
+  x=_mm_add_ps(x,_mm_mul_ps(y,_mm_set1_ps(DP2)));
+  x=_mm_add_ps(x,_mm_mul_ps(y,_mm_set1_ps(DP3)));
+  __m128 z=_mm_mul_ps(x,x);
+  __m128 c=_mm_add_ps(_mm_mul_ps(_mm_set1_ps(COSCOF0),z),_mm_set1_ps(COSCOF1));
+  c=_mm_add_ps(_mm_mul_ps(c,z),_mm_set1_ps(COSCOF2));
+  c=_mm_mul_ps(_mm_mul_ps(c,z),z);
+  c=_mm_sub_ps(c,_mm_mul_ps(z,_mm_set1_ps(0.5f)));
+  c=_mm_add_ps(c,_mm_set1_ps(1.0f));
+  __m128 s=_mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINCOF0),z),_mm_set1_ps(SINCOF1));
+  s=_mm_add_ps(_mm_mul_ps(s,z),_mm_set1_ps(SINCOF2));
+  s=_mm_add_ps(_mm_mul_ps(_mm_mul_ps(s,z),x),x);
+  // in octants where the polynomials swap roles pick the other one
+  __m128 sinResult=_mm_or_ps(_mm_and_ps(polyMask,s),_mm_andnot_ps(polyMask,c));
+  __m128 cosResult=_mm_or_ps(_mm_and_ps(polyMask,c),_mm_andnot_ps(polyMask,s));
+  o_sin=_mm_xor_ps(sinResult,signSin);
+  o_cos=_mm_xor_ps(cosResult,signCos);
+}
+
+void updateSSE2(SpotState &_s, float _time, size_t _begin, size_t _end)
+{
+  const __m128 time=_mm_set1_ps(_time);
+  const __m128 one=_mm_set1_ps(1.0f);
+  size_t i=_begin;
+  for(; i+4<=_end; i+=4)
+  {
+    __m128 sinA;
+    __m128 cosA;
+    sincos4(_mm_add_ps(time,_mm_loadu_ps(&_s.m_timeOffset[i])),sinA,cosA);
+    __m128 px=_mm_loadu_ps(&_s.m_posX[i]);
+    __m128 py=_mm_loadu_ps(&_s.m_posY[i]);
+    __m128 pz=_mm_loadu_ps(&_s.m_posZ[i]);
+    __m128 dx=_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&_s.m_centreX[i]),_mm_mul_ps(cosA,_mm_loadu_ps(&_s.m_radiusX[i]))),px);
+    __m128 dy=_mm_sub_ps(_mm_setzero_ps(),py);
+    __m128 dz=_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&_s.m_centreZ[i]),_mm_mul_ps(sinA,_mm_loadu_ps(&_s.m_radiusZ[i]))),pz);
+    __m128 lenSq=_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx,dx),_mm_mul_ps(dy,dy)),_mm_mul_ps(dz,dz));
+    __m128 inv=_mm_div_ps(one,_mm_sqrt_ps(lenSq));
+    dx=_mm_mul_ps(dx,inv);
+    dy=_mm_mul_ps(dy,inv);
+    dz=_mm_mul_ps(dz,inv);
+    _mm_storeu_ps(&_s.m_dirX[i],dx);
+    _mm_storeu_ps(&_s.m_dirY[i],dy);
+    _mm_storeu_ps(&_s.m_dirZ[i],dz);
+
+    __m128 mix=_mm_loadu_ps(&_s.m_mix[i]);
+    __m128 t;
+    __m128 unused;
+    sincos4(_mm_mul_ps(mix,_mm_set1_ps(HALFPI)),t,unused);
+    __m128 sr=_mm_loadu_ps(&_s.m_startR[i]);
+    __m128 sg=_mm_loadu_ps(&_s.m_startG[i]);
+    __m128 sb=_mm_loadu_ps(&_s.m_startB[i]);
+    _mm_storeu_ps(&_s.m_colourR[i],_mm_add_ps(sr,_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&_s.m_endR[i]),sr),t)));
+    _mm_storeu_ps(&_s.m_colourG[i],_mm_add_ps(sg,_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&_s.m_endG[i]),sg),t)));
+    _mm_storeu_ps(&_s.m_colourB[i],_mm_add_ps(sb,_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&_s.m_endB[i]),sb),t)));
+    mix=_mm_add_ps(mix,_mm_set1_ps(MIXSTEP));
+    _mm_storeu_ps(&_s.m_mix[i],_mm_andnot_ps(_mm_cmpge_ps(mix,one),mix));
+
+    __m128 cosTilt=_mm_sub_ps(_mm_setzero_ps(),dy);
+    __m128 sinTilt=_mm_sqrt_ps(_mm_max_ps(_mm_setzero_ps(),_mm_sub_ps(one,_mm_mul_ps(cosTilt,cosTilt))));
+    __m128 cosEdge=_mm_sub_ps(_mm_mul_ps(cosTilt,_mm_loadu_ps(&_s.m_cosCutoff[i])),
+                              _mm_mul_ps(sinTilt,_mm_loadu_ps(&_s.m_sinCutoff[i])));
+    cosEdge=_mm_max_ps(cosEdge,_mm_set1_ps(COSMAXEDGE));
+    _mm_storeu_ps(&_s.m_range[i],_mm_div_ps(_mm_mul_ps(_mm_set1_ps(RANGESCALE),py),cosEdge));
+  }
+  updateScalar(_s,_time,i,_end);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief 8 wide version of sincos4
+//----------------------------------------------------------------------------------------------------------------------
+SIMD_AVX2 inline void sincos8(__m256 _x, __m256 &o_sin, __m256 &o_cos)
+{
+  const __m256 signMask=_mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0x80000000)));
+  __m256 signSin=_mm256_and_ps(_x,signMask);
+  __m256 x=_mm256_andnot_ps(signMask,_x);
+  __m256i j=_mm256_cvttps_epi32(_mm256_mul_ps(x,_mm256_set1_ps(FOPI)));
+  j=_mm256_and_si256(_mm256_add_epi32(j,_mm256_set1_epi32(1)),_mm256_set1_epi32(~1));
+  __m256 y=_mm256_cvtepi32_ps(j);
+  __m256 swapSignSin=_mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j,_mm256_set1_epi32(4)),29));
+  __m256 polyMask=_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j,_mm256_set1_epi32(2)),_mm256_setzero_si256()));
+  __m256i jc=_mm256_sub_epi32(j,_mm256_set1_epi32(2));
+  __m256 signCos=_mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(jc,_mm256_set1_epi32(4)),29));
+  signSin=_mm256_xor_ps(signSin,swapSignSin);
+  x=_mm256_fmadd_ps(y,_mm256_set1_ps(DP1),x);
+  x=_mm256_fmadd_ps(y,_mm256_set1_ps(DP2),x);
+  x=_mm256_fmadd_ps(y,_mm256_set1_ps(DP3),x);
+  __m256 z=_mm256_mul_ps(x,x);
+  __m256 c=_mm256_fmadd_ps(_mm256_set1_ps(COSCOF0),z,_mm256_set1_ps(COSCOF1));
+  c=_mm256_fmadd_ps(c,z,_mm256_set1_ps(COSCOF2));
+  c=_mm256_mul_ps(_mm256_mul_ps(c,z),z);
+  c=_mm256_fnmadd_ps(z,_mm256_set1_ps(0.5f),c);
+  c=_mm256_add_ps(c,_mm256_set1_ps(1.0f));
+  __m256 s=_mm256_fmadd_ps(_mm256_set1_ps(SINCOF0),z,_mm256_set1_ps(SINCOF1));
+  s=_mm256_fmadd_ps(s,z,_mm256_set1_ps(SINCOF2));
+  s=_mm256_fmadd_ps(_mm256_mul_ps(s,z),x,x);
+  __m256 sinResult=_mm256_blendv_ps(c,s,polyMask);
+  __m256 cosResult=_mm256_blendv_ps(s,c,polyMask);
+  o_sin=_mm256_xor_ps(sinResult,signSin);
+  o_cos=_mm256_xor_ps(cosResult,signCos);
+}
+
+SIMD_AVX2 void updateAVX2(SpotState &_s, float _time, size_t _begin, size_t _end)
+{
+  const __m256 time=_mm256_set1_ps(_time);
+  const __m256 one=_mm256_set1_ps(1.0f);
+  const __m256 zero=_mm256_setzero_ps();
+  size_t i=_begin;
+  for(; i+8<=_end; i+=8)
+  {
+    __m256 sinA;
+    __m256 cosA;
+    sincos8(_mm256_add_ps(time,_mm256_loadu_ps(&_s.m_timeOffset[i])),sinA,cosA);
+    __m256 px=_mm256_loadu_ps(&_s.m_posX[i]);
+    __m256 py=_mm256_loadu_ps(&_s.m_posY[i]);
+    __m256 pz=_mm256_loadu_ps(&_s.m_posZ[i]);
+    __m256 dx=_mm256_sub_ps(_mm256_fmadd_ps(cosA,_mm256_loadu_ps(&_s.m_radiusX[i]),_mm256_loadu_ps(&_s.m_centreX[i])),px);
+    __m256 dy=_mm256_sub_ps(zero,py);
+    __m256 dz=_mm256_sub_ps(_mm256_fmadd_ps(sinA,_mm256_loadu_ps(&_s.m_radiusZ[i]),_mm256_loadu_ps(&_s.m_centreZ[i])),pz);
+    __m256 lenSq=_mm256_fmadd_ps(dz,dz,_mm256_fmadd_ps(dy,dy,_mm256_mul_ps(dx,dx)));
+    __m256 inv=_mm256_div_ps(one,_mm256_sqrt_ps(lenSq));
+    dx=_mm256_mul_ps(dx,inv);
+    dy=_mm256_mul_ps(dy,inv);
+    dz=_mm256_mul_ps(dz,inv);
+    _mm256_storeu_ps(&_s.m_dirX[i],dx);
+    _mm256_storeu_ps(&_s.m_dirY[i],dy);
+    _mm256_storeu_ps(&_s.m_dirZ[i],dz);
+
+    __m256 mix=_mm256_loadu_ps(&_s.m_mix[i]);
+    __m256 t;
+    __m256 unused;
+    sincos8(_mm256_mul_ps(mix,_mm256_set1_ps(HALFPI)),t,unused);
+    __m256 sr=_mm256_loadu_ps(&_s.m_startR[i]);
+    __m256 sg=_mm256_loadu_ps(&_s.m_startG[i]);
+    __m256 sb=_mm256_loadu_ps(&_s.m_startB[i]);
+    _mm256_storeu_ps(&_s.m_colourR[i],_mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(&_s.m_endR[i]),sr),t,sr));
+    _mm256_storeu_ps(&_s.m_colourG[i],_mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(&_s.m_endG[i]),sg),t,sg));
+    _mm256_storeu_ps(&_s.m_colourB[i],_mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(&_s.m_endB[i]),sb),t,sb));
+    mix=_mm256_add_ps(mix,_mm256_set1_ps(MIXSTEP));
+    _mm256_storeu_ps(&_s.m_mix[i],_mm256_andnot_ps(_mm256_cmp_ps(mix,one,_CMP_GE_OQ),mix));
+
+    __m256 cosTilt=_mm256_sub_ps(zero,dy);
+    __m256 sinTilt=_mm256_sqrt_ps(_mm256_max_ps(zero,_mm256_fnmadd_ps(cosTilt,cosTilt,one)));
+    __m256 cosEdge=_mm256_fmsub_ps(cosTilt,_mm256_loadu_ps(&_s.m_cosCutoff[i]),
+                                   _mm256_mul_ps(sinTilt,_mm256_loadu_ps(&_s.m_sinCutoff[i])));
+    cosEdge=_mm256_max_ps(cosEdge,_mm256_set1_ps(COSMAXEDGE));
+    _mm256_storeu_ps(&_s.m_range[i],_mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(RANGESCALE),py),cosEdge));
+  }
+  // finish the tail 4 then 1 at a time
+  updateSSE2(_s,_time,i,_end);
+}
+
+#endif
+
+} // end anonymous namespace
+
+SpotAnimator::SpotAnimator()
+{
+  m_kernel=Kernel::SCALAR;
+  m_update=updateScalar;
+#if defined(SIMD_X86)
+  if(isSupported(Kernel::AVX2))
+  {
+    m_kernel=Kernel::AVX2;
+    m_update=updateAVX2;
+  }
+  else
+  {
+    m_kernel=Kernel::SSE2;
+    m_update=updateSSE2;
+  }
+#endif
+}
+
+SpotAnimator::SpotAnimator(Kernel _kernel)
+{
+  m_kernel=Kernel::SCALAR;
+  m_update=updateScalar;
+#if defined(SIMD_X86)
+  if(isSupported(_kernel))
+  {
+    m_kernel=_kernel;
+    switch(_kernel)
+    {
+      case Kernel::AVX2 : m_update=updateAVX2; break;
+      case Kernel::SSE2 : m_update=updateSSE2; break;
+      case Kernel::SCALAR : break;
+    }
+  }
+#endif
+}
+
+const char *SpotAnimator::kernelName(Kernel _kernel)
+{
+  switch(_kernel)
+  {
+    case Kernel::AVX2 : return "avx2";
+    case Kernel::SSE2 : return "sse2";
+    case Kernel::SCALAR : return "scalar";
+  }
+  return "unknown";
+}
+
+bool SpotAnimator::isSupported(Kernel _kernel)
+{
+  switch(_kernel)
+  {
+    case Kernel::SCALAR : return true;
+#if defined(SIMD_X86)
+    // the build targets SSE2 so any CPU it runs on has it
+    case Kernel::SSE2 : return true;
+    case Kernel::AVX2 : return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    default : return false;
+#endif
+  }
+  return false;
+}
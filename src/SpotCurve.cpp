@@ -0,0 +1,86 @@
+#include "SpotCurve.h"
+#include <algorithm>
+#include <cmath>
+#include "SpotAnimator.h"
+
+void SpotCurve::pack(const SpotState &_state, std::vector<SpotParamsStd430> &o_params)
+{
+  const SpotState &s=_state;
+  o_params.resize(s.size());
+  for(size_t i=0; i<s.size(); ++i)
+  {
+    SpotParamsStd430 &p=o_params[i];
+    p.m_position[0]=s.m_posX[i];
+    p.m_position[1]=s.m_posY[i];
+    p.m_position[2]=s.m_posZ[i];
+    p.m_position[3]=s.m_timeOffset[i];
+    p.m_ellipse[0]=s.m_centreX[i];
+    p.m_ellipse[1]=s.m_centreZ[i];
+    p.m_ellipse[2]=s.m_radiusX[i];
+    p.m_ellipse[3]=s.m_radiusZ[i];
+    p.m_start[0]=s.m_startR[i];
+    p.m_start[1]=s.m_startG[i];
+    p.m_start[2]=s.m_startB[i];
+    p.m_start[3]=s.m_mix[i];
+    p.m_end[0]=s.m_endR[i];
+    p.m_end[1]=s.m_endG[i];
+    p.m_end[2]=s.m_endB[i];
+    p.m_end[3]=0.0f;
+    p.m_cutoff[0]=s.m_cosCutoff[i];
+    p.m_cutoff[1]=s.m_sinCutoff[i];
+    p.m_cutoff[2]=0.0f;
+    p.m_cutoff[3]=0.0f;
+  }
+}
+
+void SpotCurve::phase(double _ticks, double _baseTicks, float _timeStep, float &o_angle, float &o_mix)
+{
+  o_angle=static_cast<float>(std::fmod(_ticks*_timeStep,SpotAnimator::TWOPI));
+  o_mix=static_cast<float>(std::fmod(std::max(0.0,_ticks-_baseTicks)*SpotAnimator::MIXSTEP,1.0));
+}
+
+SpotCurve::Sample SpotCurve::evaluate(const SpotParamsStd430 &_spot, float _angle, float _mix)
+{
+  const SpotParamsStd430 &s=_spot;
+  Sample o;
+  float mix=s.m_start[3]+_mix;
+  mix-= mix >= 1.0f ? 1.0f : 0.0f;
+  SpotAnimator::evaluate(_angle+s.m_position[3],mix,s.m_position,s.m_ellipse,s.m_start,s.m_end,s.m_cutoff[0],
+                         s.m_cutoff[1],o.m_dir,o.m_colour,o.m_range);
+  return o;
+}
+
+SpotCone SpotCurve::envelope(const SpotParamsStd430 &_spot)
+{
+  const SpotParamsStd430 &s=_spot;
+  SpotCone cone;
+  std::copy(s.m_position,s.m_position+3,cone.m_apex);
+  float v[3]={s.m_ellipse[0]-s.m_position[0],-s.m_position[1],s.m_ellipse[1]-s.m_position[2]};
+  float distance=std::sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+  // every aim point is inside the sphere of the larger radius around the centre
+  float radius=std::max(std::fabs(s.m_ellipse[2]),std::fabs(s.m_ellipse[3]));
+  float spread= radius < distance ? std::asin(radius/distance) : 2.0f*SpotAnimator::HALFPI;
+  float cutoff=std::atan2(s.m_cutoff[1],s.m_cutoff[0]);
+  float angle=spread+cutoff;
+  // the range grows with the tilt from straight down, the furthest any aim can tilt is the axis' tilt plus
+  // the spread. A cone reaches a little further than its range off axis so that is allowed for too
+  float tilt= distance > 0.0f ? std::acos(std::min(std::max(-v[1]/distance,-1.0f),1.0f)) : 0.0f;
+  float cosEdge=std::cos(std::min(tilt+spread+cutoff,2.0f*SpotAnimator::HALFPI));
+  cone.m_range=SpotAnimator::range(s.m_position[1],cosEdge)/std::max(s.m_cutoff[0],SpotAnimator::COSMAXEDGE);
+  if(angle >= SpotAnimator::HALFPI || distance <= 0.0f)
+  {
+    cone.m_axis[0]=0.0f;
+    cone.m_axis[1]=-1.0f;
+    cone.m_axis[2]=0.0f;
+    cone.m_cosAngle=0.0f;
+    cone.m_sinAngle=1.0f;
+    return cone;
+  }
+  for(int i=0; i<3; ++i)
+  {
+    cone.m_axis[i]=v[i]/distance;
+  }
+  cone.m_cosAngle=std::cos(angle);
+  cone.m_sinAngle=std::sin(angle);
+  return cone;
+}
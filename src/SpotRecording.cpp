@@ -0,0 +1,204 @@
+#include "SpotRecording.h"
+#include <cstring>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief append a variable length integer, seven bits a byte with the top bit set on all but the last
+//----------------------------------------------------------------------------------------------------------------------
+static void putVarint(std::vector<unsigned char> &io_bytes, uint32_t _value)
+{
+  while(_value >= 0x80)
+  {
+    io_bytes.push_back(static_cast<unsigned char>(_value | 0x80));
+    _value>>=7;
+  }
+  io_bytes.push_back(static_cast<unsigned char>(_value));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief read a variable length integer
+/// @returns false if it runs past _end
+//----------------------------------------------------------------------------------------------------------------------
+static bool getVarint(const unsigned char *&io_bytes, const unsigned char *_end, uint32_t &o_value)
+{
+  o_value=0;
+  for(int shift=0; shift<35; shift+=7)
+  {
+    if(io_bytes == _end)
+    {
+      return false;
+    }
+    unsigned char b=*io_bytes++;
+    o_value|=static_cast<uint32_t>(b & 0x7f) << shift;
+    if(!(b & 0x80))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief map small negative differences to small unsigned values
+//----------------------------------------------------------------------------------------------------------------------
+static uint32_t zigzag(uint32_t _delta)
+{
+  return (_delta << 1) ^ (0u-(_delta >> 31));
+}
+
+static uint32_t unzigzag(uint32_t _value)
+{
+  return (_value >> 1) ^ (0u-(_value & 1));
+}
+
+SpotRecorder::~SpotRecorder()
+{
+  close();
+}
+
+bool SpotRecorder::open(const std::string &_fname, size_t _numLights)
+{
+  close();
+  m_out.open(_fname,std::ios::binary | std::ios::trunc);
+  if(!m_out.is_open())
+  {
+    return false;
+  }
+  // the first tick is encoded against all zeros
+  m_previous.assign(_numLights*WORDS,0);
+  m_ticks=0;
+  SpotRecordingHeader header={MAGIC,VERSION,static_cast<uint32_t>(_numLights),0};
+  m_out.write(reinterpret_cast<const char *>(&header),sizeof(header));
+  m_bytes=sizeof(header);
+  return true;
+}
+
+void SpotRecorder::close()
+{
+  if(!m_out.is_open())
+  {
+    return;
+  }
+  // the tick count is only known now
+  m_out.seekp(offsetof(SpotRecordingHeader,m_tickCount));
+  m_out.write(reinterpret_cast<const char *>(&m_ticks),sizeof(m_ticks));
+  m_out.close();
+}
+
+bool SpotRecorder::write(const LightStd140 *_lights, size_t _numLights)
+{
+  if(!isOpen() || _numLights*WORDS != m_previous.size())
+  {
+    return false;
+  }
+  m_encoded.clear();
+  uint32_t run=0;
+  for(size_t i=0; i<m_previous.size(); ++i)
+  {
+    uint32_t word;
+    std::memcpy(&word,reinterpret_cast<const unsigned char *>(_lights)+i*sizeof(uint32_t),sizeof(word));
+    uint32_t delta=word-m_previous[i];
+    if(delta == 0)
+    {
+      ++run;
+      continue;
+    }
+    putVarint(m_encoded,run);
+    putVarint(m_encoded,zigzag(delta));
+    m_previous[i]=word;
+    run=0;
+  }
+  // a run reaching the end of the tick needs no value after it
+  if(run != 0)
+  {
+    putVarint(m_encoded,run);
+  }
+  uint32_t size=static_cast<uint32_t>(m_encoded.size());
+  m_out.write(reinterpret_cast<const char *>(&size),sizeof(size));
+  m_out.write(reinterpret_cast<const char *>(m_encoded.data()),static_cast<std::streamsize>(size));
+  m_bytes+=sizeof(size)+size;
+  ++m_ticks;
+  return true;
+}
+
+bool SpotPlayer::open(const std::string &_fname)
+{
+  if(!m_file.open(_fname) || m_file.size() < sizeof(SpotRecordingHeader))
+  {
+    m_file.close();
+    return false;
+  }
+  std::memcpy(&m_header,m_file.data(),sizeof(m_header));
+  if(m_header.m_magic != SpotRecorder::MAGIC || m_header.m_version != SpotRecorder::VERSION ||
+     m_header.m_lightCount == 0 || m_header.m_tickCount == 0)
+  {
+    m_file.close();
+    return false;
+  }
+  m_lights.assign(m_header.m_lightCount,LightStd140());
+  m_offset=m_file.size();
+  m_tick=m_header.m_tickCount;
+  m_played=0;
+  return true;
+}
+
+bool SpotPlayer::next()
+{
+  if(!isOpen())
+  {
+    return false;
+  }
+  // back to the start, the first tick was encoded against zeros
+  if(m_tick == m_header.m_tickCount)
+  {
+    std::memset(m_lights.data(),0,m_lights.size()*sizeof(LightStd140));
+    m_offset=sizeof(SpotRecordingHeader);
+    m_tick=0;
+  }
+  uint32_t size;
+  if(m_file.size()-m_offset < sizeof(size))
+  {
+    m_file.close();
+    return false;
+  }
+  std::memcpy(&size,m_file.data()+m_offset,sizeof(size));
+  m_offset+=sizeof(size);
+  if(m_file.size()-m_offset < size)
+  {
+    m_file.close();
+    return false;
+  }
+  const unsigned char *bytes=m_file.data()+m_offset;
+  const unsigned char *end=bytes+size;
+  unsigned char *words=reinterpret_cast<unsigned char *>(m_lights.data());
+  size_t numWords=m_lights.size()*SpotRecorder::WORDS;
+  size_t i=0;
+  while(i < numWords)
+  {
+    uint32_t run;
+    uint32_t value;
+    if(!getVarint(bytes,end,run) || run > numWords-i)
+    {
+      m_file.close();
+      return false;
+    }
+    i+=run;
+    if(i == numWords)
+    {
+      break;
+    }
+    if(!getVarint(bytes,end,value))
+    {
+      m_file.close();
+      return false;
+    }
+    uint32_t word;
+    std::memcpy(&word,words+i*sizeof(uint32_t),sizeof(word));
+    word+=unzigzag(value);
+    std::memcpy(words+i*sizeof(uint32_t),&word,sizeof(word));
+    ++i;
+  }
+  m_offset+=size;
+  ++m_tick;
+  ++m_played;
+  return true;
+}
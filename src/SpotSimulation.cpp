@@ -0,0 +1,172 @@
+#include "SpotSimulation.h"
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief if the thread falls this many ticks behind it drops them rather than trying to catch up
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static int MAXLAG=4;
+
+void SpotFrame::resize(size_t _count)
+{
+  std::vector<float> *arrays[]={&m_dirX,&m_dirY,&m_dirZ,&m_colourR,&m_colourG,&m_colourB,&m_range};
+  for(auto a : arrays)
+  {
+    a->resize(_count,0.0f);
+  }
+}
+
+void SpotFrame::copyFrom(const SpotState &_state)
+{
+  // assign reuses the capacity so steady state ticks don't allocate
+  m_dirX.assign(_state.m_dirX.begin(),_state.m_dirX.end());
+  m_dirY.assign(_state.m_dirY.begin(),_state.m_dirY.end());
+  m_dirZ.assign(_state.m_dirZ.begin(),_state.m_dirZ.end());
+  m_colourR.assign(_state.m_colourR.begin(),_state.m_colourR.end());
+  m_colourG.assign(_state.m_colourG.begin(),_state.m_colourG.end());
+  m_colourB.assign(_state.m_colourB.begin(),_state.m_colourB.end());
+  m_range.assign(_state.m_range.begin(),_state.m_range.end());
+}
+
+SpotSimulation::SpotSimulation(float _tickSeconds, float _timeStep) :
+  m_time(0.0f),
+  m_timeStep(_timeStep),
+  m_tickLength(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(_tickSeconds))),
+  m_hasPending(false),
+  m_ticks(0),
+  m_profiler(nullptr),
+  m_paused(false),
+  m_running(false)
+{
+}
+
+SpotSimulation::~SpotSimulation()
+{
+  stop();
+}
+
+void SpotSimulation::setState(const SpotState &_state)
+{
+  std::lock_guard<std::mutex> lock(m_pendingMutex);
+  m_pending=_state;
+  m_hasPending.store(true,std::memory_order_release);
+}
+
+void SpotSimulation::start()
+{
+  if(isRunning())
+  {
+    return;
+  }
+  m_running.store(true);
+  m_thread=std::thread(&SpotSimulation::run,this);
+}
+
+void SpotSimulation::stop()
+{
+  if(!isRunning())
+  {
+    return;
+  }
+  m_running.store(false);
+  m_thread.join();
+}
+
+void SpotSimulation::step()
+{
+  tick(Clock::now());
+}
+
+void SpotSimulation::run()
+{
+  Clock::time_point next=Clock::now();
+  while(m_running.load(std::memory_order_relaxed))
+  {
+    if(!m_paused.load(std::memory_order_relaxed))
+    {
+      tick(next);
+    }
+    next+=m_tickLength;
+    Clock::time_point now=Clock::now();
+    // a long stall (debugger, suspended laptop) would otherwise be followed by a burst of ticks
+    if(now-next > MAXLAG*m_tickLength)
+    {
+      next=now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void SpotSimulation::tick(Clock::time_point _time)
+{
+  Clock::time_point start=Clock::now();
+  if(m_hasPending.load(std::memory_order_acquire))
+  {
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    std::swap(m_state,m_pending);
+    m_hasPending.store(false,std::memory_order_relaxed);
+  }
+  m_animator.update(m_state,m_time);
+  // the animation is periodic in 2pi, wrapping keeps the kernel's trig accurate however long we run
+  m_time=fmodf(m_time+m_timeStep,static_cast<float>(SpotAnimator::TWOPI));
+
+  SpotFrame &frame=m_frames.writeBuffer();
+  frame.copyFrom(m_state);
+  frame.m_tick=m_ticks.fetch_add(1,std::memory_order_relaxed)+1;
+  frame.m_time=_time;
+  m_frames.publish();
+  if(m_profiler)
+  {
+    m_profiler->record("animate",FrameProfiler::SIMULATION,start,Clock::now());
+  }
+}
+
+bool SpotSimulation::acquire()
+{
+  if(!m_frames.hasUpdate())
+  {
+    return false;
+  }
+  // the slot we are about to give back may be overwritten straight away so keep a copy to blend from
+  m_previous=m_frames.readBuffer();
+  m_frames.update();
+  return true;
+}
+
+void SpotSimulation::interpolate(SpotFrame &o_frame, Clock::time_point _now) const
+{
+  const SpotFrame &current=m_frames.readBuffer();
+  size_t count=current.size();
+  float t=1.0f;
+  if(m_previous.size() == count && current.m_time > m_previous.m_time)
+  {
+    std::chrono::duration<float> span=current.m_time-m_previous.m_time;
+    std::chrono::duration<float> elapsed=(_now-m_tickLength)-m_previous.m_time;
+    t=std::min(std::max(elapsed.count()/span.count(),0.0f),1.0f);
+  }
+  if(t >= 1.0f)
+  {
+    o_frame=current;
+    return;
+  }
+  o_frame.resize(count);
+  o_frame.m_tick=current.m_tick;
+  o_frame.m_time=_now;
+  const SpotFrame &p=m_previous;
+  for(size_t i=0; i<count; ++i)
+  {
+    float x=p.m_dirX[i]+(current.m_dirX[i]-p.m_dirX[i])*t;
+    float y=p.m_dirY[i]+(current.m_dirY[i]-p.m_dirY[i])*t;
+    float z=p.m_dirZ[i]+(current.m_dirZ[i]-p.m_dirZ[i])*t;
+    // the directions are close together so a normalised lerp is as good as a slerp
+    float inv=1.0f/std::sqrt(x*x+y*y+z*z);
+    o_frame.m_dirX[i]=x*inv;
+    o_frame.m_dirY[i]=y*inv;
+    o_frame.m_dirZ[i]=z*inv;
+    o_frame.m_colourR[i]=p.m_colourR[i]+(current.m_colourR[i]-p.m_colourR[i])*t;
+    o_frame.m_colourG[i]=p.m_colourG[i]+(current.m_colourG[i]-p.m_colourG[i])*t;
+    o_frame.m_colourB[i]=p.m_colourB[i]+(current.m_colourB[i]-p.m_colourB[i])*t;
+    // the blended cone sits between the two so the larger range keeps the clusters conservative
+    o_frame.m_range[i]=std::max(p.m_range[i],current.m_range[i]);
+  }
+}
@@ -0,0 +1,16 @@
+#include "SpotState.h"
+
+void SpotState::resize(size_t _count)
+{
+  std::vector<float> *arrays[]=
+  {
+    &m_timeOffset,&m_radiusX,&m_radiusZ,&m_centreX,&m_centreZ,&m_mix,
+    &m_startR,&m_startG,&m_startB,&m_endR,&m_endG,&m_endB,
+    &m_posX,&m_posY,&m_posZ,&m_cosCutoff,&m_sinCutoff,
+    &m_dirX,&m_dirY,&m_dirZ,&m_colourR,&m_colourG,&m_colourB,&m_range
+  };
+  for(auto a : arrays)
+  {
+    a->resize(_count,0.0f);
+  }
+}
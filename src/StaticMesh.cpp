@@ -0,0 +1,205 @@
+#include "StaticMesh.h"
+#include <algorithm>
+#include <cstddef>
+#include "MeshOptimizer.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief bytes sent per glBufferSubData, small enough that each call only touches a few pages of the mapping
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static size_t UPLOADCHUNK=1<<20;
+
+StaticMesh::~StaticMesh()
+{
+  glDeleteBuffers(1,&m_indexBuffer);
+  glDeleteBuffers(1,&m_vertexBuffer);
+  glDeleteVertexArrays(1,&m_vao);
+}
+
+void StaticMesh::stream(GLenum _target, const unsigned char *_data, size_t _bytes)
+{
+  // allocate first then fill, the driver can start copying the early chunks while later pages fault in
+  glBufferData(_target,static_cast<GLsizeiptr>(_bytes),nullptr,GL_STATIC_DRAW);
+  for(size_t offset=0; offset<_bytes; offset+=UPLOADCHUNK)
+  {
+    size_t size=std::min(UPLOADCHUNK,_bytes-offset);
+    glBufferSubData(_target,static_cast<GLintptr>(offset),static_cast<GLsizeiptr>(size),_data+offset);
+  }
+}
+
+void StaticMesh::upload(const unsigned char *_vertices, size_t _vertexBytes, GLsizei _stride,
+                        const unsigned char *_indices, size_t _indexCount, size_t _indexSize)
+{
+  if(m_vao == 0)
+  {
+    glGenVertexArrays(1,&m_vao);
+    glGenBuffers(1,&m_vertexBuffer);
+    glGenBuffers(1,&m_indexBuffer);
+  }
+  glBindVertexArray(m_vao);
+  glBindBuffer(GL_ARRAY_BUFFER,m_vertexBuffer);
+  stream(GL_ARRAY_BUFFER,_vertices,_vertexBytes);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(2);
+  if(m_layout == Layout::PACKED)
+  {
+    // half float position and the two snorm components of the octahedral normal, the shader decodes the rest
+    glVertexAttribPointer(0,3,GL_HALF_FLOAT,GL_FALSE,_stride,reinterpret_cast<void *>(0));
+    glVertexAttribPointer(2,2,GL_SHORT,GL_TRUE,_stride,reinterpret_cast<void *>(offsetof(PackedVertex,m_normal)));
+    glDisableVertexAttribArray(1);
+  }
+  else
+  {
+    // the file stores position, normal, uv
+    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,_stride,reinterpret_cast<void *>(0));
+    glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,_stride,reinterpret_cast<void *>(3*sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,_stride,reinterpret_cast<void *>(6*sizeof(float)));
+  }
+  // the element buffer binding is part of the VAO state
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,m_indexBuffer);
+  stream(GL_ELEMENT_ARRAY_BUFFER,_indices,_indexCount*_indexSize);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+  m_parts.assign(1,Part{static_cast<GLsizei>(_indexCount),0,0});
+  m_indexType=_indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  m_vertexCount=_vertexBytes/static_cast<size_t>(_stride);
+  m_indexBytes=_indexCount*_indexSize;
+}
+
+void StaticMesh::uploadVertices(const std::vector<float> &_vertices, const unsigned char *_indices,
+                                size_t _indexCount, size_t _indexSize)
+{
+  if(m_layout == Layout::PACKED)
+  {
+    std::vector<PackedVertex> packed;
+    MeshOptimizer::pack(_vertices,packed);
+    upload(reinterpret_cast<const unsigned char *>(packed.data()),packed.size()*sizeof(PackedVertex),
+           static_cast<GLsizei>(sizeof(PackedVertex)),_indices,_indexCount,_indexSize);
+  }
+  else
+  {
+    upload(reinterpret_cast<const unsigned char *>(_vertices.data()),_vertices.size()*sizeof(float),
+           static_cast<GLsizei>(MeshFile::VERTEXFLOATS*sizeof(float)),_indices,_indexCount,_indexSize);
+  }
+}
+
+size_t StaticMesh::vertexSize(Layout _layout)
+{
+  return _layout == Layout::PACKED ? sizeof(PackedVertex) : MeshFile::VERTEXFLOATS*sizeof(float);
+}
+
+void StaticMesh::load(const MeshFile &_mesh)
+{
+  m_layout=Layout::FLOAT;
+  const MeshHeader &header=_mesh.header();
+  upload(_mesh.vertices(),_mesh.vertexBytes(),static_cast<GLsizei>(header.m_stride),
+         _mesh.indices(),header.m_indexCount,header.m_indexSize);
+}
+
+void StaticMesh::load(const std::vector<float> &_vertices, const std::vector<uint32_t> &_indices)
+{
+  uploadVertices(_vertices,reinterpret_cast<const unsigned char *>(_indices.data()),_indices.size(),sizeof(uint32_t));
+}
+
+void StaticMesh::load(const std::vector<std::vector<float>> &_vertices,
+                      const std::vector<std::vector<uint32_t>> &_indices)
+{
+  std::vector<Part> parts;
+  size_t vertexCount=0;
+  size_t indexCount=0;
+  size_t largestPart=0;
+  for(size_t i=0; i<_vertices.size(); ++i)
+  {
+    size_t partVertices=_vertices[i].size()/MeshFile::VERTEXFLOATS;
+    parts.push_back({static_cast<GLsizei>(_indices[i].size()),static_cast<GLuint>(indexCount),
+                     static_cast<GLint>(vertexCount)});
+    vertexCount+=partVertices;
+    indexCount+=_indices[i].size();
+    largestPart=std::max(largestPart,partVertices);
+  }
+  std::vector<float> vertices;
+  vertices.reserve(vertexCount*MeshFile::VERTEXFLOATS);
+  for(auto &v : _vertices)
+  {
+    vertices.insert(vertices.end(),v.begin(),v.end());
+  }
+  // the indices are relative to each part's base vertex so 16 bits do as long as every part fits
+  size_t indexSize= largestPart <= 65536 ? 2 : 4;
+  std::vector<unsigned char> indices(indexCount*indexSize);
+  size_t next=0;
+  for(auto &part : _indices)
+  {
+    for(uint32_t index : part)
+    {
+      if(indexSize == 2)
+      {
+        reinterpret_cast<uint16_t *>(indices.data())[next++]=static_cast<uint16_t>(index);
+      }
+      else
+      {
+        reinterpret_cast<uint32_t *>(indices.data())[next++]=index;
+      }
+    }
+  }
+  uploadVertices(vertices,indices.data(),indexCount,indexSize);
+  m_parts=parts;
+}
+
+StaticMesh::DrawCommand StaticMesh::command(size_t _part, GLuint _instanceCount, GLuint _baseInstance) const
+{
+  const Part &p=m_parts[_part];
+  return {static_cast<GLuint>(p.m_indexCount),_instanceCount,p.m_firstIndex,p.m_baseVertex,_baseInstance};
+}
+
+void StaticMesh::draw(size_t _part) const
+{
+  const Part &p=m_parts[_part];
+  size_t indexSize= m_indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+  glBindVertexArray(m_vao);
+  glDrawElementsBaseVertex(GL_TRIANGLES,p.m_indexCount,m_indexType,
+                           reinterpret_cast<void *>(p.m_firstIndex*indexSize),p.m_baseVertex);
+  glBindVertexArray(0);
+}
+
+void StaticMesh::bindInstances(GLuint _instances, size_t _first)
+{
+  glBindBuffer(GL_ARRAY_BUFFER,_instances);
+  glEnableVertexAttribArray(INSTANCEATTRIB);
+  glVertexAttribIPointer(INSTANCEATTRIB,1,GL_UNSIGNED_INT,0,reinterpret_cast<void *>(_first*sizeof(uint32_t)));
+  glVertexAttribDivisor(INSTANCEATTRIB,1);
+}
+
+void StaticMesh::drawInstanced(size_t _part, GLuint _instances, size_t _first, size_t _count) const
+{
+  if(_count == 0)
+  {
+    return;
+  }
+  const Part &p=m_parts[_part];
+  size_t indexSize= m_indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+  glBindVertexArray(m_vao);
+  // the list is shared by every mesh drawing from it, pointing the attribute at this draw's range does the
+  // job of a base instance which GL 3.3 doesn't have
+  bindInstances(_instances,_first);
+  glDrawElementsInstancedBaseVertex(GL_TRIANGLES,p.m_indexCount,m_indexType,
+                                    reinterpret_cast<void *>(p.m_firstIndex*indexSize),
+                                    static_cast<GLsizei>(_count),p.m_baseVertex);
+  // the plain draw has no instance attribute
+  glDisableVertexAttribArray(INSTANCEATTRIB);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+}
+
+void StaticMesh::drawIndirect(GLuint _commands, size_t _first, size_t _count, GLuint _instances) const
+{
+  glBindVertexArray(m_vao);
+  // the base instance of each command offsets the attribute so the whole list is bound from its start
+  bindInstances(_instances,0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER,_commands);
+  glMultiDrawElementsIndirect(GL_TRIANGLES,m_indexType,reinterpret_cast<void *>(_first*sizeof(DrawCommand)),
+                              static_cast<GLsizei>(_count),0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER,0);
+  glDisableVertexAttribArray(INSTANCEATTRIB);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+}
@@ -0,0 +1,79 @@
+#include "TextureBuffer.h"
+#include <iostream>
+
+TextureBuffer::~TextureBuffer()
+{
+  glDeleteTextures(1,&m_texture);
+  glDeleteBuffers(1,&m_buffer);
+}
+
+void TextureBuffer::create(GLenum _format, GLuint _unit)
+{
+  m_format=_format;
+  m_unit=_unit;
+  glGenBuffers(1,&m_buffer);
+  glGenTextures(1,&m_texture);
+  // a zero sized buffer can't be attached on all drivers so start with one texel
+  reserve(16);
+}
+
+void TextureBuffer::bindToProgram(GLuint _programID, const std::string &_samplerName) const
+{
+  GLint location=glGetUniformLocation(_programID,_samplerName.c_str());
+  if(location == -1)
+  {
+    std::cerr<<"sampler "<<_samplerName<<" not found in program "<<_programID<<"\n";
+    return;
+  }
+  glUseProgram(_programID);
+  glUniform1i(location,static_cast<GLint>(m_unit));
+}
+
+void TextureBuffer::bind() const
+{
+  glActiveTexture(GL_TEXTURE0+m_unit);
+  glBindTexture(GL_TEXTURE_BUFFER,m_texture);
+}
+
+void TextureBuffer::reserve(size_t _bytes)
+{
+  if(_bytes <= m_capacity)
+  {
+    return;
+  }
+  // grow geometrically so a slowly increasing size doesn't reallocate every frame
+  size_t capacity=m_capacity*2 > _bytes ? m_capacity*2 : _bytes;
+  glBindBuffer(GL_TEXTURE_BUFFER,m_buffer);
+  glBufferData(GL_TEXTURE_BUFFER,capacity,nullptr,GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER,0);
+  glBindTexture(GL_TEXTURE_BUFFER,m_texture);
+  glTexBuffer(GL_TEXTURE_BUFFER,m_format,m_buffer);
+  glBindTexture(GL_TEXTURE_BUFFER,0);
+  m_capacity=capacity;
+}
+
+void TextureBuffer::update(size_t _offset, size_t _bytes, const void *_data, FrameStats &_stats)
+{
+  if(_bytes == 0)
+  {
+    return;
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER,m_buffer);
+  glBufferSubData(GL_TEXTURE_BUFFER,_offset,_bytes,_data);
+  glBindBuffer(GL_TEXTURE_BUFFER,0);
+  _stats.addUpload(_bytes);
+}
+
+void TextureBuffer::copy(GLuint _buffer, size_t _sourceOffset, size_t _offset, size_t _bytes)
+{
+  if(_bytes == 0)
+  {
+    return;
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER,_buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,m_buffer);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,static_cast<GLintptr>(_sourceOffset),
+                      static_cast<GLintptr>(_offset),static_cast<GLsizeiptr>(_bytes));
+  glBindBuffer(GL_COPY_READ_BUFFER,0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+}
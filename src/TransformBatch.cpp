@@ -0,0 +1,443 @@
+#include "TransformBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "SimdSupport.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief how far from orthonormal the columns of a 3x3 can be for it to be treated as a rotation
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static float RIGIDTOLERANCE=1.0e-5f;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief byte offsets of the members of a TransformStd140 block
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static size_t MVOFFSET=offsetof(TransformStd140,m_MV);
+constexpr static size_t MVPOFFSET=offsetof(TransformStd140,m_MVP);
+constexpr static size_t NORMALOFFSET=offsetof(TransformStd140,m_normalMatrix);
+constexpr static size_t IDOFFSET=offsetof(TransformStd140,m_objectID);
+
+namespace
+{
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief are the columns of a column major 3x3 (stride apart) orthonormal
+//----------------------------------------------------------------------------------------------------------------------
+bool isRotation(const float *_m, size_t _stride)
+{
+  for(size_t a=0; a<3; ++a)
+  {
+    for(size_t b=a; b<3; ++b)
+    {
+      const float *ca=_m+a*_stride;
+      const float *cb=_m+b*_stride;
+      float dot=ca[0]*cb[0]+ca[1]*cb[1]+ca[2]*cb[2];
+      if(std::fabs(dot-(a == b ? 1.0f : 0.0f)) > RIGIDTOLERANCE)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief inverse transpose of a column major 3x3 with columns _stride apart, the columns of A^-T are the cross
+/// products of the columns of A over its determinant
+/// @returns false and leaves o_n alone if the matrix is singular
+//----------------------------------------------------------------------------------------------------------------------
+bool inverseTranspose(const float *_m, size_t _stride, float o_n[9])
+{
+  const float *a=_m;
+  const float *b=_m+_stride;
+  const float *c=_m+2*_stride;
+  float bc[3]={b[1]*c[2]-b[2]*c[1],b[2]*c[0]-b[0]*c[2],b[0]*c[1]-b[1]*c[0]};
+  float det=a[0]*bc[0]+a[1]*bc[1]+a[2]*bc[2];
+  if(std::fabs(det) < 1.0e-12f)
+  {
+    return false;
+  }
+  float inv=1.0f/det;
+  float ca[3]={c[1]*a[2]-c[2]*a[1],c[2]*a[0]-c[0]*a[2],c[0]*a[1]-c[1]*a[0]};
+  float ab[3]={a[1]*b[2]-a[2]*b[1],a[2]*b[0]-a[0]*b[2],a[0]*b[1]-a[1]*b[0]};
+  for(int r=0; r<3; ++r)
+  {
+    o_n[r]=bc[r]*inv;
+    o_n[3+r]=ca[r]*inv;
+    o_n[6+r]=ab[r]*inv;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief reference implementation, one object at a time
+//----------------------------------------------------------------------------------------------------------------------
+void transformScalar(const float *const *_m, const float *const *_n, const TransformBatch::Frame &_f, char *_out,
+                     size_t _stride, size_t _begin, size_t _end)
+{
+  const float *V=_f.m_view;
+  const float *PV=_f.m_viewProjection;
+  const float *W=_f.m_normalView;
+  for(size_t i=_begin; i<_end; ++i)
+  {
+    TransformStd140 *t=reinterpret_cast<TransformStd140 *>(_out+i*_stride);
+    for(int c=0; c<4; ++c)
+    {
+      float x=_m[c*3][i];
+      float y=_m[c*3+1][i];
+      float z=_m[c*3+2][i];
+      // the model's bottom row is 0 0 0 1
+      float w= c == 3 ? 1.0f : 0.0f;
+      for(int r=0; r<4; ++r)
+      {
+        t->m_MV[c*4+r]=V[r]*x+V[4+r]*y+V[8+r]*z+V[12+r]*w;
+        t->m_MVP[c*4+r]=PV[r]*x+PV[4+r]*y+PV[8+r]*z+PV[12+r]*w;
+      }
+    }
+    for(int c=0; c<3; ++c)
+    {
+      float x=_n[c*3][i];
+      float y=_n[c*3+1][i];
+      float z=_n[c*3+2][i];
+      for(int r=0; r<3; ++r)
+      {
+        t->m_normalMatrix[c*4+r]=W[r]*x+W[3+r]*y+W[6+r]*z;
+      }
+      t->m_normalMatrix[c*4+3]=0.0f;
+    }
+    t->m_objectID=static_cast<int32_t>(_f.m_firstID+i);
+    t->m_pad[0]=t->m_pad[1]=t->m_pad[2]=0;
+  }
+}
+
+#if defined(SIMD_X86)
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief transpose 4 rows of 4 objects into a column of each object's block, _out points at the first one
+//----------------------------------------------------------------------------------------------------------------------
+inline void storeColumns(__m128 _r0, __m128 _r1, __m128 _r2, __m128 _r3, char *_out, size_t _stride)
+{
+  _MM_TRANSPOSE4_PS(_r0,_r1,_r2,_r3);
+  _mm_storeu_ps(reinterpret_cast<float *>(_out),_r0);
+  _mm_storeu_ps(reinterpret_cast<float *>(_out+_stride),_r1);
+  _mm_storeu_ps(reinterpret_cast<float *>(_out+2*_stride),_r2);
+  _mm_storeu_ps(reinterpret_cast<float *>(_out+3*_stride),_r3);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the object ids of 4 consecutive objects and the padding after them
+//----------------------------------------------------------------------------------------------------------------------
+inline void storeIDs(size_t _first, char *_out, size_t _stride)
+{
+  for(size_t l=0; l<4; ++l)
+  {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(_out+l*_stride),_mm_set_epi32(0,0,0,static_cast<int>(_first+l)));
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a column of 4 objects times a broadcast matrix, rows 0-3 of _mat*(x,y,z,w)
+//----------------------------------------------------------------------------------------------------------------------
+inline __m128 row4(const float *_mat, int _r, __m128 _x, __m128 _y, __m128 _z)
+{
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(_mat[_r]),_x),_mm_mul_ps(_mm_set1_ps(_mat[4+_r]),_y)),
+                    _mm_mul_ps(_mm_set1_ps(_mat[8+_r]),_z));
+}
+
+void transformSSE2(const float *const *_m, const float *const *_n, const TransformBatch::Frame &_f, char *_out,
+                   size_t _stride, size_t _begin, size_t _end)
+{
+  const float *V=_f.m_view;
+  const float *PV=_f.m_viewProjection;
+  const float *W=_f.m_normalView;
+  const __m128 zero=_mm_setzero_ps();
+  size_t i=_begin;
+  for(; i+4<=_end; i+=4)
+  {
+    char *out=_out+i*_stride;
+    for(int c=0; c<4; ++c)
+    {
+      __m128 x=_mm_loadu_ps(&_m[c*3][i]);
+      __m128 y=_mm_loadu_ps(&_m[c*3+1][i]);
+      __m128 z=_mm_loadu_ps(&_m[c*3+2][i]);
+      __m128 mv[4];
+      __m128 mvp[4];
+      for(int r=0; r<4; ++r)
+      {
+        mv[r]=row4(V,r,x,y,z);
+        mvp[r]=row4(PV,r,x,y,z);
+        // the translation column picks up the view's translation
+        if(c == 3)
+        {
+          mv[r]=_mm_add_ps(mv[r],_mm_set1_ps(V[12+r]));
+          mvp[r]=_mm_add_ps(mvp[r],_mm_set1_ps(PV[12+r]));
+        }
+      }
+      storeColumns(mv[0],mv[1],mv[2],mv[3],out+MVOFFSET+c*4*sizeof(float),_stride);
+      storeColumns(mvp[0],mvp[1],mvp[2],mvp[3],out+MVPOFFSET+c*4*sizeof(float),_stride);
+    }
+    for(int c=0; c<3; ++c)
+    {
+      __m128 x=_mm_loadu_ps(&_n[c*3][i]);
+      __m128 y=_mm_loadu_ps(&_n[c*3+1][i]);
+      __m128 z=_mm_loadu_ps(&_n[c*3+2][i]);
+      __m128 n[3];
+      for(int r=0; r<3; ++r)
+      {
+        n[r]=_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(W[r]),x),_mm_mul_ps(_mm_set1_ps(W[3+r]),y)),
+                        _mm_mul_ps(_mm_set1_ps(W[6+r]),z));
+      }
+      storeColumns(n[0],n[1],n[2],zero,out+NORMALOFFSET+c*4*sizeof(float),_stride);
+    }
+    storeIDs(_f.m_firstID+i,out+IDOFFSET,_stride);
+  }
+  transformScalar(_m,_n,_f,_out,_stride,i,_end);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief 8 wide version of row4
+//----------------------------------------------------------------------------------------------------------------------
+SIMD_AVX2 inline __m256 row8(const float *_mat, int _r, __m256 _x, __m256 _y, __m256 _z)
+{
+  return _mm256_fmadd_ps(_mm256_set1_ps(_mat[8+_r]),_z,
+                         _mm256_fmadd_ps(_mm256_set1_ps(_mat[4+_r]),_y,_mm256_mul_ps(_mm256_set1_ps(_mat[_r]),_x)));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief transpose 4 rows of 8 objects into a column of each object's block, a 4x4 transpose per half
+//----------------------------------------------------------------------------------------------------------------------
+SIMD_AVX2 inline void storeColumns8(__m256 _r0, __m256 _r1, __m256 _r2, __m256 _r3, char *_out, size_t _stride)
+{
+  storeColumns(_mm256_castps256_ps128(_r0),_mm256_castps256_ps128(_r1),
+               _mm256_castps256_ps128(_r2),_mm256_castps256_ps128(_r3),_out,_stride);
+  storeColumns(_mm256_extractf128_ps(_r0,1),_mm256_extractf128_ps(_r1,1),
+               _mm256_extractf128_ps(_r2,1),_mm256_extractf128_ps(_r3,1),_out+4*_stride,_stride);
+}
+
+SIMD_AVX2 void transformAVX2(const float *const *_m, const float *const *_n, const TransformBatch::Frame &_f,
+                                  char *_out, size_t _stride, size_t _begin, size_t _end)
+{
+  const float *V=_f.m_view;
+  const float *PV=_f.m_viewProjection;
+  const float *W=_f.m_normalView;
+  const __m256 zero=_mm256_setzero_ps();
+  size_t i=_begin;
+  for(; i+8<=_end; i+=8)
+  {
+    char *out=_out+i*_stride;
+    for(int c=0; c<4; ++c)
+    {
+      __m256 x=_mm256_loadu_ps(&_m[c*3][i]);
+      __m256 y=_mm256_loadu_ps(&_m[c*3+1][i]);
+      __m256 z=_mm256_loadu_ps(&_m[c*3+2][i]);
+      __m256 mv[4];
+      __m256 mvp[4];
+      for(int r=0; r<4; ++r)
+      {
+        mv[r]=row8(V,r,x,y,z);
+        mvp[r]=row8(PV,r,x,y,z);
+        if(c == 3)
+        {
+          mv[r]=_mm256_add_ps(mv[r],_mm256_set1_ps(V[12+r]));
+          mvp[r]=_mm256_add_ps(mvp[r],_mm256_set1_ps(PV[12+r]));
+        }
+      }
+      storeColumns8(mv[0],mv[1],mv[2],mv[3],out+MVOFFSET+c*4*sizeof(float),_stride);
+      storeColumns8(mvp[0],mvp[1],mvp[2],mvp[3],out+MVPOFFSET+c*4*sizeof(float),_stride);
+    }
+    for(int c=0; c<3; ++c)
+    {
+      __m256 x=_mm256_loadu_ps(&_n[c*3][i]);
+      __m256 y=_mm256_loadu_ps(&_n[c*3+1][i]);
+      __m256 z=_mm256_loadu_ps(&_n[c*3+2][i]);
+      __m256 n[3];
+      for(int r=0; r<3; ++r)
+      {
+        n[r]=_mm256_fmadd_ps(_mm256_set1_ps(W[6+r]),z,
+                             _mm256_fmadd_ps(_mm256_set1_ps(W[3+r]),y,_mm256_mul_ps(_mm256_set1_ps(W[r]),x)));
+      }
+      storeColumns8(n[0],n[1],n[2],zero,out+NORMALOFFSET+c*4*sizeof(float),_stride);
+    }
+    storeIDs(_f.m_firstID+i,out+IDOFFSET,_stride);
+    storeIDs(_f.m_firstID+i+4,out+IDOFFSET+4*_stride,_stride);
+  }
+  // finish the tail 4 then 1 at a time
+  transformSSE2(_m,_n,_f,_out,_stride,i,_end);
+}
+
+#endif
+
+} // end anonymous namespace
+
+TransformBatch::TransformBatch()
+{
+  m_kernel=Kernel::SCALAR;
+  m_transform=transformScalar;
+#if defined(SIMD_X86)
+  if(isSupported(Kernel::AVX2))
+  {
+    m_kernel=Kernel::AVX2;
+    m_transform=transformAVX2;
+  }
+  else
+  {
+    m_kernel=Kernel::SSE2;
+    m_transform=transformSSE2;
+  }
+#endif
+}
+
+TransformBatch::TransformBatch(Kernel _kernel)
+{
+  m_kernel=Kernel::SCALAR;
+  m_transform=transformScalar;
+#if defined(SIMD_X86)
+  if(isSupported(_kernel))
+  {
+    m_kernel=_kernel;
+    switch(_kernel)
+    {
+      case Kernel::AVX2 : m_transform=transformAVX2; break;
+      case Kernel::SSE2 : m_transform=transformSSE2; break;
+      case Kernel::SCALAR : break;
+    }
+  }
+#endif
+}
+
+void TransformBatch::clear()
+{
+  // swapped rather than cleared so a batch that held every teapot gives its memory back
+  for(auto &m : m_models)
+  {
+    std::vector<float>().swap(m);
+  }
+  for(auto &n : m_normals)
+  {
+    std::vector<float>().swap(n);
+  }
+  std::vector<char>().swap(m_output);
+  m_inverted=0;
+}
+
+void TransformBatch::reserve(size_t _count)
+{
+  for(auto &m : m_models)
+  {
+    m.reserve(_count);
+  }
+  for(auto &n : m_normals)
+  {
+    n.reserve(_count);
+  }
+}
+
+void TransformBatch::addModel(const float *_model)
+{
+  for(size_t c=0; c<4; ++c)
+  {
+    for(size_t r=0; r<3; ++r)
+    {
+      m_models[c*3+r].push_back(_model[c*4+r]);
+    }
+  }
+  // a rotation is its own inverse transpose, anything else pays for the inverse here rather than every frame
+  float normal[9];
+  if(isRotation(_model,4) || !inverseTranspose(_model,4,normal))
+  {
+    for(size_t c=0; c<3; ++c)
+    {
+      for(size_t r=0; r<3; ++r)
+      {
+        normal[c*3+r]=_model[c*4+r];
+      }
+    }
+  }
+  else
+  {
+    ++m_inverted;
+  }
+  for(size_t i=0; i<9; ++i)
+  {
+    m_normals[i].push_back(normal[i]);
+  }
+  m_output.resize(size()*m_stride);
+}
+
+void TransformBatch::setStride(size_t _stride)
+{
+  m_stride=std::max(_stride,sizeof(TransformStd140));
+  m_output.resize(size()*m_stride);
+}
+
+void TransformBatch::transform(const float *_view, const float *_projection, size_t _begin, size_t _end)
+{
+  _end=std::min(_end,size());
+  if(_begin >= _end)
+  {
+    return;
+  }
+  Frame frame;
+  frame.m_firstID=m_firstID;
+  std::copy(_view,_view+16,frame.m_view);
+  for(int c=0; c<4; ++c)
+  {
+    for(int r=0; r<4; ++r)
+    {
+      float sum=0.0f;
+      for(int k=0; k<4; ++k)
+      {
+        sum+=_projection[k*4+r]*_view[c*4+k];
+      }
+      frame.m_viewProjection[c*4+r]=sum;
+    }
+  }
+  // the camera and mouse views are rotations so this is almost always just the view's 3x3
+  if(isRotation(_view,4) || !inverseTranspose(_view,4,frame.m_normalView))
+  {
+    for(int c=0; c<3; ++c)
+    {
+      for(int r=0; r<3; ++r)
+      {
+        frame.m_normalView[c*3+r]=_view[c*4+r];
+      }
+    }
+  }
+  const float *models[12];
+  const float *normals[9];
+  for(size_t i=0; i<12; ++i)
+  {
+    models[i]=m_models[i].data();
+  }
+  for(size_t i=0; i<9; ++i)
+  {
+    normals[i]=m_normals[i].data();
+  }
+  m_transform(models,normals,frame,m_output.data(),m_stride,_begin,_end);
+}
+
+const char *TransformBatch::kernelName(Kernel _kernel)
+{
+  switch(_kernel)
+  {
+    case Kernel::AVX2 : return "avx2";
+    case Kernel::SSE2 : return "sse2";
+    case Kernel::SCALAR : return "scalar";
+  }
+  return "unknown";
+}
+
+bool TransformBatch::isSupported(Kernel _kernel)
+{
+  switch(_kernel)
+  {
+    case Kernel::SCALAR : return true;
+#if defined(SIMD_X86)
+    // the build targets SSE2 so any CPU it runs on has it
+    case Kernel::SSE2 : return true;
+    case Kernel::AVX2 : return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    default : return false;
+#endif
+  }
+  return false;
+}
@@ -3,19 +3,231 @@ basic OpenGL demo modified from http://qt-project.org/doc/qt-5.0/qtgui/openglwin
 ****************************************************************************/
 
 #include <QtGui/QGuiApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <cstring>
 #include <iostream>
 #include "NGLScene.h"
+#include "OffscreenBenchmark.h"
 
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief split a <a>x<b> option value
+/// @returns false if the value isn't of that form
+//----------------------------------------------------------------------------------------------------------------------
+static bool parseSize(const QString &_value, int &o_a, int &o_b)
+{
+  QStringList parts=_value.split("x");
+  if(parts.size()!=2)
+  {
+    return false;
+  }
+  o_a=parts.at(0).toInt();
+  o_b=parts.at(1).toInt();
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief every command line option, shared by main, which adds them to the parser, and the functions that
+/// read them
+//----------------------------------------------------------------------------------------------------------------------
+struct Options
+{
+  QCommandLineOption m_grid{QStringList() << "g" << "grid",
+                            "teapot grid dimensions as <columns>x<rows> (default 8x8)","grid","8x8"};
+  QCommandLineOption m_loop{"no-instancing","draw the teapots one at a time rather than with a single instanced draw"};
+  QCommandLineOption m_noCull{"no-object-culling","shade every object with the cluster light lists rather than its own"};
+  QCommandLineOption m_deferred{"deferred","start with deferred rather than forward shading"};
+  QCommandLineOption m_noShadows{"no-shadows","draw the spots without shadow maps"};
+  QCommandLineOption m_shadowBudget{"shadow-budget","most shadow tiles redrawn per frame, 0 for no limit (default 8)","tiles","8"};
+  QCommandLineOption m_noLod{"no-lod","draw every teapot and the plane with the full mesh rather than the level of detail for its size on screen"};
+  QCommandLineOption m_noGpuCull{"no-gpu-culling","frustum cull the teapots on the CPU and draw a level at a time even when compute shaders are available"};
+  QCommandLineOption m_paused{"paused","start with the light animation paused"};
+  QCommandLineOption m_gpuAnimation{"gpu-animation","evaluate the spot animation in a compute shader, G toggles it"};
+  QCommandLineOption m_packedVertices{"packed-vertices","upload the teapot and plane with half float positions and octahedral normals, 12 rather than 32 bytes a vertex"};
+  QCommandLineOption m_depthPrepass{"depth-prepass","lay down the depth first so the forward lighting runs once per visible pixel, Z toggles it"};
+  QCommandLineOption m_jobs{"jobs","threads sharing the per frame CPU work, 0 for one per core, 1 to run it all on the render thread (default 0)","threads","0"};
+  QCommandLineOption m_budget{"frame-budget","scale the render size to keep the GPU frame time under this many ms, R toggles it (default off)","ms","0"};
+  QCommandLineOption m_minScale{"min-scale","smallest render scale of each axis with --frame-budget (default 0.5)","scale","0.5"};
+  QCommandLineOption m_fxaa{"fxaa","anti-alias with FXAA rather than 4x multisampling"};
+  QCommandLineOption m_halfRes{"half-res-lighting","evaluate the deferred lights at half resolution with a bilateral upsample"};
+  QCommandLineOption m_resolutionLog{"resolution-log","write the GPU time and render scale of every frame to a CSV file","file"};
+  QCommandLineOption m_scene{"scene","draw the teapots and spots of a scene file written by SceneConvert","file"};
+  QCommandLineOption m_record{"record","record the lights of every animation tick to a file","file"};
+  QCommandLineOption m_replay{"replay","play back a recording rather than animating the lights","file"};
+  QCommandLineOption m_capture{"capture","write every frame drawn to numbered .png or .exr files or a .y4m stream, %d in the name sets the numbering","file"};
+  QCommandLineOption m_captureFps{"capture-fps","frame rate written in a .y4m capture (default 30)","fps","30"};
+  QCommandLineOption m_lights{QStringList() << "l" << "lights","number of spot lights (default 8)","count","8"};
+  QCommandLineOption m_stats{"stats","print the uniform calls and bytes uploaded per frame once a second"};
+  QCommandLineOption m_seed{"seed","random seed for the lights, the time is used if not given","seed","1"};
+  QCommandLineOption m_bench{"bench","render offscreen with no window and print the frame times as JSON"};
+  QCommandLineOption m_size{"size","benchmark resolution as <width>x<height> (default 1280x720)","size","1280x720"};
+  QCommandLineOption m_frames{"frames","number of benchmark frames timed (default 300)","count","300"};
+  QCommandLineOption m_warmup{"warmup","number of benchmark frames rendered before timing (default 30)","count","30"};
+  QCommandLineOption m_output{"bench-output","write the benchmark JSON to a file rather than stdout","file"};
+  QCommandLineOption m_image{"bench-image","save the last benchmark frame to an image","file"};
+  QCommandLineOption m_crossover{"crossover","benchmark forward against deferred shading from 8 up to this many lights","lights"};
+  QCommandLineOption m_profile{"profile","show the per phase CPU and GPU timings over the scene"};
+  QCommandLineOption m_trace{"trace","write a Chrome trace of the first frames (the timed frames with --bench)","file"};
+  QCommandLineOption m_noCache{"no-shader-cache","always compile the shaders rather than loading cached binaries"};
+  QCommandLineOption m_noMeshCache{"no-mesh-cache","build the ground plane every run rather than mapping the cached mesh"};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief add every option to a parser, in the order --help lists them
+  //----------------------------------------------------------------------------------------------------------------------
+  void addTo(QCommandLineParser &_parser) const
+  {
+    _parser.addOptions({m_grid,m_loop,m_noCull,m_deferred,m_noShadows,m_shadowBudget,m_noLod,m_noGpuCull,m_paused,
+                        m_gpuAnimation,m_packedVertices,m_depthPrepass,m_jobs,m_budget,m_minScale,m_fxaa,m_halfRes,
+                        m_resolutionLog,m_scene,m_record,m_replay,m_capture,m_captureFps,m_lights,m_stats,m_seed,
+                        m_bench,m_size,m_frames,m_warmup,m_output,m_image,m_crossover,m_profile,m_trace,m_noCache,
+                        m_noMeshCache});
+  }
+};
 
+static const Options &options()
+{
+  static const Options s_options;
+  return s_options;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a directory under the per user cache directory, created if need be
+/// @returns the path or an empty string if it couldn't be created
+//----------------------------------------------------------------------------------------------------------------------
+static std::string cacheDir(const QString &_name)
+{
+  QString dir=QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(_name);
+  return QDir().mkpath(dir) ? dir.toStdString() : std::string();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief apply the options the window and the benchmark share to the scene, before initializeGL
+//----------------------------------------------------------------------------------------------------------------------
+static void configureScene(const QCommandLineParser &_parser, NGLScene &_scene)
+{
+  const Options &o=options();
+  int gridX=8;
+  int gridZ=8;
+  if(parseSize(_parser.value(o.m_grid),gridX,gridZ))
+  {
+    _scene.setGridSize(gridX,gridZ);
+  }
+  else
+  {
+    std::cerr<<"invalid grid size, expected <columns>x<rows>\n";
+  }
+  _scene.setInstanced(!_parser.isSet(o.m_loop));
+  _scene.setObjectCulling(!_parser.isSet(o.m_noCull));
+  _scene.setDeferred(_parser.isSet(o.m_deferred));
+  _scene.setShadowMapping(!_parser.isSet(o.m_noShadows));
+  _scene.setShadowBudget(_parser.value(o.m_shadowBudget).toUInt());
+  _scene.setLod(!_parser.isSet(o.m_noLod));
+  _scene.setGpuCulling(!_parser.isSet(o.m_noGpuCull));
+  _scene.setAnimate(!_parser.isSet(o.m_paused));
+  _scene.setGpuAnimation(_parser.isSet(o.m_gpuAnimation));
+  _scene.setPackedVertices(_parser.isSet(o.m_packedVertices));
+  _scene.setDepthPrepass(_parser.isSet(o.m_depthPrepass));
+  _scene.setJobThreads(_parser.value(o.m_jobs).toInt());
+  _scene.setMinRenderScale(_parser.value(o.m_minScale).toFloat());
+  _scene.setFrameBudget(_parser.value(o.m_budget).toDouble());
+  _scene.setFxaa(_parser.isSet(o.m_fxaa));
+  _scene.setHalfResLighting(_parser.isSet(o.m_halfRes));
+  _scene.setResolutionLog(_parser.value(o.m_resolutionLog).toStdString());
+  _scene.setNumLights(_parser.value(o.m_lights).toInt());
+  if(_parser.isSet(o.m_seed))
+  {
+    _scene.setSeed(_parser.value(o.m_seed).toUInt());
+  }
+  // linked shader binaries and the generated ground plane are kept in the per user cache directory
+  _scene.setShaderCacheDir(_parser.isSet(o.m_noCache) ? std::string() : cacheDir("shaders"));
+  _scene.setMeshCacheDir(_parser.isSet(o.m_noMeshCache) ? std::string() : cacheDir("meshes"));
+  _scene.setSceneFile(_parser.value(o.m_scene).toStdString());
+  _scene.setRecordFile(_parser.value(o.m_record).toStdString());
+  _scene.setReplayFile(_parser.value(o.m_replay).toStdString());
+  _scene.setCaptureFile(_parser.value(o.m_capture).toStdString(),_parser.value(o.m_captureFps).toInt());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief render the scene offscreen and report the frame times as JSON
+//----------------------------------------------------------------------------------------------------------------------
+static int runBenchmark(const QCommandLineParser &_parser, const QSurfaceFormat &_format)
+{
+  const Options &o=options();
+  int width=1280;
+  int height=720;
+  if(!parseSize(_parser.value(o.m_size),width,height))
+  {
+    std::cerr<<"invalid size, expected <width>x<height>\n";
+  }
+  OffscreenBenchmark bench(width,height,_format);
+  NGLScene &scene=bench.scene();
+  configureScene(_parser,scene);
+  // the benchmark always uses a fixed seed so runs can be compared
+  unsigned int seed=_parser.value(o.m_seed).toUInt();
+  scene.setSeed(seed);
+  if(_parser.isSet(o.m_trace))
+  {
+    bench.setTraceFile(_parser.value(o.m_trace).toStdString());
+  }
+  int frames=_parser.value(o.m_frames).toInt();
+  int warmup=_parser.value(o.m_warmup).toInt();
+  bool ok= _parser.isSet(o.m_crossover) ? bench.runCrossover(_parser.value(o.m_crossover).toUInt(),frames,warmup)
+                                        : bench.run(frames,warmup);
+  if(!ok)
+  {
+    return EXIT_FAILURE;
+  }
+  QJsonObject results=bench.results();
+  results["seed"]=static_cast<qint64>(seed);
+  QByteArray json=QJsonDocument(results).toJson(QJsonDocument::Indented);
+  if(_parser.isSet(o.m_output))
+  {
+    QFile file(_parser.value(o.m_output));
+    if(!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+      std::cerr<<"unable to write "<<_parser.value(o.m_output).toStdString()<<"\n";
+      return EXIT_FAILURE;
+    }
+    file.write(json);
+  }
+  else
+  {
+    std::cout<<json.constData();
+  }
+  if(_parser.isSet(o.m_image) && !bench.saveFrame(_parser.value(o.m_image)))
+  {
+    std::cerr<<"unable to save "<<_parser.value(o.m_image).toStdString()<<"\n";
+  }
+  return EXIT_SUCCESS;
+}
 
 int main(int argc, char **argv)
 {
+  // the benchmark needs no window system, this has to be set before the application is created
+  for(int i=1; i<argc; ++i)
+  {
+    if(std::strcmp(argv[i],"--bench")==0 && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+      qputenv("QT_QPA_PLATFORM","offscreen");
+    }
+  }
   QGuiApplication app(argc, argv);
+  // process the command line so the scene size can be changed without a rebuild
+  QCommandLineParser parser;
+  parser.setApplicationDescription("ngl::SpotLight demo");
+  parser.addHelpOption();
+  const Options &o=options();
+  o.addTo(parser);
+  parser.process(app);
   // create an OpenGL format specifier
   QSurfaceFormat format;
   // set the number of samples for multisampling
   // will need to enable glEnable(GL_MULTISAMPLE); once we have a context
-  format.setSamples(4);
+  // FXAA takes the place of multisampling
+  format.setSamples(parser.isSet(o.m_fxaa) ? 0 : 4);
   #if defined(__APPLE__)
     // at present mac osx Mountain Lion only supports GL3.2
     // the new mavericks will have GL 4.x so can change
@@ -30,8 +242,19 @@ int main(int argc, char **argv)
   format.setProfile(QSurfaceFormat::CoreProfile);
   // now set the depth buffer to 24 bits
   format.setDepthBufferSize(24);
+  if(parser.isSet(o.m_bench))
+  {
+    return runBenchmark(parser,format);
+  }
   // now we are going to create our scene window
   NGLScene window;
+  configureScene(parser,window);
+  window.setPrintStats(parser.isSet(o.m_stats));
+  window.setShowProfile(parser.isSet(o.m_profile));
+  if(parser.isSet(o.m_trace))
+  {
+    window.captureTrace(parser.value(o.m_trace).toStdString(),120);
+  }
   // and set the OpenGL format
   window.setFormat(format);
   // we can now query the version to see if it worked
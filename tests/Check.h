@@ -0,0 +1,46 @@
+#ifndef CHECK_H_
+#define CHECK_H_
+#include <cstdlib>
+#include <iostream>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Check.h
+/// @brief the assertion the unit tests share, a failed check is reported with its line and the test carries on
+/// so one run lists every failure, main returns testResult()
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the checks failed so far
+//----------------------------------------------------------------------------------------------------------------------
+inline int &testFailures()
+{
+  static int failures=0;
+  return failures;
+}
+
+inline bool checkTrue(bool _condition, const char *_text, const char *_file, int _line)
+{
+  if(!_condition)
+  {
+    std::cerr<<_file<<":"<<_line<<" check failed : "<<_text<<"\n";
+    ++testFailures();
+  }
+  return _condition;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the exit code of a test, EXIT_FAILURE if any check failed
+//----------------------------------------------------------------------------------------------------------------------
+inline int testResult()
+{
+  if(testFailures() != 0)
+  {
+    std::cerr<<testFailures()<<" checks failed\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+#define CHECK(_condition) checkTrue((_condition),#_condition,__FILE__,__LINE__)
+
+#endif
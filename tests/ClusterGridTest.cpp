@@ -0,0 +1,251 @@
+/****************************************************************************
+Unit test of ClusterGrid::assign. Random eye space spots are binned into the
+grid for NGLScene's projection and every cluster's list is compared with a
+brute force one that tests each light against each cluster's bounds, built
+here independently of the grid. Points sampled inside every froxel that a
+light actually reaches (inside its range and cone, as the shader tests) must
+find that light in their cluster's list, and the slice of a depth must match
+a search of the slice boundaries. Returns EXIT_FAILURE on any mismatch.
+usage : ClusterGridTest
+****************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "ClusterGrid.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the projection NGLScene builds the grid for and the samples taken per froxel
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static float ZNEAR=0.05f;
+constexpr static float ZFAR=350.0f;
+constexpr static float FOV=45.0f;
+constexpr static float ASPECT=16.0f/9.0f;
+constexpr static int SAMPLES=4;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief spots scattered through the frustum pointing anywhere, cutoffs from narrow to 80 degrees so both
+/// shapes of cone bound are used, some crossing the near plane and some behind the camera
+//----------------------------------------------------------------------------------------------------------------------
+static void randomLights(size_t _count, std::vector<LightStd140> &o_lights)
+{
+  std::mt19937 gen(4321);
+  std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+  std::uniform_real_distribution<float> positive(0.0f,1.0f);
+  o_lights.assign(_count,LightStd140());
+  for(auto &l : o_lights)
+  {
+    float depth=positive(gen)*positive(gen)*60.0f-2.0f;
+    l.m_position[0]=unit(gen)*0.5f*std::max(depth,1.0f);
+    l.m_position[1]=unit(gen)*0.3f*std::max(depth,1.0f);
+    l.m_position[2]=-depth;
+    l.m_position[3]=1.0f;
+    float d[3]={unit(gen),unit(gen),unit(gen)};
+    float len=std::max(std::sqrt(d[0]*d[0]+d[1]*d[1]+d[2]*d[2]),0.001f);
+    for(int i=0; i<3; ++i)
+    {
+      l.m_direction[i]=d[i]/len;
+    }
+    float cutoff=(positive(gen)*79.0f+1.0f)*3.14159265f/180.0f;
+    l.m_spotCosCutoff=std::cos(cutoff);
+    l.m_range=positive(gen)*20.0f+0.5f;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the test the lighting shader makes, whether a point is inside a light's range and cone
+//----------------------------------------------------------------------------------------------------------------------
+static bool pointLit(const LightStd140 &_light, const float *_p)
+{
+  float v[3];
+  float d=0.0f;
+  for(int i=0; i<3; ++i)
+  {
+    v[i]=_p[i]-_light.m_position[i];
+    d+=v[i]*v[i];
+  }
+  d=std::sqrt(d);
+  if(d > _light.m_range)
+  {
+    return false;
+  }
+  if(d < 1e-6f)
+  {
+    return true;
+  }
+  float spotDot=(v[0]*_light.m_direction[0]+v[1]*_light.m_direction[1]+v[2]*_light.m_direction[2])/d;
+  return spotDot >= _light.m_spotCosCutoff;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the depth where slice _z starts
+//----------------------------------------------------------------------------------------------------------------------
+static float sliceDepth(unsigned int _z, unsigned int _dimZ)
+{
+  return ZNEAR*std::pow(ZFAR/ZNEAR,static_cast<float>(_z)/_dimZ);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief whether the box around a light's bounding sphere overlaps a froxel's depths and, once it is wholly in
+/// front of the near plane, the screen tile it projects to
+//----------------------------------------------------------------------------------------------------------------------
+static bool sphereOverlapsFroxel(const BoundingSphere &_sphere, float _xScale, float _yScale, const float *_ndcMin,
+                                 const float *_ndcMax, float _d0, float _d1)
+{
+  float nearDepth=-_sphere.m_centre[2]-_sphere.m_radius;
+  float farDepth=-_sphere.m_centre[2]+_sphere.m_radius;
+  if(farDepth < _d0 || nearDepth > _d1 || farDepth < ZNEAR || nearDepth > ZFAR)
+  {
+    return false;
+  }
+  if(nearDepth <= ZNEAR)
+  {
+    return true;
+  }
+  float scale[2]={_xScale,_yScale};
+  for(int i=0; i<2; ++i)
+  {
+    float lo=scale[i]*(_sphere.m_centre[i]-_sphere.m_radius);
+    float hi=scale[i]*(_sphere.m_centre[i]+_sphere.m_radius);
+    lo=std::min(lo/nearDepth,lo/farDepth);
+    hi=std::max(hi/nearDepth,hi/farDepth);
+    // tiles on the screen edge take everything past it
+    if((hi < _ndcMin[i] && _ndcMin[i] > -1.0f) || (lo > _ndcMax[i] && _ndcMax[i] < 1.0f) || hi < -1.0f || lo > 1.0f)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the eye space box around a froxel and the sphere around the box
+//----------------------------------------------------------------------------------------------------------------------
+static void froxelBounds(const ClusterGrid &_grid, float _xScale, float _yScale, unsigned int _x, unsigned int _y,
+                         unsigned int _z, float *o_min, float *o_max, BoundingSphere &o_sphere)
+{
+  float d[2]={sliceDepth(_z,_grid.dimZ()),sliceDepth(_z+1,_grid.dimZ())};
+  float nx[2]={-1.0f+2.0f*_x/_grid.dimX(),-1.0f+2.0f*(_x+1)/_grid.dimX()};
+  float ny[2]={-1.0f+2.0f*_y/_grid.dimY(),-1.0f+2.0f*(_y+1)/_grid.dimY()};
+  o_min[0]=o_min[1]=1e30f;
+  o_max[0]=o_max[1]=-1e30f;
+  for(int i=0; i<2; ++i)
+  {
+    for(int j=0; j<2; ++j)
+    {
+      o_min[0]=std::min(o_min[0],nx[i]*d[j]/_xScale);
+      o_max[0]=std::max(o_max[0],nx[i]*d[j]/_xScale);
+      o_min[1]=std::min(o_min[1],ny[i]*d[j]/_yScale);
+      o_max[1]=std::max(o_max[1],ny[i]*d[j]/_yScale);
+    }
+  }
+  o_min[2]=-d[1];
+  o_max[2]=-d[0];
+  float halfDiagonalSq=0.0f;
+  for(int i=0; i<3; ++i)
+  {
+    o_sphere.m_centre[i]=0.5f*(o_min[i]+o_max[i]);
+    float h=0.5f*(o_max[i]-o_min[i]);
+    halfDiagonalSq+=h*h;
+  }
+  o_sphere.m_radius=std::sqrt(halfDiagonalSq);
+}
+
+int main()
+{
+  float yScale=1.0f/std::tan(0.5f*FOV*3.14159265f/180.0f);
+  float xScale=yScale/ASPECT;
+  ClusterGrid grid;
+  grid.setProjection(xScale,yScale,ZNEAR,ZFAR);
+  std::vector<LightStd140> lights;
+  randomLights(256,lights);
+  grid.assign(lights.data(),lights.size());
+
+  CHECK(grid.cells().size() == grid.numClusters()*2);
+  size_t listed=0;
+  size_t mismatched=0;
+  size_t missed=0;
+  std::mt19937 gen(99);
+  std::uniform_real_distribution<float> positive(0.0f,1.0f);
+  std::vector<uint32_t> reference;
+  for(unsigned int z=0; z<grid.dimZ(); ++z)
+  {
+    for(unsigned int y=0; y<grid.dimY(); ++y)
+    {
+      for(unsigned int x=0; x<grid.dimX(); ++x)
+      {
+        size_t cluster=grid.clusterIndex(x,y,z);
+        uint32_t count=0;
+        const uint32_t *list=grid.lightsInCluster(cluster,count);
+        listed+=count;
+        CHECK(std::is_sorted(list,list+count));
+
+        float bmin[3];
+        float bmax[3];
+        BoundingSphere cell;
+        froxelBounds(grid,xScale,yScale,x,y,z,bmin,bmax,cell);
+        float ndcMin[2]={-1.0f+2.0f*x/grid.dimX(),-1.0f+2.0f*y/grid.dimY()};
+        float ndcMax[2]={-1.0f+2.0f*(x+1)/grid.dimX(),-1.0f+2.0f*(y+1)/grid.dimY()};
+        float d0=sliceDepth(z,grid.dimZ());
+        float d1=sliceDepth(z+1,grid.dimZ());
+        reference.clear();
+        for(size_t i=0; i<lights.size(); ++i)
+        {
+          SpotCone cone=spotConeFromLight(lights[i]);
+          BoundingSphere sphere=coneBoundingSphere(cone);
+          if(sphereOverlapsFroxel(sphere,xScale,yScale,ndcMin,ndcMax,d0,d1) &&
+             sphereIntersectsAABB(sphere,bmin,bmax) && coneIntersectsSphere(cone,cell))
+          {
+            reference.push_back(static_cast<uint32_t>(i));
+          }
+        }
+        if(count != reference.size() || !std::equal(list,list+count,reference.begin()))
+        {
+          ++mismatched;
+        }
+
+        // points inside the froxel, every light that reaches one must be in the list
+        for(int s=0; s<SAMPLES; ++s)
+        {
+          float depth=sliceDepth(z,grid.dimZ())+positive(gen)*(sliceDepth(z+1,grid.dimZ())-sliceDepth(z,grid.dimZ()));
+          float nx=-1.0f+2.0f*(x+positive(gen))/grid.dimX();
+          float ny=-1.0f+2.0f*(y+positive(gen))/grid.dimY();
+          float p[3]={nx*depth/xScale,ny*depth/yScale,-depth};
+          for(size_t i=0; i<lights.size(); ++i)
+          {
+            if(pointLit(lights[i],p) && !std::binary_search(list,list+count,static_cast<uint32_t>(i)))
+            {
+              ++missed;
+            }
+          }
+        }
+      }
+    }
+  }
+  CHECK(listed == grid.indices().size());
+  CHECK(mismatched == 0);
+  CHECK(missed == 0);
+
+  // the slice of a depth is the last one starting at or before it
+  for(int s=0; s<1000; ++s)
+  {
+    float depth=ZNEAR*std::pow(ZFAR/ZNEAR,positive(gen));
+    unsigned int slice=0;
+    while(slice+1 < grid.dimZ() && sliceDepth(slice+1,grid.dimZ()) <= depth)
+    {
+      ++slice;
+    }
+    // a depth right on a boundary can round into either slice
+    unsigned int found=grid.sliceForDepth(depth);
+    CHECK(found == slice || found+1 == slice || found == slice+1);
+  }
+  CHECK(grid.sliceForDepth(0.0f) == 0);
+  CHECK(grid.sliceForDepth(ZFAR*2.0f) == grid.dimZ()-1);
+
+  std::printf("%zu lights, %zu clusters, %zu entries, %zu lists differ, %zu lit samples missed\n",lights.size(),
+              grid.numClusters(),listed,mismatched,missed);
+  return testResult();
+}
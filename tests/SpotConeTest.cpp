@@ -0,0 +1,198 @@
+/****************************************************************************
+Unit test of the spot cone bounds in SpotCone.h and LightCuller::reaches.
+A spot at the origin shining down is tested against spheres inside its
+cone, outside its angle, past its range and behind its apex, both shapes of
+coneBoundingSphere are checked against their expected centre and radius and
+against points on the cone, then random cones are checked for missing any
+sphere around a point they light. Returns EXIT_FAILURE on any failed check.
+usage : SpotConeTest
+****************************************************************************/
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "Check.h"
+#include "LightCuller.h"
+#include "SpotCone.h"
+
+constexpr static float DEGTORAD=3.14159265f/180.0f;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a spot at _position shining along the unit _direction
+//----------------------------------------------------------------------------------------------------------------------
+static LightStd140 spot(const float *_position, const float *_direction, float _cutoff, float _range)
+{
+  LightStd140 l=LightStd140();
+  for(int i=0; i<3; ++i)
+  {
+    l.m_position[i]=_position[i];
+    l.m_direction[i]=_direction[i];
+  }
+  l.m_position[3]=1.0f;
+  l.m_spotCosCutoff=std::cos(_cutoff*DEGTORAD);
+  l.m_range=_range;
+  return l;
+}
+
+static BoundingSphere sphere(float _x, float _y, float _z, float _radius)
+{
+  return {{_x,_y,_z},_radius};
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief both tests the culling makes should agree on a sphere
+//----------------------------------------------------------------------------------------------------------------------
+static bool lit(const LightStd140 &_light, const BoundingSphere &_sphere)
+{
+  bool cone=coneIntersectsSphere(spotConeFromLight(_light),_sphere);
+  bool reaches=LightCuller::reaches(_light,_sphere);
+  CHECK(cone == reaches);
+  return reaches;
+}
+
+static bool contains(const BoundingSphere &_sphere, const float *_p)
+{
+  float d=0.0f;
+  for(int i=0; i<3; ++i)
+  {
+    d+=(_p[i]-_sphere.m_centre[i])*(_p[i]-_sphere.m_centre[i]);
+  }
+  return std::sqrt(d) <= _sphere.m_radius*1.0001f+1e-5f;
+}
+
+static bool near(float _a, float _b)
+{
+  return std::fabs(_a-_b) <= 1e-4f*std::fmax(1.0f,std::fabs(_b));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the apex and points round the cap edge and cap centre of a cone must all be in its bounding sphere
+//----------------------------------------------------------------------------------------------------------------------
+static bool boundsCone(const SpotCone &_cone)
+{
+  BoundingSphere s=coneBoundingSphere(_cone);
+  if(!contains(s,_cone.m_apex))
+  {
+    return false;
+  }
+  // two unit vectors at right angles to the axis, u = t x a for any t not along it and w = a x u
+  const float *a=_cone.m_axis;
+  float t[3]={0.0f,0.0f,0.0f};
+  t[std::fabs(a[0]) < 0.9f ? 0 : 1]=1.0f;
+  float u[3]={t[1]*a[2]-t[2]*a[1],t[2]*a[0]-t[0]*a[2],t[0]*a[1]-t[1]*a[0]};
+  float len=std::sqrt(u[0]*u[0]+u[1]*u[1]+u[2]*u[2]);
+  for(int i=0; i<3; ++i)
+  {
+    u[i]/=len;
+  }
+  float w[3]={a[1]*u[2]-a[2]*u[1],a[2]*u[0]-a[0]*u[2],a[0]*u[1]-a[1]*u[0]};
+  for(int step=0; step<16; ++step)
+  {
+    float phi=step*2.0f*3.14159265f/16.0f;
+    // the cap is the part of the range sphere inside the cone, sample its edge and its middle
+    float along=_cone.m_range*_cone.m_cosAngle;
+    float across=_cone.m_range*_cone.m_sinAngle;
+    float edge[3];
+    float centre[3];
+    for(int i=0; i<3; ++i)
+    {
+      edge[i]=_cone.m_apex[i]+a[i]*along+(u[i]*std::cos(phi)+w[i]*std::sin(phi))*across;
+      centre[i]=_cone.m_apex[i]+a[i]*_cone.m_range;
+    }
+    if(!contains(s,edge) || !contains(s,centre))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main()
+{
+  const float origin[3]={0.0f,0.0f,0.0f};
+  const float down[3]={0.0f,-1.0f,0.0f};
+  // a 30 degree spot reaching 10 units down
+  LightStd140 light=spot(origin,down,30.0f,10.0f);
+
+  // inside the cone, on the axis and off it within the angle
+  CHECK(lit(light,sphere(0.0f,-5.0f,0.0f,0.5f)));
+  CHECK(lit(light,sphere(2.0f,-5.0f,0.0f,0.1f)));
+  // outside the angle, and a sphere outside it big enough to cross the cone surface
+  CHECK(!lit(light,sphere(5.0f,-2.0f,0.0f,0.5f)));
+  CHECK(!lit(light,sphere(0.0f,-5.0f,4.0f,0.5f)));
+  CHECK(lit(light,sphere(5.0f,-2.0f,0.0f,4.5f)));
+  // beyond the range, and straddling it
+  CHECK(!lit(light,sphere(0.0f,-12.0f,0.0f,0.5f)));
+  CHECK(!lit(light,sphere(0.0f,-10.6f,0.0f,0.5f)));
+  CHECK(lit(light,sphere(0.0f,-10.4f,0.0f,0.5f)));
+  // behind the apex, and over it
+  CHECK(!lit(light,sphere(0.0f,2.0f,0.0f,0.5f)));
+  CHECK(!lit(light,sphere(0.0f,0.6f,0.0f,0.5f)));
+  CHECK(lit(light,sphere(0.0f,0.4f,0.0f,0.5f)));
+
+  // a narrow cone is bounded by the sphere through its apex and cap edge, centred range/(2cos) down the axis
+  SpotCone narrow=spotConeFromLight(light);
+  BoundingSphere narrowBounds=coneBoundingSphere(narrow);
+  float narrowOffset=10.0f/(2.0f*std::cos(30.0f*DEGTORAD));
+  CHECK(near(narrowBounds.m_radius,narrowOffset));
+  CHECK(near(narrowBounds.m_centre[1],-narrowOffset));
+  CHECK(near(narrowBounds.m_centre[0],0.0f) && near(narrowBounds.m_centre[2],0.0f));
+  CHECK(boundsCone(narrow));
+  // a wide one by the sphere round its cap edge, which is smaller than the one through the apex
+  SpotCone wide=spotConeFromLight(spot(origin,down,60.0f,10.0f));
+  BoundingSphere wideBounds=coneBoundingSphere(wide);
+  CHECK(near(wideBounds.m_radius,10.0f*std::sin(60.0f*DEGTORAD)));
+  CHECK(near(wideBounds.m_centre[1],-10.0f*std::cos(60.0f*DEGTORAD)));
+  CHECK(wideBounds.m_radius < 10.0f/(2.0f*std::cos(60.0f*DEGTORAD)));
+  CHECK(boundsCone(wide));
+  // the two shapes meet at 45 degrees
+  SpotCone edge=spotConeFromLight(spot(origin,down,45.0f,10.0f));
+  CHECK(near(coneBoundingSphere(edge).m_radius,10.0f/std::sqrt(2.0f)));
+
+  // random cones must bound themselves and never miss a small sphere round a point they light
+  std::mt19937 gen(5678);
+  std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+  std::uniform_real_distribution<float> positive(0.0f,1.0f);
+  size_t unbounded=0;
+  size_t missed=0;
+  size_t tested=0;
+  for(int c=0; c<500; ++c)
+  {
+    float position[3]={unit(gen)*10.0f,unit(gen)*10.0f,unit(gen)*10.0f};
+    float d[3]={unit(gen),unit(gen),unit(gen)};
+    float len=std::sqrt(d[0]*d[0]+d[1]*d[1]+d[2]*d[2]);
+    if(len < 0.01f)
+    {
+      continue;
+    }
+    for(int i=0; i<3; ++i)
+    {
+      d[i]/=len;
+    }
+    LightStd140 l=spot(position,d,positive(gen)*88.0f+1.0f,positive(gen)*20.0f+0.5f);
+    SpotCone cone=spotConeFromLight(l);
+    if(!boundsCone(cone))
+    {
+      ++unbounded;
+    }
+    for(int p=0; p<200; ++p)
+    {
+      float q[3]={position[0]+unit(gen)*20.0f,position[1]+unit(gen)*20.0f,position[2]+unit(gen)*20.0f};
+      float v[3]={q[0]-position[0],q[1]-position[1],q[2]-position[2]};
+      float dist=std::sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+      bool inside=dist <= l.m_range && v[0]*d[0]+v[1]*d[1]+v[2]*d[2] >= l.m_spotCosCutoff*dist;
+      if(inside)
+      {
+        ++tested;
+        if(!lit(l,sphere(q[0],q[1],q[2],0.01f)))
+        {
+          ++missed;
+        }
+      }
+    }
+  }
+  CHECK(unbounded == 0);
+  CHECK(missed == 0);
+  CHECK(tested > 1000);
+  std::printf("%zu lit points tested, %zu missed, %zu cones outside their bounds\n",tested,missed,unbounded);
+  return testResult();
+}
@@ -0,0 +1,160 @@
+/****************************************************************************
+Unit test of SpotCurve against SpotAnimator. Random spots are stepped a
+tick at a time by every kernel the CPU runs, with the animation time wrapped
+in float the way SpotSimulation does it, and SpotCurve evaluated from the
+phase of each tick must land on the same direction, colour and range. The
+parameters are packed part way through so the colour mix is counted from a
+tick other than 0, and every cone stepped through must stay inside the
+envelope of its spot. Returns EXIT_FAILURE on any failed check.
+usage : SpotCurveTest
+****************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "SpotAnimator.h"
+#include "SpotCurve.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the spots are packed at this tick and compared for TICKS after it
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static int BASETICK=37;
+constexpr static int TICKS=400;
+constexpr static float TIMESTEP=0.2f;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the float time the animator is stepped with drifts from the double phase by a few ulp a tick
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static float TOLERANCE=1e-3f;
+
+static void randomise(size_t _count, SpotState &o_state)
+{
+  std::mt19937 gen(2468);
+  std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+  std::uniform_real_distribution<float> positive(0.0f,1.0f);
+  o_state.resize(_count);
+  for(size_t i=0; i<_count; ++i)
+  {
+    o_state.m_posX[i]=unit(gen)*3.0f;
+    o_state.m_posY[i]=2.0f+positive(gen)*4.0f;
+    o_state.m_posZ[i]=unit(gen)*3.0f;
+    o_state.m_centreX[i]=unit(gen)*12.0f;
+    o_state.m_centreZ[i]=unit(gen)*12.0f;
+    o_state.m_radiusX[i]=unit(gen)*2.0f+0.5f;
+    o_state.m_radiusZ[i]=unit(gen)*2.0f+0.5f;
+    o_state.m_timeOffset[i]=positive(gen)*4.0f+0.6f;
+    // a multiple of the step as changeSpotParams leaves it, so the stepped and closed form mix wrap together
+    o_state.m_mix[i]=std::floor(positive(gen)/SpotAnimator::MIXSTEP)*SpotAnimator::MIXSTEP;
+    o_state.m_startR[i]=positive(gen);
+    o_state.m_startG[i]=positive(gen);
+    o_state.m_startB[i]=positive(gen);
+    o_state.m_endR[i]=positive(gen);
+    o_state.m_endG[i]=positive(gen);
+    o_state.m_endB[i]=positive(gen);
+    float cutoff=(positive(gen)*40.0f+0.5f)*3.14159265f/180.0f;
+    o_state.m_cosCutoff[i]=std::cos(cutoff);
+    o_state.m_sinCutoff[i]=std::sin(cutoff);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the largest difference between a sample and the stepped spot, the range relative to its size
+//----------------------------------------------------------------------------------------------------------------------
+static float difference(const SpotCurve::Sample &_sample, const SpotState &_s, size_t _i)
+{
+  return std::max({std::fabs(_sample.m_dir[0]-_s.m_dirX[_i]),std::fabs(_sample.m_dir[1]-_s.m_dirY[_i]),
+                   std::fabs(_sample.m_dir[2]-_s.m_dirZ[_i]),std::fabs(_sample.m_colour[0]-_s.m_colourR[_i]),
+                   std::fabs(_sample.m_colour[1]-_s.m_colourG[_i]),std::fabs(_sample.m_colour[2]-_s.m_colourB[_i]),
+                   std::fabs(_sample.m_range-_s.m_range[_i])/_s.m_range[_i]});
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief does the envelope hold the cone a sample lights
+//----------------------------------------------------------------------------------------------------------------------
+static bool inside(const SpotCone &_envelope, const SpotCurve::Sample &_sample, float _cosCutoff)
+{
+  if(_sample.m_range > _envelope.m_range*1.0001f)
+  {
+    return false;
+  }
+  if(_envelope.m_cosAngle <= 0.0f)
+  {
+    return true;
+  }
+  float cosAxis=_sample.m_dir[0]*_envelope.m_axis[0]+_sample.m_dir[1]*_envelope.m_axis[1]+
+                _sample.m_dir[2]*_envelope.m_axis[2];
+  float reach=std::acos(std::min(cosAxis,1.0f))+std::acos(_cosCutoff);
+  return reach <= std::acos(_envelope.m_cosAngle)+1e-4f;
+}
+
+static void testKernel(SpotAnimator::Kernel _kernel)
+{
+  SpotState state;
+  randomise(1003,state);
+  SpotAnimator animator(_kernel);
+  float time=0.0f;
+  std::vector<SpotParamsStd430> params;
+  std::vector<SpotCone> envelopes;
+  float maxError=0.0f;
+  size_t outside=0;
+  for(int tick=0; tick<BASETICK+TICKS; ++tick)
+  {
+    if(tick == BASETICK)
+    {
+      // the mix values now are the ones at BASETICK, where the curve starts counting the mix from
+      SpotCurve::pack(state,params);
+      envelopes.resize(params.size());
+      std::transform(params.begin(),params.end(),envelopes.begin(),SpotCurve::envelope);
+    }
+    animator.update(state,time);
+    time=std::fmod(time+TIMESTEP,static_cast<float>(SpotAnimator::TWOPI));
+    if(tick < BASETICK)
+    {
+      continue;
+    }
+    float angle;
+    float mix;
+    SpotCurve::phase(tick,BASETICK,TIMESTEP,angle,mix);
+    for(size_t i=0; i<state.size(); ++i)
+    {
+      SpotCurve::Sample s=SpotCurve::evaluate(params[i],angle,mix);
+      maxError=std::max(maxError,difference(s,state,i));
+      outside+= inside(envelopes[i],s,params[i].m_cutoff[0]) ? 0 : 1;
+    }
+  }
+  std::printf("%-7s max error vs stepped %g, %zu cones outside their envelope\n",
+              SpotAnimator::kernelName(_kernel),maxError,outside);
+  CHECK(maxError < TOLERANCE);
+  CHECK(outside == 0);
+}
+
+int main()
+{
+  for(auto k : {SpotAnimator::Kernel::SCALAR,SpotAnimator::Kernel::SSE2,SpotAnimator::Kernel::AVX2})
+  {
+    if(SpotAnimator::isSupported(k))
+    {
+      testKernel(k);
+    }
+  }
+  // a whole turn later the spot is aimed the same way
+  SpotState state;
+  randomise(1,state);
+  std::vector<SpotParamsStd430> params;
+  SpotCurve::pack(state,params);
+  float angle;
+  float mix;
+  SpotCurve::phase(0.0,0.0,1.0f,angle,mix);
+  SpotCurve::Sample first=SpotCurve::evaluate(params[0],angle,mix);
+  SpotCurve::phase(SpotAnimator::TWOPI,0.0,1.0f,angle,mix);
+  SpotCurve::Sample turn=SpotCurve::evaluate(params[0],angle,mix);
+  for(int i=0; i<3; ++i)
+  {
+    CHECK(std::fabs(first.m_dir[i]-turn.m_dir[i]) < 1e-5f);
+  }
+  // before the parameters were set the mix stays where it was packed
+  SpotCurve::phase(3.0,10.0,1.0f,angle,mix);
+  CHECK(mix == 0.0f);
+  return testResult();
+}
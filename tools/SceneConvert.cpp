@@ -0,0 +1,227 @@
+/****************************************************************************
+Converts a text scene description into the binary scene file SpotLight
+maps with --scene. Each line of the description is one of
+
+  teapot <x> <y> <z> [y rotation in degrees] [scale]
+  matrix <16 floats, column major>
+  spot <x> <y> <z> <aim x> <aim z> <radius x> <radius z> <start r g b>
+       <end r g b> <time offset> <cutoff> <inner cutoff> <exponent>
+  grid <columns> <rows>
+  random-spots <count> <seed>
+
+grid adds the demo's teapot grid and random-spots scatters spots the way
+NGLScene::createLights does, so production sized test scenes take a line
+each. Blank lines and anything after a # are ignored. Instances are
+written as they are read so memory use doesn't grow with the scene.
+usage : SceneConvert <description or -> <scene file>
+****************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "SceneFile.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief write a teapot at a position turned about y and uniformly scaled, the same matrix as
+/// ngl::Transformation builds
+//----------------------------------------------------------------------------------------------------------------------
+static void addTeapot(SceneWriter &_writer, float _x, float _y, float _z, float _rotY, float _scale)
+{
+  float radians=_rotY*3.14159265358979f/180.0f;
+  float c=std::cos(radians)*_scale;
+  float s=std::sin(radians)*_scale;
+  const float model[SceneFile::MATRIXFLOATS]={   c, 0.0f,   -s, 0.0f,
+                                              0.0f,_scale, 0.0f, 0.0f,
+                                                 s, 0.0f,    c, 0.0f,
+                                                _x,   _y,   _z, 1.0f};
+  _writer.addInstance(model);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the demo's grid of teapots, two units apart and centred on the origin
+//----------------------------------------------------------------------------------------------------------------------
+static void addGrid(SceneWriter &_writer, int _columns, int _rows)
+{
+  for(int iz=0; iz<_rows; ++iz)
+  {
+    for(int ix=0; ix<_columns; ++ix)
+    {
+      int x=2*ix-_columns;
+      int z=2*iz-_rows;
+      addTeapot(_writer,static_cast<float>(x),0.49f,static_cast<float>(z),static_cast<float>((x*z)*20),1.0f);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief spots spread over an area growing with the count, with the ranges NGLScene::createLights uses
+//----------------------------------------------------------------------------------------------------------------------
+static void addRandomSpots(SceneWriter &_writer, size_t _count, unsigned int _seed)
+{
+  std::mt19937 gen(_seed);
+  std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+  std::uniform_real_distribution<float> positive(0.0f,1.0f);
+  float spread=3.0f*std::sqrt(std::max(1.0f,_count/8.0f));
+  for(size_t i=0; i<_count; ++i)
+  {
+    float spot[SceneFile::SPOTCOLUMNS];
+    float x=unit(gen)*spread;
+    float z=unit(gen)*spread;
+    spot[SceneFile::POSX]=x;
+    spot[SceneFile::POSY]=3.0f;
+    spot[SceneFile::POSZ]=z;
+    spot[SceneFile::CENTREX]=x*4.0f+unit(gen);
+    spot[SceneFile::CENTREZ]=z*4.0f+unit(gen);
+    spot[SceneFile::RADIUSX]=unit(gen)*2.0f+0.5f;
+    spot[SceneFile::RADIUSZ]=unit(gen)*2.0f+0.5f;
+    for(size_t c=SceneFile::STARTR; c<=SceneFile::ENDB; ++c)
+    {
+      spot[c]=std::max(0.4f,positive(gen));
+    }
+    spot[SceneFile::TIMEOFFSET]=positive(gen)*4.0f+0.6f;
+    spot[SceneFile::CUTOFF]=positive(gen)*24.0f+0.5f;
+    spot[SceneFile::INNERCUTOFF]=positive(gen)*12.0f+0.1f;
+    spot[SceneFile::EXPONENT]=positive(gen)*2.0f+1.0f;
+    _writer.addSpot(spot);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief read exactly _count floats from the rest of a line
+//----------------------------------------------------------------------------------------------------------------------
+static bool readFloats(std::istringstream &_line, float *o_values, size_t _count)
+{
+  for(size_t i=0; i<_count; ++i)
+  {
+    if(!(_line>>o_values[i]))
+    {
+      return false;
+    }
+  }
+  std::string extra;
+  return !(_line>>extra);
+}
+
+static bool convert(std::istream &_in, SceneWriter &_writer)
+{
+  std::string text;
+  size_t lineNumber=0;
+  while(std::getline(_in,text))
+  {
+    ++lineNumber;
+    text=text.substr(0,text.find('#'));
+    std::istringstream line(text);
+    std::string item;
+    if(!(line>>item))
+    {
+      continue;
+    }
+    bool ok=false;
+    if(item == "teapot")
+    {
+      // position then the optional rotation and scale
+      float v[5]={0.0f,0.0f,0.0f,0.0f,1.0f};
+      size_t count=0;
+      float value;
+      while(count<5 && line>>value)
+      {
+        v[count++]=value;
+      }
+      // anything left over, numbers or not, is an error
+      line.clear();
+      std::string extra;
+      ok=count >= 3 && !(line>>extra);
+      if(ok)
+      {
+        addTeapot(_writer,v[0],v[1],v[2],v[3],v[4]);
+      }
+    }
+    else if(item == "matrix")
+    {
+      float model[SceneFile::MATRIXFLOATS];
+      ok=readFloats(line,model,SceneFile::MATRIXFLOATS);
+      if(ok)
+      {
+        _writer.addInstance(model);
+      }
+    }
+    else if(item == "spot")
+    {
+      float spot[SceneFile::SPOTCOLUMNS];
+      ok=readFloats(line,spot,SceneFile::SPOTCOLUMNS);
+      if(ok)
+      {
+        _writer.addSpot(spot);
+      }
+    }
+    else if(item == "grid")
+    {
+      int columns=0;
+      int rows=0;
+      ok= (line>>columns>>rows) && columns > 0 && rows > 0;
+      if(ok)
+      {
+        addGrid(_writer,columns,rows);
+      }
+    }
+    else if(item == "random-spots")
+    {
+      long count=0;
+      unsigned int seed=1;
+      ok= (line>>count>>seed) && count > 0;
+      if(ok)
+      {
+        addRandomSpots(_writer,static_cast<size_t>(count),seed);
+      }
+    }
+    if(!ok)
+    {
+      std::cerr<<"line "<<lineNumber<<": can't read \""<<text<<"\"\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  if(argc != 3)
+  {
+    std::cerr<<"usage : SceneConvert <description or -> <scene file>\n";
+    return EXIT_FAILURE;
+  }
+  std::ifstream file;
+  std::string input=argv[1];
+  if(input != "-")
+  {
+    file.open(input);
+    if(!file.is_open())
+    {
+      std::cerr<<"unable to read "<<input<<"\n";
+      return EXIT_FAILURE;
+    }
+  }
+  SceneWriter writer;
+  if(!writer.begin(argv[2]))
+  {
+    std::cerr<<"unable to write "<<argv[2]<<"\n";
+    return EXIT_FAILURE;
+  }
+  if(!convert(input == "-" ? std::cin : file,writer))
+  {
+    writer.abort();
+    return EXIT_FAILURE;
+  }
+  if(!writer.finish())
+  {
+    std::cerr<<"unable to write "<<argv[2]<<"\n";
+    return EXIT_FAILURE;
+  }
+  std::printf("%s: %zu instances, %zu spots\n",argv[2],writer.numInstances(),writer.numSpots());
+  return EXIT_SUCCESS;
+}